@@ -0,0 +1,56 @@
+#include "bench_shared.hpp"
+#include "aggregate.hpp"
+#include <functional>
+#include <random>
+
+namespace {
+// The reduction loop aggregates used before the kernels: a type check and a std::function call per element
+auto reduce_with_callback(const jp::JSONArray &array,
+                          const std::function<jp::JSONDouble(jp::JSONDouble, jp::JSONDouble)> &fn,
+                          jp::JSONDouble initial) -> jp::JSONDouble {
+    auto result = initial;
+    for (const auto &item : array) {
+        if (item.is_integer()) {
+            result = fn(result, static_cast<jp::JSONDouble>(item.as_integer()));
+        } else if (item.is_double()) {
+            result = fn(result, item.as_double());
+        }
+    }
+    return result;
+}
+} // namespace
+
+auto main() -> int {
+    constexpr auto size = std::size_t{1'000'000};
+    auto rng = std::mt19937_64{42};
+    auto distribution = std::uniform_real_distribution<jp::JSONDouble>{-1000, 1000};
+
+    auto doubles = jp::JSONArray{};
+    auto integers = jp::JSONArray{};
+    for (auto i = std::size_t{0}; i < size; i++) {
+        doubles.push_back(jp::JSONValue{distribution(rng)});
+        integers.push_back(jp::JSONValue{static_cast<jp::JSONInteger>(distribution(rng))});
+    }
+
+    const auto packed = std::vector<jp::JSONDouble>(size, 1.5);
+
+    run_benchmark("callback sum (1M doubles)", 20, [&] {
+        do_not_optimize(reduce_with_callback(doubles, [](auto a, auto b) { return a + b; }, 0));
+    });
+    run_benchmark("callback max (1M doubles)", 20, [&] {
+        do_not_optimize(reduce_with_callback(doubles, [](auto a, auto b) { return std::max(a, b); },
+                                             std::numeric_limits<jp::JSONDouble>::lowest()));
+    });
+    run_benchmark("reduce<Sum> (1M doubles)", 20,
+                  [&] { do_not_optimize(query::aggregate::reduce<query::aggregate::Sum>(doubles)); });
+    run_benchmark("reduce<Max> (1M doubles)", 20,
+                  [&] { do_not_optimize(query::aggregate::reduce<query::aggregate::Max>(doubles)); });
+    run_benchmark("reduce<Sum> (1M integers)", 20,
+                  [&] { do_not_optimize(query::aggregate::reduce<query::aggregate::Sum>(integers)); });
+    run_benchmark("sum kernel (1M packed doubles)", 100,
+                  [&] { do_not_optimize(query::aggregate::sum(std::span<const jp::JSONDouble>{packed})); });
+    run_benchmark("max kernel (1M packed doubles)", 100,
+                  [&] { do_not_optimize(query::aggregate::max(std::span<const jp::JSONDouble>{packed})); });
+
+    return 0;
+}
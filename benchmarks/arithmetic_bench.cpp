@@ -0,0 +1,35 @@
+#include "bench_shared.hpp"
+#include "parser.hpp"
+#include "query_evaluator.hpp"
+#include "query_lexer.hpp"
+#include "query_parser.hpp"
+
+namespace {
+auto parse_query(const std::string &query) -> query::Expression {
+    auto [tokens, errors] = query::collect_tokens(query);
+    auto parser = query::Parser(tokens);
+    return std::move(*parser.parse());
+}
+
+void bench_expression(query::Evaluator &evaluator, const std::string &name, const std::string &query) {
+    const auto expression = parse_query(query);
+    run_benchmark(name, 1'000'000, [&] {
+        auto result = evaluator.evaluate_expression(expression);
+        do_not_optimize(result);
+    });
+}
+} // namespace
+
+auto main() -> int {
+    auto json = jp::parse(R"({"ts": 1700000000123, "id": 9007199254740993, "step": 1000, "x": 1.5, "y": 2.25})");
+    auto evaluator = query::Evaluator(&json.value());
+
+    bench_expression(evaluator, "int: ts - step * 60", "ts - step * 60");
+    bench_expression(evaluator, "int: id + id / step", "id + id / step");
+    bench_expression(evaluator, "int: (ts + 1) * 2 - ts", "(ts + 1) * 2 - ts");
+    bench_expression(evaluator, "int: -ts / 1000", "-ts / 1000");
+    bench_expression(evaluator, "double: x * y + x", "x * y + x");
+    bench_expression(evaluator, "mixed: ts * x - y", "ts * x - y");
+
+    return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+template <typename T> inline void do_not_optimize(const T &value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+struct BenchResult {
+    std::string name;
+    std::size_t iterations;
+    double ns_per_op;
+};
+
+// Runs `fn` `iterations` times after a short warm-up and prints the time per call
+template <typename F> auto run_benchmark(std::string_view name, std::size_t iterations, F &&fn) -> BenchResult {
+    for (auto i = std::size_t{0}; i < iterations / 10 + 1; i++) {
+        fn();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (auto i = std::size_t{0}; i < iterations; i++) {
+        fn();
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    const auto ns_per_op =
+        static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()) /
+        static_cast<double>(iterations);
+
+    std::cout << std::left << std::setw(40) << name << std::right << std::setw(12) << std::fixed
+              << std::setprecision(1) << ns_per_op << " ns/op" << std::endl;
+
+    return BenchResult{std::string{name}, iterations, ns_per_op};
+}
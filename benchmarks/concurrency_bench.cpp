@@ -0,0 +1,85 @@
+#include "bench_shared.hpp"
+#include "query_evaluator.hpp"
+#include "query_lexer.hpp"
+#include "query_parser.hpp"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace {
+auto parse_query(const std::string &query) -> query::Expression {
+    auto [tokens, errors] = query::collect_tokens(query);
+    auto parser = query::Parser(tokens);
+    return std::move(*parser.parse());
+}
+
+// Every thread runs the whole query mix `rounds` times against the same evaluator, returns queries per second
+auto throughput(const query::Evaluator &evaluator, const std::vector<query::Expression> &queries,
+                std::size_t thread_count, std::size_t rounds) -> double {
+    const auto start = std::chrono::steady_clock::now();
+
+    auto threads = std::vector<std::thread>{};
+    for (auto t = std::size_t{0}; t < thread_count; t++) {
+        threads.emplace_back([&] {
+            for (auto round = std::size_t{0}; round < rounds; round++) {
+                for (const auto &query : queries) {
+                    auto result = evaluator.evaluate_expression(query);
+                    do_not_optimize(result);
+                }
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return static_cast<double>(thread_count * rounds * queries.size()) / elapsed;
+}
+} // namespace
+
+// Usage: concurrency_bench [max_threads] [elements]
+// Runs a mix of queries on 1, 2, 4, ... threads sharing one evaluator and one document. Nothing is locked during
+// evaluation, so throughput should grow with the thread count up to the number of cores.
+auto main(int argc, char *argv[]) -> int {
+    const auto hardware = std::max(1u, std::thread::hardware_concurrency());
+    const auto max_threads = argc > 1 ? std::stoull(argv[1]) : std::size_t{hardware};
+    const auto size = argc > 2 ? std::stoull(argv[2]) : std::size_t{10'000};
+
+    auto items = jp::JSONArray{};
+    items.reserve(size);
+    for (auto i = std::size_t{0}; i < size; i++) {
+        auto item = jp::JSONObject{};
+        item.emplace("id", jp::JSONValue{static_cast<jp::JSONInteger>(i)});
+        item.emplace("price", jp::JSONValue{static_cast<jp::JSONDouble>(i % 1000) / 10});
+        items.push_back(jp::JSONValue{std::move(item)});
+    }
+    auto root = jp::JSONObject{};
+    root.emplace("items", jp::JSONValue{std::move(items)});
+    const auto json = jp::JSONValue{std::move(root)};
+
+    // Reductions stay on the calling thread, the benchmark measures independent queries running side by side
+    auto evaluator = query::Evaluator(&json);
+    auto queries = std::vector<query::Expression>{};
+    for (const auto *query : {"items[42].price", "sum(items[*].price)", "size(items[?(price > 50)])",
+                              "first(items[?(price > 90)])", "avg(items[*].price * 2)", "items[?(id == 7)]"}) {
+        queries.push_back(parse_query(query));
+        evaluator.bind(queries.back());
+    }
+
+    const auto rounds = std::max<std::size_t>(1, 2'000'000 / size);
+    std::cout << "hardware threads: " << hardware << std::endl;
+
+    auto baseline = 0.0;
+    for (auto threads = std::size_t{1}; threads <= max_threads; threads *= 2) {
+        const auto qps = throughput(evaluator, queries, threads, rounds);
+        if (threads == 1) {
+            baseline = qps;
+        }
+        std::cout << std::left << std::setw(12) << (std::to_string(threads) + " threads") << std::right
+                  << std::setw(14) << std::fixed << std::setprecision(0) << qps << " queries/s" << std::setw(10)
+                  << std::setprecision(2) << qps / baseline << "x" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Synthetic documents for the benchmarks. Each generator writes a document of at least `target_bytes` that only
+// depends on its arguments, so runs on different machines and standard libraries measure the same input. Numbers are
+// never negative, the lexer doesn't accept a sign.
+namespace generators {
+
+// splitmix64, the standard distributions aren't specified precisely enough to be reproducible across libraries
+class Random {
+  public:
+    explicit Random(std::uint64_t seed) : state(seed) {}
+
+    auto next() -> std::uint64_t {
+        auto z = (state += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    auto below(std::uint64_t bound) -> std::uint64_t { return next() % bound; }
+
+  private:
+    std::uint64_t state;
+};
+
+// Chains of objects and arrays `depth` levels deep: {"items": [{"a": [{"a": [... 1 ...]}]}, ...]}
+inline auto deep_nesting(std::size_t target_bytes, std::size_t depth = 64) -> std::string {
+    auto json = std::string{R"({"items": [)"};
+    auto chains = std::size_t{0};
+    while (json.size() < target_bytes) {
+        json += chains++ == 0 ? "" : ", ";
+        for (auto level = std::size_t{0}; level < depth; level++) {
+            json += R"({"a": [)";
+        }
+        json += std::to_string(chains);
+        for (auto level = std::size_t{0}; level < depth; level++) {
+            json += "]}";
+        }
+    }
+    json += "]}";
+    return json;
+}
+
+// A single object with one member per key: {"key_0": 0, "key_1": "value 7", ...}
+inline auto wide_object(std::size_t target_bytes) -> std::string {
+    auto random = Random{1};
+    auto json = std::string{"{"};
+    for (auto key = std::size_t{0}; json.size() < target_bytes; key++) {
+        json += std::format(R"({}"key_{}": )", key == 0 ? "" : ", ", key);
+        if (random.below(2) == 0) {
+            json += std::to_string(random.below(1'000'000));
+        } else {
+            json += std::format(R"("value {}")", random.below(1'000'000));
+        }
+    }
+    json += "}";
+    return json;
+}
+
+// Integers, decimals and numbers with exponents: {"values": [...]}
+inline auto number_heavy(std::size_t target_bytes) -> std::string {
+    auto random = Random{2};
+    auto json = std::string{R"({"values": [)"};
+    for (auto i = std::size_t{0}; json.size() < target_bytes; i++) {
+        json += i == 0 ? "" : ", ";
+        switch (random.below(3)) {
+        case 0:
+            json += std::to_string(random.below(10'000'000'000));
+            break;
+        case 1:
+            json += std::format("{}.{}", random.below(100'000), random.below(1000));
+            break;
+        default:
+            json += std::format("{}.{}e{}", random.below(10), random.below(100), random.below(20));
+            break;
+        }
+    }
+    json += "]}";
+    return json;
+}
+
+// Strings with every kind of escape: {"strings": ["line\nbreak \"quoted\" \\ é ...", ...]}
+inline auto string_heavy(std::size_t target_bytes) -> std::string {
+    constexpr std::string_view pieces[] = {"plain text", R"(\n)", R"(\"quoted\")", R"(\\)", R"(é)", R"(\t)",
+                                           "a somewhat longer run of ordinary characters", R"(\/)"};
+    auto random = Random{3};
+    auto json = std::string{R"({"strings": [)"};
+    for (auto i = std::size_t{0}; json.size() < target_bytes; i++) {
+        json += i == 0 ? "\"" : ", \"";
+        const auto length = 1 + random.below(8);
+        for (auto piece = std::size_t{0}; piece < length; piece++) {
+            json += pieces[random.below(std::size(pieces))];
+            json += ' ';
+        }
+        json += '"';
+    }
+    json += "]}";
+    return json;
+}
+
+// The typical API response: {"items": [{"id": 0, "name": "item 0", "price": 12.5, "tags": [...], ...}, ...]}
+inline auto records(std::size_t target_bytes) -> std::string {
+    constexpr std::string_view tags[] = {"red", "green", "blue", "sale", "new", "used"};
+    auto random = Random{4};
+    auto json = std::string{R"({"items": [)"};
+    for (auto id = std::size_t{0}; json.size() < target_bytes; id++) {
+        json += std::format(R"({}{{"id": {}, "name": "item {}", "price": {}.{}, "stock": {}, "active": {}, )",
+                            id == 0 ? "" : ", ", id, id, random.below(1000), random.below(100), random.below(500),
+                            random.below(2) == 0 ? "true" : "false");
+        json += R"("tags": [)";
+        const auto tag_count = random.below(4);
+        for (auto tag = std::size_t{0}; tag < tag_count; tag++) {
+            json += std::format(R"({}"{}")", tag == 0 ? "" : ", ", tags[random.below(std::size(tags))]);
+        }
+        json += std::format(R"(], "owner": {{"id": {}, "region": "r{}"}}, "note": null}})", random.below(10'000),
+                            random.below(16));
+    }
+    json += "]}";
+    return json;
+}
+
+struct Document {
+    std::string_view name;
+    std::string json;
+};
+
+inline auto all(std::size_t target_bytes) -> std::vector<Document> {
+    return {{"deep_nesting", deep_nesting(target_bytes)},
+            {"wide_object", wide_object(target_bytes)},
+            {"number_heavy", number_heavy(target_bytes)},
+            {"string_heavy", string_heavy(target_bytes)},
+            {"records", records(target_bytes)}};
+}
+
+} // namespace generators
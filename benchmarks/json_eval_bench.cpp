@@ -0,0 +1,197 @@
+#include "bench_shared.hpp"
+#include "generators.hpp"
+#include "jsonobject.hpp"
+#include "lexer.hpp"
+#include "memory.hpp"
+#include "parser.hpp"
+#include "query_evaluator.hpp"
+#include "query_lexer.hpp"
+#include "query_parser.hpp"
+#include <format>
+#include <functional>
+#include <optional>
+#include <vector>
+
+namespace {
+
+struct Options {
+    double min_seconds = 0.5;
+    std::size_t size = std::size_t{1} << 20;
+    std::string filter;
+};
+
+struct Measurement {
+    std::string name;
+    std::string group;
+    std::string input;
+    // Bytes of input one operation processes, 0 where throughput doesn't apply
+    std::size_t bytes = 0;
+    std::size_t iterations = 0;
+    double ns_per_op = 0;
+    double allocations_per_op = 0;
+    double allocated_bytes_per_op = 0;
+
+    [[nodiscard]] auto mb_per_s() const -> double {
+        return bytes == 0 ? 0.0 : static_cast<double>(bytes) / ns_per_op * 1e9 / 1e6;
+    }
+};
+
+// Doubles the iterations until a run takes `min_seconds`, then counts the allocations of one more call. Counting is
+// off while timing, so the atomic increments don't show up in ns/op.
+auto measure(const Options &options, std::string_view group, std::string_view input, std::size_t bytes,
+             const std::function<void()> &fn) -> std::optional<Measurement> {
+    auto result = Measurement{.name = std::format("{}/{}", group, input),
+                              .group = std::string{group},
+                              .input = std::string{input},
+                              .bytes = bytes};
+    if (!options.filter.empty() && result.name.find(options.filter) == std::string::npos) {
+        return std::nullopt;
+    }
+
+    fn();
+    for (auto iterations = std::size_t{1};; iterations *= 2) {
+        const auto start = std::chrono::steady_clock::now();
+        for (auto i = std::size_t{0}; i < iterations; i++) {
+            fn();
+        }
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (elapsed >= options.min_seconds || iterations >= (std::size_t{1} << 30)) {
+            result.iterations = iterations;
+            result.ns_per_op = elapsed * 1e9 / static_cast<double>(iterations);
+            break;
+        }
+    }
+
+    jp::memory::reset();
+    jp::memory::start_counting();
+    fn();
+    jp::memory::stop_counting();
+    const auto allocated = jp::memory::total();
+    result.allocations_per_op = static_cast<double>(allocated.allocations);
+    result.allocated_bytes_per_op = static_cast<double>(allocated.bytes);
+
+    std::cerr << std::left << std::setw(40) << result.name << std::right << std::setw(14) << std::fixed
+              << std::setprecision(1) << result.ns_per_op << " ns/op" << std::setw(10) << result.mb_per_s()
+              << " MB/s" << std::setw(10) << std::setprecision(0) << result.allocations_per_op << " allocs/op"
+              << std::endl;
+    return result;
+}
+
+auto parse_query(std::string_view query) -> query::Expression {
+    auto [tokens, errors] = query::collect_tokens(query);
+    auto parser = query::Parser(tokens);
+    return std::move(*parser.parse());
+}
+
+void print_json(const std::vector<Measurement> &results, std::ostream &out) {
+    out << R"({"benchmarks": [)";
+    for (auto i = std::size_t{0}; i < results.size(); i++) {
+        const auto &result = results[i];
+        out << (i == 0 ? "\n" : ",\n")
+            << std::format(R"(  {{"name": "{}", "group": "{}", "input": "{}", "bytes": {}, "iterations": {}, )",
+                           result.name, result.group, result.input, result.bytes, result.iterations)
+            << std::format(R"("ns_per_op": {:.1f}, "mb_per_s": {:.2f}, "allocs_per_op": {:.0f}, )", result.ns_per_op,
+                           result.mb_per_s(), result.allocations_per_op)
+            << std::format(R"("bytes_allocated_per_op": {:.0f}}})", result.allocated_bytes_per_op);
+    }
+    out << "\n]}\n";
+}
+
+auto parse_options(int argc, char *argv[]) -> std::optional<Options> {
+    auto options = Options{};
+    for (auto i = 1; i < argc; i++) {
+        const auto arg = std::string_view{argv[i]};
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return std::nullopt;
+        }
+        if (arg == "--min-time") {
+            options.min_seconds = std::stod(argv[++i]);
+        } else if (arg == "--size") {
+            options.size = std::stoull(argv[++i]);
+        } else if (arg == "--filter") {
+            options.filter = argv[++i];
+        } else {
+            std::cerr << "Unknown option " << arg << std::endl;
+            return std::nullopt;
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+// Usage: json-eval-bench [--min-time <seconds>] [--size <bytes>] [--filter <substring>]
+// Lexes, parses and prints generated documents of about `size` bytes each, and parses and evaluates queries over the
+// records document. Results go to stdout as JSON, progress to stderr, so `json-eval-bench > results.json` keeps a
+// comparable record of a run.
+auto main(int argc, char *argv[]) -> int {
+    const auto options = parse_options(argc, argv);
+    if (!options) {
+        return 1;
+    }
+
+    auto results = std::vector<Measurement>{};
+    const auto record = [&](std::optional<Measurement> measurement) {
+        if (measurement) {
+            results.push_back(std::move(*measurement));
+        }
+    };
+
+    const auto documents = generators::all(options->size);
+    for (const auto &document : documents) {
+        record(measure(*options, "lexer", document.name, document.json.size(), [&] {
+            auto lexer = jp::Lexer(document.json);
+            auto tokens = std::size_t{0};
+            while (auto token = lexer.next_token()) {
+                tokens++;
+            }
+            do_not_optimize(tokens);
+        }));
+
+        auto [tokens, errors] = jp::collect_tokens(document.json);
+        record(measure(*options, "parser", document.name, document.json.size(), [&] {
+            auto parser = jp::Parser(tokens);
+            auto value = parser.parse();
+            do_not_optimize(value);
+        }));
+
+        const auto value = jp::Parser(tokens).parse();
+        record(measure(*options, "to_string", document.name, document.json.size(), [&] {
+            auto text = jp::to_string(*value);
+            do_not_optimize(text);
+        }));
+    }
+
+    constexpr std::pair<std::string_view, std::string_view> queries[] = {
+        {"member", "items[100].name"},
+        {"filter", "items[?(price > 500)]"},
+        {"aggregate", "sum(items[*].price)"},
+        {"arithmetic", "items[10].price * 2 + items[20].price"},
+        {"top_k", "top_k(items[*].price, 10)"},
+    };
+
+    for (const auto &[name, query] : queries) {
+        record(measure(*options, "query_parser", name, query.size(), [&] {
+            auto [tokens, errors] = query::collect_tokens(query);
+            auto expression = query::Parser(tokens).parse();
+            do_not_optimize(expression);
+        }));
+    }
+
+    const auto &records = documents.back();
+    const auto records_value = jp::parse(records.json);
+    const auto evaluator = query::Evaluator(&*records_value);
+    for (const auto &[name, query] : queries) {
+        // Bound once like json-eval does, so the timed loop doesn't pay for looking functions up by name
+        auto expression = parse_query(query);
+        evaluator.bind(expression);
+        record(measure(*options, "evaluator", name, 0, [&] {
+            auto result = evaluator.evaluate_expression(expression);
+            do_not_optimize(result);
+        }));
+    }
+
+    print_json(results, std::cout);
+    return 0;
+}
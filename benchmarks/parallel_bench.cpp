@@ -0,0 +1,41 @@
+#include "bench_shared.hpp"
+#include "aggregate.hpp"
+#include <random>
+#include <format>
+#include <thread>
+
+// Usage: parallel_bench [elements] [max_threads]
+auto main(int argc, char *argv[]) -> int {
+    const auto size = argc > 1 ? std::stoull(argv[1]) : std::size_t{10'000'000};
+
+    auto rng = std::mt19937_64{42};
+    auto distribution = std::uniform_real_distribution<jp::JSONDouble>{-1000, 1000};
+    auto values = jp::JSONArray{};
+    values.reserve(size);
+    for (auto i = std::size_t{0}; i < size; i++) {
+        values.push_back(jp::JSONValue{distribution(rng)});
+    }
+
+    const auto max_threads = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2]))
+                                      : std::max(1u, std::thread::hardware_concurrency());
+    auto baseline = 0.0;
+
+    for (auto threads = 1u; threads <= max_threads; threads *= 2) {
+        auto pool = std::make_unique<jp::ThreadPool>(threads);
+        auto *pool_ptr = threads == 1 ? nullptr : pool.get();
+
+        const auto sum = run_benchmark(std::format("sum, {} thread(s)", threads), 5, [&] {
+            do_not_optimize(query::aggregate::reduce<query::aggregate::Sum>(values, pool_ptr, 0));
+        });
+        run_benchmark(std::format("max, {} thread(s)", threads), 5, [&] {
+            do_not_optimize(query::aggregate::reduce<query::aggregate::Max>(values, pool_ptr, 0));
+        });
+
+        if (threads == 1) {
+            baseline = sum.ns_per_op;
+        }
+        std::cout << "  sum speedup: " << baseline / sum.ns_per_op << "x" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include "bench_shared.hpp"
+#include "query_evaluator.hpp"
+#include "query_lexer.hpp"
+#include "query_parser.hpp"
+
+namespace {
+auto parse_query(const std::string &query) -> query::Expression {
+    auto [tokens, errors] = query::collect_tokens(query);
+    auto parser = query::Parser(tokens);
+    return std::move(*parser.parse());
+}
+
+void bench_expression(query::Evaluator &evaluator, const std::string &name, const std::string &query,
+                      std::size_t iterations) {
+    const auto expression = parse_query(query);
+    run_benchmark(name, iterations, [&] {
+        auto result = evaluator.evaluate_expression(expression);
+        do_not_optimize(result);
+    });
+}
+} // namespace
+
+// Usage: pipeline_bench [elements]
+// Pipelines over an array of objects. The "materialized" cases build the intermediate array like every query did
+// before evaluation became lazy, the others fold or stop early without building it.
+auto main(int argc, char *argv[]) -> int {
+    const auto size = argc > 1 ? std::stoull(argv[1]) : std::size_t{1'000'000};
+
+    auto items = jp::JSONArray{};
+    items.reserve(size);
+    for (auto i = std::size_t{0}; i < size; i++) {
+        auto item = jp::JSONObject{};
+        item.emplace("id", jp::JSONValue{static_cast<jp::JSONInteger>(i)});
+        item.emplace("price", jp::JSONValue{static_cast<jp::JSONDouble>(i % 1000) / 10});
+        items.push_back(jp::JSONValue{std::move(item)});
+    }
+    auto root = jp::JSONObject{};
+    root.emplace("items", jp::JSONValue{std::move(items)});
+    const auto json = jp::JSONValue{std::move(root)};
+
+    auto evaluator = query::Evaluator(&json);
+
+    bench_expression(evaluator, "materialized: items[?(price > 50)]", "items[?(price > 50)]", 5);
+    bench_expression(evaluator, "lazy: size(items[?(price > 50)])", "size(items[?(price > 50)])", 5);
+    bench_expression(evaluator, "lazy: first(items[?(price > 50)])", "first(items[?(price > 50)])", 100'000);
+    bench_expression(evaluator, "materialized: items[*].price * 2", "items[*].price * 2", 5);
+    bench_expression(evaluator, "lazy: sum(items[*].price * 2)", "sum(items[*].price * 2)", 5);
+
+    return 0;
+}
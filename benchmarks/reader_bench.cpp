@@ -0,0 +1,89 @@
+#include "bench_shared.hpp"
+#include "file_reader.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+namespace {
+auto create_files(const std::filesystem::path &directory, std::size_t count) -> std::vector<std::string> {
+    std::filesystem::create_directories(directory);
+
+    auto paths = std::vector<std::string>{};
+    paths.reserve(count);
+    for (auto i = std::size_t{0}; i < count; i++) {
+        auto path = (directory / (std::to_string(i) + ".json")).string();
+        if (!std::filesystem::exists(path)) {
+            auto file = std::ofstream{path};
+            file << R"({"id": )" << i << R"(, "name": "item )" << i << R"(", "tags": ["a", "b"], "price": )"
+                 << static_cast<double>(i % 1000) / 10 << "}";
+        }
+        paths.push_back(std::move(path));
+    }
+    return paths;
+}
+
+// The way main.cpp read a document before the file reader
+auto istreambuf_file(const std::string &path) -> std::optional<std::string> {
+    auto file = std::ifstream{path};
+    return std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+}
+
+// Reads every file once, returns the best time per file out of a few runs in nanoseconds
+template <typename Read> auto time_per_file(const std::vector<std::string> &paths, const Read &read) -> double {
+    auto best = 0.0;
+    for (auto run = 0; run < 3; run++) {
+        auto bytes = std::size_t{0};
+        const auto start = std::chrono::steady_clock::now();
+        read([&](std::size_t, std::optional<std::string> content) { bytes += content ? content->size() : 0; });
+        const auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start);
+        do_not_optimize(bytes);
+
+        const auto per_file = elapsed.count() / static_cast<double>(paths.size());
+        best = run == 0 ? per_file : std::min(best, per_file);
+    }
+    return best;
+}
+
+void report(std::string_view name, double ns_per_file, double baseline) {
+    std::cout << std::left << std::setw(24) << name << std::right << std::setw(10) << std::fixed
+              << std::setprecision(0) << ns_per_file << " ns/file" << std::setw(10) << std::setprecision(2)
+              << baseline / ns_per_file << "x" << std::endl;
+}
+} // namespace
+
+// Usage: reader_bench [directory] [files]
+// Reads many small files, created in `directory` on the first run, with the ifstream loop main.cpp used, with pread
+// and with io_uring. The files are in the page cache after the first run, so this measures the system call
+// overhead, not the disk.
+auto main(int argc, char *argv[]) -> int {
+    const auto directory = std::filesystem::path{argc > 1 ? argv[1] : "/tmp/json-eval-reader-bench"};
+    const auto count = argc > 2 ? std::stoull(argv[2]) : std::size_t{100'000};
+    const auto paths = create_files(directory, count);
+
+    const auto istreambuf = time_per_file(paths, [&](const jp::FileReader::Callback &on_file) {
+        for (auto i = std::size_t{0}; i < paths.size(); i++) {
+            on_file(i, istreambuf_file(paths[i]));
+        }
+    });
+    report("ifstream", istreambuf, istreambuf);
+
+    for (const auto backend : {jp::FileReader::Backend::Pread, jp::FileReader::Backend::IoUring}) {
+        auto reader = jp::FileReader{64, backend};
+        if (reader.backend() != backend) {
+            std::cout << "io_uring is not available, skipped" << std::endl;
+            continue;
+        }
+
+        const auto ns = time_per_file(paths, [&](const jp::FileReader::Callback &on_file) {
+            // Batches like the reader threads of the CLI take them
+            for (auto first = std::size_t{0}; first < paths.size(); first += 1024) {
+                reader.read(paths, first, std::min<std::size_t>(1024, paths.size() - first), on_file);
+            }
+        });
+        report(backend == jp::FileReader::Backend::Pread ? "pread" : "io_uring", ns, istreambuf);
+    }
+
+    return 0;
+}
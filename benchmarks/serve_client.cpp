@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+auto connect_to(const std::string &path) -> int {
+    auto address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    std::ranges::copy(path.substr(0, sizeof(address.sun_path) - 1), address.sun_path);
+
+    const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0) {
+        std::perror(path.c_str());
+        return -1;
+    }
+    return fd;
+}
+
+// Sends `count` queries one at a time and records the round trip of each, in microseconds
+auto run_client(const std::string &path, const std::vector<std::string> &queries, std::size_t count,
+                std::vector<double> &latencies) -> bool {
+    const auto fd = connect_to(path);
+    if (fd < 0) {
+        return false;
+    }
+
+    auto buffer = std::string{};
+    auto chunk = std::array<char, 1 << 16>{};
+    for (auto i = std::size_t{0}; i < count; i++) {
+        const auto request = queries[i % queries.size()] + '\n';
+        const auto start = Clock::now();
+        if (::write(fd, request.data(), request.size()) != static_cast<ssize_t>(request.size())) {
+            ::close(fd);
+            return false;
+        }
+
+        auto newline = buffer.find('\n');
+        while (newline == std::string::npos) {
+            const auto read = ::read(fd, chunk.data(), chunk.size());
+            if (read <= 0) {
+                ::close(fd);
+                return false;
+            }
+            buffer.append(chunk.data(), static_cast<std::size_t>(read));
+            newline = buffer.find('\n');
+        }
+        buffer.erase(0, newline + 1);
+
+        latencies.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+
+    ::close(fd);
+    return true;
+}
+} // namespace
+
+// Usage: serve_client <socket> [clients] [requests_per_client] [query]...
+// Connects `clients` clients to a running `json-eval --serve --socket <socket>`, each sending its requests one at a
+// time, and reports the round-trip latency percentiles and the total throughput.
+auto main(int argc, char *argv[]) -> int {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <socket> [clients] [requests_per_client] [query]..." << std::endl;
+        return 1;
+    }
+
+    const auto path = std::string{argv[1]};
+    const auto clients = argc > 2 ? std::stoull(argv[2]) : std::size_t{4};
+    const auto count = argc > 3 ? std::stoull(argv[3]) : std::size_t{10'000};
+    auto queries = std::vector<std::string>(argv + std::min(argc, 4), argv + argc);
+    if (queries.empty()) {
+        queries = {"size(items)", "items[42]", "sum(items[*].price)", "size(items[?(price > 50)])"};
+    }
+
+    auto latencies = std::vector<std::vector<double>>(clients);
+    auto succeeded = std::vector<char>(clients, 0);
+    const auto start = Clock::now();
+
+    auto threads = std::vector<std::thread>{};
+    for (auto c = std::size_t{0}; c < clients; c++) {
+        threads.emplace_back([&, c] { succeeded[c] = run_client(path, queries, count, latencies[c]) ? 1 : 0; });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    const auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    if (std::ranges::count(succeeded, 0) != 0) {
+        std::cerr << "A client lost its connection" << std::endl;
+        return 1;
+    }
+
+    auto all = std::vector<double>{};
+    for (const auto &client : latencies) {
+        all.insert(all.end(), client.begin(), client.end());
+    }
+    std::ranges::sort(all);
+    const auto percentile = [&](double q) {
+        return all[std::min(all.size() - 1, static_cast<std::size_t>(q * static_cast<double>(all.size())))];
+    };
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "requests:   " << all.size() << " from " << clients << " clients" << std::endl;
+    std::cout << "throughput: " << static_cast<double>(all.size()) / elapsed << " requests/s" << std::endl;
+    std::cout << "p50:        " << percentile(0.5) << " us" << std::endl;
+    std::cout << "p90:        " << percentile(0.9) << " us" << std::endl;
+    std::cout << "p99:        " << percentile(0.99) << " us" << std::endl;
+    std::cout << "max:        " << all.back() << " us" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include "memory.hpp"
+#include <cstdlib>
+#include <new>
+
+// Replaces the global operator new and delete to count allocations for memory.hpp. Linked only into programs that
+// count, see the AllocationCounting library, every other program keeps the standard allocator.
+
+namespace {
+// Runs before main, so --stats knows whether the counts mean anything
+const auto registered = (jp::memory::detail::mark_counting_available(), true);
+} // namespace
+
+// The allocation functions every other form of new and delete ends up in
+auto operator new(std::size_t size) -> void * {
+    jp::memory::detail::count_allocation(size);
+    if (auto *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+auto operator new(std::size_t size, std::align_val_t alignment) -> void * {
+    jp::memory::detail::count_allocation(size);
+    const auto align = static_cast<std::size_t>(alignment);
+    // aligned_alloc wants a multiple of the alignment
+    if (auto *memory = std::aligned_alloc(align, (size + align - 1) / align * align)) {
+        return memory;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *memory) noexcept {
+    if (memory != nullptr) {
+        jp::memory::detail::count_free();
+    }
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t /*alignment*/) noexcept {
+    if (memory != nullptr) {
+        jp::memory::detail::count_free();
+    }
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t /*size*/) noexcept { operator delete(memory); }
+
+void operator delete(void *memory, std::size_t /*size*/, std::align_val_t alignment) noexcept {
+    operator delete(memory, alignment);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+namespace jp {
+
+// Blocking FIFO holding at most `capacity` elements. Producers wait while it is full, which slows them down to the
+// pace of the consumers, and consumers wait while it is empty.
+template <typename T> class BoundedQueue {
+  public:
+    explicit BoundedQueue(std::size_t capacity) : capacity(capacity == 0 ? 1 : capacity) {}
+
+    // Returns false, dropping the value, if the queue was closed
+    auto push(T value) -> bool {
+        auto lock = std::unique_lock{mutex};
+        not_full.wait(lock, [&] { return closed || elements.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+
+        elements.push_back(std::move(value));
+        lock.unlock();
+        not_empty.notify_one();
+        return true;
+    }
+
+    // Returns std::nullopt once the queue is closed and every element was taken
+    auto pop() -> std::optional<T> {
+        auto lock = std::unique_lock{mutex};
+        not_empty.wait(lock, [&] { return closed || !elements.empty(); });
+        if (elements.empty()) {
+            return std::nullopt;
+        }
+
+        auto value = std::move(elements.front());
+        elements.pop_front();
+        lock.unlock();
+        not_full.notify_one();
+        return value;
+    }
+
+    // No more elements are accepted, consumers still drain the ones already queued
+    void close() {
+        {
+            auto lock = std::scoped_lock{mutex};
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+  private:
+    std::size_t capacity;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    std::deque<T> elements;
+    bool closed = false;
+};
+
+} // namespace jp
@@ -13,6 +13,8 @@ constexpr auto is_lowercase_alphabetic(char c) -> bool { return (c >= 'a' && c <
 constexpr auto is_uppercase_alphabetic(char c) -> bool { return (c >= 'A' && c <= 'Z'); }
 constexpr auto is_alphabetic(char c) -> bool { return is_lowercase_alphabetic(c) || is_uppercase_alphabetic(c); }
 constexpr auto is_alphanumeric(char c) -> bool { return is_alphabetic(c) || is_numeric(c); }
+constexpr auto is_identifier_start(char c) -> bool { return is_alphabetic(c) || c == '_'; }
+constexpr auto is_identifier(char c) -> bool { return is_alphanumeric(c) || c == '_'; }
 constexpr auto is_hex_digit(char c) -> bool {
     return is_numeric(c) || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
 }
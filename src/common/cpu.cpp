@@ -0,0 +1,67 @@
+#include "cpu.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+namespace jp::cpu {
+
+auto level_name(Level level) -> const char * {
+    switch (level) {
+    case Level::Scalar:
+        return "scalar";
+    case Level::SSE42:
+        return "sse4.2";
+    case Level::AVX2:
+        return "avx2";
+    case Level::AVX512:
+        return "avx512";
+    }
+    return "";
+}
+
+auto parse_level(std::string_view name) -> std::optional<Level> {
+    for (auto i = std::size_t{0}; i < level_count; i++) {
+        const auto level = static_cast<Level>(i);
+        if (name == level_name(level)) {
+            return level;
+        }
+    }
+    return std::nullopt;
+}
+
+auto detected_level() -> Level {
+#if defined(__x86_64__) || defined(__i386__)
+    // The builtins read CPUID once, and check with XGETBV that the OS saves the wider registers
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return Level::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi2")) {
+        return Level::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt")) {
+        return Level::SSE42;
+    }
+#endif
+    return Level::Scalar;
+}
+
+auto active_level() -> Level {
+    static const auto level = [] {
+        const auto detected = detected_level();
+        const auto *forced = std::getenv("JSON_EVAL_ISA");
+        if (forced == nullptr || *forced == '\0') {
+            return detected;
+        }
+
+        const auto requested = parse_level(forced);
+        if (!requested) {
+            std::cerr << "Unknown JSON_EVAL_ISA level " << forced << ", using " << level_name(detected) << std::endl;
+            return detected;
+        }
+        return std::min(*requested, detected);
+    }();
+    return level;
+}
+
+} // namespace jp::cpu
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+namespace jp::cpu {
+
+// Instruction set levels the vectorized kernels are built for, every level includes the ones before it. SSE4.2 stands
+// for x86-64-v2, AVX-512 needs the byte and word instructions (AVX-512BW) as well.
+enum class Level { Scalar, SSE42, AVX2, AVX512 };
+constexpr auto level_count = std::size_t{4};
+
+auto level_name(Level level) -> const char *;
+auto parse_level(std::string_view name) -> std::optional<Level>;
+
+// The highest level the processor and the operating system support, from CPUID. Scalar on other architectures.
+auto detected_level() -> Level;
+
+// The level the kernels run at, chosen once on first use: the detected level, lowered to the one named by the
+// JSON_EVAL_ISA environment variable (scalar, sse4.2, avx2 or avx512) if that is set. A level the processor lacks
+// can't be forced, the detected one is used instead.
+auto active_level() -> Level;
+
+} // namespace jp::cpu
+
+// Kernels for the levels above Scalar are compiled into every build with these attributes and only called once
+// active_level() allows it, so the binary still runs on the baseline of its target
+#if defined(__x86_64__) || defined(__i386__)
+#define JSON_EVAL_X86_KERNELS
+#define JSON_EVAL_TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define JSON_EVAL_TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt")))
+#define JSON_EVAL_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,bmi,bmi2,popcnt")))
+#endif
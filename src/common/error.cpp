@@ -1,16 +1,299 @@
+#include <cstring>
+#include <format>
 #include <iostream>
+#include <string_view>
 #include "error.hpp"
 
+// The error is a variant alternative next to the result of every evaluation, it shouldn't be the larger one
+static_assert(sizeof(Error) <= 56);
+
+namespace {
+
+struct Description {
+    ErrorSource source;
+    std::string_view format;
+};
+
+auto describe(ErrorCode code) -> Description {
+    using enum ErrorCode;
+    constexpr auto lexer = ErrorSource::Lexer;
+    constexpr auto parser = ErrorSource::Parser;
+    constexpr auto query_lexer = ErrorSource::QueryLexer;
+    constexpr auto evaluator = ErrorSource::Evaluator;
+
+    switch (code) {
+    case ReadFailed:
+        return {lexer, "Could not read the input: {}"};
+    case InvalidCompressedData:
+        return {lexer, "Invalid {} data: {}"};
+    case TruncatedCompressedData:
+        return {lexer, "The {} data is truncated"};
+
+    case UnexpectedKeyword:
+        return {lexer, "Unexpected keyword '{}'"};
+    case UnexpectedCharacter:
+        return {lexer, "Unexpected character '{}'"};
+    case UnexpectedEndOfString:
+        return {lexer, "Unexpected end of string"};
+    case UnterminatedUnicodeEscape:
+        return {lexer, "Expected 4 hex digits after '\\u', found closing '\"'"};
+    case ExpectedHexDigit:
+        return {lexer, "Expected 4 hex digits after '\\u', found {}"};
+    case UnexpectedEscape:
+        return {lexer, "Unexpected escape character '{}'"};
+    case UnescapedControlCharacter:
+        return {lexer, "Unescaped control character (code {}) in string"};
+    case InvalidUtf8:
+        return {lexer, "Invalid UTF-8 in string at byte {}"};
+    case InvalidExponent:
+        return {lexer, "Invalid scientific notation"};
+    case MalformedNumber:
+        return {lexer, "Invalid number '{}'"};
+
+    case UnexpectedToken:
+        return {parser, "Unexpected token: Expected {}, instead found '{}'"};
+    case UnexpectedEndOfStream:
+        return {parser, "Unexpected end of stream: Expected {}"};
+    case TrailingToken:
+        return {parser, "Unexpected token: '{}'"};
+    case Expected:
+        return {parser, "Expected {}"};
+    case NestingTooDeep:
+        return {parser, "Arrays and objects nested deeper than {} levels"};
+
+    case InvalidNumber:
+        return {query_lexer, "Failed to parse number"};
+    case UnexpectedQueryCharacter:
+        return {query_lexer, "Unexpected character '{}'"};
+
+    case InputNotAnObject:
+        return {evaluator, "The input JSON is not an object"};
+    case KeyNotFound:
+        return {evaluator, "Key '{}' not found"};
+    case KeyNotAnArray:
+        return {evaluator, "Key '{}' is not an array"};
+    case KeyNotAnObject:
+        return {evaluator, "Key '{}' is not an object"};
+    case KeyNotIndexable:
+        return {evaluator, "Attempt to index into key '{}' which is not an array"};
+    case IndexNotAnInteger:
+        return {evaluator, "Index must be an integer, instead found {}: {}[{}]"};
+    case IndexOutOfBounds:
+        return {evaluator, "Index {} out of bounds for '{}' of size {}"};
+    case FilteredMemberAccess:
+        return {evaluator, "Cannot access members of the filtered array '{}'"};
+    case SelectorInPath:
+        return {evaluator, "Filters and wildcards are not allowed in this path"};
+    case FilterOutsideSubscript:
+        return {evaluator, "Filters are only allowed as array subscripts"};
+    case WildcardOutsideSubscript:
+        return {evaluator, "Wildcards are only allowed as array subscripts"};
+    case ExpectedArray:
+        return {evaluator, "Expected an array, instead found {}"};
+    case NoIndexCache:
+        return {evaluator, "No index cache attached to the evaluator"};
+
+    case UnsupportedBinaryOperation:
+        return {evaluator, "Unsupported binary operation"};
+    case UnsupportedBinaryOperator:
+        return {evaluator, "Unsupported binary operation: {}"};
+    case UnsupportedUnaryOperator:
+        return {evaluator, "Unsupported unary operation: {}"};
+    case UnsupportedOperandTypes:
+        return {evaluator, "Unsupported binary operation on types: {} and {}"};
+    case UnsupportedOperandType:
+        return {evaluator, "Unsupported unary operation on type: {}"};
+    case UnsupportedArithmetic:
+        return {evaluator, "Unsupported arithmetic operation on type: {}"};
+    case ElementsNotNumbers:
+        return {evaluator, "Arithmetic on arrays expects the elements to be numbers"};
+    case BroadcastSizeMismatch:
+        return {evaluator, "Cannot broadcast arrays of sizes {} and {}"};
+    case BroadcastLengthMismatch:
+        return {evaluator, "Cannot broadcast arrays of different sizes"};
+    case DivisionByZero:
+        return {evaluator, "Division by zero"};
+    case UnsupportedComparison:
+        return {evaluator, "Unsupported comparison: {}"};
+    case UncomparableValue:
+        return {evaluator, "Cannot compare against a value of type {}"};
+
+    case FunctionNotFound:
+        return {evaluator, "Function '{}' not found"};
+    case UnknownIntrinsic:
+        return {evaluator, "Unknown intrinsic"};
+    case ExpectedOneArgument:
+        return {evaluator, "{}() expects exactly 1 argument"};
+    case ExpectedTwoArguments:
+        return {evaluator, "{}() expects exactly 2 arguments"};
+    case ExpectedArgumentRange:
+        return {evaluator, "{}() expects {} or {} arguments"};
+    case MissingArguments:
+        return {evaluator, "{}() expects at least one argument"};
+    case EmptyArray:
+        return {evaluator, "{}() received an empty array"};
+    case EmptySummary:
+        return {evaluator, "{}() of an empty array"};
+    case NonNumericElements:
+        return {evaluator, "{}() expects array elements to be numbers"};
+    case NonScalarElements:
+        return {evaluator, "{}() expects array elements to be scalars"};
+    case ExpectedNumbers:
+        return {evaluator, "{}() expects numbers or an array of numbers"};
+    case ExpectedNumbersFound:
+        return {evaluator, "{}() expects numbers or an array of numbers, instead found {}"};
+    case ExpectedContainer:
+        return {evaluator, "{}() expects an array or object as its argument, instead found {}"};
+    case ExpectedArrayArgument:
+        return {evaluator, "{}() expects an array as its first argument, instead found {}"};
+    case ExpectedMemberPath:
+        return {evaluator, "{}() expects a member path as its second argument"};
+    case ArgumentOutOfRange:
+        return {evaluator, "{}() expects argument {} to be a number between {} and {}"};
+    case ExpectedNonNegativeInteger:
+        return {evaluator, "{}() expects argument {} to be a non-negative integer"};
+    case NthOutOfBounds:
+        return {evaluator, "nth() index {} out of bounds for an array of size {}"};
+    }
+    return {evaluator, "Unknown error"};
+}
+
+auto duplicate(const char *text) -> const char * {
+    const auto size = std::strlen(text) + 1;
+    auto *copy = new char[size];
+    std::memcpy(copy, text, size);
+    return copy;
+}
+
+} // namespace
+
+auto Error::default_source(ErrorCode code) -> ErrorSource { return describe(code).source; }
+
+void Error::set(std::size_t slot, const std::string &text) {
+    assign(slot, Kind::OwnedText, {.text = duplicate(text.c_str())});
+}
+
+Error::Error(const Error &other)
+    : code(other.code), source(other.source), is_warning(other.is_warning), line(other.line), column(other.column),
+      kinds(other.kinds), values(other.values), context(other.context) {
+    copy_owned_text();
+}
+
+Error::Error(Error &&other) noexcept
+    : code(other.code), source(other.source), is_warning(other.is_warning), line(other.line), column(other.column),
+      kinds(other.kinds), values(other.values), context(other.context) {
+    other.kinds = {};
+}
+
+auto Error::operator=(const Error &other) -> Error & {
+    if (this != &other) {
+        auto copy = other;
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+auto Error::operator=(Error &&other) noexcept -> Error & {
+    if (this != &other) {
+        release();
+        code = other.code;
+        source = other.source;
+        is_warning = other.is_warning;
+        line = other.line;
+        column = other.column;
+        kinds = other.kinds;
+        values = other.values;
+        context = other.context;
+        other.kinds = {};
+    }
+    return *this;
+}
+
+Error::~Error() { release(); }
+
+void Error::copy_owned_text() {
+    for (auto i = std::size_t{0}; i < max_args; i++) {
+        if (kinds[i] == Kind::OwnedText) {
+            values[i].text = duplicate(values[i].text);
+        }
+    }
+}
+
+void Error::release() {
+    for (auto i = std::size_t{0}; i < max_args; i++) {
+        if (kinds[i] == Kind::OwnedText) {
+            delete[] values[i].text;
+        }
+    }
+    kinds = {};
+}
+
+auto Error::message() const -> std::string {
+    auto result = std::string{};
+    if (context != nullptr) {
+        result += std::format("{}: ", context);
+    }
+
+    auto format = describe(code).format;
+    auto slot = std::size_t{0};
+    for (auto placeholder = format.find("{}"); placeholder != std::string_view::npos; placeholder = format.find("{}")) {
+        result += format.substr(0, placeholder);
+        format.remove_prefix(placeholder + 2);
+
+        const auto value = slot < max_args ? values[slot] : Arg{};
+        switch (slot < max_args ? kinds[slot] : Kind::None) {
+        case Kind::None:
+            break;
+        case Kind::Integer:
+            result += std::to_string(value.integer);
+            break;
+        case Kind::Double:
+            result += std::format("{}", value.number);
+            break;
+        case Kind::Char:
+            result += value.character;
+            break;
+        case Kind::Text:
+        case Kind::OwnedText:
+            result += value.text;
+            break;
+        }
+        slot++;
+    }
+    result += format;
+    return result;
+}
+
+auto Error::source_name() const -> const char * {
+    switch (source) {
+    case ErrorSource::Lexer:
+        return "Lexer";
+    case ErrorSource::Parser:
+        return "Parser";
+    case ErrorSource::QueryLexer:
+        return "Query Lexer";
+    case ErrorSource::Query:
+        return "Query";
+    case ErrorSource::Evaluator:
+        return "Evaluator";
+    }
+    return "";
+}
+
 auto Error::operator==(const Error &other) const -> bool {
-    return (source == other.source && message == other.message && line == other.line && column == other.column &&
-            is_warning == other.is_warning);
+    if (code != other.code || source != other.source || line != other.line || column != other.column ||
+        is_warning != other.is_warning || kinds != other.kinds) {
+        return false;
+    }
+    // Arguments and context are compared by what they display as
+    return message() == other.message();
 }
 
 void display_error(const Error &error) {
     std::cout << "Error:";
 
-    if (error.source != "Evaluator") {
-        std::cout << error.source << ":" << error.line << ":" << error.column << ":";
+    if (error.source != ErrorSource::Evaluator) {
+        std::cout << error.source_name() << ":" << error.line << ":" << error.column << ":";
     }
-    std::cout << ' ' << error.message << std::endl;
+    std::cout << ' ' << error.message() << std::endl;
 }
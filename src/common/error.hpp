@@ -1,16 +1,168 @@
 #pragma once
 
+#include <array>
+#include <concepts>
+#include <cstdint>
 #include <string>
+#include <utility>
 
+// What went wrong. Every code has a message template in error.cpp whose `{}` are filled with the error's arguments.
+enum class ErrorCode : std::uint16_t {
+    // Reading the input
+    ReadFailed,
+    InvalidCompressedData,
+    TruncatedCompressedData,
+
+    // JSON lexer
+    UnexpectedKeyword,
+    UnexpectedCharacter,
+    UnexpectedEndOfString,
+    UnterminatedUnicodeEscape,
+    ExpectedHexDigit,
+    UnexpectedEscape,
+    UnescapedControlCharacter,
+    InvalidUtf8,
+    InvalidExponent,
+    MalformedNumber,
+
+    // JSON and query parser
+    UnexpectedToken,
+    UnexpectedEndOfStream,
+    TrailingToken,
+    Expected,
+    NestingTooDeep,
+
+    // Query lexer
+    InvalidNumber,
+    UnexpectedQueryCharacter,
+
+    // Evaluator: paths
+    InputNotAnObject,
+    KeyNotFound,
+    KeyNotAnArray,
+    KeyNotAnObject,
+    KeyNotIndexable,
+    IndexNotAnInteger,
+    IndexOutOfBounds,
+    FilteredMemberAccess,
+    SelectorInPath,
+    FilterOutsideSubscript,
+    WildcardOutsideSubscript,
+    ExpectedArray,
+    NoIndexCache,
+
+    // Evaluator: operators
+    UnsupportedBinaryOperation,
+    UnsupportedBinaryOperator,
+    UnsupportedUnaryOperator,
+    UnsupportedOperandTypes,
+    UnsupportedOperandType,
+    UnsupportedArithmetic,
+    ElementsNotNumbers,
+    BroadcastSizeMismatch,
+    BroadcastLengthMismatch,
+    DivisionByZero,
+    UnsupportedComparison,
+    UncomparableValue,
+
+    // Evaluator: functions
+    FunctionNotFound,
+    UnknownIntrinsic,
+    ExpectedOneArgument,
+    ExpectedTwoArguments,
+    ExpectedArgumentRange,
+    MissingArguments,
+    EmptyArray,
+    EmptySummary,
+    NonNumericElements,
+    NonScalarElements,
+    ExpectedNumbers,
+    ExpectedNumbersFound,
+    ExpectedContainer,
+    ExpectedArrayArgument,
+    ExpectedMemberPath,
+    ArgumentOutOfRange,
+    ExpectedNonNegativeInteger,
+    NthOutOfBounds,
+};
+
+enum class ErrorSource : std::uint8_t { Lexer, Parser, QueryLexer, Query, Evaluator };
+
+// Evaluation fails on every missing key or type mismatch and most of those errors are only propagated, counted or
+// discarded, so an error is a code with a few typed arguments and the text is only put together by message().
+//
+// Text arguments passed as `const char *` are borrowed: they must be string literals or names owned by the query
+// (identifiers), which outlive the error. Text that only exists while the error is created, like a lexeme, is passed
+// as a std::string and copied.
 struct Error {
-    std::string source;
-    std::string message;
-    unsigned line;
-    unsigned column;
+    static constexpr auto max_args = std::size_t{4};
+
+    template <typename... Args>
+        requires(sizeof...(Args) <= max_args)
+    explicit Error(ErrorCode code, Args &&...args) : code(code), source(default_source(code)) {
+        auto slot = std::size_t{0};
+        (set(slot++, std::forward<Args>(args)), ...);
+    }
 
+    Error(const Error &other);
+    Error(Error &&other) noexcept;
+    auto operator=(const Error &other) -> Error &;
+    auto operator=(Error &&other) noexcept -> Error &;
+    ~Error();
+
+    ErrorCode code;
+    ErrorSource source;
     bool is_warning = false;
+    unsigned line = 0;
+    unsigned column = 0;
+
+    auto at(unsigned error_line, unsigned error_column) && -> Error && {
+        line = error_line;
+        column = error_column;
+        return std::move(*this);
+    }
+
+    [[nodiscard]] auto message() const -> std::string;
+    [[nodiscard]] auto source_name() const -> const char *;
 
     auto operator==(const Error &other) const -> bool;
+
+  private:
+    enum class Kind : std::uint8_t { None, Integer, Double, Char, Text, OwnedText };
+
+    union Arg {
+        std::int64_t integer;
+        double number;
+        char character;
+        const char *text;
+    };
+
+    static auto default_source(ErrorCode code) -> ErrorSource;
+
+    void set(std::size_t slot, const char *text) { assign(slot, Kind::Text, {.text = text}); }
+    void set(std::size_t slot, const std::string &text);
+    void set(std::size_t slot, char c) { assign(slot, Kind::Char, {.character = c}); }
+    void set(std::size_t slot, std::floating_point auto number) {
+        assign(slot, Kind::Double, {.number = static_cast<double>(number)});
+    }
+    void set(std::size_t slot, std::integral auto integer) {
+        assign(slot, Kind::Integer, {.integer = static_cast<std::int64_t>(integer)});
+    }
+    void assign(std::size_t slot, Kind kind, Arg value) {
+        kinds[slot] = kind;
+        values[slot] = value;
+    }
+
+    void copy_owned_text();
+    void release();
+
+    // Kept next to the position so that the whole error is 56 bytes
+    std::array<Kind, max_args> kinds{};
+    std::array<Arg, max_args> values{};
+
+  public:
+    // Prepended to the message, e.g. the name of the query in a batch. Borrowed like the text arguments.
+    const char *context = nullptr;
 };
 
 void display_error(const Error &error);
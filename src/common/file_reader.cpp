@@ -0,0 +1,399 @@
+#include "file_reader.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef JSON_EVAL_IO_URING
+#include <atomic>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+namespace jp {
+
+namespace {
+
+// Reads `fd` from `offset` to its end into `content`, which is grown as needed. Returns false on a read error.
+auto read_rest(int fd, std::string &content, std::size_t offset) -> bool {
+    while (true) {
+        if (offset == content.size()) {
+            content.resize(std::max<std::size_t>(4096, 2 * content.size()));
+        }
+
+        const auto count = ::pread(fd, content.data() + offset, content.size() - offset, static_cast<off_t>(offset));
+        if (count < 0 && errno == EINTR) {
+            continue;
+        }
+        if (count < 0) {
+            return false;
+        }
+        if (count == 0) {
+            content.resize(offset);
+            return true;
+        }
+        offset += static_cast<std::size_t>(count);
+    }
+}
+
+} // namespace
+
+auto pread_file(const std::string &path) -> std::optional<std::string> {
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    // The size is only a hint, one byte more lets the read that finds the end fit without growing the string
+    struct stat info {};
+    auto content = std::string{};
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        content.resize(static_cast<std::size_t>(info.st_size) + 1);
+    }
+
+    const auto read = read_rest(fd, content, 0);
+    ::close(fd);
+    if (!read) {
+        return std::nullopt;
+    }
+    return content;
+}
+
+#ifdef JSON_EVAL_IO_URING
+
+// The rings are set up with the raw system calls, liburing isn't needed. Every slot reads one file at a time with
+// at most one request in flight: openat, then reads into the slot's registered buffer until the end of the file,
+// then close.
+struct FileReader::Ring {
+    enum Operation : std::uint64_t { Open, Read, Close };
+
+    struct Slot {
+        std::size_t index = 0;
+        int fd = -1;
+        // Bytes of the file in the slot's buffer
+        std::size_t filled = 0;
+        bool delivered = false;
+        // The kernel owns the descriptor once its close is submitted, even if the ring fails before it completes
+        bool closing = false;
+    };
+
+    static constexpr auto buffer_size = std::size_t{64} << 10;
+
+    static auto create(std::size_t depth) -> std::unique_ptr<Ring> {
+        auto ring = std::make_unique<Ring>();
+        if (!ring->setup(static_cast<unsigned>(std::clamp<std::size_t>(depth, 1, 4096)))) {
+            return nullptr;
+        }
+        return ring;
+    }
+
+    ~Ring() {
+        if (sqes != nullptr) {
+            ::munmap(sqes, sqes_size);
+        }
+        if (cq_ptr != nullptr && cq_ptr != sq_ptr) {
+            ::munmap(cq_ptr, cq_size);
+        }
+        if (sq_ptr != nullptr) {
+            ::munmap(sq_ptr, sq_size);
+        }
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    // Returns false if the ring failed. The files that weren't delivered yet have to be read another way: the ones
+    // that were in flight are added to `retry`, the ones that weren't started begin at `resume_at`.
+    auto read(const std::vector<std::string> &paths, std::size_t first, std::size_t count, const Callback &on_file,
+              std::vector<std::size_t> &retry, std::size_t &resume_at) -> bool {
+        auto next = first;
+        const auto end = first + count;
+        auto active = std::size_t{0};
+
+        while (next < end || active > 0) {
+            while (next < end && !free_slots.empty()) {
+                const auto slot = free_slots.back();
+                free_slots.pop_back();
+                slots[slot] = Slot{.index = next};
+                prepare_open(slot, paths[next].c_str());
+                next++;
+                active++;
+            }
+
+            if (!submit_and_wait()) {
+                for (auto slot = std::size_t{0}; slot < slots.size(); slot++) {
+                    if (std::ranges::find(free_slots, slot) != free_slots.end()) {
+                        continue;
+                    }
+                    auto &file = slots[slot];
+                    if (file.fd >= 0 && !file.closing) {
+                        ::close(file.fd);
+                    }
+                    if (!file.delivered) {
+                        retry.push_back(file.index);
+                    }
+                }
+                std::ranges::sort(retry);
+                resume_at = next;
+                return false;
+            }
+
+            auto head = std::atomic_ref{*cq_head}.load(std::memory_order_relaxed);
+            const auto tail = std::atomic_ref{*cq_tail}.load(std::memory_order_acquire);
+            for (; head != tail; head++) {
+                const auto &cqe = cqes[head & cq_mask];
+                const auto slot = static_cast<std::size_t>(cqe.user_data >> 2);
+                if (complete(slot, static_cast<Operation>(cqe.user_data & 3), cqe.res, on_file)) {
+                    free_slots.push_back(slot);
+                    active--;
+                }
+            }
+            std::atomic_ref{*cq_head}.store(head, std::memory_order_release);
+        }
+        return true;
+    }
+
+  private:
+    auto setup(unsigned depth) -> bool {
+        auto params = io_uring_params{};
+        fd = static_cast<int>(::syscall(__NR_io_uring_setup, depth, &params));
+        if (fd < 0 || !supports_operations()) {
+            return false;
+        }
+
+        sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const auto single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single_mmap) {
+            sq_size = cq_size = std::max(sq_size, cq_size);
+        }
+
+        sq_ptr = map(sq_size, IORING_OFF_SQ_RING);
+        cq_ptr = single_mmap ? sq_ptr : map(cq_size, IORING_OFF_CQ_RING);
+        sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = static_cast<io_uring_sqe *>(map(sqes_size, IORING_OFF_SQES));
+        if (sq_ptr == nullptr || cq_ptr == nullptr || sqes == nullptr) {
+            return false;
+        }
+
+        auto *sq = static_cast<char *>(sq_ptr);
+        sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+        sq_mask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+        auto *cq = static_cast<char *>(cq_ptr);
+        cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+        cq_mask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+        slots.resize(params.sq_entries);
+        for (auto slot = slots.size(); slot > 0; slot--) {
+            free_slots.push_back(slot - 1);
+        }
+
+        // Registering pins the buffers, a low RLIMIT_MEMLOCK makes it fail and the reads use the buffers unpinned
+        buffers.resize(slots.size() * buffer_size);
+        auto iovecs = std::vector<iovec>(slots.size());
+        for (auto slot = std::size_t{0}; slot < slots.size(); slot++) {
+            iovecs[slot] = iovec{.iov_base = buffers.data() + slot * buffer_size, .iov_len = buffer_size};
+        }
+        fixed_buffers = ::syscall(__NR_io_uring_register, fd, IORING_REGISTER_BUFFERS, iovecs.data(),
+                                  static_cast<unsigned>(iovecs.size())) == 0;
+        return true;
+    }
+
+    auto supports_operations() const -> bool {
+        constexpr auto max_ops = 256;
+        auto storage = std::vector<std::byte>(sizeof(io_uring_probe) + max_ops * sizeof(io_uring_probe_op));
+        auto *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+        if (::syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, max_ops) < 0) {
+            return false;
+        }
+
+        return std::ranges::all_of(std::array{IORING_OP_OPENAT, IORING_OP_READ_FIXED, IORING_OP_READ, IORING_OP_CLOSE},
+                                   [&](auto op) {
+                                       return op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+                                   });
+    }
+
+    auto map(std::size_t size, std::uint64_t offset) const -> void * {
+        auto *pointer = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                               static_cast<off_t>(offset));
+        return pointer == MAP_FAILED ? nullptr : pointer;
+    }
+
+    // A slot never has more than one request queued, so with as many slots as entries the queue can't overflow
+    auto next_sqe(std::size_t slot, Operation operation) -> io_uring_sqe & {
+        const auto tail = std::atomic_ref{*sq_tail}.load(std::memory_order_relaxed) + pending;
+        const auto index = tail & sq_mask;
+        sq_array[index] = index;
+        pending++;
+
+        auto &sqe = sqes[index];
+        sqe = io_uring_sqe{};
+        sqe.user_data = (static_cast<std::uint64_t>(slot) << 2) | operation;
+        return sqe;
+    }
+
+    void prepare_open(std::size_t slot, const char *path) {
+        auto &sqe = next_sqe(slot, Open);
+        sqe.opcode = IORING_OP_OPENAT;
+        sqe.fd = AT_FDCWD;
+        sqe.addr = reinterpret_cast<std::uint64_t>(path);
+        sqe.open_flags = O_RDONLY | O_CLOEXEC;
+    }
+
+    // Reads the rest of the slot's buffer from where the previous reads stopped
+    void prepare_read(std::size_t slot) {
+        const auto filled = slots[slot].filled;
+        auto &sqe = next_sqe(slot, Read);
+        sqe.opcode = fixed_buffers ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe.fd = slots[slot].fd;
+        sqe.off = filled;
+        sqe.addr = reinterpret_cast<std::uint64_t>(buffers.data() + slot * buffer_size + filled);
+        sqe.len = static_cast<unsigned>(buffer_size - filled);
+        sqe.buf_index = fixed_buffers ? static_cast<std::uint16_t>(slot) : 0;
+    }
+
+    void prepare_close(std::size_t slot) {
+        auto &sqe = next_sqe(slot, Close);
+        sqe.opcode = IORING_OP_CLOSE;
+        sqe.fd = slots[slot].fd;
+        slots[slot].closing = true;
+    }
+
+    // Publishes the prepared requests and waits for at least one completion
+    auto submit_and_wait() -> bool {
+        std::atomic_ref{*sq_tail}.fetch_add(pending, std::memory_order_release);
+        auto to_submit = pending;
+        pending = 0;
+
+        while (true) {
+            const auto submitted = ::syscall(__NR_io_uring_enter, fd, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (submitted >= 0) {
+                return true;
+            }
+            if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+                return false;
+            }
+            // Requests that were consumed before the interruption stay submitted
+            to_submit = 0;
+        }
+    }
+
+    // Handles a completion, returns true once the slot's file is done
+    auto complete(std::size_t slot, Operation operation, int result, const Callback &on_file) -> bool {
+        auto &file = slots[slot];
+        switch (operation) {
+        case Open:
+            if (result < 0) {
+                on_file(file.index, std::nullopt);
+                return true;
+            }
+            file.fd = result;
+            prepare_read(slot);
+            return false;
+        case Read: {
+            if (result == -EINTR || result == -EAGAIN) {
+                prepare_read(slot);
+                return false;
+            }
+            if (result > 0) {
+                file.filled += static_cast<std::size_t>(result);
+            }
+            // A short read isn't the end of the file, that is only known from a read returning nothing
+            if (result > 0 && file.filled < buffer_size) {
+                prepare_read(slot);
+                return false;
+            }
+
+            auto content = std::optional<std::string>{};
+            if (result >= 0) {
+                const auto *buffer = buffers.data() + slot * buffer_size;
+                content.emplace(buffer, buffer + file.filled);
+                // Larger files are finished synchronously, the ring is meant for many small ones
+                if (file.filled == buffer_size && !read_rest(file.fd, *content, buffer_size)) {
+                    content.reset();
+                }
+            }
+            file.delivered = true;
+            on_file(file.index, std::move(content));
+            prepare_close(slot);
+            return false;
+        }
+        case Close:
+            file.fd = -1;
+            return true;
+        }
+        return true;
+    }
+
+    int fd = -1;
+    void *sq_ptr = nullptr;
+    void *cq_ptr = nullptr;
+    io_uring_sqe *sqes = nullptr;
+    std::size_t sq_size = 0;
+    std::size_t cq_size = 0;
+    std::size_t sqes_size = 0;
+
+    unsigned *sq_tail = nullptr;
+    unsigned *sq_array = nullptr;
+    unsigned sq_mask = 0;
+    unsigned *cq_head = nullptr;
+    unsigned *cq_tail = nullptr;
+    unsigned cq_mask = 0;
+    io_uring_cqe *cqes = nullptr;
+    unsigned pending = 0;
+
+    std::vector<char> buffers;
+    bool fixed_buffers = false;
+    std::vector<Slot> slots;
+    std::vector<std::size_t> free_slots;
+};
+
+#else
+
+// io_uring isn't available on this platform, every reader uses pread
+struct FileReader::Ring {
+    static auto create(std::size_t /*depth*/) -> std::unique_ptr<Ring> { return nullptr; }
+
+    auto read(const std::vector<std::string> & /*paths*/, std::size_t first, std::size_t /*count*/,
+              const Callback & /*on_file*/, std::vector<std::size_t> & /*retry*/, std::size_t &resume_at) -> bool {
+        resume_at = first;
+        return false;
+    }
+};
+
+#endif
+
+FileReader::FileReader(std::size_t queue_depth, Backend preferred) {
+    if (preferred == Backend::IoUring) {
+        ring = Ring::create(queue_depth);
+    }
+}
+
+FileReader::~FileReader() = default;
+
+void FileReader::read(const std::vector<std::string> &paths, std::size_t first, std::size_t count,
+                      const Callback &on_file) {
+    auto retry = std::vector<std::size_t>{};
+    auto resume_at = first;
+    if (ring && !ring->read(paths, first, count, on_file, retry, resume_at)) {
+        ring.reset();
+    }
+
+    if (!ring) {
+        // Files that were in flight when the ring failed are read again before the ones it didn't get to
+        for (const auto index : retry) {
+            on_file(index, pread_file(paths[index]));
+        }
+        for (auto index = resume_at; index < first + count; index++) {
+            on_file(index, pread_file(paths[index]));
+        }
+    }
+}
+
+} // namespace jp
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace jp {
+
+// Reads many whole files. With io_uring, the openat, read and close requests of up to `queue_depth` files are in
+// flight at once and files are read into buffers registered with the kernel when the reader is created, so a batch
+// costs a few io_uring_enter calls instead of several syscalls per file. Where io_uring isn't compiled in or the
+// kernel refuses it, files are read one after the other with pread. A reader is used by one thread at a time.
+class FileReader {
+  public:
+    enum class Backend { IoUring, Pread };
+
+    // Called with the index of a file in `paths` and its content, std::nullopt if it couldn't be read
+    using Callback = std::function<void(std::size_t index, std::optional<std::string> content)>;
+
+    explicit FileReader(std::size_t queue_depth = 64, Backend preferred = Backend::IoUring);
+    ~FileReader();
+
+    FileReader(const FileReader &) = delete;
+    FileReader &operator=(const FileReader &) = delete;
+    FileReader(FileReader &&) = delete;
+    FileReader &operator=(FileReader &&) = delete;
+
+    // Reads paths[first, first + count), calling `on_file` for each file as soon as it has been read. With io_uring
+    // that is in completion order, not in path order.
+    void read(const std::vector<std::string> &paths, std::size_t first, std::size_t count, const Callback &on_file);
+
+    [[nodiscard]] auto backend() const -> Backend { return ring ? Backend::IoUring : Backend::Pread; }
+
+  private:
+    struct Ring;
+
+    std::unique_ptr<Ring> ring;
+};
+
+// Reads the file with open, fstat and pread, std::nullopt if it can't be read
+auto pread_file(const std::string &path) -> std::optional<std::string>;
+
+} // namespace jp
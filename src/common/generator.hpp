@@ -0,0 +1,104 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace jp {
+
+// Lazily produced sequence of references, driven by a coroutine that `co_yield`s them one at a time. A yielded value
+// only has to live until the consumer advances, so a coroutine may yield a temporary or a local it keeps overwriting.
+// Nothing runs until the first element is requested and destroying the generator early simply drops the frame, which
+// is how consumers stop a pipeline before it is exhausted.
+template <typename Ref> class Generator {
+    static_assert(std::is_reference_v<Ref>, "Generator yields references");
+    using Value = std::remove_reference_t<Ref>;
+
+  public:
+    struct promise_type {
+        Value *current = nullptr;
+
+        auto get_return_object() -> Generator { return Generator{Handle::from_promise(*this)}; }
+        auto initial_suspend() noexcept -> std::suspend_always { return {}; }
+        auto final_suspend() noexcept -> std::suspend_always { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+
+        // The operand of co_yield outlives the suspension, temporaries are only destroyed once the coroutine resumes
+        auto yield_value(Value &value) noexcept -> std::suspend_always {
+            current = std::addressof(value);
+            return {};
+        }
+        auto yield_value(std::remove_const_t<Value> &&value) noexcept -> std::suspend_always {
+            current = std::addressof(value);
+            return {};
+        }
+
+        // Generators only produce values
+        void await_transform() = delete;
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+    class iterator {
+      public:
+        using value_type = std::remove_cvref_t<Ref>;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(Handle handle) : handle(handle) {}
+
+        auto operator*() const -> Ref { return static_cast<Ref>(*handle.promise().current); }
+        auto operator->() const -> Value * { return handle.promise().current; }
+
+        auto operator++() -> iterator & {
+            handle.resume();
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+
+        auto operator==(std::default_sentinel_t) const -> bool { return !handle || handle.done(); }
+
+      private:
+        Handle handle;
+    };
+
+    Generator() = default;
+    Generator(Generator &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+    auto operator=(Generator &&other) noexcept -> Generator & {
+        if (this != &other) {
+            reset();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    Generator(const Generator &) = delete;
+    auto operator=(const Generator &) -> Generator & = delete;
+    ~Generator() { reset(); }
+
+    // Runs the coroutine up to its first element. The sequence can only be traversed once.
+    auto begin() -> iterator {
+        if (handle) {
+            handle.resume();
+        }
+        return iterator{handle};
+    }
+    auto end() -> std::default_sentinel_t { return {}; }
+
+  private:
+    explicit Generator(Handle handle) : handle(handle) {}
+
+    void reset() {
+        if (handle) {
+            handle.destroy();
+        }
+        handle = {};
+    }
+
+    Handle handle;
+};
+
+} // namespace jp
@@ -0,0 +1,96 @@
+#include "memory.hpp"
+#include <atomic>
+
+namespace jp::memory {
+
+namespace {
+
+// One cache line per category, threads allocating for different categories don't contend
+struct alignas(64) CategoryCounts {
+    std::atomic<std::size_t> allocations{0};
+    std::atomic<std::size_t> bytes{0};
+};
+
+struct AllocationCounts {
+    std::atomic<bool> available{false};
+    std::atomic<bool> enabled{false};
+    CategoryCounts categories[category_count];
+    std::atomic<std::size_t> frees{0};
+};
+
+// Constant initialized, so it is usable by allocations made before main
+constinit auto allocation_counts = AllocationCounts{};
+
+} // namespace
+
+auto category_name(Category category) -> const char * {
+    switch (category) {
+    case Category::Other:
+        return "other";
+    case Category::Lexer:
+        return "lexer";
+    case Category::ParserObjects:
+        return "parser_objects";
+    case Category::ParserArrays:
+        return "parser_arrays";
+    case Category::ParserStrings:
+        return "parser_strings";
+    case Category::Evaluator:
+        return "evaluator";
+    }
+    return "";
+}
+
+auto counting_available() -> bool { return allocation_counts.available.load(std::memory_order_relaxed); }
+
+void start_counting() { allocation_counts.enabled.store(true, std::memory_order_relaxed); }
+
+void stop_counting() { allocation_counts.enabled.store(false, std::memory_order_relaxed); }
+
+auto counts(Category category) -> Counts {
+    const auto &counts = allocation_counts.categories[static_cast<std::size_t>(category)];
+    return {.allocations = counts.allocations.load(std::memory_order_relaxed),
+            .bytes = counts.bytes.load(std::memory_order_relaxed)};
+}
+
+auto total() -> Counts {
+    auto sum = Counts{};
+    for (auto i = std::size_t{0}; i < category_count; i++) {
+        const auto category = counts(static_cast<Category>(i));
+        sum.allocations += category.allocations;
+        sum.bytes += category.bytes;
+    }
+    return sum;
+}
+
+auto frees() -> std::size_t { return allocation_counts.frees.load(std::memory_order_relaxed); }
+
+void reset() {
+    for (auto &category : allocation_counts.categories) {
+        category.allocations.store(0, std::memory_order_relaxed);
+        category.bytes.store(0, std::memory_order_relaxed);
+    }
+    allocation_counts.frees.store(0, std::memory_order_relaxed);
+}
+
+namespace detail {
+
+void count_allocation(std::size_t size) {
+    if (allocation_counts.enabled.load(std::memory_order_relaxed)) {
+        auto &category = allocation_counts.categories[static_cast<std::size_t>(current_category)];
+        category.allocations.fetch_add(1, std::memory_order_relaxed);
+        category.bytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+void count_free() {
+    if (allocation_counts.enabled.load(std::memory_order_relaxed)) {
+        allocation_counts.frees.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void mark_counting_available() { allocation_counts.available.store(true, std::memory_order_relaxed); }
+
+} // namespace detail
+
+} // namespace jp::memory
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+
+namespace jp::memory {
+
+// What an allocation was made for, by the code that made it. Allocations outside of any Scope are Other.
+enum class Category { Other, Lexer, ParserObjects, ParserArrays, ParserStrings, Evaluator };
+constexpr auto category_count = std::size_t{6};
+
+auto category_name(Category category) -> const char *;
+
+struct Counts {
+    std::size_t allocations = 0;
+    std::size_t bytes = 0;
+};
+
+// Whether the program links the AllocationCounting library, whose operator new counts allocations. Without it every
+// count stays 0 and operator new is the standard one.
+auto counting_available() -> bool;
+
+// Allocations through operator new are counted once this was called, counting costs a relaxed atomic increment each
+void start_counting();
+void stop_counting();
+
+// Totals since counting started or the last reset(). Frees can't be attributed to the category that allocated, they
+// are only counted.
+auto counts(Category category) -> Counts;
+auto total() -> Counts;
+auto frees() -> std::size_t;
+void reset();
+
+namespace detail {
+// Called by the replacement operator new and delete in allocation_counting.cpp
+void count_allocation(std::size_t size);
+void count_free();
+void mark_counting_available();
+} // namespace detail
+
+// The category allocations of the calling thread currently go to
+inline thread_local auto current_category = Category::Other;
+
+// Attributes the allocations of the calling thread to `category` while alive. Scopes nest, the innermost wins.
+class Scope {
+  public:
+    explicit Scope(Category category) : previous(current_category) { current_category = category; }
+    ~Scope() { current_category = previous; }
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    Category previous;
+};
+
+} // namespace jp::memory
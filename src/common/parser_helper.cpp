@@ -1,7 +1,10 @@
 #include "parser_helper.hpp"
 #include "common.hpp"
+#include "scan.hpp"
+#include "utf8.hpp"
+#include <charconv>
 #include <cmath>
-#include <format>
+#include <cstdlib>
 
 /*
 String parsing:
@@ -32,10 +35,48 @@ String parsing:
         'A' . 'F'
         'a' . 'f'
 */
+namespace {
+
+// Length of the escape sequence at `index`, which holds a '\\'
+auto escape_length(std::string_view source, std::size_t index) -> jp::expected<std::size_t, Error> {
+    if (index + 1 >= source.size()) {
+        return Error{ErrorCode::UnexpectedEndOfString};
+    }
+
+    const auto next_c = source[index + 1];
+
+    if (next_c == '"' || next_c == '\\' || next_c == '/' || next_c == 'b' || next_c == 'f' || next_c == 'n' ||
+        next_c == 'r' || next_c == 't') {
+        return std::size_t{2};
+    }
+
+    if (next_c == 'u') {
+        if (index + 6 >= source.size()) {
+            return Error{ErrorCode::UnexpectedEndOfString};
+        }
+
+        for (int i = 0; i < 4; i++) {
+            char cu = source[index + 2 + i];
+            if (cu == '"') {
+                return Error{ErrorCode::UnterminatedUnicodeEscape};
+            }
+            if (!is_hex_digit(cu)) {
+                return Error{ErrorCode::ExpectedHexDigit, cu};
+            }
+        }
+
+        return std::size_t{6};
+    }
+
+    return Error{ErrorCode::UnexpectedEscape, next_c};
+}
+
+} // namespace
+
 // Expects a string_view that starts with the first character after the opening '"'
 auto parse_str(std::string_view &source,
                const std::function<bool(char)> &ending_predicate) -> jp::expected<std::string, Error> {
-    auto current_index = 0;
+    auto current_index = std::size_t{0};
 
     while (current_index < source.size()) {
         const auto c = source[current_index];
@@ -48,90 +89,147 @@ auto parse_str(std::string_view &source,
 
         // Verify escape characters (we save the escape character as well)
         if (c == '\\') {
-            if (current_index + 1 >= source.size()) {
-                return Error{"Lexer", "Unexpected end of string", 0, 0};
-            }
-
-            const auto next_c = source[current_index + 1];
-
-            if (next_c == '"' || next_c == '\\' || next_c == '/' || next_c == 'b' || next_c == 'f' || next_c == 'n' ||
-                next_c == 'r' || next_c == 't') {
-                current_index += 2;
-                continue;
-            } else if (next_c == 'u') {
-                if (current_index + 6 >= source.size()) {
-                    return Error{"Lexer", "Unexpected end of string", 0, 0};
-                }
-
-                for (int i = 0; i < 4; i++) {
-                    char cu = source[current_index + 2 + i];
-                    if (cu == '"') {
-                        return Error{"Lexer", "Expected 4 hex digits after '\\u', found closing '\"'", 0, 0};
-                    }
-                    if (!is_hex_digit(cu)) {
-                        return Error{"Lexer", std::format("Expected 4 hex digits after '\\u', found {}", cu), 0, 0};
-                    }
-                }
-
-                current_index += 6;
-                continue;
-            } else {
-                return Error{"Lexer", std::format("Unexpected escape character '{}'", next_c), 0, 0};
+            auto length = escape_length(source, current_index);
+            if (length.has_error()) {
+                return length.consume_error();
             }
+            current_index += length.value();
+            continue;
         }
 
         current_index += 1;
     }
 
-    return Error{"Lexer", "Unexpected end of string", 0, 0};
+    return Error{ErrorCode::UnexpectedEndOfString};
 }
 
-auto parse_num(std::string_view &source) -> jp::expected<jp::Number, Error> {
-    auto i = 0u;
-    // consume digits until '.' or 'e' or 'E'
-    while (i < source.size() && is_numeric(source[i])) {
-        i++;
+auto parse_str(std::string_view &source, jp::utf8::Mode utf8_mode) -> jp::expected<std::string, Error> {
+    auto current_index = std::size_t{0};
+
+    // Jumps from one quote, backslash or control character to the next
+    while ((current_index += jp::scan::find_string_special(source.substr(current_index))) < source.size()) {
+        const auto c = source[current_index];
+
+        if (c == '"') {
+            const auto body = source.substr(0, current_index);
+            source.remove_prefix(current_index + 1);
+            if (jp::utf8::is_valid(body)) {
+                return std::string{body};
+            }
+            if (utf8_mode == jp::utf8::Mode::Lenient) {
+                return jp::utf8::repair(body);
+            }
+            return Error{ErrorCode::InvalidUtf8, jp::utf8::first_invalid(body)};
+        }
+
+        if (c == '\\') {
+            auto length = escape_length(source, current_index);
+            if (length.has_error()) {
+                return length.consume_error();
+            }
+            current_index += length.value();
+            continue;
+        }
+
+        // Control characters have to be escaped
+        return Error{ErrorCode::UnescapedControlCharacter, static_cast<int>(c)};
     }
 
-    bool is_float = i < source.size() && source[i] == '.';
-    // check if it's a floating point number
-    if (is_float) {
-        i++;
+    return Error{ErrorCode::UnexpectedEndOfString};
+}
+
+/*
+Number parsing:
+    number:
+        '-'? int fraction? exponent?
+
+    int:
+        '0'
+        '1' . '9' digits?
+
+    fraction:
+        '.' digits
+
+    exponent:
+        ('e' | 'E') ('+' | '-')? digits
+
+Integers without a fraction and exponents that keep them whole and within 64 bits stay integers, everything else is a
+double. Doubles too small to represent become zero, doubles too large are malformed. A leading zero ends the integer
+part, the digits after it are left for the next token.
+*/
+auto parse_num(std::string_view &source) -> jp::expected<jp::Number, Error> {
+    auto i = std::size_t{0};
+    const auto digits = [&] {
+        const auto start = i;
         while (i < source.size() && is_numeric(source[i])) {
             i++;
         }
+        return i - start;
+    };
+    // The malformed prefix is consumed, lexing goes on after it
+    const auto malformed = [&](Error error) {
+        source.remove_prefix(i);
+        return error;
+    };
+
+    if (i < source.size() && source[i] == '-') {
+        i++;
+    }
+    const auto integer_start = i;
+    if (digits() == 0) {
+        return malformed(Error{ErrorCode::MalformedNumber, std::string{source.substr(0, i)}});
+    }
+    if (source[integer_start] == '0') {
+        i = integer_start + 1;
     }
-    const auto number_str = source.substr(0, i);
 
-    auto value = jp::Number{};
-    if (is_float) {
-        value = jp::Number{.value = std::stod(std::string(number_str))};
-    } else {
-        value = jp::Number{.value = std::stoll(std::string(number_str))};
+    const auto is_fraction = i < source.size() && source[i] == '.';
+    if (is_fraction) {
+        i++;
+        if (digits() == 0) {
+            return malformed(Error{ErrorCode::MalformedNumber, std::string{source.substr(0, i)}});
+        }
     }
-    source.remove_prefix(i);
 
-    // check if it's a scientific notation
-    if (!source.empty() && (source[0] == 'e' || source[0] == 'E')) {
-        auto i = 1u;
+    const auto is_exponent = i < source.size() && (source[i] == 'e' || source[i] == 'E');
+    auto is_negative_exponent = false;
+    if (is_exponent) {
+        i++;
         if (i < source.size() && (source[i] == '+' || source[i] == '-')) {
+            is_negative_exponent = source[i] == '-';
             i++;
         }
-        while (i < source.size() && is_numeric(source[i])) {
-            i++;
-        }
-
         // no number after 'e' or 'E'
-        if (i == 1) {
-            return Error{"Lexer", "Invalid scientific notation", 0, 0};
+        if (digits() == 0) {
+            return malformed(Error{ErrorCode::InvalidExponent});
         }
+    }
 
-        const auto exponential = source.substr(1, i - 1);
-        const auto exp_value = std::stod(std::string(exponential));
-        std::visit([&exp_value](auto &value) { value = value * std::pow(10, exp_value); }, value.value);
+    const auto number_str = source.substr(0, i);
+    source.remove_prefix(i);
 
-        source.remove_prefix(i);
+    if (!is_fraction && !is_exponent) {
+        auto integer = std::int64_t{0};
+        const auto [end, error] = std::from_chars(number_str.data(), number_str.data() + number_str.size(), integer);
+        if (error == std::errc{}) {
+            return jp::Number{.value = integer};
+        }
     }
 
-    return value;
+    auto value = 0.0;
+    const auto [end, error] = std::from_chars(number_str.data(), number_str.data() + number_str.size(), value);
+    if (error == std::errc::result_out_of_range) {
+        // Underflow rounds to zero like strtod, which from_chars leaves to the caller. Overflow has no JSON
+        // representation, so it is rejected rather than printed as `inf`.
+        value = std::strtod(std::string{number_str}.c_str(), nullptr);
+        if (std::isinf(value)) {
+            return Error{ErrorCode::MalformedNumber, std::string{number_str}};
+        }
+    }
+
+    constexpr auto integer_limit = 9223372036854775808.0;
+    if (is_exponent && !is_fraction && !is_negative_exponent && value > -integer_limit && value < integer_limit) {
+        return jp::Number{.value = static_cast<std::int64_t>(value)};
+    }
+    return jp::Number{.value = value};
 }
@@ -3,11 +3,15 @@
 #include "expected.hpp"
 #include "error.hpp"
 #include "token.hpp"
+#include "utf8.hpp"
 #include <functional>
 
 constexpr auto default_ending_predicate = [](char c) -> bool { return c == '"'; };
 
-// Expects a string_view that starts with the first character after the opening '"'
-auto parse_str(std::string_view &source, const std::function<bool(char)> &ending_predicate = default_ending_predicate)
+// Expects a string_view that starts with the first character after the opening '"'. The string has to be valid UTF-8
+// without unescaped control characters, in lenient mode invalid sequences are replaced instead.
+auto parse_str(std::string_view &source, jp::utf8::Mode utf8_mode) -> jp::expected<std::string, Error>;
+// Ends the string at the first character `ending_predicate` accepts instead of the closing '"'
+auto parse_str(std::string_view &source, const std::function<bool(char)> &ending_predicate)
     -> jp::expected<std::string, Error>;
 auto parse_num(std::string_view &source) -> jp::expected<jp::Number, Error>;
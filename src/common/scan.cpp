@@ -0,0 +1,182 @@
+#include "scan.hpp"
+#include <bit>
+#include <cstdint>
+
+#if defined(JSON_EVAL_X86_KERNELS)
+#include <immintrin.h>
+#endif
+
+namespace jp::scan {
+
+namespace {
+
+auto skip_whitespace_scalar(const char *data, std::size_t size, Whitespace run) -> Whitespace {
+    for (; run.size < size && is_whitespace(data[run.size]); run.size++) {
+        if (data[run.size] == '\n') {
+            run.newlines++;
+            run.last_newline = run.size;
+        }
+    }
+    return run;
+}
+
+auto skip_whitespace_scalar(const char *data, std::size_t size) -> Whitespace {
+    return skip_whitespace_scalar(data, size, Whitespace{});
+}
+
+auto find_string_special_scalar(const char *data, std::size_t size, std::size_t from) -> std::size_t {
+    while (from < size && !is_string_special(data[from])) {
+        from++;
+    }
+    return from;
+}
+
+auto find_string_special_scalar(const char *data, std::size_t size) -> std::size_t {
+    return find_string_special_scalar(data, size, 0);
+}
+
+constexpr auto scalar_kernels = Kernels{skip_whitespace_scalar, find_string_special_scalar};
+
+#if defined(JSON_EVAL_X86_KERNELS)
+
+// Adds a block of `width` bytes, given as masks with bit i set for byte i, to the run. Returns true if the block ends
+// the run.
+[[gnu::always_inline]] inline auto add_block(Whitespace &run, std::uint64_t whitespace, std::uint64_t newline,
+                                             std::size_t width) -> bool {
+    const auto other = ~whitespace & (width == 64 ? ~std::uint64_t{0} : (std::uint64_t{1} << width) - 1);
+    const auto length = other == 0 ? width : static_cast<std::size_t>(std::countr_zero(other));
+    const auto newlines = length == 64 ? newline : newline & ((std::uint64_t{1} << length) - 1);
+    if (newlines != 0) {
+        run.newlines += static_cast<std::size_t>(std::popcount(newlines));
+        run.last_newline = run.size + 63 - static_cast<std::size_t>(std::countl_zero(newlines));
+    }
+    run.size += length;
+    return other != 0;
+}
+
+JSON_EVAL_TARGET_SSE42 auto skip_whitespace_sse42(const char *data, std::size_t size) -> Whitespace {
+    auto run = Whitespace{};
+    for (; run.size + 16 <= size;) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + run.size));
+        const auto newline = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'));
+        const auto blank = _mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(' ')),
+                                        _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\t')));
+        const auto whitespace = _mm_or_si128(_mm_or_si128(blank, newline), _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r')));
+        if (add_block(run, static_cast<std::uint32_t>(_mm_movemask_epi8(whitespace)),
+                      static_cast<std::uint32_t>(_mm_movemask_epi8(newline)), 16)) {
+            return run;
+        }
+    }
+    return skip_whitespace_scalar(data, size, run);
+}
+
+JSON_EVAL_TARGET_SSE42 auto find_string_special_sse42(const char *data, std::size_t size) -> std::size_t {
+    auto i = std::size_t{0};
+    for (; i + 16 <= size; i += 16) {
+        const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        // Unsigned bytes up to 0x1f are the ones max(byte, 0x1f) leaves at 0x1f
+        const auto control = _mm_cmpeq_epi8(_mm_max_epu8(bytes, _mm_set1_epi8(0x1f)), _mm_set1_epi8(0x1f));
+        const auto special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')),
+                                                       _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\\'))),
+                                          control);
+        if (const auto mask = static_cast<std::uint32_t>(_mm_movemask_epi8(special)); mask != 0) {
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+    return find_string_special_scalar(data, size, i);
+}
+
+JSON_EVAL_TARGET_AVX2 auto skip_whitespace_avx2(const char *data, std::size_t size) -> Whitespace {
+    auto run = Whitespace{};
+    for (; run.size + 32 <= size;) {
+        const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + run.size));
+        const auto newline = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'));
+        const auto blank = _mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' ')),
+                                           _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\t')));
+        const auto whitespace =
+            _mm256_or_si256(_mm256_or_si256(blank, newline), _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\r')));
+        if (add_block(run, static_cast<std::uint32_t>(_mm256_movemask_epi8(whitespace)),
+                      static_cast<std::uint32_t>(_mm256_movemask_epi8(newline)), 32)) {
+            return run;
+        }
+    }
+    return skip_whitespace_scalar(data, size, run);
+}
+
+JSON_EVAL_TARGET_AVX2 auto find_string_special_avx2(const char *data, std::size_t size) -> std::size_t {
+    auto i = std::size_t{0};
+    for (; i + 32 <= size; i += 32) {
+        const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+        const auto control =
+            _mm256_cmpeq_epi8(_mm256_max_epu8(bytes, _mm256_set1_epi8(0x1f)), _mm256_set1_epi8(0x1f));
+        const auto special = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('"')),
+                                                             _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\\'))),
+                                             control);
+        if (const auto mask = static_cast<std::uint32_t>(_mm256_movemask_epi8(special)); mask != 0) {
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+    return find_string_special_scalar(data, size, i);
+}
+
+// The last partial block is read with a masked load, which doesn't touch the bytes past the end
+JSON_EVAL_TARGET_AVX512 auto load_mask(std::size_t remaining) -> __mmask64 {
+    return remaining >= 64 ? ~__mmask64{0} : (__mmask64{1} << remaining) - 1;
+}
+
+JSON_EVAL_TARGET_AVX512 auto skip_whitespace_avx512(const char *data, std::size_t size) -> Whitespace {
+    auto run = Whitespace{};
+    while (run.size < size) {
+        // Masked off bytes are zero, which isn't whitespace and ends the run within the input
+        const auto bytes = _mm512_maskz_loadu_epi8(load_mask(size - run.size), data + run.size);
+        const auto newline = _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8('\n'));
+        const auto whitespace = newline | _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8(' ')) |
+                                _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8('\t')) |
+                                _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8('\r'));
+        if (add_block(run, whitespace, newline, 64)) {
+            break;
+        }
+    }
+    return run;
+}
+
+JSON_EVAL_TARGET_AVX512 auto find_string_special_avx512(const char *data, std::size_t size) -> std::size_t {
+    for (auto i = std::size_t{0}; i < size; i += 64) {
+        const auto valid = load_mask(size - i);
+        const auto bytes = _mm512_maskz_loadu_epi8(valid, data + i);
+        const auto special = _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8('"')) |
+                             _mm512_cmpeq_epi8_mask(bytes, _mm512_set1_epi8('\\')) |
+                             _mm512_cmplt_epu8_mask(bytes, _mm512_set1_epi8(0x20));
+        if (const auto mask = special & valid; mask != 0) {
+            return i + static_cast<std::size_t>(std::countr_zero(mask));
+        }
+    }
+    return size;
+}
+
+constexpr auto sse42_kernels = Kernels{skip_whitespace_sse42, find_string_special_sse42};
+constexpr auto avx2_kernels = Kernels{skip_whitespace_avx2, find_string_special_avx2};
+constexpr auto avx512_kernels = Kernels{skip_whitespace_avx512, find_string_special_avx512};
+
+#endif
+
+} // namespace
+
+auto kernels(cpu::Level level) -> const Kernels & {
+#if defined(JSON_EVAL_X86_KERNELS)
+    switch (level) {
+    case cpu::Level::Scalar:
+        return scalar_kernels;
+    case cpu::Level::SSE42:
+        return sse42_kernels;
+    case cpu::Level::AVX2:
+        return avx2_kernels;
+    case cpu::Level::AVX512:
+        return avx512_kernels;
+    }
+#endif
+    (void)level;
+    return scalar_kernels;
+}
+
+} // namespace jp::scan
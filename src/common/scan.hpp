@@ -0,0 +1,60 @@
+#pragma once
+
+#include "cpu.hpp"
+#include <cstddef>
+#include <string_view>
+
+// Byte scanning kernels of the lexer, in one variant per cpu::Level
+namespace jp::scan {
+
+constexpr auto is_whitespace(char c) -> bool { return c == ' ' || c == '\n' || c == '\t' || c == '\r'; }
+
+struct Whitespace {
+    std::size_t size = 0;
+    std::size_t newlines = 0;
+    // Index of the last '\n', only meaningful if there was one
+    std::size_t last_newline = 0;
+};
+
+struct Kernels {
+    auto (*skip_whitespace)(const char *data, std::size_t size) -> Whitespace;
+    auto (*find_string_special)(const char *data, std::size_t size) -> std::size_t;
+};
+
+// The variants of `level`, which has to be supported by the processor
+auto kernels(cpu::Level level) -> const Kernels &;
+
+inline auto active_kernels() -> const Kernels & {
+    static const auto &selected = kernels(cpu::active_level());
+    return selected;
+}
+
+// The whitespace `text` starts with. Most runs between tokens are a single space, those don't reach the kernel.
+inline auto skip_whitespace(std::string_view text) -> Whitespace {
+    if (text.empty() || !is_whitespace(text.front())) {
+        return {};
+    }
+    if (text.size() == 1 || !is_whitespace(text[1])) {
+        return text.front() == '\n' ? Whitespace{.size = 1, .newlines = 1, .last_newline = 0} : Whitespace{.size = 1};
+    }
+    return active_kernels().skip_whitespace(text.data(), text.size());
+}
+
+constexpr auto is_string_special(char c) -> bool {
+    return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+// Index of the first '"', '\\' or control character in `text`, text.size() if there is none. Only these bytes end
+// or change the meaning of a string, the runs between them are copied as they are. Keys and short values end within
+// the first few bytes, which are checked before calling the kernel.
+inline auto find_string_special(std::string_view text) -> std::size_t {
+    constexpr auto inline_bytes = std::size_t{8};
+    for (auto i = std::size_t{0}; i < inline_bytes; i++) {
+        if (i == text.size() || is_string_special(text[i])) {
+            return i;
+        }
+    }
+    return inline_bytes + active_kernels().find_string_special(text.data() + inline_bytes, text.size() - inline_bytes);
+}
+
+} // namespace jp::scan
@@ -0,0 +1,142 @@
+#include "thread_pool.hpp"
+#include "memory.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <format>
+
+namespace jp {
+
+namespace {
+// Pool and queue owned by the current thread, current_pool is nullptr outside of any pool
+thread_local auto current_pool = static_cast<const ThreadPool *>(nullptr);
+thread_local auto current_queue = std::size_t{0};
+} // namespace
+
+ThreadPool::ThreadPool(std::size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (auto i = std::size_t{0}; i < thread_count; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+
+    for (auto i = std::size_t{0}; i < thread_count; i++) {
+        workers.emplace_back([this, i] { worker_loop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        auto lock = std::scoped_lock{wake_mutex};
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    // Tasks spawned by a worker stay on its own deque, everything else is spread round-robin
+    const auto queue = current_pool == this ? current_queue : next_queue++ % queues.size();
+
+    {
+        auto lock = std::scoped_lock{queues[queue]->mutex};
+        queues[queue]->tasks.push_back(std::move(task));
+    }
+
+    {
+        auto lock = std::scoped_lock{wake_mutex};
+        pending++;
+    }
+    wake.notify_one();
+}
+
+auto ThreadPool::try_run_one(std::size_t home) -> bool {
+    auto task = std::function<void()>{};
+
+    for (auto offset = std::size_t{0}; offset < queues.size() && !task; offset++) {
+        auto &queue = *queues[(home + offset) % queues.size()];
+        auto lock = std::scoped_lock{queue.mutex};
+
+        if (queue.tasks.empty()) {
+            continue;
+        }
+
+        // LIFO on the own deque for locality, FIFO when stealing so the oldest (largest) work moves
+        if (offset == 0) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        } else {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    {
+        auto lock = std::scoped_lock{wake_mutex};
+        pending--;
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::worker_loop(std::size_t index) {
+    current_pool = this;
+    current_queue = index;
+    trace::set_thread_name(std::format("pool worker {}", index));
+
+    while (true) {
+        if (try_run_one(index)) {
+            continue;
+        }
+
+        auto lock = std::unique_lock{wake_mutex};
+        wake.wait(lock, [this] { return stopping || pending > 0; });
+
+        if (stopping && pending == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::parallel_for(std::size_t count, const std::function<void(std::size_t)> &fn) {
+    // Shared with the tasks: the last one can still be notifying when the caller sees the count reach zero and returns
+    auto remaining = std::make_shared<std::atomic<std::size_t>>(count);
+    // Chunks allocate on behalf of the caller
+    const auto category = memory::current_category;
+
+    for (auto i = std::size_t{0}; i < count; i++) {
+        submit([&fn, remaining, i, category] {
+            {
+                auto scope = memory::Scope{category};
+                auto span = trace::Span{"chunk", "pool", static_cast<std::int64_t>(i)};
+                fn(i);
+            }
+            if (--*remaining == 0) {
+                remaining->notify_all();
+            }
+        });
+    }
+
+    const auto home = current_pool == this ? current_queue : 0;
+    while (true) {
+        const auto left = remaining->load();
+        if (left == 0) {
+            return;
+        }
+
+        // Help out instead of blocking, the tasks still queued may well be our own
+        if (!try_run_one(home)) {
+            remaining->wait(left);
+        }
+    }
+}
+
+} // namespace jp
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jp {
+
+// Work-stealing thread pool. Every worker owns a deque: it pops its own tasks from the back and steals from the
+// front of the other deques once it runs dry. Threads waiting in parallel_for() execute pending tasks instead of
+// blocking, so nested parallel sections can't deadlock the pool.
+class ThreadPool {
+  public:
+    // 0 picks the number of hardware threads
+    explicit ThreadPool(std::size_t thread_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    void submit(std::function<void()> task);
+
+    // Calls fn(i) for every i in [0, count) and returns once all calls have finished
+    void parallel_for(std::size_t count, const std::function<void(std::size_t)> &fn);
+
+    [[nodiscard]] auto size() const -> std::size_t { return workers.size(); }
+
+  private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    auto try_run_one(std::size_t home) -> bool;
+    void worker_loop(std::size_t index);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> next_queue{0};
+    bool stopping = false;
+};
+
+} // namespace jp
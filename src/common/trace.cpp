@@ -0,0 +1,152 @@
+#include "trace.hpp"
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace jp::trace {
+
+namespace {
+
+// One cache line per event
+struct Event {
+    char name[32];
+    const char *category;
+    std::int64_t start_ns;
+    std::int64_t duration_ns;
+    std::int64_t index;
+};
+
+struct ThreadBuffer {
+    std::vector<Event> events;
+    // Spans recorded so far, the ring holds the latest events.size() of them
+    std::size_t recorded = 0;
+    std::size_t thread_id = 0;
+    std::string thread_name;
+};
+
+struct Registry {
+    std::mutex mutex;
+    // Kept after their threads exit, until the trace is written
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::size_t events_per_thread = 0;
+    std::int64_t origin_ns = 0;
+};
+
+auto registry() -> Registry & {
+    static auto instance = Registry{};
+    return instance;
+}
+
+thread_local auto current_buffer = static_cast<ThreadBuffer *>(nullptr);
+
+auto now_ns() -> std::int64_t {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+auto thread_buffer() -> ThreadBuffer & {
+    if (current_buffer == nullptr) {
+        auto &shared = registry();
+        auto lock = std::scoped_lock{shared.mutex};
+        auto buffer = std::make_unique<ThreadBuffer>();
+        buffer->events.resize(shared.events_per_thread);
+        buffer->thread_id = shared.buffers.size() + 1;
+        current_buffer = shared.buffers.emplace_back(std::move(buffer)).get();
+    }
+    return *current_buffer;
+}
+
+// Names are written without escaping, characters that would need it are replaced
+void copy_name(std::string_view name, char (&target)[32]) {
+    const auto size = std::min(name.size(), sizeof(target) - 1);
+    for (auto i = std::size_t{0}; i < size; i++) {
+        const auto c = name[i];
+        target[i] = c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20 ? '_' : c;
+    }
+    target[size] = '\0';
+}
+
+} // namespace
+
+void start(std::size_t events_per_thread) {
+    auto &shared = registry();
+    {
+        auto lock = std::scoped_lock{shared.mutex};
+        shared.events_per_thread = std::max(std::size_t{1}, events_per_thread);
+        shared.origin_ns = now_ns();
+    }
+    enabled.store(true, std::memory_order_relaxed);
+}
+
+void set_thread_name(std::string_view name) {
+    if (enabled.load(std::memory_order_relaxed)) {
+        thread_buffer().thread_name = name;
+    }
+}
+
+void Span::begin(std::string_view span_name, const char *span_category, std::int64_t span_index) {
+    name = span_name;
+    category = span_category;
+    index = span_index;
+    start_ns = now_ns();
+    active = true;
+}
+
+void Span::end() {
+    const auto end_ns = now_ns();
+    auto &buffer = thread_buffer();
+    auto &event = buffer.events[buffer.recorded % buffer.events.size()];
+    copy_name(name, event.name);
+    event.category = category;
+    event.start_ns = start_ns;
+    event.duration_ns = end_ns - start_ns;
+    event.index = index;
+    buffer.recorded++;
+}
+
+auto write(const std::string &path) -> bool {
+    auto file = std::ofstream{path};
+    if (!file) {
+        return false;
+    }
+
+    auto &shared = registry();
+    auto lock = std::scoped_lock{shared.mutex};
+    const auto micros = [&](std::int64_t ns) { return static_cast<double>(ns - shared.origin_ns) / 1e3; };
+
+    auto dropped = std::size_t{0};
+    file << R"({"traceEvents": [)" << '\n';
+    file << R"({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "json-eval"}})";
+    for (const auto &buffer : shared.buffers) {
+        if (!buffer->thread_name.empty()) {
+            auto name = Event{};
+            copy_name(buffer->thread_name, name.name);
+            file << std::format(R"(,{}{{"name": "thread_name", "ph": "M", "pid": 1, "tid": {}, )", '\n',
+                                buffer->thread_id)
+                 << std::format(R"("args": {{"name": "{}"}}}})", name.name);
+        }
+
+        const auto capacity = buffer->events.size();
+        const auto kept = std::min(buffer->recorded, capacity);
+        dropped += buffer->recorded - kept;
+        for (auto i = buffer->recorded - kept; i < buffer->recorded; i++) {
+            const auto &event = buffer->events[i % capacity];
+            file << std::format(R"(,{}{{"name": "{}", "cat": "{}", "ph": "X", "pid": 1, "tid": {}, "ts": {:.3f}, )",
+                                '\n', event.name, event.category, buffer->thread_id, micros(event.start_ns));
+            file << std::format(R"("dur": {:.3f})", static_cast<double>(event.duration_ns) / 1e3);
+            if (event.index >= 0) {
+                file << std::format(R"(, "args": {{"index": {}}})", event.index);
+            }
+            file << '}';
+        }
+    }
+    file << std::format("\n], \"displayTimeUnit\": \"ns\", \"otherData\": {{\"dropped_events\": {}}}}}\n", dropped);
+
+    return static_cast<bool>(file);
+}
+
+} // namespace jp::trace
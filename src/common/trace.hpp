@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace jp::trace {
+
+// Set by start(), spans opened before it are not recorded
+inline std::atomic<bool> enabled{false};
+
+// Records spans from now on. Every thread keeps its latest `events_per_thread` spans in a ring buffer of its own, so
+// recording never takes a lock.
+void start(std::size_t events_per_thread = std::size_t{1} << 16);
+
+// Writes the recorded spans in the Chrome trace event format, which Perfetto and chrome://tracing open. The traced
+// work has to be finished: the ring buffers are read without synchronizing with their threads.
+auto write(const std::string &path) -> bool;
+
+// Names the calling thread in the trace
+void set_thread_name(std::string_view name);
+
+// Records the time from construction to destruction on the calling thread, at the cost of one relaxed load while
+// tracing is off. The name is copied when the span ends, the category has to outlive the trace. A non-negative
+// `index` is attached as an argument.
+class Span {
+  public:
+    explicit Span(std::string_view name, const char *category, std::int64_t index = -1) {
+        if (enabled.load(std::memory_order_relaxed)) {
+            begin(name, category, index);
+        }
+    }
+
+    ~Span() {
+        if (active) {
+            end();
+        }
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+
+  private:
+    void begin(std::string_view span_name, const char *span_category, std::int64_t span_index);
+    void end();
+
+    std::string_view name;
+    const char *category = nullptr;
+    std::int64_t index = -1;
+    std::int64_t start_ns = 0;
+    bool active = false;
+};
+
+} // namespace jp::trace
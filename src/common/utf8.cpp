@@ -0,0 +1,363 @@
+#include "utf8.hpp"
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(JSON_EVAL_X86_KERNELS)
+#include <immintrin.h>
+#endif
+
+namespace jp::utf8 {
+
+namespace {
+
+struct Sequence {
+    // An ill-formed sequence has the size of its maximal subpart, at least one byte
+    std::size_t size;
+    bool valid;
+};
+
+// The sequence starting at `i`, checked against table 3-7 of the Unicode standard
+auto decode(const unsigned char *data, std::size_t size, std::size_t i) -> Sequence {
+    const auto lead = data[i];
+    if (lead < 0x80) {
+        return {1, true};
+    }
+
+    auto length = std::size_t{0};
+    // The second byte's range depends on the lead byte, the ones after it are plain continuation bytes
+    auto lower = 0x80u;
+    auto upper = 0xbfu;
+    if (lead >= 0xc2 && lead <= 0xdf) {
+        length = 2;
+    } else if (lead >= 0xe0 && lead <= 0xef) {
+        length = 3;
+        lower = lead == 0xe0 ? 0xa0 : lower;
+        upper = lead == 0xed ? 0x9f : upper;
+    } else if (lead >= 0xf0 && lead <= 0xf4) {
+        length = 4;
+        lower = lead == 0xf0 ? 0x90 : lower;
+        upper = lead == 0xf4 ? 0x8f : upper;
+    } else {
+        return {1, false};
+    }
+
+    for (auto k = std::size_t{1}; k < length; k++) {
+        if (i + k >= size || data[i + k] < lower || data[i + k] > upper) {
+            return {k, false};
+        }
+        lower = 0x80u;
+        upper = 0xbfu;
+    }
+    return {length, true};
+}
+
+auto first_invalid_scalar(const char *text, std::size_t size) -> std::size_t {
+    const auto *data = reinterpret_cast<const unsigned char *>(text);
+    auto i = std::size_t{0};
+    while (i < size) {
+        // Eight ASCII bytes at a time
+        if (i + 8 <= size) {
+            auto word = std::uint64_t{0};
+            std::memcpy(&word, data + i, sizeof(word));
+            if ((word & 0x8080808080808080) == 0) {
+                i += 8;
+                continue;
+            }
+        }
+        const auto sequence = decode(data, size, i);
+        if (!sequence.valid) {
+            return i;
+        }
+        i += sequence.size;
+    }
+    return size;
+}
+
+auto validate_scalar(const char *data, std::size_t size) -> bool { return first_invalid_scalar(data, size) == size; }
+
+constexpr auto scalar_kernels = Kernels{validate_scalar};
+
+#if defined(JSON_EVAL_X86_KERNELS)
+
+// The lookup algorithm of Keiser and Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte". Every error a
+// byte can make together with the one before it is a bit, and three 16 entry tables indexed by the high and low nibble
+// of the previous byte and the high nibble of the current one give the errors each nibble allows. A byte pair is
+// invalid if all three agree on an error. The third and fourth bytes of a sequence are checked by looking back two and
+// three bytes for a lead byte that needs them.
+constexpr auto too_short = std::uint8_t{1 << 0};      // a lead byte or ASCII after a lead byte
+constexpr auto too_long = std::uint8_t{1 << 1};       // a continuation byte after ASCII
+constexpr auto overlong_3 = std::uint8_t{1 << 2};     // 0xe0 followed by 0x80 - 0x9f
+constexpr auto too_large = std::uint8_t{1 << 3};      // 0xf4 followed by 0x90 - 0xbf, or a lead byte above 0xf4
+constexpr auto surrogate = std::uint8_t{1 << 4};      // 0xed followed by 0xa0 - 0xbf
+constexpr auto overlong_2 = std::uint8_t{1 << 5};     // 0xc0 or 0xc1
+constexpr auto too_large_1000 = std::uint8_t{1 << 6}; // a lead byte above 0xf4 followed by 0x80 - 0x8f
+constexpr auto overlong_4 = std::uint8_t{1 << 6};     // 0xf0 followed by 0x80 - 0x8f
+constexpr auto two_continuations = std::uint8_t{1 << 7};
+constexpr auto carry = std::uint8_t{too_short | too_long | two_continuations};
+
+alignas(16) constexpr std::uint8_t byte_1_high[16] = {
+    // 0_______: ASCII
+    too_long, too_long, too_long, too_long, too_long, too_long, too_long, too_long,
+    // 10______: continuation
+    two_continuations, two_continuations, two_continuations, two_continuations,
+    // 1100____, 1101____, 1110____, 1111____: lead bytes
+    too_short | overlong_2, too_short, too_short | overlong_3 | surrogate,
+    too_short | too_large | too_large_1000 | overlong_4};
+
+alignas(16) constexpr std::uint8_t byte_1_low[16] = {
+    carry | overlong_3 | overlong_2 | overlong_4,
+    carry | overlong_2,
+    carry,
+    carry,
+    carry | too_large,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000 | surrogate,
+    carry | too_large | too_large_1000,
+    carry | too_large | too_large_1000};
+
+alignas(16) constexpr std::uint8_t byte_2_high[16] = {
+    too_short, too_short, too_short, too_short, too_short, too_short, too_short, too_short,
+    too_long | overlong_2 | two_continuations | overlong_3 | too_large_1000 | overlong_4,
+    too_long | overlong_2 | two_continuations | overlong_3 | too_large,
+    too_long | overlong_2 | two_continuations | surrogate | too_large,
+    too_long | overlong_2 | two_continuations | surrogate | too_large,
+    too_short, too_short, too_short, too_short};
+
+// A block whose last byte is at least 0xc0, second to last at least 0xe0 or third to last at least 0xf0 ends in the
+// middle of a sequence. Subtracting these maxima with saturation leaves a non-zero byte exactly there.
+constexpr auto incomplete_max = [] {
+    auto max = std::array<std::uint8_t, 64>{};
+    max.fill(0xff);
+    max[61] = 0xef;
+    max[62] = 0xdf;
+    max[63] = 0xbf;
+    return max;
+}();
+
+// The errors found so far, the last block and where it ends in the middle of a sequence
+struct Validation128 {
+    __m128i error;
+    __m128i previous;
+    __m128i incomplete;
+};
+
+struct Validation256 {
+    __m256i error;
+    __m256i previous;
+    __m256i incomplete;
+};
+
+struct Validation512 {
+    __m512i error;
+    __m512i previous;
+    __m512i incomplete;
+};
+
+JSON_EVAL_TARGET_SSE42 auto lookup(const std::uint8_t (&table)[16], __m128i index) -> __m128i {
+    return _mm_shuffle_epi8(_mm_load_si128(reinterpret_cast<const __m128i *>(table)), index);
+}
+
+JSON_EVAL_TARGET_SSE42 void check_block(Validation128 &state, __m128i input) {
+    if (_mm_movemask_epi8(input) == 0) {
+        // ASCII doesn't continue a sequence, one cut at the end of the last block stays cut
+        state.error = _mm_or_si128(state.error, state.incomplete);
+        state.incomplete = _mm_setzero_si128();
+        state.previous = input;
+        return;
+    }
+
+    const auto nibble = _mm_set1_epi8(0x0f);
+    const auto prev1 = _mm_alignr_epi8(input, state.previous, 15);
+    const auto prev2 = _mm_alignr_epi8(input, state.previous, 14);
+    const auto prev3 = _mm_alignr_epi8(input, state.previous, 13);
+    const auto special =
+        _mm_and_si128(_mm_and_si128(lookup(byte_1_high, _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                                    lookup(byte_1_low, _mm_and_si128(prev1, nibble))),
+                      lookup(byte_2_high, _mm_and_si128(_mm_srli_epi16(input, 4), nibble)));
+    // Bytes two after a 3 or 4 byte lead and three after a 4 byte lead have to be continuations
+    const auto third = _mm_subs_epu8(prev2, _mm_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+    const auto fourth = _mm_subs_epu8(prev3, _mm_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+    const auto continuation = _mm_and_si128(_mm_or_si128(third, fourth), _mm_set1_epi8(static_cast<char>(0x80)));
+
+    state.error = _mm_or_si128(state.error, _mm_xor_si128(continuation, special));
+    state.incomplete =
+        _mm_subs_epu8(input, _mm_loadu_si128(reinterpret_cast<const __m128i *>(incomplete_max.data() + 48)));
+    state.previous = input;
+}
+
+JSON_EVAL_TARGET_SSE42 auto validate_sse42(const char *data, std::size_t size) -> bool {
+    auto state = Validation128{_mm_setzero_si128(), _mm_setzero_si128(), _mm_setzero_si128()};
+    auto i = std::size_t{0};
+    for (; i + 16 <= size; i += 16) {
+        check_block(state, _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)));
+    }
+    if (i < size) {
+        // Zero padding is ASCII
+        char tail[16] = {};
+        std::memcpy(tail, data + i, size - i);
+        check_block(state, _mm_loadu_si128(reinterpret_cast<const __m128i *>(tail)));
+    }
+    const auto error = _mm_or_si128(state.error, state.incomplete);
+    return _mm_testz_si128(error, error) != 0;
+}
+
+JSON_EVAL_TARGET_AVX2 auto lookup(const std::uint8_t (&table)[16], __m256i index) -> __m256i {
+    return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i *>(table))),
+                               index);
+}
+
+JSON_EVAL_TARGET_AVX2 void check_block(Validation256 &state, __m256i input) {
+    if (_mm256_movemask_epi8(input) == 0) {
+        state.error = _mm256_or_si256(state.error, state.incomplete);
+        state.incomplete = _mm256_setzero_si256();
+        state.previous = input;
+        return;
+    }
+
+    // alignr shifts within 128 bit lanes, each lane is paired with the one before it
+    const auto nibble = _mm256_set1_epi8(0x0f);
+    const auto shifted = _mm256_permute2x128_si256(state.previous, input, 0x21);
+    const auto prev1 = _mm256_alignr_epi8(input, shifted, 15);
+    const auto prev2 = _mm256_alignr_epi8(input, shifted, 14);
+    const auto prev3 = _mm256_alignr_epi8(input, shifted, 13);
+    const auto special = _mm256_and_si256(
+        _mm256_and_si256(lookup(byte_1_high, _mm256_and_si256(_mm256_srli_epi16(prev1, 4), nibble)),
+                         lookup(byte_1_low, _mm256_and_si256(prev1, nibble))),
+        lookup(byte_2_high, _mm256_and_si256(_mm256_srli_epi16(input, 4), nibble)));
+    const auto third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+    const auto fourth = _mm256_subs_epu8(prev3, _mm256_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+    const auto continuation =
+        _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8(static_cast<char>(0x80)));
+
+    state.error = _mm256_or_si256(state.error, _mm256_xor_si256(continuation, special));
+    state.incomplete =
+        _mm256_subs_epu8(input, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(incomplete_max.data() + 32)));
+    state.previous = input;
+}
+
+JSON_EVAL_TARGET_AVX2 auto validate_avx2(const char *data, std::size_t size) -> bool {
+    auto state = Validation256{_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+    auto i = std::size_t{0};
+    for (; i + 32 <= size; i += 32) {
+        check_block(state, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i)));
+    }
+    if (i < size) {
+        char tail[32] = {};
+        std::memcpy(tail, data + i, size - i);
+        check_block(state, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(tail)));
+    }
+    const auto error = _mm256_or_si256(state.error, state.incomplete);
+    return _mm256_testz_si256(error, error) != 0;
+}
+
+JSON_EVAL_TARGET_AVX512 auto lookup(const std::uint8_t (&table)[16], __m512i index) -> __m512i {
+    return _mm512_shuffle_epi8(_mm512_broadcast_i32x4(_mm_load_si128(reinterpret_cast<const __m128i *>(table))),
+                               index);
+}
+
+JSON_EVAL_TARGET_AVX512 void check_block(Validation512 &state, __m512i input) {
+    if (_mm512_movepi8_mask(input) == 0) {
+        state.error = _mm512_or_si512(state.error, state.incomplete);
+        state.incomplete = _mm512_setzero_si512();
+        state.previous = input;
+        return;
+    }
+
+    // Each 128 bit lane is paired with the one before it: the last lane of the previous block, then lanes 0 to 2
+    const auto nibble = _mm512_set1_epi8(0x0f);
+    const auto shifted = _mm512_permutex2var_epi64(state.previous, _mm512_set_epi64(13, 12, 11, 10, 9, 8, 7, 6), input);
+    const auto prev1 = _mm512_alignr_epi8(input, shifted, 15);
+    const auto prev2 = _mm512_alignr_epi8(input, shifted, 14);
+    const auto prev3 = _mm512_alignr_epi8(input, shifted, 13);
+    const auto special = _mm512_and_si512(
+        _mm512_and_si512(lookup(byte_1_high, _mm512_and_si512(_mm512_srli_epi16(prev1, 4), nibble)),
+                         lookup(byte_1_low, _mm512_and_si512(prev1, nibble))),
+        lookup(byte_2_high, _mm512_and_si512(_mm512_srli_epi16(input, 4), nibble)));
+    const auto third = _mm512_subs_epu8(prev2, _mm512_set1_epi8(static_cast<char>(0xe0 - 0x80)));
+    const auto fourth = _mm512_subs_epu8(prev3, _mm512_set1_epi8(static_cast<char>(0xf0 - 0x80)));
+    const auto continuation =
+        _mm512_and_si512(_mm512_or_si512(third, fourth), _mm512_set1_epi8(static_cast<char>(0x80)));
+
+    state.error = _mm512_or_si512(state.error, _mm512_xor_si512(continuation, special));
+    state.incomplete = _mm512_subs_epu8(input, _mm512_loadu_si512(incomplete_max.data()));
+    state.previous = input;
+}
+
+JSON_EVAL_TARGET_AVX512 auto validate_avx512(const char *data, std::size_t size) -> bool {
+    auto state = Validation512{_mm512_setzero_si512(), _mm512_setzero_si512(), _mm512_setzero_si512()};
+    for (auto i = std::size_t{0}; i < size; i += 64) {
+        // Masked off bytes are zero, which is ASCII
+        const auto remaining = size - i;
+        const auto valid = remaining >= 64 ? ~__mmask64{0} : (__mmask64{1} << remaining) - 1;
+        check_block(state, _mm512_maskz_loadu_epi8(valid, data + i));
+    }
+    const auto error = _mm512_or_si512(state.error, state.incomplete);
+    return _mm512_test_epi8_mask(error, error) == 0;
+}
+
+constexpr auto sse42_kernels = Kernels{validate_sse42};
+constexpr auto avx2_kernels = Kernels{validate_avx2};
+constexpr auto avx512_kernels = Kernels{validate_avx512};
+
+#endif
+
+} // namespace
+
+auto mode_name(Mode mode) -> const char * { return mode == Mode::Strict ? "strict" : "lenient"; }
+
+auto parse_mode(std::string_view name) -> std::optional<Mode> {
+    for (const auto mode : {Mode::Strict, Mode::Lenient}) {
+        if (name == mode_name(mode)) {
+            return mode;
+        }
+    }
+    return std::nullopt;
+}
+
+auto kernels(cpu::Level level) -> const Kernels & {
+#if defined(JSON_EVAL_X86_KERNELS)
+    switch (level) {
+    case cpu::Level::Scalar:
+        return scalar_kernels;
+    case cpu::Level::SSE42:
+        return sse42_kernels;
+    case cpu::Level::AVX2:
+        return avx2_kernels;
+    case cpu::Level::AVX512:
+        return avx512_kernels;
+    }
+#endif
+    (void)level;
+    return scalar_kernels;
+}
+
+auto first_invalid(std::string_view text) -> std::size_t { return first_invalid_scalar(text.data(), text.size()); }
+
+auto repair(std::string_view text) -> std::string {
+    constexpr auto replacement = std::string_view{"\xef\xbf\xbd"};
+    const auto *data = reinterpret_cast<const unsigned char *>(text.data());
+    auto repaired = std::string{};
+    repaired.reserve(text.size() + replacement.size());
+
+    auto i = std::size_t{0};
+    while (i < text.size()) {
+        const auto valid = first_invalid(text.substr(i));
+        repaired.append(text.substr(i, valid));
+        i += valid;
+        if (i < text.size()) {
+            repaired.append(replacement);
+            i += decode(data, text.size(), i).size;
+        }
+    }
+    return repaired;
+}
+
+} // namespace jp::utf8
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "cpu.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// UTF-8 validation of string bodies, in one variant per cpu::Level
+namespace jp::utf8 {
+
+// Strict rejects a string with an invalid sequence, lenient replaces every maximal invalid subpart with U+FFFD
+enum class Mode { Strict, Lenient };
+
+auto mode_name(Mode mode) -> const char *;
+auto parse_mode(std::string_view name) -> std::optional<Mode>;
+
+struct Kernels {
+    auto (*validate)(const char *data, std::size_t size) -> bool;
+};
+
+// The variants of `level`, which has to be supported by the processor
+auto kernels(cpu::Level level) -> const Kernels &;
+
+inline auto active_kernels() -> const Kernels & {
+    static const auto &selected = kernels(cpu::active_level());
+    return selected;
+}
+
+// Whether `text` is well-formed UTF-8: no overlong forms, surrogates, code points past U+10FFFF or cut sequences.
+// Keys and short values are mostly ASCII, which is checked before calling the kernel.
+inline auto is_valid(std::string_view text) -> bool {
+    constexpr auto inline_bytes = std::size_t{16};
+    if (text.size() <= inline_bytes) {
+        auto high = 0u;
+        for (const auto c : text) {
+            high |= static_cast<unsigned char>(c);
+        }
+        if (high < 0x80) {
+            return true;
+        }
+    }
+    return active_kernels().validate(text.data(), text.size());
+}
+
+// Index of the first byte that doesn't start a well-formed sequence, text.size() if there is none
+auto first_invalid(std::string_view text) -> std::size_t;
+
+// `text` with every maximal subpart of an ill-formed sequence replaced by U+FFFD, as the Unicode standard recommends
+auto repair(std::string_view text) -> std::string;
+
+} // namespace jp::utf8
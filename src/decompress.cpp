@@ -0,0 +1,168 @@
+#include "decompress.hpp"
+#include <algorithm>
+#include <climits>
+
+#ifdef JSON_EVAL_GZIP
+#include <zlib.h>
+#endif
+
+#ifdef JSON_EVAL_ZSTD
+#include <zstd.h>
+#endif
+
+auto detect_compression(std::string_view prefix) -> Compression {
+    if (prefix.starts_with("\x1f\x8b")) {
+        return Compression::Gzip;
+    }
+    if (prefix.starts_with("\x28\xb5\x2f\xfd")) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+auto compression_name(Compression compression) -> const char * {
+    switch (compression) {
+    case Compression::None:
+        return "uncompressed";
+    case Compression::Gzip:
+        return "gzip";
+    case Compression::Zstd:
+        return "zstd";
+    }
+    return "";
+}
+
+struct Decompressor::State {
+#ifdef JSON_EVAL_GZIP
+    z_stream gzip{};
+    bool gzip_initialized = false;
+#endif
+#ifdef JSON_EVAL_ZSTD
+    ZSTD_DCtx *zstd = nullptr;
+#endif
+    // Whether the last member or frame was read to its end
+    bool complete = true;
+};
+
+Decompressor::Decompressor(Compression compression) : compression(compression), state(std::make_unique<State>()) {
+#ifdef JSON_EVAL_GZIP
+    if (compression == Compression::Gzip) {
+        // 32 lets zlib accept the gzip header
+        state->gzip_initialized = inflateInit2(&state->gzip, MAX_WBITS + 32) == Z_OK;
+    }
+#endif
+#ifdef JSON_EVAL_ZSTD
+    if (compression == Compression::Zstd) {
+        state->zstd = ZSTD_createDCtx();
+    }
+#endif
+}
+
+Decompressor::~Decompressor() {
+#ifdef JSON_EVAL_GZIP
+    if (state->gzip_initialized) {
+        inflateEnd(&state->gzip);
+    }
+#endif
+#ifdef JSON_EVAL_ZSTD
+    ZSTD_freeDCtx(state->zstd);
+#endif
+}
+
+auto Decompressor::decompress(std::string_view &input, std::span<char> output) -> jp::expected<std::size_t, Error> {
+    const auto *name = compression_name(compression);
+
+    switch (compression) {
+    case Compression::None: {
+        const auto size = std::min(input.size(), output.size());
+        std::copy_n(input.data(), size, output.data());
+        input.remove_prefix(size);
+        return size;
+    }
+
+    case Compression::Gzip: {
+#ifdef JSON_EVAL_GZIP
+        auto &stream = state->gzip;
+        if (!state->gzip_initialized) {
+            return Error{ErrorCode::InvalidCompressedData, name, "the decompressor could not be initialized"};
+        }
+
+        // Called until the output is full or zlib can't make progress: output of consumed input may still be pending
+        auto written = std::size_t{0};
+        while (written < output.size()) {
+            // zlib counts in 32 bits
+            const auto in_size = static_cast<uInt>(std::min<std::size_t>(input.size(), UINT_MAX));
+            const auto out_size = static_cast<uInt>(std::min<std::size_t>(output.size() - written, UINT_MAX));
+            stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+            stream.avail_in = in_size;
+            stream.next_out = reinterpret_cast<Bytef *>(output.data() + written);
+            stream.avail_out = out_size;
+
+            const auto result = inflate(&stream, Z_NO_FLUSH);
+            const auto consumed = in_size - stream.avail_in;
+            const auto produced = out_size - stream.avail_out;
+            input.remove_prefix(consumed);
+            written += produced;
+
+            if (result == Z_STREAM_END) {
+                // Another member may follow
+                state->complete = true;
+                if (inflateReset(&stream) != Z_OK) {
+                    return Error{ErrorCode::InvalidCompressedData, name, "could not start the next member"};
+                }
+                if (input.empty()) {
+                    break;
+                }
+                continue;
+            }
+            if (result == Z_BUF_ERROR || (consumed == 0 && produced == 0)) {
+                break;
+            }
+            if (result != Z_OK) {
+                return Error{ErrorCode::InvalidCompressedData, name, std::string{stream.msg ? stream.msg : "corrupt"}};
+            }
+            state->complete = false;
+        }
+        return written;
+#else
+        return Error{ErrorCode::InvalidCompressedData, name, "this build has no gzip support"};
+#endif
+    }
+
+    case Compression::Zstd: {
+#ifdef JSON_EVAL_ZSTD
+        if (state->zstd == nullptr) {
+            return Error{ErrorCode::InvalidCompressedData, name, "the decompressor could not be initialized"};
+        }
+
+        auto in = ZSTD_inBuffer{.src = input.data(), .size = input.size(), .pos = 0};
+        auto out = ZSTD_outBuffer{.dst = output.data(), .size = output.size(), .pos = 0};
+        while (out.pos < out.size) {
+            const auto in_before = in.pos;
+            const auto out_before = out.pos;
+            const auto result = ZSTD_decompressStream(state->zstd, &out, &in);
+            if (ZSTD_isError(result) != 0) {
+                return Error{ErrorCode::InvalidCompressedData, name, ZSTD_getErrorName(result)};
+            }
+            if (in.pos == in_before && out.pos == out_before) {
+                break;
+            }
+            // 0 means a frame was completed, the next one starts with the next call
+            state->complete = result == 0;
+        }
+        input.remove_prefix(in.pos);
+        return out.pos;
+#else
+        return Error{ErrorCode::InvalidCompressedData, name, "this build has no zstd support"};
+#endif
+    }
+    }
+    return std::size_t{0};
+}
+
+auto Decompressor::finish() const -> jp::expected<bool, Error> {
+    if (!state->complete) {
+        return Error{ErrorCode::TruncatedCompressedData, compression_name(compression)};
+    }
+    return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "error.hpp"
+#include "expected.hpp"
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string_view>
+
+enum class Compression { None, Gzip, Zstd };
+
+// Recognizes the magic bytes at the start of a document, 4 bytes are enough
+auto detect_compression(std::string_view prefix) -> Compression;
+auto compression_name(Compression compression) -> const char *;
+
+// Streaming decompressor for one document, which may consist of several concatenated gzip members or zstd frames.
+// Support for each format is compiled in when its library is found (JSON_EVAL_GZIP, JSON_EVAL_ZSTD), otherwise
+// decompress() fails with an error naming the format.
+class Decompressor {
+  public:
+    explicit Decompressor(Compression compression);
+    ~Decompressor();
+
+    Decompressor(const Decompressor &) = delete;
+    Decompressor &operator=(const Decompressor &) = delete;
+    Decompressor(Decompressor &&) = delete;
+    Decompressor &operator=(Decompressor &&) = delete;
+
+    // Decompresses from the front of `input` into `output` until either is exhausted. The consumed input is removed
+    // from `input`, returns the number of bytes written.
+    auto decompress(std::string_view &input, std::span<char> output) -> jp::expected<std::size_t, Error>;
+
+    // Fails if the input ended in the middle of a member or frame
+    [[nodiscard]] auto finish() const -> jp::expected<bool, Error>;
+
+  private:
+    struct State;
+
+    Compression compression;
+    std::unique_ptr<State> state;
+};
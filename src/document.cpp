@@ -0,0 +1,294 @@
+#include "document.hpp"
+#include "error.hpp"
+#include "bounded_queue.hpp"
+#include "file_reader.hpp"
+#include "lexer.hpp"
+#include "memory_usage.hpp"
+#include "parser.hpp"
+#include "trace.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using Lexed = std::pair<std::vector<jp::Token>, std::vector<Error>>;
+
+// Decompressed text handed to the lexer at a time
+constexpr auto buffer_size = std::size_t{1} << 20;
+
+struct Chunk {
+    std::unique_ptr<char[]> data;
+    std::size_t size;
+};
+
+// Lexes everything read from `fd` while it is being read, decompressing it first if it starts with the magic bytes of
+// gzip or zstd. A reader thread reads and decompresses into one buffer while the lexer works through the previous
+// ones, so the decompressed text is never held in full.
+auto lex_stream(int fd, jp::utf8::Mode utf8_mode, Stats *stats) -> jp::expected<Lexed, Error> {
+    constexpr auto buffer_count = std::size_t{3};
+    constexpr auto input_size = std::size_t{1} << 18;
+
+    auto filled = jp::BoundedQueue<Chunk>{buffer_count};
+    auto empty = jp::BoundedQueue<Chunk>{buffer_count};
+    for (auto i = std::size_t{0}; i < buffer_count; i++) {
+        empty.push(Chunk{std::make_unique<char[]>(buffer_size), 0});
+    }
+
+    auto failure = std::optional<Error>{};
+    auto reader = std::thread([&] {
+        jp::trace::set_thread_name("input reader");
+        auto input = std::make_unique<char[]>(input_size);
+        auto pending = std::string_view{};
+        auto end_of_input = false;
+
+        // Reads at least `minimum` bytes unless the input ends first
+        const auto read_input = [&](std::size_t minimum) {
+            auto timer = PhaseTimer{stats, Phase::Read};
+            auto size = std::size_t{0};
+            while (size < minimum) {
+                const auto count = ::read(fd, input.get() + size, input_size - size);
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (count < 0) {
+                    failure = Error{ErrorCode::ReadFailed, std::string{std::strerror(errno)}};
+                    return false;
+                }
+                if (count == 0) {
+                    end_of_input = true;
+                    break;
+                }
+                size += static_cast<std::size_t>(count);
+            }
+            pending = std::string_view{input.get(), size};
+            timer.add_bytes(size);
+            return true;
+        };
+
+        // The magic bytes decide how the rest is read
+        auto done = !read_input(4);
+        const auto compression = detect_compression(pending);
+        auto decompressor = Decompressor{compression};
+        // Plain text only passes through
+        auto *decompress_stats = compression == Compression::None ? nullptr : stats;
+        if (stats != nullptr) {
+            stats->compression = compression;
+        }
+
+        while (!done) {
+            auto chunk = *empty.pop();
+            // A full buffer per chunk, pipes deliver much smaller pieces
+            chunk.size = 0;
+            while (chunk.size < buffer_size) {
+                if (pending.empty() && !end_of_input && !read_input(1)) {
+                    done = true;
+                    break;
+                }
+
+                const auto pending_before = pending.size();
+                auto timer = PhaseTimer{decompress_stats, Phase::Decompress};
+                auto written = decompressor.decompress(
+                    pending, std::span<char>{chunk.data.get() + chunk.size, buffer_size - chunk.size});
+                if (written.has_error()) {
+                    failure = written.consume_error();
+                    done = true;
+                    break;
+                }
+                chunk.size += written.value();
+                timer.add_bytes(written.value());
+
+                // Without progress either more input is needed or everything was decompressed
+                if (written.value() == 0 && pending.size() == pending_before && (end_of_input || !pending.empty())) {
+                    if (!pending.empty()) {
+                        failure = Error{ErrorCode::InvalidCompressedData, compression_name(compression),
+                                        "trailing data"};
+                    } else if (auto finished = decompressor.finish(); finished.has_error()) {
+                        failure = finished.consume_error();
+                    }
+                    done = true;
+                    break;
+                }
+            }
+            filled.push(std::move(chunk));
+        }
+        filled.close();
+    });
+
+    auto lexer = jp::StreamLexer{utf8_mode};
+    while (auto chunk = filled.pop()) {
+        auto timer = PhaseTimer{stats, Phase::Lex};
+        lexer.feed(std::string_view{chunk->data.get(), chunk->size});
+        timer.add_bytes(chunk->size);
+        empty.push(std::move(*chunk));
+    }
+    reader.join();
+
+    // Lexer errors after a broken input are only noise
+    if (failure) {
+        return std::move(*failure);
+    }
+    auto timer = PhaseTimer{stats, Phase::Lex};
+    lexer.finish();
+    return Lexed{std::move(lexer.tokens()), std::move(lexer.errors())};
+}
+
+// Lexes a document held in memory, decompressing it a buffer at a time if it is compressed
+auto lex_source(std::string_view source, jp::utf8::Mode utf8_mode) -> jp::expected<Lexed, Error> {
+    const auto compression = detect_compression(source);
+    if (compression == Compression::None) {
+        return jp::collect_tokens(source, utf8_mode);
+    }
+
+    auto decompressor = Decompressor{compression};
+    auto buffer = std::make_unique<char[]>(buffer_size);
+    auto lexer = jp::StreamLexer{utf8_mode};
+    for (;;) {
+        const auto source_before = source.size();
+        auto written = decompressor.decompress(source, std::span<char>{buffer.get(), buffer_size});
+        if (written.has_error()) {
+            return written.consume_error();
+        }
+        if (written.value() == 0 && source.size() == source_before) {
+            break;
+        }
+        lexer.feed(std::string_view{buffer.get(), written.value()});
+    }
+
+    if (!source.empty()) {
+        return Error{ErrorCode::InvalidCompressedData, compression_name(compression), "trailing data"};
+    }
+    if (auto finished = decompressor.finish(); finished.has_error()) {
+        return finished.consume_error();
+    }
+    lexer.finish();
+    return Lexed{std::move(lexer.tokens()), std::move(lexer.errors())};
+}
+
+auto lex_file(const std::string &path, jp::utf8::Mode utf8_mode, Stats *stats) -> jp::expected<Lexed, Error> {
+    if (path == "-") {
+        return lex_stream(STDIN_FILENO, utf8_mode, stats);
+    }
+
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return Error{ErrorCode::ReadFailed, std::string{std::strerror(errno)}};
+    }
+
+    // Compressed files are streamed, plain ones are lexed in one piece
+    char magic[4];
+    const auto count = ::pread(fd, magic, sizeof(magic), 0);
+    if (count > 0 && detect_compression({magic, static_cast<std::size_t>(count)}) != Compression::None) {
+        auto lexed = lex_stream(fd, utf8_mode, stats);
+        ::close(fd);
+        return lexed;
+    }
+    ::close(fd);
+
+    auto source = std::optional<std::string>{};
+    {
+        auto timer = PhaseTimer{stats, Phase::Read};
+        source = jp::pread_file(path);
+        if (!source) {
+            return Error{ErrorCode::ReadFailed, std::string{std::strerror(errno)}};
+        }
+        timer.add_bytes(source->size());
+    }
+
+    auto timer = PhaseTimer{stats, Phase::Lex};
+    timer.add_bytes(source->size());
+    return jp::collect_tokens(*source, utf8_mode);
+}
+
+} // namespace
+
+auto load_document(const std::string &path, jp::utf8::Mode utf8_mode, Stats *stats) -> std::optional<jp::JSONValue> {
+    if (path != "-" && !std::filesystem::exists(path)) {
+        std::cerr << "File does not exist: " << path << std::endl;
+        return std::nullopt;
+    }
+
+    auto lexed = lex_file(path, utf8_mode, stats);
+    if (lexed.has_error()) {
+        std::cerr << (path == "-" ? "stdin" : path) << ": " << lexed.error().message() << std::endl;
+        return std::nullopt;
+    }
+
+    auto &[tokens, errors] = lexed.value();
+
+    for (const auto &error : errors) {
+        display_error(error);
+    }
+
+    if (!errors.empty()) {
+        return std::nullopt;
+    }
+
+    auto parser = jp::Parser(tokens);
+    auto document = std::optional<jp::JSONValue>{};
+    {
+        auto timer = PhaseTimer{stats, Phase::Parse};
+        document = parser.parse();
+    }
+
+    if (!document) {
+        for (const auto &error : parser.get_errors()) {
+            display_error(error);
+        }
+        return std::nullopt;
+    }
+
+    if (stats != nullptr) {
+        stats->phase(Phase::Parse).bytes = stats->phase(Phase::Lex).bytes;
+        stats->tokens = tokens.size();
+        count_nodes(*document, *stats);
+        stats->dom_bytes = jp::memory_usage(*document).total();
+    }
+    return document;
+}
+
+auto parse_document(std::string_view source, jp::utf8::Mode utf8_mode) -> jp::expected<jp::JSONValue, Error> {
+    auto lexed = lex_source(source, utf8_mode);
+    if (lexed.has_error()) {
+        return lexed.consume_error();
+    }
+
+    auto &[tokens, errors] = lexed.value();
+    if (!errors.empty()) {
+        return std::move(errors.front());
+    }
+
+    auto parser = jp::Parser(tokens);
+    auto document = parser.parse();
+    if (!document) {
+        auto parser_errors = parser.get_errors();
+        if (parser_errors.empty()) {
+            return Error{ErrorCode::UnexpectedEndOfStream, "a value"};
+        }
+        return std::move(parser_errors.front());
+    }
+
+    return std::move(*document);
+}
+
+auto escape_json(std::string_view text) -> std::string {
+    auto escaped = std::string{};
+    escaped.reserve(text.size());
+    for (const auto c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            escaped += std::format("\\u{:04x}", static_cast<int>(c));
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "error.hpp"
+#include "expected.hpp"
+#include "jsonobject.hpp"
+#include "stats.hpp"
+#include "utf8.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Reads, lexes and parses the JSON file at `path`, or stdin for "-". Stdin and gzip or zstd compressed files are
+// decompressed and lexed while they are being read. Strings are validated as UTF-8 in `utf8_mode`. Errors are displayed
+// and reported as std::nullopt. The phases and counts are added to `stats` if given.
+auto load_document(const std::string &path, jp::utf8::Mode utf8_mode, Stats *stats = nullptr)
+    -> std::optional<jp::JSONValue>;
+
+// Lexes and parses a document, which may be gzip or zstd compressed, reporting the first error
+auto parse_document(std::string_view source, jp::utf8::Mode utf8_mode) -> jp::expected<jp::JSONValue, Error>;
+
+// Escapes `text` for use inside a JSON string literal
+auto escape_json(std::string_view text) -> std::string;
@@ -0,0 +1,208 @@
+#include "file_pipeline.hpp"
+#include "bounded_queue.hpp"
+#include "document.hpp"
+#include "file_reader.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <format>
+#include <glob.h>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+
+namespace {
+
+// Files each reader thread has in flight at most
+constexpr auto read_batch = std::size_t{32};
+
+auto is_glob(const std::string &input) -> bool {
+    return input.find_first_of("*?[") != std::string::npos && !std::filesystem::exists(input);
+}
+
+auto glob_matches(const std::string &pattern) -> std::vector<std::string> {
+    auto matches = std::vector<std::string>{};
+    auto result = glob_t{};
+    if (::glob(pattern.c_str(), 0, nullptr, &result) == 0) {
+        matches.assign(result.gl_pathv, result.gl_pathv + result.gl_pathc);
+    }
+    ::globfree(&result);
+    return matches;
+}
+
+// Compressed documents keep the .json before their own extension
+auto is_json_file(const std::filesystem::path &path) -> bool {
+    const auto name = path.filename().string();
+    return name.ends_with(".json") || name.ends_with(".json.gz") || name.ends_with(".json.zst");
+}
+
+auto json_files_below(const std::string &directory) -> std::vector<std::string> {
+    auto files = std::vector<std::string>{};
+    for (const auto &entry : std::filesystem::recursive_directory_iterator{directory}) {
+        if (entry.is_regular_file() && is_json_file(entry.path())) {
+            files.push_back(entry.path().string());
+        }
+    }
+    std::ranges::sort(files);
+    return files;
+}
+
+struct ReadFile {
+    std::size_t index;
+    std::optional<std::string> source;
+};
+
+auto evaluate_file(const std::string &path, const std::optional<std::string> &source, const FileQuery &query,
+                   jp::utf8::Mode utf8_mode) -> std::pair<std::string, bool> {
+    const auto line = [&](std::string_view member) {
+        return std::format(R"({{"path": "{}", {}}})", escape_json(path), member);
+    };
+    const auto error = [&](std::string_view message) {
+        return std::pair{line(std::format(R"("error": "{}")", escape_json(message))), false};
+    };
+
+    if (!source) {
+        return error("Could not read file");
+    }
+
+    auto parse_span = std::optional<jp::trace::Span>{std::in_place, "parse", "file"};
+    const auto document = parse_document(*source, utf8_mode);
+    if (document.has_error()) {
+        return error(document.error().message());
+    }
+    parse_span.reset();
+
+    auto evaluate_span = jp::trace::Span{"evaluate", "file"};
+    const auto result = query(document.value());
+    if (result.has_error()) {
+        return error(result.error().message());
+    }
+    return {line(std::format(R"("result": {})", jp::to_string(result.value()))), true};
+}
+
+} // namespace
+
+auto expand_inputs(const std::vector<std::string> &inputs) -> std::optional<std::vector<std::string>> {
+    auto paths = std::vector<std::string>{};
+    for (const auto &input : inputs) {
+        if (is_glob(input)) {
+            auto matches = glob_matches(input);
+            if (matches.empty()) {
+                std::cerr << "No files match: " << input << std::endl;
+                return std::nullopt;
+            }
+            std::ranges::move(matches, std::back_inserter(paths));
+        } else if (std::filesystem::is_directory(input)) {
+            auto found = json_files_below(input);
+            if (found.empty()) {
+                std::cerr << "No JSON files in " << input << std::endl;
+                return std::nullopt;
+            }
+            std::ranges::move(found, std::back_inserter(paths));
+        } else if (std::filesystem::exists(input)) {
+            paths.push_back(input);
+        } else {
+            std::cerr << "File does not exist: " << input << std::endl;
+            return std::nullopt;
+        }
+    }
+    return paths;
+}
+
+auto is_multi_file(const std::vector<std::string> &inputs) -> bool {
+    return inputs.size() > 1 || is_glob(inputs.front()) || std::filesystem::is_directory(inputs.front());
+}
+
+auto evaluate_files(const std::vector<std::string> &paths, const FileQuery &query, const Options &options) -> int {
+    const auto jobs = options.jobs == 0 ? std::max(1u, std::thread::hardware_concurrency()) : options.jobs;
+    const auto in_flight =
+        options.max_in_flight == 0 ? 2 * jobs + read_batch * options.io_threads : options.max_in_flight;
+
+    // A slot is taken before a file is read and given back once its line is printed. Files take slots in path
+    // order, so the next file to print always holds one and the pipeline can't stall on a full window.
+    auto slots = std::counting_semaphore<>{static_cast<std::ptrdiff_t>(in_flight)};
+    auto next_path = std::atomic<std::size_t>{0};
+    auto documents = jp::BoundedQueue<ReadFile>{jobs};
+
+    auto output_mutex = std::mutex{};
+    auto output_ready = std::condition_variable{};
+    auto finished = std::map<std::size_t, std::pair<std::string, bool>>{};
+
+    auto readers_left = std::atomic<std::size_t>{options.io_threads};
+    auto readers = std::vector<std::thread>{};
+    for (auto r = std::size_t{0}; r < options.io_threads; r++) {
+        readers.emplace_back([&, r] {
+            jp::trace::set_thread_name(std::format("file reader {}", r));
+            const auto backend = options.io_uring ? jp::FileReader::Backend::IoUring : jp::FileReader::Backend::Pread;
+            auto reader = jp::FileReader{read_batch, backend};
+            while (true) {
+                // Up to a batch of slots, then as many paths, so that paths are still taken in order
+                slots.acquire();
+                auto taken = std::size_t{1};
+                while (taken < read_batch && slots.try_acquire()) {
+                    taken++;
+                }
+
+                const auto first = next_path.fetch_add(taken);
+                const auto count = first < paths.size() ? std::min(taken, paths.size() - first) : 0;
+                if (count < taken) {
+                    slots.release(static_cast<std::ptrdiff_t>(taken - count));
+                }
+                if (count == 0) {
+                    break;
+                }
+
+                // Documents go to the workers as their reads complete
+                auto span = jp::trace::Span{"read batch", "file", static_cast<std::int64_t>(first)};
+                reader.read(paths, first, count, [&](std::size_t index, std::optional<std::string> source) {
+                    documents.push(ReadFile{index, std::move(source)});
+                });
+            }
+            if (--readers_left == 0) {
+                documents.close();
+            }
+        });
+    }
+
+    auto workers = std::vector<std::thread>{};
+    for (auto w = std::size_t{0}; w < jobs; w++) {
+        workers.emplace_back([&, w] {
+            jp::trace::set_thread_name(std::format("file worker {}", w));
+            while (auto file = documents.pop()) {
+                auto span = jp::trace::Span{"file", "file", static_cast<std::int64_t>(file->index)};
+                auto line = evaluate_file(paths[file->index], file->source, query, options.utf8);
+                {
+                    auto lock = std::scoped_lock{output_mutex};
+                    finished.emplace(file->index, std::move(line));
+                }
+                output_ready.notify_one();
+            }
+        });
+    }
+
+    auto failed = false;
+    for (auto index = std::size_t{0}; index < paths.size(); index++) {
+        auto lock = std::unique_lock{output_mutex};
+        output_ready.wait(lock, [&] { return finished.contains(index); });
+        auto node = finished.extract(index);
+        lock.unlock();
+
+        std::cout << node.mapped().first << '\n';
+        failed = failed || !node.mapped().second;
+        slots.release();
+    }
+    std::cout.flush();
+
+    for (auto &thread : readers) {
+        thread.join();
+    }
+    for (auto &thread : workers) {
+        thread.join();
+    }
+
+    return failed ? 1 : 0;
+}
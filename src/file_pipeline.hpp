@@ -0,0 +1,30 @@
+#pragma once
+
+#include "error.hpp"
+#include "expected.hpp"
+#include "jsonobject.hpp"
+#include "options.hpp"
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Replaces every directory by the *.json (or *.json.gz, *.json.zst) files below it and every glob by its matches, each
+// sorted by path. Inputs that don't exist and globs without matches are displayed and reported as std::nullopt.
+auto expand_inputs(const std::vector<std::string> &inputs) -> std::optional<std::vector<std::string>>;
+
+// Whether `inputs` has to go through evaluate_files, a single plain file is evaluated directly
+auto is_multi_file(const std::vector<std::string> &inputs) -> bool;
+
+using FileQuery = std::function<jp::expected<jp::JSONValue, Error>(const jp::JSONValue &document)>;
+
+// Runs `query` on every file and prints one line per file, in the order of `paths`:
+//
+//     {"path": "<path>", "result": <json>}
+//     {"path": "<path>", "error": "<message>"}
+//
+// `options.io_threads` threads read the files and hand them to `options.jobs` threads through a bounded queue, the
+// workers parse and evaluate them. Reading stops while `options.max_in_flight` documents are read but not printed,
+// so memory depends on that limit and the size of the largest files, not on the total input size.
+// Returns the exit code: 1 if any file failed.
+auto evaluate_files(const std::vector<std::string> &paths, const FileQuery &query, const Options &options) -> int;
@@ -45,14 +45,13 @@ struct JSONValue {
     }
 
     [[nodiscard]] auto type_id() const -> std::size_t { return value.index(); }
-    [[nodiscard]] auto type_str() const -> std::string {
-        return std::visit(overloaded{[](const JSONNull &) -> std::string { return "null"; },
-                                     [](bool) -> std::string { return "bool"; },
-                                     [](JSONDouble) -> std::string { return "double"; },
-                                     [](JSONInteger) -> std::string { return "integer"; },
-                                     [](const std::string &) -> std::string { return "string"; },
-                                     [](const JSONObject &) -> std::string { return "object"; },
-                                     [](const JSONArray &) -> std::string { return "array"; }},
+    [[nodiscard]] auto type_str() const -> std::string { return type_name(); }
+    [[nodiscard]] auto type_name() const -> const char * {
+        return std::visit(overloaded{[](const JSONNull &) { return "null"; }, [](bool) { return "bool"; },
+                                     [](JSONDouble) { return "double"; }, [](JSONInteger) { return "integer"; },
+                                     [](const std::string &) { return "string"; },
+                                     [](const JSONObject &) { return "object"; },
+                                     [](const JSONArray &) { return "array"; }},
                           value);
     }
 
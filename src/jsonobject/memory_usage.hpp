@@ -0,0 +1,78 @@
+#pragma once
+
+#include "jsonobject.hpp"
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jp {
+
+// Footprint of a DOM subtree as requested from the allocator, allocator overhead per block not included. Containers
+// count their capacity, not their size.
+struct MemoryUsage {
+    // The values themselves, inline in their parent
+    std::size_t value_bytes = 0;
+    // Heap blocks of strings (values and keys) that don't fit the small string buffer
+    std::size_t string_bytes = 0;
+    std::size_t array_bytes = 0;
+    // Hash table nodes and bucket arrays
+    std::size_t object_bytes = 0;
+    std::size_t nodes = 0;
+
+    [[nodiscard]] auto total() const -> std::size_t { return value_bytes + string_bytes + array_bytes + object_bytes; }
+
+    // How many times larger the DOM is than the text it was parsed from
+    [[nodiscard]] auto ratio_to(std::size_t source_bytes) const -> double {
+        return source_bytes == 0 ? 0.0 : static_cast<double>(total()) / static_cast<double>(source_bytes);
+    }
+};
+
+namespace detail {
+
+inline auto heap_bytes(const std::string &text) -> std::size_t {
+    // Short strings live inside the object itself
+    const auto *inline_buffer = reinterpret_cast<const char *>(&text);
+    if (text.data() >= inline_buffer && text.data() < inline_buffer + sizeof(std::string)) {
+        return 0;
+    }
+    return text.capacity() + 1;
+}
+
+// libstdc++ nodes hold the next pointer, the pair and the cached hash of the key
+constexpr auto object_node_bytes =
+    sizeof(void *) + sizeof(std::pair<const std::string, JSONValue>) + sizeof(std::size_t);
+
+} // namespace detail
+
+inline auto memory_usage(const JSONValue &value) -> MemoryUsage {
+    auto usage = MemoryUsage{.value_bytes = sizeof(JSONValue)};
+    auto pending = std::vector<const JSONValue *>{&value};
+
+    while (!pending.empty()) {
+        const auto *current = pending.back();
+        pending.pop_back();
+        usage.nodes++;
+
+        if (current->is_string()) {
+            usage.string_bytes += detail::heap_bytes(current->as_string());
+        } else if (current->is_array()) {
+            const auto &array = current->as_array();
+            usage.array_bytes += array.capacity() * sizeof(JSONValue);
+            for (const auto &element : array) {
+                pending.push_back(&element);
+            }
+        } else if (current->is_object()) {
+            const auto &object = current->as_object();
+            usage.object_bytes += object.size() * detail::object_node_bytes + object.bucket_count() * sizeof(void *);
+            for (const auto &[key, member] : object) {
+                usage.string_bytes += detail::heap_bytes(key);
+                pending.push_back(&member);
+            }
+        }
+    }
+
+    return usage;
+}
+
+} // namespace jp
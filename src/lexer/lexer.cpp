@@ -2,10 +2,11 @@
 #include "common.hpp"
 #include "error.hpp"
 #include "expected.hpp"
+#include "memory.hpp"
 #include "parser_helper.hpp"
+#include "scan.hpp"
 
 #include <cmath>
-#include <format>
 #include <iomanip>
 #include <iostream>
 
@@ -42,16 +43,14 @@ auto Lexer::peek() -> std::optional<char> {
 }
 
 void Lexer::trim_whitespace() {
-    while (auto c = peek()) {
-        if (c == ' ' || c == '\t' || c == '\r') {
-            chop();
-        } else if (c == '\n') {
-            chop();
-            newline();
-        } else {
-            break;
-        }
+    const auto whitespace = scan::skip_whitespace(source);
+    if (whitespace.newlines > 0) {
+        line_number += static_cast<std::uint32_t>(whitespace.newlines);
+        column_number = static_cast<std::uint32_t>(whitespace.size - whitespace.last_newline);
+    } else {
+        column_number += static_cast<std::uint32_t>(whitespace.size);
     }
+    source.remove_prefix(whitespace.size);
 }
 
 void Lexer::newline() {
@@ -74,14 +73,14 @@ auto Lexer::parse_keyword() -> jp::expected<Token, Error> {
         return jp::Token{.token_type = jp::Null{}, .row = line_number, .col = column_number};
     }
 
-    return Error{"Lexer", std::format("Unexpected keyword '{}'", keyword), line_number, column_number};
+    return Error{ErrorCode::UnexpectedKeyword, std::string{keyword}}.at(line_number, column_number);
 }
 
 auto Lexer::parse_string() -> jp::expected<Token, Error> {
     const auto starting_col = column_number;
     chop(); // consume opening quote
     const auto source_size_before = source.size();
-    auto str = parse_str(source);
+    auto str = parse_str(source, utf8_mode);
     if (str.has_error()) {
         auto error = str.consume_error();
         error.column = starting_col;
@@ -118,7 +117,7 @@ auto Lexer::next_token() -> std::optional<jp::expected<Token, Error>> {
 
     const char c = *peek();
 
-    if (is_numeric(c)) {
+    if (is_numeric(c) || c == '-') {
         return parse_number();
     }
 
@@ -146,14 +145,16 @@ auto Lexer::next_token() -> std::optional<jp::expected<Token, Error>> {
     case ':':
         return jp::Token{.token_type = jp::Colon{}, .row = line_number, .col = first_char_column};
     };
-    return Error{"Lexer", std::format("Unexpected character '{}'", c), line_number, first_char_column};
+    return Error{ErrorCode::UnexpectedCharacter, c}.at(line_number, first_char_column);
 }
 
-auto collect_tokens(const std::string_view source) -> std::pair<std::vector<Token>, std::vector<Error>> {
+auto collect_tokens(const std::string_view source, utf8::Mode utf8_mode)
+    -> std::pair<std::vector<Token>, std::vector<Error>> {
+    auto scope = memory::Scope{memory::Category::Lexer};
     auto tokens = std::vector<Token>{};
     auto errors = std::vector<Error>{};
 
-    for (const auto &next_token : Lexer(source)) {
+    for (const auto &next_token : Lexer(source, utf8_mode)) {
         if (next_token.has_value()) {
             tokens.push_back(next_token.value());
         } else {
@@ -164,4 +165,65 @@ auto collect_tokens(const std::string_view source) -> std::pair<std::vector<Toke
     return {tokens, errors};
 }
 
+void StreamLexer::feed(std::string_view chunk) {
+    auto scope = memory::Scope{memory::Category::Lexer};
+    // Where tokens can be split: after whitespace or structural characters outside strings
+    auto first_cut = std::string_view::npos;
+    auto last_cut = std::string_view::npos;
+    for (auto i = std::size_t{0}; i < chunk.size(); i++) {
+        const auto c = chunk[i];
+        if (in_string) {
+            if (escaped) {
+                escaped = false;
+            } else if (c == '\\') {
+                escaped = true;
+            } else if (c == '"') {
+                in_string = false;
+            }
+        } else if (c == '"') {
+            in_string = true;
+        } else if (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == ',' || c == ':' || c == '[' || c == ']' ||
+                   c == '{' || c == '}') {
+            if (first_cut == std::string_view::npos) {
+                first_cut = i + 1;
+            }
+            last_cut = i + 1;
+        }
+    }
+
+    if (last_cut == std::string_view::npos) {
+        carry.append(chunk);
+        return;
+    }
+
+    // Only the carried token is copied, the rest of the chunk is lexed in place
+    if (carry.empty()) {
+        first_cut = 0;
+    } else {
+        carry.append(chunk.substr(0, first_cut));
+        lex(carry);
+    }
+    lex(chunk.substr(first_cut, last_cut - first_cut));
+    carry.assign(chunk.substr(last_cut));
+}
+
+void StreamLexer::finish() {
+    auto scope = memory::Scope{memory::Category::Lexer};
+    lex(carry);
+    carry.clear();
+}
+
+void StreamLexer::lex(std::string_view source) {
+    auto lexer = Lexer(source, line_number, column_number, utf8_mode);
+    for (auto &next_token : lexer) {
+        if (next_token.has_value()) {
+            lexed_tokens.push_back(next_token.value());
+        } else {
+            lexed_errors.push_back(next_token.error());
+        }
+    }
+    line_number = lexer.line();
+    column_number = lexer.column();
+}
+
 } // namespace jp
@@ -3,16 +3,25 @@
 #include "error.hpp"
 #include "expected.hpp"
 #include "token.hpp"
+#include "utf8.hpp"
 #include <functional>
 #include <optional>
 #include <iterator>
+#include <string>
+#include <vector>
 
 namespace jp {
 
 class Lexer {
   public:
     Lexer() = delete;
-    explicit Lexer(const std::string_view source) : line_number(1), column_number(1), source(source) {}
+    // Strings are validated as UTF-8 in `utf8_mode`
+    explicit Lexer(const std::string_view source, utf8::Mode utf8_mode = utf8::Mode::Strict)
+        : line_number(1), column_number(1), source(source), utf8_mode(utf8_mode) {}
+    // Continues lexing at a position in a larger document, see StreamLexer
+    Lexer(const std::string_view source, std::uint32_t line, std::uint32_t column,
+          utf8::Mode utf8_mode = utf8::Mode::Strict)
+        : line_number(line), column_number(column), source(source), utf8_mode(utf8_mode) {}
 
     auto next_token() -> std::optional<jp::expected<Token, Error>>;
 
@@ -53,6 +62,9 @@ class Lexer {
     inline auto begin() -> Iterator { return Iterator(this); }
     static inline auto end() -> Iterator { return {}; }
 
+    [[nodiscard]] auto line() const -> std::uint32_t { return line_number; }
+    [[nodiscard]] auto column() const -> std::uint32_t { return column_number; }
+
   private:
     auto chop() -> char;
     auto chop_while(const std::function<bool(char)> &predicate) -> std::string_view;
@@ -67,8 +79,38 @@ class Lexer {
     uint32_t line_number;
     uint32_t column_number;
     std::string_view source;
+    utf8::Mode utf8_mode;
 };
 
-auto collect_tokens(const std::string_view source) -> std::pair<std::vector<Token>, std::vector<Error>>;
+auto collect_tokens(const std::string_view source, utf8::Mode utf8_mode = utf8::Mode::Strict)
+    -> std::pair<std::vector<Token>, std::vector<Error>>;
+
+// Lexes a document that arrives in chunks, e.g. from a pipe, producing the same tokens as collect_tokens on the whole
+// document. A chunk is lexed up to its last whitespace or structural character outside a string, where no token can
+// continue; the rest is carried over and lexed together with the start of the next chunk.
+class StreamLexer {
+  public:
+    explicit StreamLexer(utf8::Mode utf8_mode = utf8::Mode::Strict) : utf8_mode(utf8_mode) {}
+
+    void feed(std::string_view chunk);
+    // Lexes what is still carried over, once the input has ended
+    void finish();
+
+    auto tokens() -> std::vector<Token> & { return lexed_tokens; }
+    auto errors() -> std::vector<Error> & { return lexed_errors; }
+
+  private:
+    void lex(std::string_view source);
+
+    std::string carry;
+    // Whether the next byte is inside a string, and right after a backslash in it
+    bool in_string = false;
+    bool escaped = false;
+    utf8::Mode utf8_mode;
+    std::uint32_t line_number = 1;
+    std::uint32_t column_number = 1;
+    std::vector<Token> lexed_tokens;
+    std::vector<Error> lexed_errors;
+};
 
 } // namespace jp
@@ -1,205 +1,257 @@
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <unordered_set>
+#include "document.hpp"
 #include "error.hpp"
-#include "lexer.hpp"
-#include "parser.hpp"
+#include "file_pipeline.hpp"
 #include "query_parser.hpp"
 #include "query_lexer.hpp"
 #include "query_evaluator.hpp"
+#include "options.hpp"
+#include "server.hpp"
+#include "memory.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
 
-void register_intrinsic_functions(query::Evaluator &evaluator);
+auto parse_query(const std::string &query) -> std::optional<query::Expression> {
+    auto [query_tokens, query_errors] = query::collect_tokens(query);
 
-auto main(int argc, char *argv[]) -> int {
-    if (argc != 3) {
-        std::cerr << "Usage: " << argv[0] << " <path_to_json> <query>" << std::endl;
-        return 1;
+    for (const auto &error : query_errors) {
+        display_error(error);
     }
 
-    const std::string path = argv[1];
-    const std::string query = argv[2];
-
-    if (!std::filesystem::exists(path)) {
-        std::cerr << "File does not exist: " << path << std::endl;
-        return 1;
+    if (!query_errors.empty()) {
+        return std::nullopt;
     }
 
-    auto file = std::ifstream{path};
-    auto source = std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    auto query_parser = query::Parser(query_tokens);
 
-    auto [tokens, errors] = jp::collect_tokens(source);
+    auto expression = query_parser.parse();
 
-    for (const auto &error : errors) {
-        display_error(error);
+    if (!expression) {
+        for (const auto &error : query_parser.get_errors()) {
+            display_error(error);
+        }
+        return std::nullopt;
     }
 
-    if (!errors.empty()) {
-        return 1;
-    }
+    return expression;
+}
 
-    auto parser = jp::Parser(tokens);
-    auto obj = parser.parse();
+// Every non-empty line of the file is a `name: query` pair
+auto load_batch(const std::string &path) -> std::optional<query::Batch> {
+    auto file = std::ifstream{path};
 
-    if (!obj) {
-        for (const auto &error : parser.get_errors()) {
-            display_error(error);
-        }
-        return 1;
+    if (!file) {
+        std::cerr << "Could not open query file: " << path << std::endl;
+        return std::nullopt;
     }
 
-    if (query.empty()) {
-        std::cout << jp::to_string(*obj) << std::endl;
-        return 0;
-    }
+    auto queries = std::vector<query::NamedQuery>{};
+    auto names = std::unordered_set<std::string>{};
+    auto line = std::string{};
+    auto line_number = 0u;
 
-    auto [query_tokens, query_errors] = query::collect_tokens(query);
+    while (std::getline(file, line)) {
+        line_number++;
 
-    for (const auto &error : query_errors) {
-        display_error(error);
-    }
+        if (line.find_first_not_of(" \t\r") == std::string::npos) {
+            continue;
+        }
 
-    if (!query_errors.empty()) {
-        return 1;
-    }
+        const auto separator = line.find(':');
+        if (separator == std::string::npos) {
+            std::cerr << path << ":" << line_number << ": Expected 'name: query'" << std::endl;
+            return std::nullopt;
+        }
 
-    auto query_parser = query::Parser(query_tokens);
+        auto name = line.substr(0, separator);
+        name.erase(0, name.find_first_not_of(" \t"));
+        name.erase(name.find_last_not_of(" \t") + 1);
 
-    auto expression = query_parser.parse();
+        // Results are keyed by name, a second query with the same one would silently replace the first
+        if (!names.insert(name).second) {
+            std::cerr << path << ":" << line_number << ": Duplicate query name '" << name << "'" << std::endl;
+            return std::nullopt;
+        }
 
-    if (!expression) {
-        for (const auto &error : query_parser.get_errors()) {
-            display_error(error);
+        auto expression = parse_query(line.substr(separator + 1));
+        if (!expression) {
+            return std::nullopt;
         }
-        return 1;
+
+        queries.push_back(query::NamedQuery{.name = std::move(name), .expression = std::move(*expression)});
     }
 
-    auto evaluator = query::Evaluator(&*obj);
+    return query::Batch{std::move(queries)};
+}
 
-    register_intrinsic_functions(evaluator);
+auto run(const Options &options) -> int {
+    if (options.serve) {
+        auto documents = std::vector<ResidentDocument>{};
+        for (const auto &path : options.paths) {
+            auto stats = Stats{};
+            auto document = load_document(path, options.utf8, options.stats ? &stats : nullptr);
+            if (!document) {
+                return 1;
+            }
+            if (options.stats) {
+                print_stats(stats, path, options.stats_json, std::cerr);
+            }
+            documents.push_back({std::filesystem::path(path).stem().string(), std::move(*document)});
+        }
+        return serve(std::move(documents), options);
+    }
 
-    auto result = evaluator.evaluate_expression(*expression);
+    const auto &path = options.path;
+    const auto &query = options.query;
+    const auto multi_file = is_multi_file(options.paths);
 
-    if (!result.has_value()) {
-        display_error(result.error());
+    if (!multi_file && path != "-" && !std::filesystem::exists(path)) {
+        std::cerr << "File does not exist: " << path << std::endl;
         return 1;
     }
 
-    std::cout << jp::to_string(result.value()) << std::endl;
-
-    return 0;
-}
+    auto stats = Stats{};
+    auto *run_stats = options.stats ? &stats : nullptr;
+    const auto finish = [&](int exit_code) {
+        if (run_stats != nullptr) {
+            print_stats(stats, path, options.stats_json, std::cerr);
+        }
+        return exit_code;
+    };
+
+    // Parse the queries first so that a typo doesn't cost a full document parse
+    auto batch = std::optional<query::Batch>{};
+    auto expression = std::optional<query::Expression>{};
+    {
+        auto timer = PhaseTimer{run_stats, Phase::QueryParse};
+        if (options.batch_path) {
+            batch = load_batch(*options.batch_path);
+            if (!batch) {
+                return 1;
+            }
+        }
 
-void register_list_function(query::Evaluator &evaluator, const std::string &name,
-                            const std::function<jp::JSONDouble(jp::JSONDouble, jp::JSONDouble)> &compare_fn,
-                            jp::JSONDouble default_val) {
-    evaluator.register_function(
-        name,
-        [compare_fn, default_val, name](query::Evaluator *evaluator, const std::span<const query::Expression> &args)
-            -> jp::expected<jp::JSONValue, Error> {
-            if (args.empty()) {
-                return Error{"Evaluator", name + "() expects at least one argument", 1, 0};
+        if (!batch && !query.empty()) {
+            timer.add_bytes(query.size());
+            expression = parse_query(query);
+            if (!expression) {
+                return 1;
             }
+        }
+    }
 
-            auto evaluate_and_check_number = [&](const query::Expression &arg) -> jp::expected<jp::JSONDouble, Error> {
-                const auto result = evaluator->evaluate_expression(arg);
+    if (multi_file) {
+        const auto paths = expand_inputs(options.paths);
+        if (!paths) {
+            return 1;
+        }
 
-                if (!result.has_value()) {
-                    return result.error();
-                }
+        // Bound once, every document gets a copy pointing at it
+        auto prototype = query::Evaluator(nullptr);
+        prototype.set_thread_count(options.threads);
+        prototype.parallel_threshold = options.parallel_threshold;
+        if (batch) {
+            batch->bind(prototype);
+        } else if (expression) {
+            prototype.bind(*expression);
+        }
 
-                if (result->is_integer()) {
-                    return static_cast<jp::JSONDouble>(std::get<jp::JSONInteger>(result->value));
-                } else if (result->is_double()) {
-                    return std::get<jp::JSONDouble>(result->value);
-                } else {
-                    return Error{"Evaluator",
-                                 std::format("{}() expects numbers or an array of numbers, instead found {}", name,
-                                             result->type_str()),
-                                 1, 0};
+        // Only the process-wide numbers apply, the phases of each file overlap on the workers
+        return finish(evaluate_files(
+            *paths,
+            [&](const jp::JSONValue &document) -> jp::expected<jp::JSONValue, Error> {
+                auto evaluator = prototype;
+                evaluator.input_json = &document;
+                if (batch) {
+                    // Failed queries are null in the results, like with a single document
+                    return batch->evaluate(evaluator).first;
+                }
+                if (expression) {
+                    return evaluator.evaluate_expression(*expression);
                 }
-            };
+                return document;
+            },
+            options));
+    }
 
-            // Single argument case: If it's an array, apply compare_fn on array; otherwise, treat args as list of
-            // numbers.
-            if (args.size() == 1) {
-                const auto result = evaluator->evaluate_expression(args[0]);
+    auto obj = load_document(path, options.utf8, run_stats);
+    if (!obj) {
+        return 1;
+    }
 
-                if (!result.has_value()) {
-                    return result.error();
-                }
+    const auto print = [&](const jp::JSONValue &value) {
+        auto timer = PhaseTimer{run_stats, Phase::Output};
+        const auto text = jp::to_string(value);
+        std::cout << text << std::endl;
+        timer.add_bytes(text.size());
+    };
 
-                if (result->is_array()) {
-                    const auto &array = std::get<jp::JSONArray>(result->value);
-                    if (array.empty()) {
-                        return Error{"Evaluator", name + "() received an empty array", 1, 0};
-                    }
-
-                    jp::JSONDouble result_value = default_val;
-                    for (const auto &item : array) {
-                        if (item.is_integer()) {
-                            result_value = compare_fn(
-                                result_value, static_cast<jp::JSONDouble>(std::get<jp::JSONInteger>(item.value)));
-                        } else if (item.is_double()) {
-                            result_value = compare_fn(result_value, std::get<jp::JSONDouble>(item.value));
-                        } else {
-                            return Error{"Evaluator", name + "() expects array elements to be numbers", 1, 0};
-                        }
-                    }
-                    return jp::JSONValue{result_value};
-                }
-                // Fall through for single non-array argument, handled as a list of one.
-            }
+    if (!batch && !expression) {
+        print(*obj);
+        return finish(0);
+    }
 
-            // Multi-argument case or single non-array argument
-            jp::JSONDouble result_value = default_val;
-            for (const auto &arg : args) {
-                auto value = evaluate_and_check_number(arg);
-                if (!value.has_value()) {
-                    return value.error();
-                }
-                result_value = compare_fn(result_value, *value);
-            }
+    auto evaluator = query::Evaluator(&*obj);
+    evaluator.set_thread_count(options.threads);
+    evaluator.parallel_threshold = options.parallel_threshold;
+
+    if (batch) {
+        auto evaluated = std::pair<jp::JSONValue, std::vector<Error>>{};
+        {
+            auto timer = PhaseTimer{run_stats, Phase::Evaluate};
+            batch->bind(evaluator);
+            evaluated = batch->evaluate(evaluator);
+        }
+        auto &[results, batch_errors] = evaluated;
 
-            return jp::JSONValue{result_value};
-        });
-}
+        for (const auto &error : batch_errors) {
+            display_error(error);
+        }
 
-void register_intrinsic_functions(query::Evaluator &evaluator) {
-    evaluator.register_function(
-        "size",
-        [](query::Evaluator *evaluator,
-           const std::span<const query::Expression> &args) -> jp::expected<jp::JSONValue, Error> {
-            if (args.size() != 1) {
-                return Error{"Evaluator", "size() expects exactly 1 argument", 1, 0};
-            }
+        print(results);
+        return finish(batch_errors.empty() ? 0 : 1);
+    }
 
-            const auto &arg = args[0];
-            const auto result = evaluator->evaluate_expression(arg);
+    auto result = std::optional<jp::expected<jp::JSONValue, Error>>{};
+    {
+        auto timer = PhaseTimer{run_stats, Phase::Evaluate};
+        evaluator.bind(*expression);
+        result = evaluator.evaluate_expression(*expression);
+    }
 
-            if (!result.has_value()) {
-                return result.error();
-            }
+    if (!result->has_value()) {
+        display_error(result->error());
+        return finish(1);
+    }
 
-            if (!result->is_array() && !result->is_object()) {
-                return Error{"Evaluator",
-                             std::format("size() expects an array or object as its argument, instead found {}",
-                                         result->type_str()),
-                             1, 0};
-            }
+    print(result->value());
+    return finish(0);
+}
 
-            if (result->is_array()) {
-                return jp::JSONValue{static_cast<jp::JSONInteger>(std::get<jp::JSONArray>(result->value).size())};
-            }
+auto main(int argc, char *argv[]) -> int {
+    const auto options = parse_options(argc, argv);
+
+    if (!options) {
+        print_usage(argv[0]);
+        return 1;
+    }
 
-            return jp::JSONValue{static_cast<jp::JSONInteger>(std::get<jp::JSONObject>(result->value).size())};
-        });
-
-    register_list_function(
-        evaluator, "max", [](jp::JSONDouble a, jp::JSONDouble b) { return std::max(a, b); },
-        std::numeric_limits<jp::JSONDouble>::lowest());
-    register_list_function(
-        evaluator, "min", [](jp::JSONDouble a, jp::JSONDouble b) { return std::min(a, b); },
-        std::numeric_limits<jp::JSONDouble>::max());
-    register_list_function(evaluator, "sum", [](jp::JSONDouble a, jp::JSONDouble b) { return a + b; }, 0);
-    register_list_function(evaluator, "product", [](jp::JSONDouble a, jp::JSONDouble b) { return a * b; }, 1);
+    if (options->stats) {
+        jp::memory::start_counting();
+        start_counting_instructions();
+    }
+    if (options->trace_path) {
+        jp::trace::start();
+        jp::trace::set_thread_name("main");
+    }
+
+    const auto exit_code = run(*options);
+
+    if (options->trace_path && !jp::trace::write(*options->trace_path)) {
+        std::cerr << "Could not write the trace to " << *options->trace_path << std::endl;
+    }
+    return exit_code;
 }
@@ -0,0 +1,148 @@
+#include "options.hpp"
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+namespace {
+auto parse_count(std::string_view option, const char *value) -> std::optional<std::size_t> {
+    const auto text = std::string_view{value};
+    auto count = std::size_t{0};
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), count);
+
+    if (error != std::errc{} || end != text.data() + text.size()) {
+        std::cerr << option << " expects a non-negative integer, instead found " << text << std::endl;
+        return std::nullopt;
+    }
+
+    return count;
+}
+} // namespace
+
+auto parse_options(int argc, char *argv[]) -> std::optional<Options> {
+    auto options = Options{};
+    auto positional = std::vector<std::string>{};
+
+    for (auto i = 1; i < argc; i++) {
+        const auto arg = std::string_view{argv[i]};
+
+        if (arg == "--serve") {
+            options.serve = true;
+        } else if (arg == "--no-io-uring") {
+            options.io_uring = false;
+        } else if (arg == "--stats" || arg == "--stats=text" || arg == "--stats=json") {
+            options.stats = true;
+            options.stats_json = arg == "--stats=json";
+        } else if (arg.starts_with("--utf8=")) {
+            const auto mode = jp::utf8::parse_mode(arg.substr(std::string_view{"--utf8="}.size()));
+            if (!mode) {
+                std::cerr << "--utf8 expects strict or lenient, instead found " << arg << std::endl;
+                return std::nullopt;
+            }
+            options.utf8 = *mode;
+        } else if (arg == "--socket") {
+            if (i + 1 >= argc) {
+                std::cerr << "--socket expects a path" << std::endl;
+                return std::nullopt;
+            }
+            options.socket_path = argv[++i];
+        } else if (arg == "--trace") {
+            if (i + 1 >= argc) {
+                std::cerr << "--trace expects a path" << std::endl;
+                return std::nullopt;
+            }
+            options.trace_path = argv[++i];
+        } else if (arg == "--batch") {
+            if (i + 1 >= argc) {
+                std::cerr << "--batch expects a path to a query file" << std::endl;
+                return std::nullopt;
+            }
+            options.batch_path = argv[++i];
+        } else if (arg == "--threads" || arg == "--parallel-threshold" || arg == "--io-threads" || arg == "--jobs" ||
+                   arg == "--max-in-flight") {
+            if (i + 1 >= argc) {
+                std::cerr << arg << " expects a number" << std::endl;
+                return std::nullopt;
+            }
+
+            const auto count = parse_count(arg, argv[++i]);
+            if (!count) {
+                return std::nullopt;
+            }
+
+            // 0 threads means one per hardware thread
+            if (arg == "--threads") {
+                options.threads = *count;
+            } else if (arg == "--parallel-threshold") {
+                options.parallel_threshold = *count;
+            } else if (arg == "--io-threads") {
+                options.io_threads = std::max(std::size_t{1}, *count);
+            } else if (arg == "--jobs") {
+                options.jobs = *count;
+            } else {
+                options.max_in_flight = *count;
+            }
+        } else if (arg.starts_with("--")) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return std::nullopt;
+        } else {
+            positional.emplace_back(arg);
+        }
+    }
+
+    if (options.serve) {
+        if (positional.empty() || options.batch_path) {
+            return std::nullopt;
+        }
+        options.path = positional[0];
+        options.paths = std::move(positional);
+        return options;
+    }
+
+    if (options.socket_path) {
+        std::cerr << "--socket requires --serve" << std::endl;
+        return std::nullopt;
+    }
+
+    // The query comes last, everything before it is an input
+    const auto minimum_positional = options.batch_path ? 1u : 2u;
+    if (positional.size() < minimum_positional) {
+        return std::nullopt;
+    }
+
+    if (!options.batch_path) {
+        options.query = std::move(positional.back());
+        positional.pop_back();
+    }
+    options.path = positional[0];
+    options.paths = std::move(positional);
+
+    return options;
+}
+
+void print_usage(const char *program) {
+    std::cerr << "Usage: " << program << " <input>... <query>" << std::endl;
+    std::cerr << "       " << program << " <input>... --batch <query_file>" << std::endl;
+    std::cerr << "       " << program << " --serve [--socket <path>] <path_to_json>..." << std::endl;
+    std::cerr << "Options:" << std::endl;
+    std::cerr << "  --threads <n>             Threads for reductions over large arrays and for --serve queries "
+                 "(0 = all cores)"
+              << std::endl;
+    std::cerr << "  --socket <path>           Serve requests on a Unix socket instead of stdin" << std::endl;
+    std::cerr << "  --parallel-threshold <n>  Minimum array length reduced in parallel chunks" << std::endl;
+    std::cerr << "  --stats[=text|json]       Print the time, throughput and counts of every phase to stderr"
+              << std::endl;
+    std::cerr << "  --trace <path>            Write a Chrome trace of the run, e.g. for Perfetto" << std::endl;
+    std::cerr << "  --utf8=strict|lenient     Reject strings with invalid UTF-8 (default) or replace it with U+FFFD"
+              << std::endl;
+    std::cerr << "An input is a JSON file, a directory searched for *.json files, or a glob. Files and stdin may be"
+              << std::endl;
+    std::cerr << "gzip or zstd compressed. With several files, one result line is printed per file:" << std::endl;
+    std::cerr << "  --io-threads <n>          Threads reading files (default 2)" << std::endl;
+    std::cerr << "  --jobs <n>                Threads parsing and evaluating files (default 0 = all cores)"
+              << std::endl;
+    std::cerr << "  --max-in-flight <n>       Documents read but not yet printed (0 = 2 * jobs + 32 * io-threads)"
+              << std::endl;
+    std::cerr << "  --no-io-uring             Read files with pread instead of io_uring" << std::endl;
+}
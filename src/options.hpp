@@ -0,0 +1,39 @@
+#pragma once
+
+#include "utf8.hpp"
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct Options {
+    // The first input, the only one unless several files, directories or globs were given
+    std::string path;
+    std::vector<std::string> paths;
+    std::string query;
+    // Keep the documents resident and answer queries from stdin or `socket_path` instead of running one query
+    bool serve = false;
+    std::optional<std::string> socket_path;
+    // File with one `name: query` pair per line, evaluated in a single pass over the document
+    std::optional<std::string> batch_path;
+    std::size_t threads = 1;
+    // Arrays longer than this are reduced in parallel chunks
+    std::size_t parallel_threshold = std::size_t{1} << 18;
+    // With several input files: threads reading files, threads parsing and evaluating them, and the number of
+    // documents read but not yet printed (0 = twice the evaluating threads plus 32 per reading thread)
+    std::size_t io_threads = 2;
+    std::size_t jobs = 0;
+    std::size_t max_in_flight = 0;
+    // Read files through io_uring where the kernel allows it, otherwise with pread
+    bool io_uring = true;
+    // Report the time, throughput and counts of every phase on stderr, as text or JSON
+    bool stats = false;
+    bool stats_json = false;
+    // Write the spans of every thread to this file in the Chrome trace event format
+    std::optional<std::string> trace_path;
+    // Reject strings that aren't valid UTF-8, or replace the invalid sequences with U+FFFD
+    jp::utf8::Mode utf8 = jp::utf8::Mode::Strict;
+};
+
+auto parse_options(int argc, char *argv[]) -> std::optional<Options>;
+void print_usage(const char *program);
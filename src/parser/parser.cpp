@@ -2,7 +2,7 @@
 #include "common.hpp"
 #include "token.hpp"
 #include "lexer.hpp"
-#include <format>
+#include "memory.hpp"
 
 namespace jp {
 auto Parser::chop() -> std::optional<Token> {
@@ -26,17 +26,13 @@ auto Parser::chop() -> std::optional<Token> {
 
 void Parser::push_err(Error &&err) { errors.push_back(std::move(err)); }
 
-void Parser::push_err(std::string &&message, unsigned line, unsigned column) {
-    errors.push_back(Error{.message = std::move(message), .line = line, .column = column});
+void Parser::throw_unexpected_token(const char *expected, const Token &unexpected) {
+    push_err(Error{ErrorCode::UnexpectedToken, expected, to_string(unexpected.token_type)}.at(unexpected.row,
+                                                                                              unexpected.col));
 }
 
-void Parser::throw_unexpected_token(std::string &&expected, const Token &unexpected) {
-    push_err(std::format("Unexpected token: Expected {}, instead found {}", expected, to_string(unexpected.token_type)),
-             unexpected.row, unexpected.col);
-}
-
-void Parser::throw_unexpected_end_of_stream(std::string &&expected) {
-    push_err(std::format("Unexpected end of stream: Expected {}", expected), 0, 0);
+void Parser::throw_unexpected_end_of_stream(const char *expected) {
+    push_err(Error{ErrorCode::UnexpectedEndOfStream, expected});
 }
 
 auto Parser::get_errors() -> std::span<Error> { return errors; }
@@ -63,8 +59,12 @@ auto Parser::parse_object() -> std::optional<JSONObject> {
         }
 
         auto maybe_colon = chop();
-        if (!maybe_colon || !std::holds_alternative<jp::Colon>(maybe_colon->token_type)) {
-            throw_unexpected_token(":", *maybe_colon);
+        if (!maybe_colon) {
+            throw_unexpected_end_of_stream("':'");
+            return std::nullopt;
+        }
+        if (!std::holds_alternative<jp::Colon>(maybe_colon->token_type)) {
+            throw_unexpected_token("':'", *maybe_colon);
             return std::nullopt;
         }
 
@@ -79,7 +79,7 @@ auto Parser::parse_object() -> std::optional<JSONObject> {
         auto delimiter = chop();
 
         if (!delimiter) {
-            throw_unexpected_end_of_stream("Expected ',' or '}'");
+            throw_unexpected_end_of_stream("',' or '}'");
             return std::nullopt;
         }
 
@@ -121,7 +121,7 @@ auto Parser::parse_array() -> std::optional<JSONArray> {
         auto delimiter = chop();
 
         if (!delimiter) {
-            throw_unexpected_end_of_stream("Expected ',' or ']'");
+            throw_unexpected_end_of_stream("',' or ']'");
             return std::nullopt;
         }
 
@@ -145,22 +145,39 @@ auto Parser::parse_value() -> std::optional<JSONValue> {
 
     auto token = *chop();
 
+    const auto opens = std::holds_alternative<jp::LBrace>(token.token_type) ||
+                       std::holds_alternative<jp::LBracket>(token.token_type);
+    if (opens && depth == max_depth) {
+        push_err(Error{ErrorCode::NestingTooDeep, max_depth}.at(token.row, token.col));
+        return std::nullopt;
+    }
+
     return std::visit(
         overloaded{[&](jp::LBrace) -> std::optional<JSONValue> {
+                       // Nested values open their own scope
+                       auto scope = memory::Scope{memory::Category::ParserObjects};
+                       depth++;
                        auto obj = parse_object();
+                       depth--;
                        if (obj) {
                            return JSONValue(*obj);
                        }
                        return std::nullopt;
                    },
                    [&](jp::LBracket) -> std::optional<JSONValue> {
+                       auto scope = memory::Scope{memory::Category::ParserArrays};
+                       depth++;
                        auto arr = parse_array();
+                       depth--;
                        if (arr) {
                            return JSONValue(*arr);
                        }
                        return std::nullopt;
                    },
-                   [&](const jp::String &s) -> std::optional<JSONValue> { return JSONValue(s.value); },
+                   [&](const jp::String &s) -> std::optional<JSONValue> {
+                       auto scope = memory::Scope{memory::Category::ParserStrings};
+                       return JSONValue(s.value);
+                   },
                    [&](const jp::Number &n) -> std::optional<JSONValue> {
                        return std::visit(
                            overloaded{[&](int64_t i) -> std::optional<JSONValue> { return JSONValue(JSONInteger(i)); },
@@ -170,7 +187,10 @@ auto Parser::parse_value() -> std::optional<JSONValue> {
                    [&](jp::True) -> std::optional<JSONValue> { return JSONValue(true); },
                    [&](jp::False) -> std::optional<JSONValue> { return JSONValue(false); },
                    [&](jp::Null) -> std::optional<JSONValue> { return JSONValue(JSONNull{}); },
-                   [&](auto) -> std::optional<JSONValue> { return std::nullopt; }},
+                   [&](auto) -> std::optional<JSONValue> {
+                       throw_unexpected_token("a value", token);
+                       return std::nullopt;
+                   }},
         token.token_type);
 
     return std::nullopt;
@@ -181,11 +201,17 @@ auto Parser::parse() -> std::optional<JSONValue> {
         return std::nullopt;
     }
 
-    return parse_value();
+    auto value = parse_value();
+    if (value && !tokens.empty()) {
+        const auto &trailing = tokens.front();
+        push_err(Error{ErrorCode::TrailingToken, to_string(trailing.token_type)}.at(trailing.row, trailing.col));
+        return std::nullopt;
+    }
+    return value;
 }
 
-auto parse(const std::string_view &json) -> expected<JSONValue, std::vector<Error>> {
-    auto [tokens, errors] = jp::collect_tokens(json);
+auto parse(const std::string_view &json, utf8::Mode utf8_mode) -> expected<JSONValue, std::vector<Error>> {
+    auto [tokens, errors] = jp::collect_tokens(json, utf8_mode);
 
     if (!errors.empty()) {
         return errors;
@@ -5,11 +5,15 @@
 #include "error.hpp"
 #include "jsonobject.hpp"
 #include "expected.hpp"
+#include "utf8.hpp"
 
 namespace jp {
 
 class Parser {
   public:
+    // Deeper documents are rejected instead of overflowing the stack of the recursive descent
+    static constexpr auto max_depth = std::size_t{1024};
+
     Parser() = delete;
     explicit Parser(const std::span<jp::Token> &tokens) : tokens(tokens) {}
 
@@ -21,15 +25,16 @@ class Parser {
     auto parse_value() -> std::optional<JSONValue>;
 
     void push_err(Error &&err);
-    void push_err(std::string &&message, unsigned line, unsigned column);
-    void throw_unexpected_token(std::string &&expected, const Token &unexpected);
-    void throw_unexpected_end_of_stream(std::string &&expected);
+    void throw_unexpected_token(const char *expected, const Token &unexpected);
+    void throw_unexpected_end_of_stream(const char *expected);
     auto get_errors() -> std::span<Error>;
 
   private:
     std::span<Token> tokens;
     std::vector<Error> errors;
+    std::size_t depth = 0;
 };
 
-auto parse(const std::string_view &json) -> expected<JSONValue, std::vector<Error>>;
+auto parse(const std::string_view &json, utf8::Mode utf8_mode = utf8::Mode::Strict)
+    -> expected<JSONValue, std::vector<Error>>;
 } // namespace jp
@@ -0,0 +1,433 @@
+#include "aggregate.hpp"
+#include "cpu.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#if defined(JSON_EVAL_X86_KERNELS)
+#include <immintrin.h>
+#endif
+
+namespace query::aggregate {
+
+namespace {
+
+// Blocks are summed with independent accumulators and combined pairwise, which keeps the rounding error at O(log n)
+// and makes the result independent of how the input is split up later on.
+constexpr auto pairwise_block = std::size_t{256};
+
+// Every variant keeps eight partial results, element i going to partial i % 8, and folds them in the same order:
+// (p0 + p4) + (p2 + p6) and (p1 + p5) + (p3 + p7), then the two. Sums and products are the same at every level,
+// bit for bit, only the width of the registers holding the partials differs.
+constexpr auto lanes = std::size_t{8};
+
+template <typename Op> auto fold(const jp::JSONDouble (&partial)[lanes], Op op) -> jp::JSONDouble {
+    return op(op(op(partial[0], partial[4]), op(partial[2], partial[6])),
+              op(op(partial[1], partial[5]), op(partial[3], partial[7])));
+}
+
+struct Kernels {
+    auto (*sum_block)(const jp::JSONDouble *data, std::size_t size) -> jp::JSONDouble;
+    auto (*product)(const jp::JSONDouble *data, std::size_t size) -> jp::JSONDouble;
+    auto (*min)(const jp::JSONDouble *data, std::size_t size) -> jp::JSONDouble;
+    auto (*max)(const jp::JSONDouble *data, std::size_t size) -> jp::JSONDouble;
+    auto (*min_integers)(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger;
+    auto (*max_integers)(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger;
+};
+
+// Plain loops over contiguous integers, the compiler vectorizes these for the level of the function they are inlined
+// into. 64 bit compares need SSE4.2.
+[[gnu::always_inline]] inline auto min_integers(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger {
+    auto result = std::numeric_limits<jp::JSONInteger>::max();
+    for (auto i = std::size_t{0}; i < size; i++) {
+        result = data[i] < result ? data[i] : result;
+    }
+    return result;
+}
+
+[[gnu::always_inline]] inline auto max_integers(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger {
+    auto result = std::numeric_limits<jp::JSONInteger>::lowest();
+    for (auto i = std::size_t{0}; i < size; i++) {
+        result = data[i] > result ? data[i] : result;
+    }
+    return result;
+}
+
+// Folds the partials of whole groups of eight, then the elements past them one at a time
+template <typename Op>
+auto reduce_scalar(const jp::JSONDouble *data, std::size_t size, jp::JSONDouble identity, Op op) -> jp::JSONDouble {
+    jp::JSONDouble partial[lanes];
+    std::fill(std::begin(partial), std::end(partial), identity);
+    auto i = std::size_t{0};
+    for (; i + lanes <= size; i += lanes) {
+        for (auto lane = std::size_t{0}; lane < lanes; lane++) {
+            partial[lane] = op(partial[lane], data[i + lane]);
+        }
+    }
+
+    auto result = fold(partial, op);
+    for (; i < size; i++) {
+        result = op(result, data[i]);
+    }
+    return result;
+}
+
+constexpr auto add = [](jp::JSONDouble a, jp::JSONDouble b) { return a + b; };
+constexpr auto multiply = [](jp::JSONDouble a, jp::JSONDouble b) { return a * b; };
+constexpr auto minimum = [](jp::JSONDouble a, jp::JSONDouble b) { return std::min(a, b); };
+constexpr auto maximum = [](jp::JSONDouble a, jp::JSONDouble b) { return std::max(a, b); };
+
+constexpr auto scalar_kernels = Kernels{
+    .sum_block = [](const jp::JSONDouble *data, std::size_t size) { return reduce_scalar(data, size, 0.0, add); },
+    .product = [](const jp::JSONDouble *data, std::size_t size) { return reduce_scalar(data, size, 1.0, multiply); },
+    .min = [](const jp::JSONDouble *data, std::size_t size) {
+        return reduce_scalar(data, size, std::numeric_limits<jp::JSONDouble>::max(), minimum);
+    },
+    .max = [](const jp::JSONDouble *data, std::size_t size) {
+        return reduce_scalar(data, size, std::numeric_limits<jp::JSONDouble>::lowest(), maximum);
+    },
+    .min_integers = [](const jp::JSONInteger *data, std::size_t size) { return min_integers(data, size); },
+    .max_integers = [](const jp::JSONInteger *data, std::size_t size) { return max_integers(data, size); },
+};
+
+#if defined(JSON_EVAL_X86_KERNELS)
+
+// The SSE variants hold the eight partials in four registers of two, a[0] has partials 0 and 1
+#define JSON_EVAL_SSE_REDUCE(name, vector_op, identity, op)                                                          \
+    JSON_EVAL_TARGET_SSE42 auto name(const jp::JSONDouble *data, std::size_t size) -> jp::JSONDouble {               \
+        __m128d a[4] = {_mm_set1_pd(identity), _mm_set1_pd(identity), _mm_set1_pd(identity), _mm_set1_pd(identity)}; \
+        auto i = std::size_t{0};                                                                                     \
+        for (; i + lanes <= size; i += lanes) {                                                                      \
+            for (auto r = 0; r < 4; r++) {                                                                           \
+                a[r] = vector_op(a[r], _mm_loadu_pd(data + i + 2 * r));                                              \
+            }                                                                                                        \
+        }                                                                                                            \
+        const auto folded = vector_op(vector_op(a[0], a[2]), vector_op(a[1], a[3]));                                 \
+        auto result = op(_mm_cvtsd_f64(folded), _mm_cvtsd_f64(_mm_unpackhi_pd(folded, folded)));                     \
+        for (; i < size; i++) {                                                                                      \
+            result = op(result, data[i]);                                                                            \
+        }                                                                                                            \
+        return result;                                                                                               \
+    }
+
+// The AVX2 variants hold them in two registers of four
+#define JSON_EVAL_AVX2_REDUCE(name, vector_op, half_op, identity, op)                                                \
+    JSON_EVAL_TARGET_AVX2 auto name(const jp::JSONDouble *data, std::size_t size) -> jp::JSONDouble {                \
+        auto low = _mm256_set1_pd(identity);                                                                         \
+        auto high = _mm256_set1_pd(identity);                                                                        \
+        auto i = std::size_t{0};                                                                                     \
+        for (; i + lanes <= size; i += lanes) {                                                                      \
+            low = vector_op(low, _mm256_loadu_pd(data + i));                                                         \
+            high = vector_op(high, _mm256_loadu_pd(data + i + 4));                                                   \
+        }                                                                                                            \
+        const auto quarters = vector_op(low, high);                                                                  \
+        const auto halves = half_op(_mm256_castpd256_pd128(quarters), _mm256_extractf128_pd(quarters, 1));          \
+        auto result = op(_mm_cvtsd_f64(halves), _mm_cvtsd_f64(_mm_unpackhi_pd(halves, halves)));                     \
+        for (; i < size; i++) {                                                                                      \
+            result = op(result, data[i]);                                                                            \
+        }                                                                                                            \
+        return result;                                                                                               \
+    }
+
+// The AVX-512 variants in one register of eight
+#define JSON_EVAL_AVX512_REDUCE(name, vector_op, quarter_op, half_op, identity, op)                                  \
+    JSON_EVAL_TARGET_AVX512 auto name(const jp::JSONDouble *data, std::size_t size) -> jp::JSONDouble {              \
+        auto all = _mm512_set1_pd(identity);                                                                         \
+        auto i = std::size_t{0};                                                                                     \
+        for (; i + lanes <= size; i += lanes) {                                                                      \
+            all = vector_op(all, _mm512_loadu_pd(data + i));                                                         \
+        }                                                                                                            \
+        const auto quarters = quarter_op(_mm512_castpd512_pd256(all), _mm512_extractf64x4_pd(all, 1));             \
+        const auto halves = half_op(_mm256_castpd256_pd128(quarters), _mm256_extractf128_pd(quarters, 1));          \
+        auto result = op(_mm_cvtsd_f64(halves), _mm_cvtsd_f64(_mm_unpackhi_pd(halves, halves)));                     \
+        for (; i < size; i++) {                                                                                      \
+            result = op(result, data[i]);                                                                            \
+        }                                                                                                            \
+        return result;                                                                                               \
+    }
+
+JSON_EVAL_SSE_REDUCE(sum_sse42, _mm_add_pd, 0.0, add)
+JSON_EVAL_SSE_REDUCE(product_sse42, _mm_mul_pd, 1.0, multiply)
+JSON_EVAL_SSE_REDUCE(min_sse42, _mm_min_pd, std::numeric_limits<jp::JSONDouble>::max(), minimum)
+JSON_EVAL_SSE_REDUCE(max_sse42, _mm_max_pd, std::numeric_limits<jp::JSONDouble>::lowest(), maximum)
+
+JSON_EVAL_AVX2_REDUCE(sum_avx2, _mm256_add_pd, _mm_add_pd, 0.0, add)
+JSON_EVAL_AVX2_REDUCE(product_avx2, _mm256_mul_pd, _mm_mul_pd, 1.0, multiply)
+JSON_EVAL_AVX2_REDUCE(min_avx2, _mm256_min_pd, _mm_min_pd, std::numeric_limits<jp::JSONDouble>::max(), minimum)
+JSON_EVAL_AVX2_REDUCE(max_avx2, _mm256_max_pd, _mm_max_pd, std::numeric_limits<jp::JSONDouble>::lowest(), maximum)
+
+JSON_EVAL_AVX512_REDUCE(sum_avx512, _mm512_add_pd, _mm256_add_pd, _mm_add_pd, 0.0, add)
+JSON_EVAL_AVX512_REDUCE(product_avx512, _mm512_mul_pd, _mm256_mul_pd, _mm_mul_pd, 1.0, multiply)
+JSON_EVAL_AVX512_REDUCE(min_avx512, _mm512_min_pd, _mm256_min_pd, _mm_min_pd,
+                        std::numeric_limits<jp::JSONDouble>::max(), minimum)
+JSON_EVAL_AVX512_REDUCE(max_avx512, _mm512_max_pd, _mm256_max_pd, _mm_max_pd,
+                        std::numeric_limits<jp::JSONDouble>::lowest(), maximum)
+
+#undef JSON_EVAL_SSE_REDUCE
+#undef JSON_EVAL_AVX2_REDUCE
+#undef JSON_EVAL_AVX512_REDUCE
+
+JSON_EVAL_TARGET_SSE42 auto min_integers_sse42(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger {
+    return min_integers(data, size);
+}
+JSON_EVAL_TARGET_SSE42 auto max_integers_sse42(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger {
+    return max_integers(data, size);
+}
+JSON_EVAL_TARGET_AVX2 auto min_integers_avx2(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger {
+    return min_integers(data, size);
+}
+JSON_EVAL_TARGET_AVX2 auto max_integers_avx2(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger {
+    return max_integers(data, size);
+}
+JSON_EVAL_TARGET_AVX512 auto min_integers_avx512(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger {
+    return min_integers(data, size);
+}
+JSON_EVAL_TARGET_AVX512 auto max_integers_avx512(const jp::JSONInteger *data, std::size_t size) -> jp::JSONInteger {
+    return max_integers(data, size);
+}
+
+constexpr auto sse42_kernels =
+    Kernels{sum_sse42, product_sse42, min_sse42, max_sse42, min_integers_sse42, max_integers_sse42};
+constexpr auto avx2_kernels = Kernels{sum_avx2, product_avx2, min_avx2, max_avx2, min_integers_avx2, max_integers_avx2};
+constexpr auto avx512_kernels =
+    Kernels{sum_avx512, product_avx512, min_avx512, max_avx512, min_integers_avx512, max_integers_avx512};
+
+#endif
+
+auto select_kernels(jp::cpu::Level level) -> const Kernels & {
+#if defined(JSON_EVAL_X86_KERNELS)
+    switch (level) {
+    case jp::cpu::Level::Scalar:
+        return scalar_kernels;
+    case jp::cpu::Level::SSE42:
+        return sse42_kernels;
+    case jp::cpu::Level::AVX2:
+        return avx2_kernels;
+    case jp::cpu::Level::AVX512:
+        return avx512_kernels;
+    }
+#endif
+    (void)level;
+    return scalar_kernels;
+}
+
+auto kernels() -> const Kernels & {
+    static const auto &selected = select_kernels(jp::cpu::active_level());
+    return selected;
+}
+
+auto pairwise_sum(const jp::JSONDouble *data, std::size_t size) -> jp::JSONDouble {
+    if (size <= pairwise_block) {
+        return kernels().sum_block(data, size);
+    }
+
+    // Split on a block boundary so that every leaf is a full block
+    const auto half = (size / 2 + pairwise_block - 1) / pairwise_block * pairwise_block;
+    return pairwise_sum(data, half) + pairwise_sum(data + half, size - half);
+}
+
+} // namespace
+
+auto sum(std::span<const jp::JSONDouble> values) -> jp::JSONDouble {
+    return pairwise_sum(values.data(), values.size());
+}
+
+auto sum(std::span<const jp::JSONInteger> values) -> std::optional<jp::JSONInteger> {
+    // A 128 bit accumulator can't overflow for any realistic input, so only the final result has to be checked
+    __extension__ using wide = __int128;
+    auto result = wide{0};
+    for (const auto value : values) {
+        result += value;
+    }
+
+    if (result > std::numeric_limits<jp::JSONInteger>::max() || result < std::numeric_limits<jp::JSONInteger>::min()) {
+        return std::nullopt;
+    }
+    return static_cast<jp::JSONInteger>(result);
+}
+
+auto product(std::span<const jp::JSONDouble> values) -> jp::JSONDouble {
+    return kernels().product(values.data(), values.size());
+}
+
+auto product(std::span<const jp::JSONInteger> values) -> std::optional<jp::JSONInteger> {
+    auto result = jp::JSONInteger{1};
+    for (const auto value : values) {
+        if (__builtin_mul_overflow(result, value, &result)) {
+            return std::nullopt;
+        }
+    }
+    return result;
+}
+
+auto min(std::span<const jp::JSONDouble> values) -> jp::JSONDouble {
+    return kernels().min(values.data(), values.size());
+}
+
+auto max(std::span<const jp::JSONDouble> values) -> jp::JSONDouble {
+    return kernels().max(values.data(), values.size());
+}
+
+auto min(std::span<const jp::JSONInteger> values) -> jp::JSONInteger {
+    return kernels().min_integers(values.data(), values.size());
+}
+
+auto max(std::span<const jp::JSONInteger> values) -> jp::JSONInteger {
+    return kernels().max_integers(values.data(), values.size());
+}
+
+auto gather(std::span<const jp::JSONValue> values) -> NumericColumn {
+    auto column = NumericColumn{};
+    column.integers.reserve(values.size());
+
+    for (const auto &value : values) {
+        if (value.is_integer()) {
+            if (column.kind == ValueKind::Integers) {
+                column.integers.push_back(value.as_integer());
+            } else {
+                column.doubles.push_back(static_cast<jp::JSONDouble>(value.as_integer()));
+                column.kind = ValueKind::Mixed;
+            }
+            continue;
+        }
+
+        if (!value.is_double()) {
+            column.kind = ValueKind::NonNumeric;
+            return column;
+        }
+
+        if (column.kind == ValueKind::Integers) {
+            column.doubles.reserve(values.size());
+            for (const auto integer : column.integers) {
+                column.doubles.push_back(static_cast<jp::JSONDouble>(integer));
+            }
+            column.kind = column.integers.empty() ? ValueKind::Doubles : ValueKind::Mixed;
+            column.integers = {};
+        }
+        column.doubles.push_back(value.as_double());
+    }
+
+    return column;
+}
+
+template <typename Op> auto reduce(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error> {
+    if (values.empty()) {
+        return Error{ErrorCode::EmptyArray, Op::name.data()};
+    }
+
+    const auto column = gather(values);
+
+    if (column.kind == ValueKind::NonNumeric) {
+        return Error{ErrorCode::NonNumericElements, Op::name.data()};
+    }
+
+    if (column.kind != ValueKind::Integers) {
+        return jp::JSONValue{Op::reduce(std::span<const jp::JSONDouble>{column.doubles})};
+    }
+
+    return reduce_integers<Op>(column.integers);
+}
+
+namespace {
+
+// Result of reducing one chunk. `integer` is only set for chunks made of integers that didn't overflow.
+struct Partial {
+    ValueKind kind;
+    std::optional<jp::JSONInteger> integer;
+    jp::JSONDouble real;
+};
+
+template <typename Op> auto reduce_chunk(std::span<const jp::JSONValue> values) -> Partial {
+    const auto column = gather(values);
+
+    if (column.kind == ValueKind::NonNumeric) {
+        return Partial{.kind = ValueKind::NonNumeric, .integer = std::nullopt, .real = 0};
+    }
+
+    if (column.kind != ValueKind::Integers) {
+        return Partial{.kind = column.kind,
+                       .integer = std::nullopt,
+                       .real = Op::reduce(std::span<const jp::JSONDouble>{column.doubles})};
+    }
+
+    if (const auto integer = Op::reduce(std::span<const jp::JSONInteger>{column.integers})) {
+        return Partial{.kind = ValueKind::Integers, .integer = *integer, .real = static_cast<jp::JSONDouble>(*integer)};
+    }
+
+    auto doubles = std::vector<jp::JSONDouble>{};
+    doubles.reserve(column.integers.size());
+    for (const auto integer : column.integers) {
+        doubles.push_back(static_cast<jp::JSONDouble>(integer));
+    }
+    return Partial{.kind = ValueKind::Integers,
+                   .integer = std::nullopt,
+                   .real = Op::reduce(std::span<const jp::JSONDouble>{doubles})};
+}
+
+} // namespace
+
+template <typename Op>
+auto reduce(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+            std::size_t threshold) -> jp::expected<jp::JSONValue, Error> {
+    if (values.size() <= threshold) {
+        return reduce<Op>(values);
+    }
+
+    const auto chunks = (values.size() + parallel_chunk_size - 1) / parallel_chunk_size;
+    auto partials = std::vector<Partial>(chunks);
+
+    const auto run_chunk = [&](std::size_t chunk) {
+        const auto offset = chunk * parallel_chunk_size;
+        const auto size = std::min(parallel_chunk_size, values.size() - offset);
+        partials[chunk] = reduce_chunk<Op>(values.subspan(offset, size));
+    };
+
+    if (pool != nullptr) {
+        pool->parallel_for(chunks, run_chunk);
+    } else {
+        for (auto chunk = std::size_t{0}; chunk < chunks; chunk++) {
+            run_chunk(chunk);
+        }
+    }
+
+    // The partials are combined with the same kernels, in chunk order
+    auto integers = std::vector<jp::JSONInteger>{};
+    auto reals = std::vector<jp::JSONDouble>{};
+    integers.reserve(chunks);
+    reals.reserve(chunks);
+
+    for (const auto &partial : partials) {
+        if (partial.kind == ValueKind::NonNumeric) {
+            return Error{ErrorCode::NonNumericElements, Op::name.data()};
+        }
+        if (partial.integer) {
+            integers.push_back(*partial.integer);
+        }
+        reals.push_back(partial.real);
+    }
+
+    if (integers.size() == chunks) {
+        if (const auto result = Op::reduce(std::span<const jp::JSONInteger>{integers})) {
+            return jp::JSONValue{*result};
+        }
+    }
+
+    return jp::JSONValue{Op::reduce(std::span<const jp::JSONDouble>{reals})};
+}
+
+template auto reduce<Sum>(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+template auto reduce<Product>(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+template auto reduce<Min>(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+template auto reduce<Max>(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+
+template auto reduce<Sum>(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+                          std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+template auto reduce<Product>(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+                              std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+template auto reduce<Min>(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+                          std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+template auto reduce<Max>(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+                          std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+
+} // namespace query::aggregate
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "error.hpp"
+#include "expected.hpp"
+#include "jsonobject.hpp"
+#include "thread_pool.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Reduction kernels behind sum(), product(), min() and max(). The values are classified and gathered into a contiguous
+// buffer of integers or doubles in one pass, then reduced by a vectorized kernel. Arrays of integers produce an
+// integer unless the result overflows.
+namespace query::aggregate {
+
+// Kernels over contiguous data. The integer kernels return std::nullopt on overflow.
+auto sum(std::span<const jp::JSONDouble> values) -> jp::JSONDouble;
+auto sum(std::span<const jp::JSONInteger> values) -> std::optional<jp::JSONInteger>;
+auto product(std::span<const jp::JSONDouble> values) -> jp::JSONDouble;
+auto product(std::span<const jp::JSONInteger> values) -> std::optional<jp::JSONInteger>;
+auto min(std::span<const jp::JSONDouble> values) -> jp::JSONDouble;
+auto min(std::span<const jp::JSONInteger> values) -> jp::JSONInteger;
+auto max(std::span<const jp::JSONDouble> values) -> jp::JSONDouble;
+auto max(std::span<const jp::JSONInteger> values) -> jp::JSONInteger;
+
+struct Sum {
+    static constexpr std::string_view name = "sum";
+    static auto reduce(std::span<const jp::JSONDouble> values) { return sum(values); }
+    static auto reduce(std::span<const jp::JSONInteger> values) { return sum(values); }
+};
+
+struct Product {
+    static constexpr std::string_view name = "product";
+    static auto reduce(std::span<const jp::JSONDouble> values) { return product(values); }
+    static auto reduce(std::span<const jp::JSONInteger> values) { return product(values); }
+};
+
+struct Min {
+    static constexpr std::string_view name = "min";
+    static auto reduce(std::span<const jp::JSONDouble> values) { return min(values); }
+    static auto reduce(std::span<const jp::JSONInteger> values) -> std::optional<jp::JSONInteger> {
+        return min(values);
+    }
+};
+
+struct Max {
+    static constexpr std::string_view name = "max";
+    static auto reduce(std::span<const jp::JSONDouble> values) { return max(values); }
+    static auto reduce(std::span<const jp::JSONInteger> values) -> std::optional<jp::JSONInteger> {
+        return max(values);
+    }
+};
+
+// Reduces integers that are already packed, in double precision if the integer result overflows
+template <typename Op> auto reduce_integers(std::span<const jp::JSONInteger> values) -> jp::JSONValue {
+    if (const auto result = Op::reduce(values)) {
+        return jp::JSONValue{*result};
+    }
+
+    const auto doubles = std::vector<jp::JSONDouble>(values.begin(), values.end());
+    return jp::JSONValue{Op::reduce(std::span<const jp::JSONDouble>{doubles})};
+}
+
+// Reduces values that arrive one at a time, for sequences that are never materialized. Numbers are packed into a
+// bounded buffer that is reduced together with the running total whenever it fills up, so memory doesn't grow with the
+// input. Like reduce(), integers produce an integer unless the result overflows.
+template <typename Op> class Accumulator {
+  public:
+    // Returns false for values that aren't numbers
+    auto add(const jp::JSONValue &value) -> bool {
+        if (value.is_integer() && integral) {
+            integers.push_back(value.as_integer());
+        } else if (value.is_numeric()) {
+            to_doubles();
+            doubles.push_back(value.is_integer() ? static_cast<jp::JSONDouble>(value.as_integer()) : value.as_double());
+        } else {
+            return false;
+        }
+
+        count++;
+        if (integers.size() >= buffer_size || doubles.size() >= buffer_size) {
+            flush();
+        }
+        return true;
+    }
+
+    [[nodiscard]] auto empty() const -> bool { return count == 0; }
+
+    // Must not be called on an empty accumulator
+    auto result() -> jp::JSONValue {
+        flush();
+        return integral ? jp::JSONValue{*integer_total} : jp::JSONValue{*double_total};
+    }
+
+  private:
+    static constexpr auto buffer_size = std::size_t{4096};
+
+    void flush() {
+        if (integral) {
+            if (integer_total) {
+                integers.push_back(*std::exchange(integer_total, std::nullopt));
+            }
+            if (integers.empty()) {
+                return;
+            }
+            if (const auto total = Op::reduce(std::span<const jp::JSONInteger>{integers})) {
+                integer_total = *total;
+                integers.clear();
+                return;
+            }
+            // The buffer overflowed, it still holds every value that went into the total
+            to_doubles();
+        }
+
+        if (double_total) {
+            doubles.push_back(*std::exchange(double_total, std::nullopt));
+        }
+        if (!doubles.empty()) {
+            double_total = Op::reduce(std::span<const jp::JSONDouble>{doubles});
+            doubles.clear();
+        }
+    }
+
+    void to_doubles() {
+        if (!integral) {
+            return;
+        }
+        integral = false;
+        if (integer_total) {
+            doubles.push_back(static_cast<jp::JSONDouble>(*std::exchange(integer_total, std::nullopt)));
+        }
+        doubles.insert(doubles.end(), integers.begin(), integers.end());
+        integers.clear();
+    }
+
+    std::size_t count = 0;
+    bool integral = true;
+    std::optional<jp::JSONInteger> integer_total;
+    std::optional<jp::JSONDouble> double_total;
+    std::vector<jp::JSONInteger> integers;
+    std::vector<jp::JSONDouble> doubles;
+};
+
+enum class ValueKind { Integers, Doubles, Mixed, NonNumeric };
+
+// Numbers copied out of the DOM into a contiguous buffer. Integers are collected until the first double shows up,
+// at which point everything gathered so far moves to the double buffer.
+struct NumericColumn {
+    ValueKind kind = ValueKind::Integers;
+    std::vector<jp::JSONInteger> integers;
+    std::vector<jp::JSONDouble> doubles;
+};
+
+// Classifies and gathers the values in a single pass over the DOM, which dominates the cost of a reduction
+auto gather(std::span<const jp::JSONValue> values) -> NumericColumn;
+
+template <typename Op> auto reduce(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+
+extern template auto reduce<Sum>(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+extern template auto reduce<Product>(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+extern template auto reduce<Min>(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+extern template auto reduce<Max>(std::span<const jp::JSONValue> values) -> jp::expected<jp::JSONValue, Error>;
+
+constexpr auto parallel_chunk_size = std::size_t{1} << 16;
+
+// Values longer than `threshold` are split into chunks of parallel_chunk_size, reduced on `pool` (sequentially if it
+// is nullptr) and combined in chunk order. The chunking doesn't depend on the pool, so neither does the result.
+template <typename Op>
+auto reduce(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+            std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+
+extern template auto reduce<Sum>(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+                                 std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+extern template auto reduce<Product>(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+                                     std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+extern template auto reduce<Min>(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+                                 std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+extern template auto reduce<Max>(std::span<const jp::JSONValue> values, jp::ThreadPool *pool,
+                                 std::size_t threshold) -> jp::expected<jp::JSONValue, Error>;
+
+} // namespace query::aggregate
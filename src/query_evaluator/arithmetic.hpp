@@ -0,0 +1,86 @@
+#pragma once
+
+#include "error.hpp"
+#include "expected.hpp"
+#include "jsonobject.hpp"
+#include "query_token.hpp"
+#include <limits>
+#include <optional>
+#include <type_traits>
+
+// Type-specialized kernels for the arithmetic operators. Integers stay integers as long as the result is exact and
+// fits into 64 bits, otherwise the operation is redone in double precision.
+namespace query::arithmetic {
+
+enum class Op { Add, Subtract, Multiply, Divide };
+
+inline auto from_token(const TokenType &token) -> std::optional<Op> {
+    return std::visit(overloaded{[](const Plus &) { return std::optional{Op::Add}; },
+                                 [](const Minus &) { return std::optional{Op::Subtract}; },
+                                 [](const Star &) { return std::optional{Op::Multiply}; },
+                                 [](const Slash &) { return std::optional{Op::Divide}; },
+                                 [](const auto &) { return std::optional<Op>{}; }},
+                      token);
+}
+
+template <Op op> auto apply(jp::JSONDouble lhs, jp::JSONDouble rhs) -> jp::expected<jp::JSONValue, Error> {
+    if constexpr (op == Op::Add) {
+        return jp::JSONValue{lhs + rhs};
+    } else if constexpr (op == Op::Subtract) {
+        return jp::JSONValue{lhs - rhs};
+    } else if constexpr (op == Op::Multiply) {
+        return jp::JSONValue{lhs * rhs};
+    } else {
+        if (rhs == 0) {
+            return Error{ErrorCode::DivisionByZero};
+        }
+        return jp::JSONValue{lhs / rhs};
+    }
+}
+
+template <Op op> auto apply(jp::JSONInteger lhs, jp::JSONInteger rhs) -> jp::expected<jp::JSONValue, Error> {
+    auto result = jp::JSONInteger{};
+    auto overflow = false;
+
+    if constexpr (op == Op::Add) {
+        overflow = __builtin_add_overflow(lhs, rhs, &result);
+    } else if constexpr (op == Op::Subtract) {
+        overflow = __builtin_sub_overflow(lhs, rhs, &result);
+    } else if constexpr (op == Op::Multiply) {
+        overflow = __builtin_mul_overflow(lhs, rhs, &result);
+    } else {
+        if (rhs == 0) {
+            return Error{ErrorCode::DivisionByZero};
+        }
+        // INT64_MIN / -1 is the only quotient that doesn't fit
+        overflow = rhs == -1 && lhs == std::numeric_limits<jp::JSONInteger>::min();
+        if (!overflow && lhs % rhs == 0) {
+            return jp::JSONValue{lhs / rhs};
+        }
+        return jp::JSONValue{static_cast<jp::JSONDouble>(lhs) / static_cast<jp::JSONDouble>(rhs)};
+    }
+
+    if (overflow) {
+        return apply<op>(static_cast<jp::JSONDouble>(lhs), static_cast<jp::JSONDouble>(rhs));
+    }
+
+    return jp::JSONValue{result};
+}
+
+// Mixed operands are computed in double precision
+template <Op op, typename L, typename R>
+    requires(!std::is_same_v<L, R>)
+auto apply(L lhs, R rhs) -> jp::expected<jp::JSONValue, Error> {
+    return apply<op>(static_cast<jp::JSONDouble>(lhs), static_cast<jp::JSONDouble>(rhs));
+}
+
+inline auto negate(jp::JSONInteger value) -> jp::JSONValue {
+    if (value == std::numeric_limits<jp::JSONInteger>::min()) {
+        return jp::JSONValue{-static_cast<jp::JSONDouble>(value)};
+    }
+    return jp::JSONValue{-value};
+}
+
+inline auto negate(jp::JSONDouble value) -> jp::JSONValue { return jp::JSONValue{-value}; }
+
+} // namespace query::arithmetic
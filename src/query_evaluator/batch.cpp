@@ -0,0 +1,154 @@
+#include "batch.hpp"
+#include "query_evaluator.hpp"
+#include "memory.hpp"
+
+namespace query {
+
+Batch::Batch(std::vector<NamedQuery> queries) : named_queries(std::move(queries)) {
+    nodes.push_back(TrieNode{.segment = {}, .parent = root, .children = {}});
+
+    for (const auto &query : named_queries) {
+        collect_paths(query.expression);
+    }
+}
+
+void Batch::collect_paths(const Value &value) {
+    std::visit(overloaded{[&](const std::unique_ptr<Path> &path) {
+                              insert(*path);
+
+                              // Subscripts are evaluated against the document root as well
+                              for (const auto *segment = path.get(); segment != nullptr;
+                                   segment = segment->next ? segment->next->get() : nullptr) {
+                                  if (segment->subscript) {
+                                      collect_paths(*segment->subscript);
+                                  }
+                              }
+                          },
+                          [&](const std::unique_ptr<Function> &function) {
+                              for (const auto &argument : function->arguments) {
+                                  collect_paths(argument);
+                              }
+                          },
+                          [&](const std::unique_ptr<Binary> &binary) {
+                              collect_paths(binary->lhs);
+                              collect_paths(binary->rhs);
+                          },
+                          [&](const std::unique_ptr<Unary> &unary) { collect_paths(unary->value); },
+                          // The filtered field is relative to the array elements and can't be shared
+                          [&](const std::unique_ptr<Filter> &filter) { collect_paths(filter->value); },
+                          [](const auto &) {}},
+               value);
+}
+
+void Batch::insert(const Path &path) {
+    auto entry = PathEntry{.path = &path, .trie_nodes = {}, .next_segments = {}};
+
+    auto node = root;
+    for (const auto *segment = &path; segment != nullptr; segment = segment->next ? segment->next->get() : nullptr) {
+        auto key = SegmentKey{segment->id.identifier, std::nullopt};
+
+        // Only literal subscripts are part of the shared prefix
+        if (segment->subscript) {
+            if (!std::holds_alternative<Integer>(*segment->subscript)) {
+                break;
+            }
+            key.second = std::get<Integer>(*segment->subscript).value;
+        }
+
+        auto child = nodes[node].children.find(key);
+        if (child == nodes[node].children.end()) {
+            nodes.push_back(TrieNode{.segment = key, .parent = node, .children = {}});
+            child = nodes[node].children.emplace(std::move(key), nodes.size() - 1).first;
+        }
+
+        node = child->second;
+        entry.trie_nodes.push_back(node);
+        entry.next_segments.push_back(segment->next ? segment->next->get() : nullptr);
+    }
+
+    if (!entry.trie_nodes.empty()) {
+        paths.push_back(std::move(entry));
+    }
+}
+
+auto Batch::resolve(const jp::JSONValue &document) const -> PathCache {
+    // Children are always created after their parents, so one forward pass resolves every node exactly once
+    auto resolved = std::vector<const jp::JSONValue *>(nodes.size(), nullptr);
+    resolved[root] = &document;
+
+    for (auto i = root + 1; i < nodes.size(); i++) {
+        const auto &node = nodes[i];
+        const auto *parent = resolved[node.parent];
+
+        if (parent == nullptr || !parent->is_object()) {
+            continue;
+        }
+
+        const auto &object = parent->as_object();
+        const auto member = object.find(node.segment.first);
+        if (member == object.end()) {
+            continue;
+        }
+
+        if (!node.segment.second) {
+            resolved[i] = &member->second;
+            continue;
+        }
+
+        const auto index = *node.segment.second;
+        if (member->second.is_array() && index >= 0 &&
+            static_cast<std::size_t>(index) < member->second.as_array().size()) {
+            resolved[i] = &member->second.as_array()[static_cast<std::size_t>(index)];
+        }
+    }
+
+    auto cache = PathCache{};
+    cache.reserve(paths.size());
+
+    for (const auto &entry : paths) {
+        for (auto k = entry.trie_nodes.size(); k-- > 0;) {
+            if (const auto *value = resolved[entry.trie_nodes[k]]) {
+                cache.emplace(entry.path, ResolvedPrefix{.value = value, .rest = entry.next_segments[k]});
+                break;
+            }
+        }
+    }
+
+    return cache;
+}
+
+void Batch::bind(const Evaluator &evaluator) {
+    for (auto &query : named_queries) {
+        evaluator.bind(query.expression);
+    }
+}
+
+auto Batch::evaluate(const Evaluator &evaluator) const -> std::pair<jp::JSONValue, std::vector<Error>> {
+    auto scope = jp::memory::Scope{jp::memory::Category::Evaluator};
+    const auto cache = resolve(*evaluator.input_json);
+
+    // The cache only applies to this call, the evaluator itself may be in use on other threads
+    auto scoped = evaluator;
+    scoped.path_cache = &cache;
+
+    auto results = jp::JSONObject{};
+    auto errors = std::vector<Error>{};
+
+    for (const auto &query : named_queries) {
+        auto result = scoped.evaluate_expression(query.expression);
+
+        if (result.has_error()) {
+            auto error = result.consume_error();
+            error.context = query.name.c_str();
+            errors.push_back(std::move(error));
+            results[query.name] = jp::JSONValue{jp::JSONNull{}};
+            continue;
+        }
+
+        results[query.name] = result.consume_value();
+    }
+
+    return {jp::JSONValue{results}, errors};
+}
+
+} // namespace query
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "error.hpp"
+#include "jsonobject.hpp"
+#include "query.hpp"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace query {
+
+class Evaluator;
+
+// Longest prefix of a path that was already resolved. `rest` is the first segment that still has to be evaluated,
+// or nullptr if the whole path was resolved to `value`.
+struct ResolvedPrefix {
+    const jp::JSONValue *value;
+    const Path *rest;
+};
+
+using PathCache = std::unordered_map<const Path *, ResolvedPrefix>;
+
+struct NamedQuery {
+    std::string name;
+    Expression expression;
+};
+
+// Evaluates many queries against one document. The constant prefixes (members and literal subscripts) of all
+// paths in the batch are merged into a trie which is resolved once per document, every query then continues from
+// the deepest resolved node of each of its paths.
+class Batch {
+  public:
+    explicit Batch(std::vector<NamedQuery> queries);
+
+    // Returns an object keyed by query name. Failed queries map to null and their errors are returned separately.
+    auto evaluate(const Evaluator &evaluator) const -> std::pair<jp::JSONValue, std::vector<Error>>;
+
+    // Binds the function calls of every query to the evaluator's functions
+    void bind(const Evaluator &evaluator);
+
+    [[nodiscard]] auto queries() const -> const std::vector<NamedQuery> & { return named_queries; }
+    [[nodiscard]] auto trie_size() const -> std::size_t { return nodes.size(); }
+
+  private:
+    using SegmentKey = std::pair<std::string, std::optional<std::int64_t>>;
+
+    struct TrieNode {
+        SegmentKey segment;
+        std::size_t parent;
+        std::map<SegmentKey, std::size_t> children;
+    };
+
+    // Trie nodes visited by a path, in order. The path continues at `rest` once they are resolved.
+    struct PathEntry {
+        const Path *path;
+        std::vector<std::size_t> trie_nodes;
+        std::vector<const Path *> next_segments;
+    };
+
+    void insert(const Path &path);
+    void collect_paths(const Value &value);
+    auto resolve(const jp::JSONValue &document) const -> PathCache;
+
+    static constexpr auto root = std::size_t{0};
+
+    std::vector<NamedQuery> named_queries;
+    std::vector<TrieNode> nodes;
+    std::vector<PathEntry> paths;
+};
+
+} // namespace query
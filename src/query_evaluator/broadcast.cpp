@@ -0,0 +1,334 @@
+#include "broadcast.hpp"
+#include "aggregate.hpp"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace query::broadcast {
+
+namespace {
+
+using arithmetic::Op;
+
+template <Op op> auto combine(jp::JSONDouble lhs, jp::JSONDouble rhs) -> jp::JSONDouble {
+    if constexpr (op == Op::Add) {
+        return lhs + rhs;
+    } else if constexpr (op == Op::Subtract) {
+        return lhs - rhs;
+    } else if constexpr (op == Op::Multiply) {
+        return lhs * rhs;
+    } else {
+        return lhs / rhs;
+    }
+}
+
+#if defined(__AVX2__)
+using Vector = __m256d;
+constexpr auto lanes = std::size_t{4};
+inline auto load(const jp::JSONDouble *data) { return _mm256_loadu_pd(data); }
+inline auto splat(jp::JSONDouble value) { return _mm256_set1_pd(value); }
+inline void store(jp::JSONDouble *data, Vector value) { _mm256_storeu_pd(data, value); }
+template <Op op> auto combine(Vector lhs, Vector rhs) -> Vector {
+    if constexpr (op == Op::Add) {
+        return _mm256_add_pd(lhs, rhs);
+    } else if constexpr (op == Op::Subtract) {
+        return _mm256_sub_pd(lhs, rhs);
+    } else if constexpr (op == Op::Multiply) {
+        return _mm256_mul_pd(lhs, rhs);
+    } else {
+        return _mm256_div_pd(lhs, rhs);
+    }
+}
+#elif defined(__SSE2__)
+using Vector = __m128d;
+constexpr auto lanes = std::size_t{2};
+inline auto load(const jp::JSONDouble *data) { return _mm_loadu_pd(data); }
+inline auto splat(jp::JSONDouble value) { return _mm_set1_pd(value); }
+inline void store(jp::JSONDouble *data, Vector value) { _mm_storeu_pd(data, value); }
+template <Op op> auto combine(Vector lhs, Vector rhs) -> Vector {
+    if constexpr (op == Op::Add) {
+        return _mm_add_pd(lhs, rhs);
+    } else if constexpr (op == Op::Subtract) {
+        return _mm_sub_pd(lhs, rhs);
+    } else if constexpr (op == Op::Multiply) {
+        return _mm_mul_pd(lhs, rhs);
+    } else {
+        return _mm_div_pd(lhs, rhs);
+    }
+}
+#endif
+
+// out[i] = lhs[i] op rhs[i], a scalar operand is a pointer to a single value. `out` may alias either operand.
+template <Op op, bool lhs_scalar, bool rhs_scalar>
+void kernel(jp::JSONDouble *out, const jp::JSONDouble *lhs, const jp::JSONDouble *rhs, std::size_t size) {
+    // An empty array operand may have no storage at all
+    if (size == 0) {
+        return;
+    }
+    auto i = std::size_t{0};
+
+#if defined(__AVX2__) || defined(__SSE2__)
+    // Only the scalar side is broadcast, an array operand is read lane by lane
+    [[maybe_unused]] auto lhs_splat = Vector{};
+    [[maybe_unused]] auto rhs_splat = Vector{};
+    if constexpr (lhs_scalar) {
+        lhs_splat = splat(*lhs);
+    }
+    if constexpr (rhs_scalar) {
+        rhs_splat = splat(*rhs);
+    }
+    for (; i + lanes <= size; i += lanes) {
+        const auto l = lhs_scalar ? lhs_splat : load(lhs + i);
+        const auto r = rhs_scalar ? rhs_splat : load(rhs + i);
+        store(out + i, combine<op>(l, r));
+    }
+#endif
+
+    for (; i < size; i++) {
+        out[i] = combine<op>(lhs[lhs_scalar ? 0 : i], rhs[rhs_scalar ? 0 : i]);
+    }
+}
+
+// Whether every element fits into 64 bits and every quotient is an integer. Checked before anything is written, so
+// that the result can overwrite an operand buffer and the operands are still intact for the fallback to doubles.
+template <Op op>
+auto integers_exact(const jp::JSONInteger *lhs, std::size_t lhs_step, const jp::JSONInteger *rhs, std::size_t rhs_step,
+                    std::size_t size) -> bool {
+    auto exact = true;
+
+    for (auto i = std::size_t{0}; i < size; i++) {
+        const auto l = lhs[i * lhs_step];
+        const auto r = rhs[i * rhs_step];
+        auto result = jp::JSONInteger{};
+        auto overflow = false;
+
+        if constexpr (op == Op::Add) {
+            overflow = __builtin_add_overflow(l, r, &result);
+        } else if constexpr (op == Op::Subtract) {
+            overflow = __builtin_sub_overflow(l, r, &result);
+        } else if constexpr (op == Op::Multiply) {
+            overflow = __builtin_mul_overflow(l, r, &result);
+        } else {
+            overflow = (r == -1 && l == std::numeric_limits<jp::JSONInteger>::min()) || l % r != 0;
+        }
+
+        exact = exact && !overflow;
+    }
+
+    return exact;
+}
+
+// out[i] = lhs[i] op rhs[i] once integers_exact() holds. `out` may alias either operand.
+template <Op op>
+void integer_kernel(jp::JSONInteger *out, const jp::JSONInteger *lhs, std::size_t lhs_step, const jp::JSONInteger *rhs,
+                    std::size_t rhs_step, std::size_t size) {
+    for (auto i = std::size_t{0}; i < size; i++) {
+        const auto l = lhs[i * lhs_step];
+        const auto r = rhs[i * rhs_step];
+
+        if constexpr (op == Op::Add) {
+            out[i] = l + r;
+        } else if constexpr (op == Op::Subtract) {
+            out[i] = l - r;
+        } else if constexpr (op == Op::Multiply) {
+            out[i] = l * r;
+        } else {
+            out[i] = l / r;
+        }
+    }
+}
+
+auto to_doubles(Operand &&operand) -> Operand {
+    return std::visit(
+        overloaded{[](jp::JSONInteger value) -> Operand { return static_cast<jp::JSONDouble>(value); },
+                   [](Integers &&values) -> Operand { return Doubles(values.begin(), values.end()); },
+                   [](auto &&value) -> Operand { return std::move(value); }},
+        std::move(operand));
+}
+
+auto has_zero(const Operand &operand) -> bool {
+    return std::visit(overloaded{[](const Integers &values) { return std::ranges::find(values, 0) != values.end(); },
+                                 [](const Doubles &values) { return std::ranges::find(values, 0.0) != values.end(); },
+                                 [](auto value) { return value == 0; }},
+                      operand);
+}
+
+template <Op op> auto apply_doubles(Operand &&lhs, Operand &&rhs, std::size_t size) -> Operand {
+    lhs = to_doubles(std::move(lhs));
+    rhs = to_doubles(std::move(rhs));
+
+    auto *lhs_array = std::get_if<Doubles>(&lhs);
+    auto *rhs_array = std::get_if<Doubles>(&rhs);
+    const auto *l = lhs_array != nullptr ? lhs_array->data() : &std::get<jp::JSONDouble>(lhs);
+    const auto *r = rhs_array != nullptr ? rhs_array->data() : &std::get<jp::JSONDouble>(rhs);
+
+    // The result overwrites an operand buffer, at least one of them is an array
+    auto result = lhs_array != nullptr ? std::move(*lhs_array) : std::move(*rhs_array);
+    auto *out = result.data();
+
+    if (lhs_array != nullptr && rhs_array != nullptr) {
+        kernel<op, false, false>(out, l, r, size);
+    } else if (lhs_array != nullptr) {
+        kernel<op, false, true>(out, l, r, size);
+    } else {
+        kernel<op, true, false>(out, l, r, size);
+    }
+
+    return result;
+}
+
+template <Op op> auto apply_integers(Operand &&lhs, Operand &&rhs, std::size_t size) -> Operand {
+    auto *lhs_array = std::get_if<Integers>(&lhs);
+    auto *rhs_array = std::get_if<Integers>(&rhs);
+    const auto *l = lhs_array != nullptr ? lhs_array->data() : &std::get<jp::JSONInteger>(lhs);
+    const auto *r = rhs_array != nullptr ? rhs_array->data() : &std::get<jp::JSONInteger>(rhs);
+    const auto lhs_step = lhs_array != nullptr ? std::size_t{1} : std::size_t{0};
+    const auto rhs_step = rhs_array != nullptr ? std::size_t{1} : std::size_t{0};
+
+    if (!integers_exact<op>(l, lhs_step, r, rhs_step, size)) {
+        return apply_doubles<op>(std::move(lhs), std::move(rhs), size);
+    }
+
+    // The result overwrites an operand buffer, at least one of them is an array
+    auto result = lhs_array != nullptr ? std::move(*lhs_array) : std::move(*rhs_array);
+    integer_kernel<op>(result.data(), l, lhs_step, r, rhs_step, size);
+    return result;
+}
+
+template <Op op> auto apply(Operand &&lhs, Operand &&rhs) -> jp::expected<Operand, Error> {
+    // Scalars use the same kernels as the rest of the evaluator
+    if (!is_array(lhs) && !is_array(rhs)) {
+        auto result = std::visit(
+            [](const auto &l, const auto &r) -> jp::expected<jp::JSONValue, Error> {
+                if constexpr (std::is_arithmetic_v<std::decay_t<decltype(l)>> &&
+                              std::is_arithmetic_v<std::decay_t<decltype(r)>>) {
+                    return arithmetic::apply<op>(l, r);
+                } else {
+                    return Error{ErrorCode::UnsupportedBinaryOperation};
+                }
+            },
+            lhs, rhs);
+        if (result.has_error()) {
+            return result.error();
+        }
+        if (result->is_integer()) {
+            return Operand{result->as_integer()};
+        }
+        return Operand{result->as_double()};
+    }
+
+    const auto size_of = [](const Operand &operand) -> std::optional<std::size_t> {
+        return std::visit(overloaded{[](const Integers &values) -> std::optional<std::size_t> { return values.size(); },
+                                     [](const Doubles &values) -> std::optional<std::size_t> { return values.size(); },
+                                     [](auto) -> std::optional<std::size_t> { return std::nullopt; }},
+                          operand);
+    };
+
+    const auto lhs_size = size_of(lhs);
+    const auto rhs_size = size_of(rhs);
+    if (lhs_size && rhs_size && *lhs_size != *rhs_size) {
+        return Error{ErrorCode::BroadcastSizeMismatch, *lhs_size, *rhs_size};
+    }
+    const auto size = lhs_size ? *lhs_size : *rhs_size;
+
+    if constexpr (op == Op::Divide) {
+        if (has_zero(rhs)) {
+            return Error{ErrorCode::DivisionByZero};
+        }
+    }
+
+    const auto integral = [](const Operand &operand) {
+        return std::holds_alternative<jp::JSONInteger>(operand) || std::holds_alternative<Integers>(operand);
+    };
+
+    if (integral(lhs) && integral(rhs)) {
+        return apply_integers<op>(std::move(lhs), std::move(rhs), size);
+    }
+    return apply_doubles<op>(std::move(lhs), std::move(rhs), size);
+}
+
+} // namespace
+
+auto make_operand(const jp::JSONValue &value) -> std::optional<Operand> {
+    if (value.is_integer()) {
+        return value.as_integer();
+    }
+    if (value.is_double()) {
+        return value.as_double();
+    }
+    if (!value.is_array()) {
+        return std::nullopt;
+    }
+
+    auto column = aggregate::gather(value.as_array());
+    switch (column.kind) {
+    case aggregate::ValueKind::Integers:
+        return std::move(column.integers);
+    case aggregate::ValueKind::Doubles:
+    case aggregate::ValueKind::Mixed:
+        return std::move(column.doubles);
+    case aggregate::ValueKind::NonNumeric:
+        break;
+    }
+    return std::nullopt;
+}
+
+auto to_value(Operand &&operand) -> jp::JSONValue {
+    const auto pack = [](const auto &values) {
+        auto array = jp::JSONArray{};
+        array.reserve(values.size());
+        for (const auto value : values) {
+            array.push_back(jp::JSONValue{value});
+        }
+        return jp::JSONValue{std::move(array)};
+    };
+
+    return std::visit(overloaded{[&](const Integers &values) { return pack(values); },
+                                 [&](const Doubles &values) { return pack(values); },
+                                 [](auto value) { return jp::JSONValue{value}; }},
+                      operand);
+}
+
+auto apply(arithmetic::Op op, Operand &&lhs, Operand &&rhs) -> jp::expected<Operand, Error> {
+    switch (op) {
+    case Op::Add:
+        return apply<Op::Add>(std::move(lhs), std::move(rhs));
+    case Op::Subtract:
+        return apply<Op::Subtract>(std::move(lhs), std::move(rhs));
+    case Op::Multiply:
+        return apply<Op::Multiply>(std::move(lhs), std::move(rhs));
+    case Op::Divide:
+        return apply<Op::Divide>(std::move(lhs), std::move(rhs));
+    }
+    return Error{ErrorCode::UnsupportedBinaryOperation};
+}
+
+auto negate(Operand &&operand) -> Operand {
+    return std::visit(
+        overloaded{[](jp::JSONInteger value) -> Operand {
+                       const auto negated = arithmetic::negate(value);
+                       return negated.is_integer() ? Operand{negated.as_integer()} : Operand{negated.as_double()};
+                   },
+                   [](jp::JSONDouble value) -> Operand { return -value; },
+                   [](Integers &&values) -> Operand {
+                       // -INT64_MIN is the only negation that doesn't fit
+                       if (std::ranges::find(values, std::numeric_limits<jp::JSONInteger>::min()) != values.end()) {
+                           auto doubles = Doubles(values.begin(), values.end());
+                           std::ranges::transform(doubles, doubles.begin(), [](auto value) { return -value; });
+                           return doubles;
+                       }
+                       std::ranges::transform(values, values.begin(), [](auto value) { return -value; });
+                       return std::move(values);
+                   },
+                   [](Doubles &&values) -> Operand {
+                       std::ranges::transform(values, values.begin(), [](auto value) { return -value; });
+                       return std::move(values);
+                   }},
+        std::move(operand));
+}
+
+} // namespace query::broadcast
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "arithmetic.hpp"
+#include "error.hpp"
+#include "expected.hpp"
+#include "jsonobject.hpp"
+#include <optional>
+#include <variant>
+#include <vector>
+
+// Element-wise arithmetic over arrays with NumPy-style broadcasting of scalars. Arrays are gathered into packed
+// columns once, every operation then runs a vectorized kernel over the columns and reuses one of the operand buffers
+// for its result. Arithmetic passed to a reduction like sum(a * b) is evaluated on operands end to end, so only its
+// leaves allocate and no intermediate JSON array is built. Integer columns stay integers unless an element overflows
+// or a division isn't exact, in which case the whole operation is redone in double precision.
+namespace query::broadcast {
+
+using Integers = std::vector<jp::JSONInteger>;
+using Doubles = std::vector<jp::JSONDouble>;
+using Operand = std::variant<jp::JSONInteger, jp::JSONDouble, Integers, Doubles>;
+
+// std::nullopt for values that aren't numbers or arrays of numbers
+auto make_operand(const jp::JSONValue &value) -> std::optional<Operand>;
+auto to_value(Operand &&operand) -> jp::JSONValue;
+
+[[nodiscard]] inline auto is_array(const Operand &operand) -> bool {
+    return std::holds_alternative<Integers>(operand) || std::holds_alternative<Doubles>(operand);
+}
+
+auto apply(arithmetic::Op op, Operand &&lhs, Operand &&rhs) -> jp::expected<Operand, Error>;
+auto negate(Operand &&operand) -> Operand;
+
+} // namespace query::broadcast
@@ -0,0 +1,45 @@
+#include "function_registry.hpp"
+#include "intrinsics.hpp"
+#include "query_evaluator.hpp"
+
+namespace query {
+
+void FunctionRegistry::add(const std::string &name, Function function) {
+    const auto [it, inserted] = ids.try_emplace(name, intrinsic_count + functions.size());
+    if (inserted) {
+        functions.push_back(std::move(function));
+    } else {
+        functions[it->second - intrinsic_count] = std::move(function);
+    }
+}
+
+auto FunctionRegistry::find(const std::string &name) const -> std::optional<std::uint32_t> {
+    if (const auto it = ids.find(name); it != ids.end()) {
+        return it->second;
+    }
+
+    if (const auto intrinsic = find_intrinsic(name)) {
+        return static_cast<std::uint32_t>(*intrinsic);
+    }
+
+    return std::nullopt;
+}
+
+auto FunctionRegistry::call(std::uint32_t id, const Evaluator &evaluator,
+                            std::span<const Expression> args) const -> jp::expected<jp::JSONValue, Error> {
+    if (id < intrinsic_count) {
+        return call_intrinsic(static_cast<Intrinsic>(id), evaluator, args);
+    }
+
+    if (id - intrinsic_count >= functions.size()) {
+        return Error{ErrorCode::FunctionNotFound, "#" + std::to_string(id)};
+    }
+    return functions[id - intrinsic_count](&evaluator, args);
+}
+
+auto FunctionRegistry::intrinsics() -> std::shared_ptr<const FunctionRegistry> {
+    static const auto registry = std::make_shared<const FunctionRegistry>();
+    return registry;
+}
+
+} // namespace query
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "error.hpp"
+#include "expected.hpp"
+#include "jsonobject.hpp"
+#include "query.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace query {
+
+class Evaluator;
+
+// Functions a query can call: the intrinsics and the user functions registered on top of them. A registry is
+// filled in once and then shared read-only by any number of evaluators, so creating an evaluator per thread or per
+// request doesn't repeat the registration.
+class FunctionRegistry {
+  public:
+    using Function =
+        std::function<jp::expected<jp::JSONValue, Error>(const Evaluator *, const std::span<const Expression> &)>;
+
+    // User functions take precedence over intrinsics of the same name, registering a name twice replaces it
+    void add(const std::string &name, Function function);
+
+    // Id to bind calls of `name` to, intrinsics are numbered before user functions
+    [[nodiscard]] auto find(const std::string &name) const -> std::optional<std::uint32_t>;
+    auto call(std::uint32_t id, const Evaluator &evaluator,
+              std::span<const Expression> args) const -> jp::expected<jp::JSONValue, Error>;
+
+    // The registry with nothing but the intrinsics, used by evaluators that don't register functions of their own
+    static auto intrinsics() -> std::shared_ptr<const FunctionRegistry>;
+
+  private:
+    std::vector<Function> functions;
+    std::unordered_map<std::string, std::uint32_t> ids;
+};
+
+} // namespace query
@@ -0,0 +1,99 @@
+#include "index.hpp"
+#include <cmath>
+#include <limits>
+
+namespace query {
+
+auto make_index_key(const jp::JSONValue &value) -> std::optional<IndexKey> {
+    return std::visit(overloaded{[](const jp::JSONNull &) -> std::optional<IndexKey> { return std::monostate{}; },
+                                 [](bool b) -> std::optional<IndexKey> { return b; },
+                                 [](jp::JSONInteger i) -> std::optional<IndexKey> { return i; },
+                                 [](jp::JSONDouble d) -> std::optional<IndexKey> {
+                                     constexpr auto limit = static_cast<jp::JSONDouble>(
+                                         std::numeric_limits<jp::JSONInteger>::max());
+                                     if (std::trunc(d) == d && d >= -limit && d < limit) {
+                                         return static_cast<jp::JSONInteger>(d);
+                                     }
+                                     return d;
+                                 },
+                                 [](const std::string &s) -> std::optional<IndexKey> { return s; },
+                                 [](const auto &) -> std::optional<IndexKey> { return std::nullopt; }},
+                      value.value);
+}
+
+FieldIndex::FieldIndex(const jp::JSONArray &array, const std::string &field)
+    : data(array.data()), size(array.size()), next_position(array.size(), npos) {
+    first_position.reserve(array.size());
+
+    // Walk backwards so that every chain ends up in ascending order
+    for (auto position = array.size(); position-- > 0;) {
+        const auto &element = array[position];
+        if (!element.is_object()) {
+            continue;
+        }
+
+        const auto &object = element.as_object();
+        const auto member = object.find(field);
+        if (member == object.end()) {
+            continue;
+        }
+
+        auto key = make_index_key(member->second);
+        if (!key) {
+            continue;
+        }
+
+        auto [it, inserted] = first_position.try_emplace(std::move(*key), position);
+        if (!inserted) {
+            next_position[position] = it->second;
+            it->second = position;
+        }
+    }
+}
+
+auto FieldIndex::find(const IndexKey &key) const -> std::vector<std::size_t> {
+    auto positions = std::vector<std::size_t>{};
+
+    const auto it = first_position.find(key);
+    if (it == first_position.end()) {
+        return positions;
+    }
+
+    for (auto position = it->second; position != npos; position = next_position[position]) {
+        positions.push_back(position);
+    }
+
+    return positions;
+}
+
+auto FieldIndex::is_stale(const jp::JSONArray &array) const -> bool {
+    return array.data() != data || array.size() != size;
+}
+
+auto IndexCache::create(const jp::JSONArray &array, const std::string &field) -> const FieldIndex & {
+    auto key = std::make_pair(&array, field);
+    indexes.erase(key);
+    return indexes.try_emplace(std::move(key), array, field).first->second;
+}
+
+auto IndexCache::find(const jp::JSONArray &array, const std::string &field) const -> const FieldIndex * {
+    const auto it = indexes.find(std::make_pair(&array, field));
+    if (it == indexes.end() || it->second.is_stale(array)) {
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+void IndexCache::refresh() {
+    for (auto &[key, index] : indexes) {
+        const auto &[array, field] = key;
+        if (index.is_stale(*array)) {
+            index = FieldIndex(*array, field);
+        }
+    }
+}
+
+void IndexCache::invalidate() { indexes.clear(); }
+
+} // namespace query
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "jsonobject.hpp"
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace query {
+
+// Hashable form of a scalar JSON value. Integral doubles are stored as integers so that `1` and `1.0` compare equal.
+using IndexKey = std::variant<std::monostate, bool, jp::JSONInteger, jp::JSONDouble, std::string>;
+
+// Returns std::nullopt for objects and arrays, which can't be used as keys
+auto make_index_key(const jp::JSONValue &value) -> std::optional<IndexKey>;
+
+// Hash index from the value of `field` to the positions of the array elements holding it
+class FieldIndex {
+  public:
+    FieldIndex(const jp::JSONArray &array, const std::string &field);
+
+    [[nodiscard]] auto find(const IndexKey &key) const -> std::vector<std::size_t>;
+    // True if the array was reallocated or resized since the index was built
+    [[nodiscard]] auto is_stale(const jp::JSONArray &array) const -> bool;
+
+  private:
+    static constexpr auto npos = static_cast<std::size_t>(-1);
+
+    const jp::JSONValue *data;
+    std::size_t size;
+    // First position of every key, following positions are chained through `next_position`
+    std::unordered_map<IndexKey, std::size_t> first_position;
+    std::vector<std::size_t> next_position;
+};
+
+// Opt-in cache of field indexes over the arrays of one document. It outlives the evaluators that use it, so
+// indexes are built once and reused by every query. Equality filters on an indexed (array, field) pair are
+// answered from the index instead of scanning the array. Evaluation only reads the cache, so it can be shared by
+// evaluators on many threads; creating and refreshing indexes has to happen before that.
+class IndexCache {
+  public:
+    auto create(const jp::JSONArray &array, const std::string &field) -> const FieldIndex &;
+    // Returns nullptr if no index was created for the pair or the array changed since, the filter then scans it
+    [[nodiscard]] auto find(const jp::JSONArray &array, const std::string &field) const -> const FieldIndex *;
+    // Rebuilds the indexes of arrays that were resized or reallocated
+    void refresh();
+    // Must be called after the document is modified in place
+    void invalidate();
+
+    [[nodiscard]] auto size() const -> std::size_t { return indexes.size(); }
+
+  private:
+    std::map<std::pair<const jp::JSONArray *, std::string>, FieldIndex> indexes;
+};
+
+} // namespace query
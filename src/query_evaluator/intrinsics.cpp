@@ -0,0 +1,707 @@
+#include "intrinsics.hpp"
+#include "aggregate.hpp"
+#include "query_evaluator.hpp"
+#include "order.hpp"
+#include "pipeline.hpp"
+#include "select.hpp"
+#include "sketch.hpp"
+#include <array>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace query {
+
+namespace {
+
+constexpr auto intrinsic_names = std::array<std::string_view, intrinsic_count>{
+    "size",           "max",   "min",      "sum", "product", "avg", "stddev", "percentile",
+    "count_distinct", "top_k", "bottom_k", "nth", "median",  "sort_by", "group_by", "unique", "first"};
+
+// Folds the elements of a pipeline argument into `state` as they are produced, the array is never built.
+// Returns std::nullopt if `add` rejects an element.
+template <typename State, typename Add>
+auto fold(const Evaluator &evaluator, const Expression &arg, State state,
+          const Add &add) -> jp::expected<std::optional<State>, Error> {
+    auto sequence = evaluator.stream(arg);
+    if (sequence.has_error()) {
+        return sequence.error();
+    }
+
+    for (const auto &value : sequence->elements) {
+        if (!add(state, value)) {
+            return std::optional<State>{};
+        }
+    }
+
+    if (*sequence->error) {
+        return **sequence->error;
+    }
+    return std::optional<State>{std::move(state)};
+}
+
+auto size(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() != 1) {
+        return Error{ErrorCode::ExpectedOneArgument, "size"};
+    }
+
+    if (is_pipeline(args[0])) {
+        const auto count = fold(evaluator, args[0], jp::JSONInteger{0}, [](jp::JSONInteger &n, const jp::JSONValue &) {
+            n++;
+            return true;
+        });
+        if (count.has_error()) {
+            return count.error();
+        }
+        return jp::JSONValue{**count};
+    }
+
+    // A path without selectors is measured in the document instead of on a copy
+    if (const auto *path = std::get_if<std::unique_ptr<Path>>(&args[0]); path && evaluator.input_json->is_object()) {
+        const auto resolved = evaluator.resolve_path(&evaluator.input_json->as_object(), **path);
+        if (resolved.has_value() && resolved.value()->is_array()) {
+            return jp::JSONValue{static_cast<jp::JSONInteger>(resolved.value()->as_array().size())};
+        }
+        if (resolved.has_value() && resolved.value()->is_object()) {
+            return jp::JSONValue{static_cast<jp::JSONInteger>(resolved.value()->as_object().size())};
+        }
+    }
+
+    const auto result = evaluator.evaluate_expression(args[0]);
+
+    if (!result.has_value()) {
+        return result.error();
+    }
+
+    if (result->is_array()) {
+        return jp::JSONValue{static_cast<jp::JSONInteger>(result->as_array().size())};
+    }
+
+    if (result->is_object()) {
+        return jp::JSONValue{static_cast<jp::JSONInteger>(result->as_object().size())};
+    }
+
+    return Error{ErrorCode::ExpectedContainer, "size", result->type_name()};
+}
+
+// Takes either a single array or a variadic number of numbers
+template <typename Op>
+auto reduce(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.empty()) {
+        return Error{ErrorCode::MissingArguments, Op::name.data()};
+    }
+
+    // Filters and projections are reduced as their elements are produced
+    if (args.size() == 1 && is_pipeline(args[0])) {
+        const auto add = [](aggregate::Accumulator<Op> &accumulator, const jp::JSONValue &value) {
+            return accumulator.add(value);
+        };
+        auto accumulator = fold(evaluator, args[0], aggregate::Accumulator<Op>{}, add);
+        if (accumulator.has_error()) {
+            return accumulator.error();
+        }
+        if (!*accumulator) {
+            return Error{ErrorCode::NonNumericElements, Op::name.data()};
+        }
+        if ((*accumulator)->empty()) {
+            return Error{ErrorCode::EmptyArray, Op::name.data()};
+        }
+        return (*accumulator)->result();
+    }
+
+    // Element-wise operations are reduced straight from their packed result, sum(a * b) never builds the product array
+    if (args.size() == 1 && (std::holds_alternative<std::unique_ptr<Binary>>(args[0]) ||
+                             std::holds_alternative<std::unique_ptr<Unary>>(args[0]))) {
+        auto operand = evaluator.evaluate_operand(args[0]);
+        if (operand.has_error()) {
+            return operand.error();
+        }
+
+        return std::visit(
+            overloaded{[](const broadcast::Integers &values) -> jp::expected<jp::JSONValue, Error> {
+                           if (values.empty()) {
+                               return Error{ErrorCode::EmptyArray, Op::name.data()};
+                           }
+                           return aggregate::reduce_integers<Op>(values);
+                       },
+                       [](const broadcast::Doubles &values) -> jp::expected<jp::JSONValue, Error> {
+                           if (values.empty()) {
+                               return Error{ErrorCode::EmptyArray, Op::name.data()};
+                           }
+                           return jp::JSONValue{Op::reduce(std::span<const jp::JSONDouble>{values})};
+                       },
+                       [](auto value) -> jp::expected<jp::JSONValue, Error> { return jp::JSONValue{value}; }},
+            operand.value());
+    }
+
+    // Single argument case: If it's an array, reduce the array; otherwise, treat args as list of numbers.
+    if (args.size() == 1) {
+        const auto result = evaluator.evaluate_expression(args[0]);
+
+        if (!result.has_value()) {
+            return result.error();
+        }
+
+        if (result->is_array()) {
+            return aggregate::reduce<Op>(result->as_array(), evaluator.thread_pool.get(),
+                                         evaluator.parallel_threshold);
+        }
+        // Fall through for single non-array argument, handled as a list of one.
+    }
+
+    // Multi-argument case or single non-array argument
+    auto values = jp::JSONArray{};
+    values.reserve(args.size());
+    for (const auto &arg : args) {
+        auto value = evaluator.evaluate_expression(arg);
+        if (!value.has_value()) {
+            return value.error();
+        }
+
+        if (!value->is_numeric()) {
+            return Error{ErrorCode::ExpectedNumbersFound, Op::name.data(), value->type_name()};
+        }
+        values.push_back(value.consume_value());
+    }
+
+    return aggregate::reduce<Op>(values);
+}
+
+// Adds every value to a sketch. Arrays longer than the evaluator's parallel threshold are split into chunks that are
+// summarized on its pool and merged in chunk order. Returns std::nullopt if `add` rejects a value.
+template <typename Sketch, typename Add>
+auto summarize(const Evaluator &evaluator, std::span<const jp::JSONValue> values, const Sketch &empty,
+               const Add &add) -> std::optional<Sketch> {
+    const auto run = [&](std::span<const jp::JSONValue> chunk) -> std::optional<Sketch> {
+        auto sketch = empty;
+        for (const auto &value : chunk) {
+            if (!add(sketch, value)) {
+                return std::nullopt;
+            }
+        }
+        return sketch;
+    };
+
+    if (values.size() <= evaluator.parallel_threshold) {
+        return run(values);
+    }
+
+    const auto chunk_size = aggregate::parallel_chunk_size;
+    const auto chunks = (values.size() + chunk_size - 1) / chunk_size;
+    auto partials = std::vector<std::optional<Sketch>>(chunks);
+
+    const auto run_chunk = [&](std::size_t chunk) {
+        const auto offset = chunk * chunk_size;
+        partials[chunk] = run(values.subspan(offset, std::min(chunk_size, values.size() - offset)));
+    };
+
+    if (evaluator.thread_pool) {
+        evaluator.thread_pool->parallel_for(chunks, run_chunk);
+    } else {
+        for (auto chunk = std::size_t{0}; chunk < chunks; chunk++) {
+            run_chunk(chunk);
+        }
+    }
+
+    auto result = empty;
+    for (const auto &partial : partials) {
+        if (!partial) {
+            return std::nullopt;
+        }
+        result.merge(*partial);
+    }
+    return result;
+}
+
+// An array argument, borrowed from the document when the argument is a path to it and owned when it was computed
+class ArrayArgument {
+  public:
+    explicit ArrayArgument(const jp::JSONArray *borrowed) : borrowed(borrowed) {}
+    explicit ArrayArgument(jp::JSONValue owned) : owned(std::move(owned)) {}
+
+    [[nodiscard]] auto as_array() const -> const jp::JSONArray & { return owned ? owned->as_array() : *borrowed; }
+
+  private:
+    const jp::JSONArray *borrowed = nullptr;
+    std::optional<jp::JSONValue> owned;
+};
+
+auto array_argument(const Evaluator &evaluator, const Expression &arg,
+                    std::string_view name) -> jp::expected<ArrayArgument, Error> {
+    // Like in size(), a path without selectors is read in the document instead of being copied out of it
+    if (const auto *path = std::get_if<std::unique_ptr<Path>>(&arg); path && evaluator.input_json->is_object()) {
+        const auto resolved = evaluator.resolve_path(&evaluator.input_json->as_object(), **path);
+        if (resolved.has_value() && !resolved.value()->is_array()) {
+            return Error{ErrorCode::ExpectedArrayArgument, name.data(), resolved.value()->type_name()};
+        }
+        if (resolved.has_value()) {
+            return ArrayArgument{&resolved.value()->as_array()};
+        }
+    }
+
+    auto value = evaluator.evaluate_expression(arg);
+    if (value.has_error()) {
+        return value.error();
+    }
+    if (!value->is_array()) {
+        return Error{ErrorCode::ExpectedArrayArgument, name.data(), value->type_name()};
+    }
+    return ArrayArgument{std::move(*value)};
+}
+
+// Summarizes the array argument `arg`, pipelines are folded element by element instead of being materialized
+template <typename Sketch, typename Add>
+auto summarize_argument(const Evaluator &evaluator, const Expression &arg, const Sketch &empty, const Add &add,
+                        std::string_view name) -> jp::expected<std::optional<Sketch>, Error> {
+    if (is_pipeline(arg)) {
+        return fold(evaluator, arg, empty, add);
+    }
+
+    const auto array = array_argument(evaluator, arg, name);
+    if (array.has_error()) {
+        return array.error();
+    }
+    return summarize(evaluator, array->as_array(), empty, add);
+}
+
+auto add_number(sketch::Moments &moments, const jp::JSONValue &value) -> bool {
+    if (value.is_integer()) {
+        moments.add(static_cast<double>(value.as_integer()));
+        return true;
+    }
+    if (value.is_double()) {
+        moments.add(value.as_double());
+        return true;
+    }
+    return false;
+}
+
+// Takes either a single array or a variadic number of numbers, like the reductions
+auto moments(const Evaluator &evaluator, std::span<const Expression> args,
+             std::string_view name) -> jp::expected<sketch::Moments, Error> {
+    if (args.empty()) {
+        return Error{ErrorCode::MissingArguments, name.data()};
+    }
+
+    const auto not_numeric = [&] {
+        return Error{ErrorCode::ExpectedNumbers, name.data()};
+    };
+
+    const auto check = [&](const std::optional<sketch::Moments> &summary) -> jp::expected<sketch::Moments, Error> {
+        if (!summary) {
+            return not_numeric();
+        }
+        if (summary->count() == 0) {
+            return Error{ErrorCode::EmptySummary, name.data()};
+        }
+        return *summary;
+    };
+
+    if (args.size() == 1 && is_pipeline(args[0])) {
+        const auto summary = fold(evaluator, args[0], sketch::Moments{}, add_number);
+        if (summary.has_error()) {
+            return summary.error();
+        }
+        return check(*summary);
+    }
+
+    if (args.size() == 1) {
+        const auto result = evaluator.evaluate_expression(args[0]);
+        if (!result.has_value()) {
+            return result.error();
+        }
+
+        if (result->is_array()) {
+            return check(summarize(evaluator, result->as_array(), sketch::Moments{}, add_number));
+        }
+    }
+
+    auto summary = sketch::Moments{};
+    for (const auto &arg : args) {
+        const auto value = evaluator.evaluate_expression(arg);
+        if (!value.has_value()) {
+            return value.error();
+        }
+        if (!add_number(summary, *value)) {
+            return not_numeric();
+        }
+    }
+    return summary;
+}
+
+auto avg(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    auto summary = moments(evaluator, args, "avg");
+    if (summary.has_error()) {
+        return summary.error();
+    }
+    return jp::JSONValue{summary->mean()};
+}
+
+auto stddev(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    auto summary = moments(evaluator, args, "stddev");
+    if (summary.has_error()) {
+        return summary.error();
+    }
+    return jp::JSONValue{summary->stddev()};
+}
+
+// Evaluates the optional numeric argument at `index`, which must lie within [min, max]
+auto numeric_argument(const Evaluator &evaluator, std::span<const Expression> args, std::size_t index, double fallback,
+                      double min, double max, std::string_view name) -> jp::expected<double, Error> {
+    if (index >= args.size()) {
+        return fallback;
+    }
+
+    const auto value = evaluator.evaluate_expression(args[index]);
+    if (!value.has_value()) {
+        return value.error();
+    }
+
+    const auto number = value->is_integer()  ? static_cast<double>(value->as_integer())
+                        : value->is_double() ? value->as_double()
+                                             : std::numeric_limits<double>::quiet_NaN();
+    if (!(number >= min && number <= max)) {
+        return Error{ErrorCode::ArgumentOutOfRange, name.data(), index + 1, min, max};
+    }
+    return number;
+}
+
+// percentile(array, q[, compression]) with q in [0, 100]
+auto percentile(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() < 2 || args.size() > 3) {
+        return Error{ErrorCode::ExpectedArgumentRange, "percentile", 2, 3};
+    }
+
+    const auto q = numeric_argument(evaluator, args, 1, 0, 0, 100, "percentile");
+    if (q.has_error()) {
+        return q.error();
+    }
+    const auto compression =
+        numeric_argument(evaluator, args, 2, sketch::TDigest::default_compression, sketch::TDigest::min_compression,
+                         sketch::TDigest::max_compression, "percentile");
+    if (compression.has_error()) {
+        return compression.error();
+    }
+
+    auto digest = summarize_argument(
+        evaluator, args[0], sketch::TDigest{*compression},
+        [](sketch::TDigest &sketch, const jp::JSONValue &value) {
+            if (value.is_integer()) {
+                sketch.add(static_cast<double>(value.as_integer()));
+                return true;
+            }
+            if (value.is_double()) {
+                sketch.add(value.as_double());
+                return true;
+            }
+            return false;
+        },
+        "percentile");
+    if (digest.has_error()) {
+        return digest.error();
+    }
+    if (!*digest) {
+        return Error{ErrorCode::NonNumericElements, "percentile"};
+    }
+    if ((*digest)->count() == 0) {
+        return Error{ErrorCode::EmptySummary, "percentile"};
+    }
+    return jp::JSONValue{(*digest)->quantile(*q / 100)};
+}
+
+// count_distinct(array[, precision]), within about 1% of the exact count at the default precision
+auto count_distinct(const Evaluator &evaluator,
+                    std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.empty() || args.size() > 2) {
+        return Error{ErrorCode::ExpectedArgumentRange, "count_distinct", 1, 2};
+    }
+
+    const auto precision = numeric_argument(evaluator, args, 1, sketch::HyperLogLog::default_precision,
+                                            sketch::HyperLogLog::min_precision, sketch::HyperLogLog::max_precision,
+                                            "count_distinct");
+    if (precision.has_error()) {
+        return precision.error();
+    }
+
+    const auto sketch = summarize_argument(
+        evaluator, args[0], sketch::HyperLogLog{static_cast<unsigned>(*precision)},
+        [](sketch::HyperLogLog &sketch, const jp::JSONValue &value) {
+            const auto hash = sketch::hash(value);
+            if (hash) {
+                sketch.add(*hash);
+            }
+            return hash.has_value();
+        },
+        "count_distinct");
+    if (sketch.has_error()) {
+        return sketch.error();
+    }
+    if (!*sketch) {
+        return Error{ErrorCode::NonScalarElements, "count_distinct"};
+    }
+    return jp::JSONValue{static_cast<jp::JSONInteger>(std::llround((*sketch)->estimate()))};
+}
+
+// Evaluates the argument at `index`, which must be a non-negative integer
+auto count_argument(const Evaluator &evaluator, std::span<const Expression> args, std::size_t index,
+                    std::string_view name) -> jp::expected<std::size_t, Error> {
+    const auto value = evaluator.evaluate_expression(args[index]);
+    if (!value.has_value()) {
+        return value.error();
+    }
+
+    if (!value->is_integer() || value->as_integer() < 0) {
+        return Error{ErrorCode::ExpectedNonNegativeInteger, name.data(), index + 1};
+    }
+    return static_cast<std::size_t>(value->as_integer());
+}
+
+auto top_k(const Evaluator &evaluator, std::span<const Expression> args, std::string_view name,
+           select::Order order) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() != 2) {
+        return Error{ErrorCode::ExpectedTwoArguments, name.data()};
+    }
+
+    const auto array = array_argument(evaluator, args[0], name);
+    if (array.has_error()) {
+        return array.error();
+    }
+    const auto k = count_argument(evaluator, args, 1, name);
+    if (k.has_error()) {
+        return k.error();
+    }
+
+    auto selected = select::top_k(array->as_array(), *k, order);
+    if (!selected) {
+        return Error{ErrorCode::NonNumericElements, name.data()};
+    }
+    return jp::JSONValue{std::move(*selected)};
+}
+
+// nth(array, n), the element at position n (counting from 0) of the array in ascending order
+auto nth(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() != 2) {
+        return Error{ErrorCode::ExpectedTwoArguments, "nth"};
+    }
+
+    const auto array = array_argument(evaluator, args[0], "nth");
+    if (array.has_error()) {
+        return array.error();
+    }
+    const auto n = count_argument(evaluator, args, 1, "nth");
+    if (n.has_error()) {
+        return n.error();
+    }
+
+    const auto &values = array->as_array();
+    if (*n >= values.size()) {
+        return Error{ErrorCode::NthOutOfBounds, *n, values.size()};
+    }
+
+    auto selected = select::nth(values, *n);
+    if (!selected) {
+        return Error{ErrorCode::NonNumericElements, "nth"};
+    }
+    return std::move(*selected);
+}
+
+auto median(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() != 1) {
+        return Error{ErrorCode::ExpectedOneArgument, "median"};
+    }
+
+    const auto array = array_argument(evaluator, args[0], "median");
+    if (array.has_error()) {
+        return array.error();
+    }
+    if (array->as_array().empty()) {
+        return Error{ErrorCode::EmptySummary, "median"};
+    }
+
+    auto selected = select::median(array->as_array());
+    if (!selected) {
+        return Error{ErrorCode::NonNumericElements, "median"};
+    }
+    return std::move(*selected);
+}
+
+// Extracts the key at the member path `arg` from every element, the path is relative to the elements like the field
+// of a filter. Elements that aren't objects or don't have the key get a null key.
+auto element_keys(const Evaluator &evaluator, const jp::JSONArray &array, const Expression &arg,
+                  std::string_view name) -> jp::expected<std::vector<order::SortKey>, Error> {
+    if (!std::holds_alternative<std::unique_ptr<Path>>(arg)) {
+        return Error{ErrorCode::ExpectedMemberPath, name.data()};
+    }
+    const auto &path = *std::get<std::unique_ptr<Path>>(arg);
+
+    auto keys = std::vector<order::SortKey>{};
+    keys.reserve(array.size());
+    for (const auto &element : array) {
+        const auto value = element.is_object() ? evaluator.resolve_path(&element.as_object(), path)
+                                               : jp::expected<const jp::JSONValue *, Error>{nullptr};
+        keys.push_back(order::make_sort_key(value.has_value() ? value.value() : nullptr));
+    }
+    return keys;
+}
+
+auto gather_positions(const jp::JSONArray &array, std::span<const std::size_t> positions) -> jp::JSONArray {
+    auto result = jp::JSONArray{};
+    result.reserve(positions.size());
+    for (const auto position : positions) {
+        result.push_back(array[position]);
+    }
+    return result;
+}
+
+// sort_by(array, key), stable ascending order of the elements by the member `key`
+auto sort_by(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() != 2) {
+        return Error{ErrorCode::ExpectedTwoArguments, "sort_by"};
+    }
+
+    const auto array = array_argument(evaluator, args[0], "sort_by");
+    if (array.has_error()) {
+        return array.error();
+    }
+    const auto keys = element_keys(evaluator, array->as_array(), args[1], "sort_by");
+    if (keys.has_error()) {
+        return keys.error();
+    }
+
+    const auto positions = order::sort_permutation(*keys, evaluator.thread_pool.get(), evaluator.parallel_threshold);
+    return jp::JSONValue{gather_positions(array->as_array(), positions)};
+}
+
+// group_by(array, key), an object from every value of the member `key` to the elements holding it. Keys that aren't
+// strings are converted like they are printed, null collects the elements without the key.
+auto group_by(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() != 2) {
+        return Error{ErrorCode::ExpectedTwoArguments, "group_by"};
+    }
+
+    const auto array = array_argument(evaluator, args[0], "group_by");
+    if (array.has_error()) {
+        return array.error();
+    }
+    const auto keys = element_keys(evaluator, array->as_array(), args[1], "group_by");
+    if (keys.has_error()) {
+        return keys.error();
+    }
+
+    // Distinct keys that print the same, like 1 and "1", end up in one group. Their positions are merged first so
+    // every element is copied once, into its final group.
+    auto named = std::unordered_map<std::string, std::vector<std::size_t>>{};
+    for (auto &group : order::group_positions(*keys)) {
+        auto name = std::visit(overloaded{[](std::monostate) { return std::string{"null"}; },
+                                          [](std::string_view s) { return std::string{s}; },
+                                          [](auto value) { return jp::to_string(jp::JSONValue{value}); }},
+                               group.key);
+
+        auto &positions = named[std::move(name)];
+        if (positions.empty()) {
+            positions = std::move(group.positions);
+        } else {
+            positions.insert(positions.end(), group.positions.begin(), group.positions.end());
+        }
+    }
+
+    auto groups = jp::JSONObject{};
+    groups.reserve(named.size());
+    for (const auto &[name, positions] : named) {
+        groups.emplace(name, jp::JSONValue{gather_positions(array->as_array(), positions)});
+    }
+    return jp::JSONValue{std::move(groups)};
+}
+
+// unique(array), the distinct elements in the order they first appear
+auto unique(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() != 1) {
+        return Error{ErrorCode::ExpectedOneArgument, "unique"};
+    }
+
+    const auto array = array_argument(evaluator, args[0], "unique");
+    if (array.has_error()) {
+        return array.error();
+    }
+
+    return jp::JSONValue{gather_positions(array->as_array(), order::unique_positions(array->as_array()))};
+}
+
+// first(array), the first element. Filters and projections stop as soon as it has been produced.
+auto first(const Evaluator &evaluator, std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    if (args.size() != 1) {
+        return Error{ErrorCode::ExpectedOneArgument, "first"};
+    }
+
+    auto sequence = evaluator.stream(args[0]);
+    if (sequence.has_error()) {
+        return sequence.error();
+    }
+
+    // Destroying the sequence afterwards drops the rest of the pipeline unevaluated
+    if (auto element = sequence->elements.begin(); element != sequence->elements.end()) {
+        return *element;
+    }
+
+    if (*sequence->error) {
+        return **sequence->error;
+    }
+    return Error{ErrorCode::EmptyArray, "first"};
+}
+
+} // namespace
+
+auto find_intrinsic(std::string_view name) -> std::optional<Intrinsic> {
+    for (auto id = std::uint32_t{0}; id < intrinsic_count; id++) {
+        if (intrinsic_names[id] == name) {
+            return static_cast<Intrinsic>(id);
+        }
+    }
+    return std::nullopt;
+}
+
+auto call_intrinsic(Intrinsic intrinsic, const Evaluator &evaluator,
+                    std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error> {
+    switch (intrinsic) {
+    case Intrinsic::Size:
+        return size(evaluator, args);
+    case Intrinsic::Max:
+        return reduce<aggregate::Max>(evaluator, args);
+    case Intrinsic::Min:
+        return reduce<aggregate::Min>(evaluator, args);
+    case Intrinsic::Sum:
+        return reduce<aggregate::Sum>(evaluator, args);
+    case Intrinsic::Product:
+        return reduce<aggregate::Product>(evaluator, args);
+    case Intrinsic::Avg:
+        return avg(evaluator, args);
+    case Intrinsic::Stddev:
+        return stddev(evaluator, args);
+    case Intrinsic::Percentile:
+        return percentile(evaluator, args);
+    case Intrinsic::CountDistinct:
+        return count_distinct(evaluator, args);
+    case Intrinsic::TopK:
+        return top_k(evaluator, args, "top_k", select::Order::Descending);
+    case Intrinsic::BottomK:
+        return top_k(evaluator, args, "bottom_k", select::Order::Ascending);
+    case Intrinsic::Nth:
+        return nth(evaluator, args);
+    case Intrinsic::Median:
+        return median(evaluator, args);
+    case Intrinsic::SortBy:
+        return sort_by(evaluator, args);
+    case Intrinsic::GroupBy:
+        return group_by(evaluator, args);
+    case Intrinsic::Unique:
+        return unique(evaluator, args);
+    case Intrinsic::First:
+        return first(evaluator, args);
+    }
+
+    return Error{ErrorCode::UnknownIntrinsic};
+}
+
+} // namespace query
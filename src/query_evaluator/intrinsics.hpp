@@ -0,0 +1,44 @@
+#pragma once
+
+#include "error.hpp"
+#include "expected.hpp"
+#include "jsonobject.hpp"
+#include "query.hpp"
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace query {
+
+class Evaluator;
+
+// Functions built into the evaluator. Calls to them are bound to one of these ids once and dispatched through a
+// switch, user functions registered on the evaluator are numbered after them.
+enum class Intrinsic : std::uint32_t {
+    Size,
+    Max,
+    Min,
+    Sum,
+    Product,
+    Avg,
+    Stddev,
+    Percentile,
+    CountDistinct,
+    TopK,
+    BottomK,
+    Nth,
+    Median,
+    SortBy,
+    GroupBy,
+    Unique,
+    First
+};
+
+constexpr auto intrinsic_count = static_cast<std::uint32_t>(Intrinsic::First) + 1;
+
+auto find_intrinsic(std::string_view name) -> std::optional<Intrinsic>;
+auto call_intrinsic(Intrinsic intrinsic, const Evaluator &evaluator,
+                    std::span<const Expression> args) -> jp::expected<jp::JSONValue, Error>;
+
+} // namespace query
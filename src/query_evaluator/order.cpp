@@ -0,0 +1,205 @@
+#include "order.hpp"
+#include "aggregate.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace query::order {
+
+namespace {
+
+struct Entry {
+    SortKey key;
+    std::size_t position;
+};
+
+auto entry_less(const Entry &lhs, const Entry &rhs) -> bool { return compare(lhs.key, rhs.key) < 0; }
+
+auto is_composite(const jp::JSONValue &value) -> bool { return value.is_object() || value.is_array(); }
+
+auto mix(std::size_t hash) -> std::size_t {
+    auto h = static_cast<std::uint64_t>(hash);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return static_cast<std::size_t>(h);
+}
+
+// Structural hash consistent with deep_equal. Members are combined order independently because objects are unordered.
+auto deep_hash(const jp::JSONValue &value) -> std::size_t {
+    if (value.is_object()) {
+        auto hash = mix(value.as_object().size() + 1);
+        for (const auto &[name, member] : value.as_object()) {
+            hash += mix(std::hash<std::string>{}(name) ^ deep_hash(member));
+        }
+        return hash;
+    }
+
+    if (value.is_array()) {
+        auto hash = mix(value.as_array().size() + 2);
+        for (const auto &element : value.as_array()) {
+            hash = mix(hash ^ deep_hash(element)) + 1;
+        }
+        return hash;
+    }
+
+    return std::hash<SortKey>{}(make_sort_key(&value));
+}
+
+auto deep_equal(const jp::JSONValue &lhs, const jp::JSONValue &rhs) -> bool {
+    if (lhs.is_object() && rhs.is_object()) {
+        const auto &left = lhs.as_object();
+        const auto &right = rhs.as_object();
+        return left.size() == right.size() && std::ranges::all_of(left, [&](const auto &member) {
+                   const auto other = right.find(member.first);
+                   return other != right.end() && deep_equal(member.second, other->second);
+               });
+    }
+
+    if (lhs.is_array() && rhs.is_array()) {
+        return std::ranges::equal(lhs.as_array(), rhs.as_array(), deep_equal);
+    }
+
+    return !is_composite(lhs) && !is_composite(rhs) && make_sort_key(&lhs) == make_sort_key(&rhs);
+}
+
+} // namespace
+
+auto make_sort_key(const jp::JSONValue *value) -> SortKey {
+    if (value == nullptr) {
+        return std::monostate{};
+    }
+
+    return std::visit(overloaded{[](bool b) -> SortKey { return b; },
+                                 [](jp::JSONInteger i) -> SortKey { return i; },
+                                 [](jp::JSONDouble d) -> SortKey {
+                                     constexpr auto limit = static_cast<jp::JSONDouble>(
+                                         std::numeric_limits<jp::JSONInteger>::max());
+                                     if (std::trunc(d) == d && d >= -limit && d < limit) {
+                                         return static_cast<jp::JSONInteger>(d);
+                                     }
+                                     return d;
+                                 },
+                                 [](const std::string &s) -> SortKey { return std::string_view{s}; },
+                                 [](const auto &) -> SortKey { return std::monostate{}; }},
+                      value->value);
+}
+
+auto compare(const SortKey &lhs, const SortKey &rhs) -> std::weak_ordering {
+    // Integers and doubles share a rank and compare by value
+    const auto rank = [](const SortKey &key) {
+        constexpr auto ranks = std::array{0, 1, 2, 2, 3};
+        return ranks[key.index()];
+    };
+
+    if (const auto order = rank(lhs) <=> rank(rhs); order != 0) {
+        return order;
+    }
+
+    return std::visit(
+        overloaded{[](bool l, bool r) -> std::weak_ordering { return l <=> r; },
+                   [](jp::JSONInteger l, jp::JSONInteger r) -> std::weak_ordering { return l <=> r; },
+                   [](std::string_view l, std::string_view r) -> std::weak_ordering { return l <=> r; },
+                   [](auto l, auto r) -> std::weak_ordering {
+                       if constexpr (std::is_arithmetic_v<decltype(l)> && std::is_arithmetic_v<decltype(r)>) {
+                           const auto left = static_cast<jp::JSONDouble>(l);
+                           const auto right = static_cast<jp::JSONDouble>(r);
+                           return left < right ? std::weak_ordering::less
+                                  : right < left ? std::weak_ordering::greater
+                                                 : std::weak_ordering::equivalent;
+                       } else {
+                           return std::weak_ordering::equivalent;
+                       }
+                   }},
+        lhs, rhs);
+}
+
+auto sort_permutation(std::span<const SortKey> keys, jp::ThreadPool *pool,
+                      std::size_t threshold) -> std::vector<std::size_t> {
+    auto entries = std::vector<Entry>{};
+    entries.reserve(keys.size());
+    for (auto position = std::size_t{0}; position < keys.size(); position++) {
+        entries.push_back(Entry{.key = keys[position], .position = position});
+    }
+
+    if (keys.size() <= threshold) {
+        std::ranges::stable_sort(entries, entry_less);
+    } else {
+        const auto run = [pool](std::size_t count, const std::function<void(std::size_t)> &fn) {
+            if (pool != nullptr) {
+                pool->parallel_for(count, fn);
+            } else {
+                for (auto i = std::size_t{0}; i < count; i++) {
+                    fn(i);
+                }
+            }
+        };
+
+        const auto size = entries.size();
+        const auto chunk_size = aggregate::parallel_chunk_size;
+
+        run((size + chunk_size - 1) / chunk_size, [&](std::size_t chunk) {
+            const auto begin = entries.begin() + static_cast<std::ptrdiff_t>(chunk * chunk_size);
+            const auto end = entries.begin() + static_cast<std::ptrdiff_t>(std::min(size, (chunk + 1) * chunk_size));
+            std::stable_sort(begin, end, entry_less);
+        });
+
+        // Merge neighbouring runs until one is left, std::merge prefers the left run on ties so the sort stays stable
+        auto buffer = std::vector<Entry>(size);
+        for (auto width = chunk_size; width < size; width *= 2) {
+            run((size + 2 * width - 1) / (2 * width), [&](std::size_t pair) {
+                const auto begin = pair * 2 * width;
+                const auto middle = std::min(size, begin + width);
+                const auto end = std::min(size, begin + 2 * width);
+                const auto at = [](auto &runs, std::size_t offset) {
+                    return runs.begin() + static_cast<std::ptrdiff_t>(offset);
+                };
+                std::merge(at(entries, begin), at(entries, middle), at(entries, middle), at(entries, end),
+                           at(buffer, begin), entry_less);
+            });
+            entries.swap(buffer);
+        }
+    }
+
+    auto positions = std::vector<std::size_t>{};
+    positions.reserve(entries.size());
+    for (const auto &entry : entries) {
+        positions.push_back(entry.position);
+    }
+    return positions;
+}
+
+auto group_positions(std::span<const SortKey> keys) -> std::vector<Group> {
+    auto groups = std::vector<Group>{};
+    auto group_of = std::unordered_map<SortKey, std::size_t>{};
+
+    for (auto position = std::size_t{0}; position < keys.size(); position++) {
+        const auto [it, inserted] = group_of.try_emplace(keys[position], groups.size());
+        if (inserted) {
+            groups.push_back(Group{.key = keys[position], .positions = {}});
+        }
+        groups[it->second].positions.push_back(position);
+    }
+
+    return groups;
+}
+
+auto unique_positions(std::span<const jp::JSONValue> values) -> std::vector<std::size_t> {
+    const auto hash = [](const jp::JSONValue *value) { return deep_hash(*value); };
+    const auto equal = [](const jp::JSONValue *lhs, const jp::JSONValue *rhs) { return deep_equal(*lhs, *rhs); };
+    auto seen = std::unordered_set<const jp::JSONValue *, decltype(hash), decltype(equal)>(values.size(), hash, equal);
+
+    auto positions = std::vector<std::size_t>{};
+    for (auto position = std::size_t{0}; position < values.size(); position++) {
+        if (seen.insert(&values[position]).second) {
+            positions.push_back(position);
+        }
+    }
+    return positions;
+}
+
+} // namespace query::order
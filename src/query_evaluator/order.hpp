@@ -0,0 +1,42 @@
+#pragma once
+
+#include "jsonobject.hpp"
+#include "thread_pool.hpp"
+#include <compare>
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+// Kernels behind sort_by(), group_by() and unique(). They work on keys extracted from the elements and return
+// positions into the original array, so no JSONValue is moved or copied until the caller builds the result.
+namespace query::order {
+
+// Non-owning key of an element. Integral doubles are stored as integers so that `1` and `1.0` are the same key.
+// Missing keys, objects and arrays are represented by std::monostate, like null.
+using SortKey = std::variant<std::monostate, bool, jp::JSONInteger, jp::JSONDouble, std::string_view>;
+
+// `value` may be nullptr for a missing key
+auto make_sort_key(const jp::JSONValue *value) -> SortKey;
+
+// Total order over keys: null < booleans < numbers < strings
+auto compare(const SortKey &lhs, const SortKey &rhs) -> std::weak_ordering;
+
+// Positions of the keys in stable ascending order. Inputs longer than `threshold` are sorted in chunks on `pool` and
+// merged pairwise, the chunking doesn't depend on the pool so neither does the result.
+auto sort_permutation(std::span<const SortKey> keys, jp::ThreadPool *pool,
+                      std::size_t threshold) -> std::vector<std::size_t>;
+
+struct Group {
+    SortKey key;
+    std::vector<std::size_t> positions;
+};
+
+// Groups in the order their keys first appear, positions within a group are ascending
+auto group_positions(std::span<const SortKey> keys) -> std::vector<Group>;
+
+// Position of the first occurrence of every distinct value. Objects and arrays compare structurally.
+auto unique_positions(std::span<const jp::JSONValue> values) -> std::vector<std::size_t>;
+
+} // namespace query::order
@@ -0,0 +1,402 @@
+#include "pipeline.hpp"
+#include "arithmetic.hpp"
+#include "index.hpp"
+#include "order.hpp"
+#include "query_evaluator.hpp"
+
+namespace query {
+
+namespace {
+
+enum class Comparison { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+auto make_comparison(const TokenType &token) -> std::optional<Comparison> {
+    return std::visit(overloaded{[](const EqualEqual &) { return std::optional{Comparison::Equal}; },
+                                 [](const BangEqual &) { return std::optional{Comparison::NotEqual}; },
+                                 [](const Less &) { return std::optional{Comparison::Less}; },
+                                 [](const LessEqual &) { return std::optional{Comparison::LessEqual}; },
+                                 [](const Greater &) { return std::optional{Comparison::Greater}; },
+                                 [](const GreaterEqual &) { return std::optional{Comparison::GreaterEqual}; },
+                                 [](const auto &) { return std::optional<Comparison>{}; }},
+                      token);
+}
+
+// Filter condition with its value evaluated once up front
+struct Condition {
+    Comparison comparison;
+    jp::JSONValue expected;
+    IndexKey key;
+
+    // Ordering only holds between values of the same kind, numbers compare with numbers and strings with strings
+    [[nodiscard]] auto matches(const jp::JSONValue &value) const -> bool {
+        if (comparison == Comparison::Equal) {
+            return make_index_key(value) == key;
+        }
+        if (comparison == Comparison::NotEqual) {
+            return make_index_key(value) != key;
+        }
+
+        const auto kind = [](const order::SortKey &sort_key) {
+            return std::holds_alternative<jp::JSONDouble>(sort_key) ? std::size_t{2} : sort_key.index();
+        };
+        const auto lhs = order::make_sort_key(&value);
+        const auto rhs = order::make_sort_key(&expected);
+        if (kind(lhs) != kind(rhs) || std::holds_alternative<std::monostate>(lhs)) {
+            return false;
+        }
+
+        const auto order = order::compare(lhs, rhs);
+        switch (comparison) {
+        case Comparison::Less:
+            return order < 0;
+        case Comparison::LessEqual:
+            return order <= 0;
+        case Comparison::Greater:
+            return order > 0;
+        default:
+            return order >= 0;
+        }
+    }
+};
+
+auto has_wildcard(const Path &path) -> bool {
+    for (const auto *segment = &path; segment != nullptr; segment = segment->next ? segment->next->get() : nullptr) {
+        if (segment->subscript && std::holds_alternative<Wildcard>(*segment->subscript)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto has_filter(const Path &path) -> bool {
+    for (const auto *segment = &path; segment != nullptr; segment = segment->next ? segment->next->get() : nullptr) {
+        if (segment->subscript && std::holds_alternative<std::unique_ptr<Filter>>(*segment->subscript)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+auto each(const jp::JSONArray &array) -> Elements {
+    for (const auto &element : array) {
+        co_yield element;
+    }
+}
+
+// Keeps an array that was evaluated up front alive for as long as it is iterated
+auto each_owned(jp::JSONValue array) -> Elements {
+    for (const auto &element : array.as_array()) {
+        co_yield element;
+    }
+}
+
+auto select(const Evaluator &evaluator, const jp::JSONArray &array, const Path &field,
+            Condition condition) -> Elements {
+    for (const auto &element : array) {
+        if (!element.is_object()) {
+            continue;
+        }
+
+        // Elements without the field simply don't match
+        const auto value = evaluator.resolve_path(&element.as_object(), field);
+        if (value.has_value() && condition.matches(*value.value())) {
+            co_yield element;
+        }
+    }
+}
+
+auto select_positions(const jp::JSONArray &array, std::vector<std::size_t> positions) -> Elements {
+    for (const auto position : positions) {
+        co_yield array[position];
+    }
+}
+
+auto apply(arithmetic::Op op, const jp::JSONValue &lhs,
+           const jp::JSONValue &rhs) -> jp::expected<jp::JSONValue, Error> {
+    if (!lhs.is_numeric() || !rhs.is_numeric()) {
+        return Error{ErrorCode::ElementsNotNumbers};
+    }
+
+    return std::visit(
+        [op](const auto &l, const auto &r) -> jp::expected<jp::JSONValue, Error> {
+            using L = std::decay_t<decltype(l)>;
+            using R = std::decay_t<decltype(r)>;
+            constexpr auto is_number = [](auto tag) {
+                using T = typename decltype(tag)::type;
+                return std::is_same_v<T, jp::JSONInteger> || std::is_same_v<T, jp::JSONDouble>;
+            };
+
+            if constexpr (is_number(std::type_identity<L>{}) && is_number(std::type_identity<R>{})) {
+                switch (op) {
+                case arithmetic::Op::Add:
+                    return arithmetic::apply<arithmetic::Op::Add>(l, r);
+                case arithmetic::Op::Subtract:
+                    return arithmetic::apply<arithmetic::Op::Subtract>(l, r);
+                case arithmetic::Op::Multiply:
+                    return arithmetic::apply<arithmetic::Op::Multiply>(l, r);
+                case arithmetic::Op::Divide:
+                    return arithmetic::apply<arithmetic::Op::Divide>(l, r);
+                }
+            }
+            return Error{ErrorCode::UnsupportedBinaryOperation};
+        },
+        lhs.value, rhs.value);
+}
+
+auto repeat(const jp::JSONValue &value) -> Elements {
+    while (true) {
+        co_yield value;
+    }
+}
+
+// One side of an element-wise operation: a sequence, or a scalar broadcast to every element of the other side
+using Side = std::variant<Elements, jp::JSONValue>;
+
+auto combine(arithmetic::Op op, Side lhs, Side rhs, std::optional<Error> *error) -> Elements {
+    const auto lhs_scalar = std::holds_alternative<jp::JSONValue>(lhs);
+    const auto rhs_scalar = std::holds_alternative<jp::JSONValue>(rhs);
+
+    // Scalar sides keep yielding the same value
+    const auto values = [](Side &side) -> Elements {
+        if (auto *elements = std::get_if<Elements>(&side)) {
+            return std::move(*elements);
+        }
+        return repeat(std::get<jp::JSONValue>(side));
+    };
+    auto lhs_values = values(lhs);
+    auto rhs_values = values(rhs);
+
+    auto l = lhs_values.begin();
+    auto r = rhs_values.begin();
+    for (; l != lhs_values.end() && r != rhs_values.end(); ++l, ++r) {
+        auto result = apply(op, *l, *r);
+        if (result.has_error()) {
+            *error = result.consume_error();
+            co_return;
+        }
+        co_yield result.consume_value();
+    }
+
+    // Only sequences run out, one that didn't means the arrays had different lengths
+    if ((!lhs_scalar && l != lhs_values.end()) || (!rhs_scalar && r != rhs_values.end())) {
+        *error = Error{ErrorCode::BroadcastLengthMismatch};
+    }
+}
+
+auto negate(Elements values, std::optional<Error> *error) -> Elements {
+    for (const auto &value : values) {
+        if (value.is_integer()) {
+            co_yield arithmetic::negate(value.as_integer());
+        } else if (value.is_double()) {
+            co_yield arithmetic::negate(value.as_double());
+        } else {
+            *error = Error{ErrorCode::ElementsNotNumbers};
+            co_return;
+        }
+    }
+}
+
+} // namespace
+
+auto is_pipeline(const Value &value) -> bool {
+    return std::visit(
+        overloaded{[](const std::unique_ptr<Path> &path) { return has_wildcard(*path) || has_filter(*path); },
+                   [](const std::unique_ptr<Binary> &binary) {
+                       return is_pipeline(binary->lhs) || is_pipeline(binary->rhs);
+                   },
+                   [](const std::unique_ptr<Unary> &unary) { return is_pipeline(unary->value); },
+                   [](const auto &) { return false; }},
+        value);
+}
+
+auto Evaluator::stream(const query::Value &value) const -> jp::expected<Sequence, Error> {
+    auto error = std::make_unique<std::optional<Error>>();
+    auto elements = stream_value(value, error.get());
+    if (elements.has_error()) {
+        return elements.error();
+    }
+    return Sequence{.error = std::move(error), .elements = elements.consume_value()};
+}
+
+auto Evaluator::stream_value(const query::Value &value,
+                             std::optional<Error> *error) const -> jp::expected<Elements, Error> {
+    // Paths are resolved by pointer, even plain arrays are iterated in place instead of being copied
+    if (const auto *path = std::get_if<std::unique_ptr<Path>>(&value)) {
+        if (!input_json->is_object()) {
+            return Error{ErrorCode::InputNotAnObject};
+        }
+        return stream_path(&input_json->as_object(), **path);
+    }
+
+    if (const auto *binary = std::get_if<std::unique_ptr<Binary>>(&value); binary != nullptr && is_pipeline(value)) {
+        const auto op = arithmetic::from_token((*binary)->op.token_type);
+        if (!op) {
+            return Error{ErrorCode::UnsupportedBinaryOperator, to_string((*binary)->op.token_type)};
+        }
+
+        // Arrays on either side are iterated in step, scalars are evaluated once
+        const auto side = [&](const Value &operand) -> jp::expected<Side, Error> {
+            if (!is_pipeline(operand)) {
+                auto evaluated = evaluate_value(operand);
+                if (evaluated.has_error()) {
+                    return evaluated.error();
+                }
+                if (!evaluated->is_array()) {
+                    return Side{evaluated.consume_value()};
+                }
+                return Side{each_owned(evaluated.consume_value())};
+            }
+
+            auto elements = stream_value(operand, error);
+            if (elements.has_error()) {
+                return elements.error();
+            }
+            return Side{elements.consume_value()};
+        };
+
+        auto lhs = side((*binary)->lhs);
+        if (lhs.has_error()) {
+            return lhs.error();
+        }
+        auto rhs = side((*binary)->rhs);
+        if (rhs.has_error()) {
+            return rhs.error();
+        }
+        return combine(*op, lhs.consume_value(), rhs.consume_value(), error);
+    }
+
+    if (const auto *unary = std::get_if<std::unique_ptr<Unary>>(&value); unary != nullptr && is_pipeline(value)) {
+        if (!std::holds_alternative<Minus>((*unary)->op.token_type)) {
+            return Error{ErrorCode::UnsupportedUnaryOperator, to_string((*unary)->op.token_type)};
+        }
+
+        auto elements = stream_value((*unary)->value, error);
+        if (elements.has_error()) {
+            return elements.error();
+        }
+        return negate(elements.consume_value(), error);
+    }
+
+    auto evaluated = evaluate_value(value);
+    if (evaluated.has_error()) {
+        return evaluated.error();
+    }
+    if (!evaluated->is_array()) {
+        return Error{ErrorCode::ExpectedArray, evaluated->type_name()};
+    }
+    return each_owned(evaluated.consume_value());
+}
+
+auto Evaluator::stream_path(const jp::JSONObject *object,
+                            const query::Path &path) const -> jp::expected<Elements, Error> {
+    const auto *segment = &path;
+
+    // The path is resolved by pointer up to the first filter or projection, which then produces the elements
+    while (true) {
+        auto member = lookup_member(object, *segment);
+        if (member.has_error()) {
+            return member.error();
+        }
+
+        const auto *evaluated = member.value();
+
+        if (segment->subscript) {
+            const auto &array = evaluated->as_array();
+
+            if (const auto *filter = std::get_if<std::unique_ptr<Filter>>(&*segment->subscript)) {
+                if (segment->next) {
+                    return Error{ErrorCode::FilteredMemberAccess, segment->id.identifier.c_str()};
+                }
+                return filter_lazily(array, **filter);
+            }
+
+            if (std::holds_alternative<Wildcard>(*segment->subscript)) {
+                return segment->next ? project_lazily(array, **segment->next) : each(array);
+            }
+
+            auto element = evaluate_subscript(array, *segment);
+            if (element.has_error()) {
+                return element.error();
+            }
+
+            evaluated = element.value();
+        }
+
+        if (!segment->next) {
+            if (!evaluated->is_array()) {
+                return Error{ErrorCode::KeyNotAnArray, segment->id.identifier.c_str()};
+            }
+            return each(evaluated->as_array());
+        }
+
+        if (!evaluated->is_object()) {
+            return Error{ErrorCode::KeyNotAnObject, segment->id.identifier.c_str()};
+        }
+
+        object = &evaluated->as_object();
+        segment = segment->next->get();
+    }
+}
+
+auto Evaluator::project_lazily(const jp::JSONArray &array, const query::Path &rest) const -> Elements {
+    // Projections nested further down the path are flattened into this one
+    const auto nested = has_wildcard(rest);
+    const auto filtered = has_filter(rest);
+
+    for (const auto &element : array) {
+        if (!element.is_object()) {
+            continue;
+        }
+
+        // Elements the rest of the path doesn't resolve on are skipped
+        if (nested) {
+            auto elements = stream_path(&element.as_object(), rest);
+            if (elements.has_value()) {
+                for (const auto &projected : elements.value()) {
+                    co_yield projected;
+                }
+            }
+        } else if (filtered) {
+            auto value = evaluate_path(&element.as_object(), rest);
+            if (value.has_value()) {
+                co_yield value.consume_value();
+            }
+        } else {
+            const auto value = resolve_path(&element.as_object(), rest);
+            if (value.has_value()) {
+                co_yield *value.value();
+            }
+        }
+    }
+}
+
+auto Evaluator::filter_lazily(const jp::JSONArray &array,
+                              const query::Filter &filter) const -> jp::expected<Elements, Error> {
+    const auto comparison = make_comparison(filter.op.token_type);
+    if (!comparison) {
+        return Error{ErrorCode::UnsupportedComparison, to_string(filter.op.token_type)};
+    }
+
+    auto expected = evaluate_value(filter.value);
+    if (expected.has_error()) {
+        return expected.error();
+    }
+
+    auto key = make_index_key(expected.value());
+    if (!key) {
+        return Error{ErrorCode::UncomparableValue, expected->type_name()};
+    }
+
+    // Equality on a plain member lookup can be answered from an index if one was created for this array
+    const auto &field = *filter.field;
+    if (*comparison == Comparison::Equal && indexes != nullptr && !field.subscript && !field.next) {
+        if (const auto *index = indexes->find(array, field.id.identifier)) {
+            return select_positions(array, index->find(*key));
+        }
+    }
+
+    return select(*this, array, field,
+                  Condition{.comparison = *comparison, .expected = expected.consume_value(), .key = std::move(*key)});
+}
+
+} // namespace query
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "error.hpp"
+#include "generator.hpp"
+#include "jsonobject.hpp"
+#include "query.hpp"
+#include <memory>
+#include <optional>
+
+// Lazy evaluation of arrays. Paths with filters or projections, and element-wise arithmetic on them, become a chain of
+// generators that hands elements to the consumer one at a time. Aggregates fold the elements as they arrive and
+// first() destroys the chain after one element, so none of the intermediate arrays is ever built.
+namespace query {
+
+using Elements = jp::Generator<const jp::JSONValue &>;
+
+// Elements refer into the document where possible, computed ones are only valid until the sequence advances.
+// Stages can't return errors from inside a coroutine, they store the first one in `error` and end the sequence.
+struct Sequence {
+    std::unique_ptr<std::optional<Error>> error;
+    Elements elements;
+};
+
+// True for values that evaluate to an array through a filter or a projection, or element-wise arithmetic on one
+auto is_pipeline(const Value &value) -> bool;
+
+} // namespace query
@@ -1,54 +1,279 @@
 #include "query_evaluator.hpp"
+#include "arithmetic.hpp"
+#include "broadcast.hpp"
+#include "memory.hpp"
+#include "trace.hpp"
 #include <span>
 
 namespace query {
 
-auto Evaluator::evaluate_path(const jp::JSONObject *object,
-                              const query::Path &path) -> jp::expected<jp::JSONValue, Error> {
+namespace {
+
+auto to_operand(const jp::JSONValue &value) -> jp::expected<broadcast::Operand, Error> {
+    auto operand = broadcast::make_operand(value);
+    if (!operand) {
+        if (value.is_array()) {
+            return Error{ErrorCode::ElementsNotNumbers};
+        }
+        return Error{ErrorCode::UnsupportedArithmetic, value.type_name()};
+    }
+    return std::move(*operand);
+}
+
+// Binary operation where at least one side is an array, operands that are themselves results of arithmetic have
+// already been materialized by the time they get here
+auto broadcast_binary(const TokenType &token, const jp::JSONValue &lhs,
+                      const jp::JSONValue &rhs) -> jp::expected<jp::JSONValue, Error> {
+    const auto op = arithmetic::from_token(token);
+    if (!op) {
+        return Error{ErrorCode::UnsupportedBinaryOperator, to_string(token)};
+    }
+
+    auto left = to_operand(lhs);
+    if (left.has_error()) {
+        return left.error();
+    }
+
+    auto right = to_operand(rhs);
+    if (right.has_error()) {
+        return right.error();
+    }
+
+    auto result = broadcast::apply(*op, left.consume_value(), right.consume_value());
+    if (result.has_error()) {
+        return result.error();
+    }
+    return broadcast::to_value(result.consume_value());
+}
+
+} // namespace
+
+auto Evaluator::lookup_member(const jp::JSONObject *object,
+                              const query::Path &path) const -> jp::expected<const jp::JSONValue *, Error> {
     const auto &id = path.id.identifier;
 
     const auto value = object->find(id);
 
     if (value == object->end()) {
-        return Error{"Evaluator", std::format("Key '{}' not found", id), 1, 0};
+        return Error{ErrorCode::KeyNotFound, id.c_str()};
     }
 
-    auto evaluated = value->second;
+    if (path.subscript && !value->second.is_array()) {
+        return Error{ErrorCode::KeyNotIndexable, id.c_str()};
+    }
 
-    if (path.subscript) {
-        if (!value->second.is_array()) {
-            return Error{"Evaluator", std::format("Attempt to index into key '{}' which is not an array", id), 1, 0};
+    return &value->second;
+}
+
+auto Evaluator::evaluate_subscript(const jp::JSONArray &array,
+                                   const query::Path &path) const -> jp::expected<const jp::JSONValue *, Error> {
+    const auto subscript = evaluate_value(*path.subscript);
+
+    if (subscript.has_error()) {
+        return subscript.error();
+    }
+
+    if (!subscript->is_integer()) {
+        return Error{ErrorCode::IndexNotAnInteger, subscript->type_name(), path.id.identifier.c_str(),
+                     to_string(subscript.value())};
+    }
+
+    const auto index = subscript->as_integer();
+    if (index < 0 || static_cast<std::size_t>(index) >= array.size()) {
+        return Error{ErrorCode::IndexOutOfBounds, index, path.id.identifier.c_str(), array.size()};
+    }
+
+    return &array[static_cast<std::size_t>(index)];
+}
+
+auto Evaluator::evaluate_path(const jp::JSONObject *object,
+                              const query::Path &path) const -> jp::expected<jp::JSONValue, Error> {
+    auto span = jp::trace::Span{"path", "evaluator"};
+    const auto *segment = &path;
+
+    // Walk the document by pointer and copy only the value the path ends on
+    while (true) {
+        auto member = lookup_member(object, *segment);
+        if (member.has_error()) {
+            return member.error();
         }
 
-        const auto &array = std::get<jp::JSONArray>(value->second.value);
+        const auto *evaluated = member.value();
+
+        if (segment->subscript) {
+            const auto &array = evaluated->as_array();
+
+            if (std::holds_alternative<std::unique_ptr<Filter>>(*segment->subscript)) {
+                if (segment->next) {
+                    return Error{ErrorCode::FilteredMemberAccess, segment->id.identifier.c_str()};
+                }
+
+                return evaluate_filter(array, *std::get<std::unique_ptr<Filter>>(*segment->subscript));
+            }
 
-        const auto subscript = evaluate_value(*path.subscript);
+            if (std::holds_alternative<Wildcard>(*segment->subscript)) {
+                return segment->next ? project(array, **segment->next) : *evaluated;
+            }
 
-        if (!std::holds_alternative<jp::JSONInteger>(subscript->value)) {
-            return Error{"Evaluator",
-                         std::format("Index must be an integer, instead found {}: {}[{}]", subscript->type_str(),
-                                     value->first, to_string(subscript.value())),
-                         1, 0};
+            auto element = evaluate_subscript(array, *segment);
+            if (element.has_error()) {
+                return element.error();
+            }
+
+            evaluated = element.value();
+        }
+
+        if (!segment->next) {
+            return *evaluated;
+        }
+
+        if (!evaluated->is_object()) {
+            return Error{ErrorCode::KeyNotAnObject, segment->id.identifier.c_str()};
         }
 
-        evaluated = array[subscript->as_integer()];
+        object = &evaluated->as_object();
+        segment = segment->next->get();
     }
+}
+
+auto Evaluator::project(const jp::JSONArray &array,
+                        const query::Path &rest) const -> jp::expected<jp::JSONValue, Error> {
+    // Projections nested further down the path are flattened into this one
+    auto nested = false;
+    for (const auto *segment = &rest; segment != nullptr; segment = segment->next ? segment->next->get() : nullptr) {
+        nested = nested || (segment->subscript && std::holds_alternative<Wildcard>(*segment->subscript));
+    }
+
+    auto results = jp::JSONArray{};
+    results.reserve(array.size());
 
-    if (path.next) {
-        if (!evaluated.is_object()) {
-            return Error{"Evaluator", std::format("Key '{}' is not an object", id), 1, 0};
+    for (const auto &element : array) {
+        if (!element.is_object()) {
+            continue;
         }
 
-        return evaluate_path(&std::get<jp::JSONObject>(evaluated.value), **path.next);
+        // Elements the rest of the path doesn't resolve on are skipped
+        auto value = evaluate_path(&element.as_object(), rest);
+        if (value.has_error()) {
+            continue;
+        }
+
+        if (nested && value->is_array()) {
+            for (const auto &projected : value->as_array()) {
+                results.push_back(projected);
+            }
+        } else {
+            results.push_back(value.consume_value());
+        }
     }
 
-    return evaluated;
+    return jp::JSONValue{results};
 }
 
-auto Evaluator::evaluate_value(const query::Value &value) -> jp::expected<jp::JSONValue, Error> {
+auto Evaluator::resolve_path(const jp::JSONObject *object,
+                             const query::Path &path) const -> jp::expected<const jp::JSONValue *, Error> {
+    const auto *segment = &path;
+
+    while (true) {
+        auto member = lookup_member(object, *segment);
+        if (member.has_error()) {
+            return member.error();
+        }
+
+        const auto *evaluated = member.value();
+
+        if (segment->subscript) {
+            if (std::holds_alternative<std::unique_ptr<Filter>>(*segment->subscript) ||
+                std::holds_alternative<Wildcard>(*segment->subscript)) {
+                return Error{ErrorCode::SelectorInPath};
+            }
+
+            auto element = evaluate_subscript(evaluated->as_array(), *segment);
+            if (element.has_error()) {
+                return element.error();
+            }
+
+            evaluated = element.value();
+        }
+
+        if (!segment->next) {
+            return evaluated;
+        }
+
+        if (!evaluated->is_object()) {
+            return Error{ErrorCode::KeyNotAnObject, segment->id.identifier.c_str()};
+        }
+
+        object = &evaluated->as_object();
+        segment = segment->next->get();
+    }
+}
+
+auto Evaluator::resolve_array(const query::Path &path) const -> jp::expected<const jp::JSONArray *, Error> {
+    if (!input_json->is_object()) {
+        return Error{ErrorCode::InputNotAnObject};
+    }
+
+    auto resolved = resolve_path(&input_json->as_object(), path);
+    if (resolved.has_error()) {
+        return resolved.error();
+    }
+
+    if (!resolved.value()->is_array()) {
+        auto last = &path;
+        while (last->next) {
+            last = last->next->get();
+        }
+        return Error{ErrorCode::KeyNotAnArray, last->id.identifier.c_str()};
+    }
+    return &resolved.value()->as_array();
+}
+
+auto Evaluator::evaluate_filter(const jp::JSONArray &array,
+                                const query::Filter &filter) const -> jp::expected<jp::JSONValue, Error> {
+    auto elements = filter_lazily(array, filter);
+    if (elements.has_error()) {
+        return elements.error();
+    }
+
+    auto matches = jp::JSONArray{};
+    for (const auto &element : elements.value()) {
+        matches.push_back(element);
+    }
+    return jp::JSONValue{matches};
+}
+
+auto Evaluator::create_index(const query::Path &array_path, const std::string &field) -> jp::expected<bool, Error> {
+    if (indexes == nullptr) {
+        return Error{ErrorCode::NoIndexCache};
+    }
+
+    auto array = resolve_array(array_path);
+    if (array.has_error()) {
+        return array.error();
+    }
+
+    indexes->create(*array.value(), field);
+    return true;
+}
+
+auto Evaluator::evaluate_value(const query::Value &value) const -> jp::expected<jp::JSONValue, Error> {
     return std::visit(
         overloaded{
             [&](const std::unique_ptr<Path> &path) -> jp::expected<jp::JSONValue, Error> {
+                if (path_cache != nullptr) {
+                    const auto cached = path_cache->find(path.get());
+                    if (cached != path_cache->end()) {
+                        const auto &[prefix, rest] = cached->second;
+                        if (rest == nullptr) {
+                            return *prefix;
+                        }
+                        if (prefix->is_object()) {
+                            return evaluate_path(&prefix->as_object(), *rest);
+                        }
+                    }
+                }
+
                 return evaluate_path(&input_json->as_object(), *path);
             },
             [&](const Integer &integer) -> jp::expected<jp::JSONValue, Error> { return jp::JSONValue{integer.value}; },
@@ -61,13 +286,54 @@ auto Evaluator::evaluate_value(const query::Value &value) -> jp::expected<jp::JS
             },
             [&](const std::unique_ptr<Unary> &unary) -> jp::expected<jp::JSONValue, Error> {
                 return evaluate_unary(*unary);
+            },
+            [&](const std::unique_ptr<Filter> &) -> jp::expected<jp::JSONValue, Error> {
+                return Error{ErrorCode::FilterOutsideSubscript};
+            },
+            [&](const Wildcard &) -> jp::expected<jp::JSONValue, Error> {
+                return Error{ErrorCode::WildcardOutsideSubscript};
             }},
         value);
 }
 
-void Evaluator::register_function(const std::string &name, func function) { functions[name] = std::move(function); }
+void Evaluator::register_function(const std::string &name, func function) {
+    auto registry = std::make_shared<FunctionRegistry>(*functions);
+    registry->add(name, std::move(function));
+    functions = std::move(registry);
+}
+
+void Evaluator::bind(query::Expression &expression) const {
+    std::visit(overloaded{[&](std::unique_ptr<Path> &path) {
+                              for (auto *segment = path.get(); segment != nullptr;
+                                   segment = segment->next ? segment->next->get() : nullptr) {
+                                  if (segment->subscript) {
+                                      bind(*segment->subscript);
+                                  }
+                              }
+                          },
+                          [&](std::unique_ptr<Function> &function) {
+                              function->id = functions->find(function->name.identifier).value_or(Function::unbound);
+                              function->registry = functions.get();
+                              for (auto &argument : function->arguments) {
+                                  bind(argument);
+                              }
+                          },
+                          [&](std::unique_ptr<Binary> &binary) {
+                              bind(binary->lhs);
+                              bind(binary->rhs);
+                          },
+                          [&](std::unique_ptr<Unary> &unary) { bind(unary->value); },
+                          [&](std::unique_ptr<Filter> &filter) { bind(filter->value); },
+                          [](auto &) {}},
+               expression);
+}
+
+void Evaluator::set_thread_count(std::size_t count) {
+    // 0 lets the pool pick one thread per core
+    thread_pool = count == 1 ? nullptr : std::make_shared<jp::ThreadPool>(count);
+}
 
-auto Evaluator::evaluate_expression(const query::Expression &expression) -> jp::expected<jp::JSONValue, Error> {
+auto Evaluator::evaluate_expression(const query::Expression &expression) const -> jp::expected<jp::JSONValue, Error> {
     // The input JSON is not an object, so we can't evaluate the expression
     if (!input_json->is_object()) {
         return *input_json;
@@ -75,20 +341,82 @@ auto Evaluator::evaluate_expression(const query::Expression &expression) -> jp::
 
     const auto &object = std::get<jp::JSONObject>(input_json->value);
 
+    auto scope = jp::memory::Scope{jp::memory::Category::Evaluator};
     return evaluate_value(expression);
 }
 
-auto Evaluator::evaluate_function_call(const query::Function &function) -> jp::expected<jp::JSONValue, Error> {
-    auto func = functions.find(function.name.identifier);
+auto Evaluator::evaluate_function_call(const query::Function &function) const -> jp::expected<jp::JSONValue, Error> {
+    auto span = jp::trace::Span{function.name.identifier, "function"};
+    auto id = function.id;
 
-    if (func == functions.end()) {
-        return Error{"Evaluator", std::format("Function '{}' not found", function.name.identifier), 1, 0};
+    // Queries that weren't bound, or were bound by an evaluator with other functions, pay for the lookup on every call
+    if (id == Function::unbound || function.registry != functions.get()) {
+        const auto found = functions->find(function.name.identifier);
+        if (!found) {
+            return Error{ErrorCode::FunctionNotFound, function.name.identifier.c_str()};
+        }
+        id = *found;
     }
 
-    return func->second(this, function.arguments);
+    return functions->call(id, *this, function.arguments);
 }
 
-auto Evaluator::evaluate_binary(const query::Binary &binary) -> jp::expected<jp::JSONValue, Error> {
+auto Evaluator::evaluate_operand(const query::Value &value) const -> jp::expected<broadcast::Operand, Error> {
+    // Nested operations hand their packed results on directly instead of materializing them as JSON arrays
+    if (const auto *binary = std::get_if<std::unique_ptr<Binary>>(&value)) {
+        return evaluate_operation(**binary);
+    }
+    if (const auto *unary = std::get_if<std::unique_ptr<Unary>>(&value)) {
+        return evaluate_negation(**unary);
+    }
+    if (const auto *integer = std::get_if<Integer>(&value)) {
+        return broadcast::Operand{integer->value};
+    }
+    if (const auto *double_ = std::get_if<Double>(&value)) {
+        return broadcast::Operand{double_->value};
+    }
+
+    const auto evaluated = evaluate_value(value);
+    if (evaluated.has_error()) {
+        return evaluated.error();
+    }
+    return to_operand(evaluated.value());
+}
+
+auto Evaluator::evaluate_operation(const query::Binary &binary) const -> jp::expected<broadcast::Operand, Error> {
+    const auto op = arithmetic::from_token(binary.op.token_type);
+    if (!op) {
+        return Error{ErrorCode::UnsupportedBinaryOperator, to_string(binary.op.token_type)};
+    }
+
+    auto lhs = evaluate_operand(binary.lhs);
+    if (lhs.has_error()) {
+        return lhs.error();
+    }
+
+    auto rhs = evaluate_operand(binary.rhs);
+    if (rhs.has_error()) {
+        return rhs.error();
+    }
+
+    return broadcast::apply(*op, lhs.consume_value(), rhs.consume_value());
+}
+
+auto Evaluator::evaluate_negation(const query::Unary &unary) const -> jp::expected<broadcast::Operand, Error> {
+    if (!std::holds_alternative<Minus>(unary.op.token_type)) {
+        return Error{ErrorCode::UnsupportedUnaryOperator, to_string(unary.op.token_type)};
+    }
+
+    auto operand = evaluate_operand(unary.value);
+    if (operand.has_error()) {
+        return operand.error();
+    }
+
+    return broadcast::negate(operand.consume_value());
+}
+
+auto Evaluator::evaluate_binary(const query::Binary &binary) const -> jp::expected<jp::JSONValue, Error> {
+    auto span = jp::trace::Span{"binary", "evaluator"};
     auto lhs = evaluate_value(binary.lhs);
     if (lhs.has_error()) {
         return lhs;
@@ -99,54 +427,78 @@ auto Evaluator::evaluate_binary(const query::Binary &binary) -> jp::expected<jp:
         return rhs;
     }
 
+    // Scalars are by far the most common operands and take the direct route below
+    if (lhs->is_array() || rhs->is_array()) {
+        return broadcast_binary(binary.op.token_type, lhs.value(), rhs.value());
+    }
+
     if (!lhs->is_numeric() || !rhs->is_numeric()) {
-        return Error{"Evaluator",
-                     std::format("Unsupported binary operation on types: {} and {}", lhs->type_str(), rhs->type_str()),
-                     1, 0};
+        return Error{ErrorCode::UnsupportedOperandTypes, lhs->type_name(), rhs->type_name()};
     }
 
-    auto lhs_num = lhs->to_double();
-    auto rhs_num = rhs->to_double();
+    // Visiting both operands picks the kernel for the (lhs, rhs) type pair through a single jump table
+    const auto apply = [&]<arithmetic::Op op>() -> jp::expected<jp::JSONValue, Error> {
+        return std::visit(
+            [](const auto &l, const auto &r) -> jp::expected<jp::JSONValue, Error> {
+                using L = std::decay_t<decltype(l)>;
+                using R = std::decay_t<decltype(r)>;
+                constexpr auto is_number = [](auto tag) {
+                    using T = typename decltype(tag)::type;
+                    return std::is_same_v<T, jp::JSONInteger> || std::is_same_v<T, jp::JSONDouble>;
+                };
+
+                if constexpr (is_number(std::type_identity<L>{}) && is_number(std::type_identity<R>{})) {
+                    return arithmetic::apply<op>(l, r);
+                } else {
+                    return Error{ErrorCode::UnsupportedBinaryOperation};
+                }
+            },
+            lhs->value, rhs->value);
+    };
 
     return std::visit(
         overloaded{
-            [&](const Plus &) -> jp::expected<jp::JSONValue, Error> { return jp::JSONValue{lhs_num + rhs_num}; },
-            [&](const Minus &) -> jp::expected<jp::JSONValue, Error> { return jp::JSONValue{lhs_num - rhs_num}; },
-            [&](const Star &) -> jp::expected<jp::JSONValue, Error> { return jp::JSONValue{lhs_num * rhs_num}; },
-            [&](const Slash &) -> jp::expected<jp::JSONValue, Error> {
-                if (rhs_num == 0) {
-                    return Error{"Evaluator", "Division by zero", 1, 0};
-                }
-                return jp::JSONValue{lhs_num / rhs_num};
-            },
+            [&](const Plus &) { return apply.template operator()<arithmetic::Op::Add>(); },
+            [&](const Minus &) { return apply.template operator()<arithmetic::Op::Subtract>(); },
+            [&](const Star &) { return apply.template operator()<arithmetic::Op::Multiply>(); },
+            [&](const Slash &) { return apply.template operator()<arithmetic::Op::Divide>(); },
             [&](const auto &token) -> jp::expected<jp::JSONValue, Error> {
-                return Error{"Evaluator", std::format("Unsupported binary operation: {}", to_string(token)), 1, 0};
+                return Error{ErrorCode::UnsupportedBinaryOperator, to_string(token)};
             },
         },
         binary.op.token_type);
-
-    return Error{"Evaluator", std::format("Unsupported binary operation on type: {}", lhs->type_str()), 1, 0};
 }
 
-auto Evaluator::evaluate_unary(const query::Unary &unary) -> jp::expected<jp::JSONValue, Error> {
+auto Evaluator::evaluate_unary(const query::Unary &unary) const -> jp::expected<jp::JSONValue, Error> {
     auto value = evaluate_value(unary.value);
+    if (value.has_error()) {
+        return value;
+    }
 
-    if (!value->is_numeric()) {
-        return Error{"Evaluator", std::format("Unsupported unary operation on type: {}", value->type_str()), 1, 0};
+    if (value->is_array()) {
+        auto operand = to_operand(value.value());
+        if (operand.has_error()) {
+            return operand.error();
+        }
+        return broadcast::to_value(broadcast::negate(operand.consume_value()));
     }
 
-    auto num = value->to_double();
+    if (!value->is_numeric()) {
+        return Error{ErrorCode::UnsupportedOperandType, value->type_name()};
+    }
 
     return std::visit(overloaded{
-                          [&](const Minus &) -> jp::expected<jp::JSONValue, Error> { return jp::JSONValue{-num}; },
+                          [&](const Minus &) -> jp::expected<jp::JSONValue, Error> {
+                              if (value->is_integer()) {
+                                  return arithmetic::negate(value->as_integer());
+                              }
+                              return arithmetic::negate(value->as_double());
+                          },
                           [&](const auto &token) -> jp::expected<jp::JSONValue, Error> {
-                              return Error{"Evaluator",
-                                           std::format("Unsupported unary operation: {}", to_string(token)), 1, 0};
+                              return Error{ErrorCode::UnsupportedUnaryOperator, to_string(token)};
                           },
                       },
                       unary.op.token_type);
-
-    return Error{"Evaluator", std::format("Unsupported unary operation on type: {}", value->type_str()), 1, 0};
 }
 
 } // namespace query
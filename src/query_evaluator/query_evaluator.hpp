@@ -4,25 +4,83 @@
 #include "expected.hpp"
 #include "jsonobject.hpp"
 #include "query.hpp"
+#include "index.hpp"
+#include "batch.hpp"
+#include "thread_pool.hpp"
+#include "intrinsics.hpp"
+#include "broadcast.hpp"
+#include "pipeline.hpp"
+#include "function_registry.hpp"
 #include <functional>
+#include <memory>
 
 namespace query {
 
+// Evaluation doesn't modify the evaluator or the document, so one evaluator can run queries on many threads at
+// once. Everything a call needs besides the document and the shared registry lives on its stack, and the few
+// settings that vary per call, like the path cache of a batch, go on a copy, which only copies pointers.
+// Indexes have to be created before the evaluator is shared.
 class Evaluator {
   public:
-    using func = std::function<jp::expected<jp::JSONValue, Error>(Evaluator *, const std::span<const Expression> &)>;
-    explicit Evaluator(const jp::JSONValue *input_json) : input_json(input_json) {}
-
-    auto evaluate_expression(const query::Expression &expression) -> jp::expected<jp::JSONValue, Error>;
-    auto evaluate_value(const query::Value &value) -> jp::expected<jp::JSONValue, Error>;
-    auto evaluate_function_call(const query::Function &function) -> jp::expected<jp::JSONValue, Error>;
-    auto evaluate_path(const jp::JSONObject *object, const query::Path &path) -> jp::expected<jp::JSONValue, Error>;
-    auto evaluate_binary(const query::Binary &binary) -> jp::expected<jp::JSONValue, Error>;
-    auto evaluate_unary(const query::Unary &unary) -> jp::expected<jp::JSONValue, Error>;
+    using func = FunctionRegistry::Function;
+    explicit Evaluator(const jp::JSONValue *input_json, IndexCache *indexes = nullptr,
+                       std::shared_ptr<const FunctionRegistry> functions = FunctionRegistry::intrinsics())
+        : input_json(input_json), indexes(indexes), functions(std::move(functions)) {}
+
+    auto evaluate_expression(const query::Expression &expression) const -> jp::expected<jp::JSONValue, Error>;
+    auto evaluate_value(const query::Value &value) const -> jp::expected<jp::JSONValue, Error>;
+    auto evaluate_function_call(const query::Function &function) const -> jp::expected<jp::JSONValue, Error>;
+    auto evaluate_path(const jp::JSONObject *object,
+                       const query::Path &path) const -> jp::expected<jp::JSONValue, Error>;
+    auto evaluate_binary(const query::Binary &binary) const -> jp::expected<jp::JSONValue, Error>;
+    // Evaluates an arithmetic operand to a scalar or a packed column, nested operations are fused
+    auto evaluate_operand(const query::Value &value) const -> jp::expected<broadcast::Operand, Error>;
+    auto evaluate_unary(const query::Unary &unary) const -> jp::expected<jp::JSONValue, Error>;
+    auto evaluate_filter(const jp::JSONArray &array,
+                         const query::Filter &filter) const -> jp::expected<jp::JSONValue, Error>;
+    // Evaluates an array lazily, see pipeline.hpp. Values that aren't pipelines are evaluated up front.
+    auto stream(const query::Value &value) const -> jp::expected<Sequence, Error>;
+    // Like evaluate_path, but returns the value in the document instead of a copy. Filters and wildcards, which
+    // produce new arrays, are rejected.
+    auto resolve_path(const jp::JSONObject *object, const query::Path &path) const
+        -> jp::expected<const jp::JSONValue *, Error>;
+    // Registers the function on a copy of the registry, other evaluators sharing it don't see the function
     void register_function(const std::string &name, func function);
+    // Resolves every function call in the expression to an intrinsic or a registered function
+    void bind(query::Expression &expression) const;
+
+    // Builds an index over the array at `array_path` keyed by the member `field` of its elements
+    auto create_index(const query::Path &array_path, const std::string &field) -> jp::expected<bool, Error>;
+    // Runs large reductions on a pool of `count` threads (0 = one per core), 1 keeps them on the calling thread
+    void set_thread_count(std::size_t count);
 
-    std::unordered_map<std::string, func> functions;
     const jp::JSONValue *input_json;
+    IndexCache *indexes;
+    std::shared_ptr<const FunctionRegistry> functions;
+    // Paths resolved ahead of time by a Batch, consulted before walking the document
+    const PathCache *path_cache = nullptr;
+    // Reductions over arrays longer than this are split into chunks and run on the thread pool
+    std::size_t parallel_threshold = std::size_t{1} << 18;
+    std::shared_ptr<jp::ThreadPool> thread_pool;
+
+  private:
+    auto evaluate_operation(const query::Binary &binary) const -> jp::expected<broadcast::Operand, Error>;
+    auto evaluate_negation(const query::Unary &unary) const -> jp::expected<broadcast::Operand, Error>;
+    auto lookup_member(const jp::JSONObject *object, const query::Path &path) const
+        -> jp::expected<const jp::JSONValue *, Error>;
+    auto evaluate_subscript(const jp::JSONArray &array, const query::Path &path) const
+        -> jp::expected<const jp::JSONValue *, Error>;
+    // Evaluates `rest` on every element of the array
+    auto project(const jp::JSONArray &array, const query::Path &rest) const -> jp::expected<jp::JSONValue, Error>;
+    auto stream_value(const query::Value &value,
+                      std::optional<Error> *error) const -> jp::expected<Elements, Error>;
+    auto stream_path(const jp::JSONObject *object,
+                     const query::Path &path) const -> jp::expected<Elements, Error>;
+    auto project_lazily(const jp::JSONArray &array, const query::Path &rest) const -> Elements;
+    // The filter's value is evaluated up front, the matching elements are produced as they are requested
+    auto filter_lazily(const jp::JSONArray &array,
+                       const query::Filter &filter) const -> jp::expected<Elements, Error>;
+    auto resolve_array(const query::Path &path) const -> jp::expected<const jp::JSONArray *, Error>;
 };
 
 } // namespace query
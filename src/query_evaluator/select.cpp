@@ -0,0 +1,117 @@
+#include "select.hpp"
+#include "aggregate.hpp"
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+namespace query::select {
+
+namespace {
+
+auto as_double(const jp::JSONValue &value) -> jp::JSONDouble {
+    return value.is_integer() ? static_cast<jp::JSONDouble>(value.as_integer()) : value.as_double();
+}
+
+// Moves the element at position n of the ascending order into place and returns it
+template <typename T> auto select(std::vector<T> &values, std::size_t n) -> T {
+    const auto position = values.begin() + static_cast<std::ptrdiff_t>(n);
+    std::ranges::nth_element(values, position);
+    return *position;
+}
+
+} // namespace
+
+auto less(const jp::JSONValue &lhs, const jp::JSONValue &rhs) -> bool {
+    if (lhs.is_integer() && rhs.is_integer()) {
+        return lhs.as_integer() < rhs.as_integer();
+    }
+    return as_double(lhs) < as_double(rhs);
+}
+
+auto top_k(std::span<const jp::JSONValue> values, std::size_t k, Order order) -> std::optional<jp::JSONArray> {
+    // The heap's front is the element that drops out first: the largest kept one when selecting the smallest values
+    const auto before = [order](const jp::JSONValue *lhs, const jp::JSONValue *rhs) {
+        return order == Order::Ascending ? less(*lhs, *rhs) : less(*rhs, *lhs);
+    };
+
+    auto heap = std::vector<const jp::JSONValue *>{};
+    heap.reserve(std::min(k, values.size()));
+
+    for (const auto &value : values) {
+        if (!value.is_numeric()) {
+            return std::nullopt;
+        }
+        if (k == 0) {
+            continue;
+        }
+
+        if (heap.size() < k) {
+            heap.push_back(&value);
+            std::ranges::push_heap(heap, before);
+        } else if (before(&value, heap.front())) {
+            std::ranges::pop_heap(heap, before);
+            heap.back() = &value;
+            std::ranges::push_heap(heap, before);
+        }
+    }
+
+    std::ranges::sort_heap(heap, before);
+
+    auto result = jp::JSONArray{};
+    result.reserve(heap.size());
+    for (const auto *value : heap) {
+        result.push_back(*value);
+    }
+    return result;
+}
+
+auto nth(std::span<const jp::JSONValue> values, std::size_t n) -> std::optional<jp::JSONValue> {
+    auto column = aggregate::gather(values);
+
+    switch (column.kind) {
+    case aggregate::ValueKind::NonNumeric:
+        return std::nullopt;
+    case aggregate::ValueKind::Integers:
+        return jp::JSONValue{select(column.integers, n)};
+    case aggregate::ValueKind::Doubles:
+    case aggregate::ValueKind::Mixed:
+        break;
+    }
+    return jp::JSONValue{select(column.doubles, n)};
+}
+
+auto median(std::span<const jp::JSONValue> values) -> std::optional<jp::JSONValue> {
+    auto column = aggregate::gather(values);
+    const auto middle = values.size() / 2;
+    const auto odd = values.size() % 2 == 1;
+
+    // After selecting the upper middle, the lower one is the largest element in front of it
+    const auto middle_pair = [&](auto &numbers) {
+        const auto upper = select(numbers, middle);
+        const auto lower = *std::max_element(numbers.begin(), numbers.begin() + static_cast<std::ptrdiff_t>(middle));
+        return std::pair{static_cast<jp::JSONDouble>(lower), static_cast<jp::JSONDouble>(upper)};
+    };
+
+    switch (column.kind) {
+    case aggregate::ValueKind::NonNumeric:
+        return std::nullopt;
+    case aggregate::ValueKind::Integers:
+        if (odd) {
+            return jp::JSONValue{select(column.integers, middle)};
+        } else {
+            const auto [lower, upper] = middle_pair(column.integers);
+            return jp::JSONValue{lower + (upper - lower) / 2};
+        }
+    case aggregate::ValueKind::Doubles:
+    case aggregate::ValueKind::Mixed:
+        break;
+    }
+
+    if (odd) {
+        return jp::JSONValue{select(column.doubles, middle)};
+    }
+    const auto [lower, upper] = middle_pair(column.doubles);
+    return jp::JSONValue{lower + (upper - lower) / 2};
+}
+
+} // namespace query::select
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "jsonobject.hpp"
+#include <cstddef>
+#include <optional>
+#include <span>
+
+// Selection kernels behind top_k(), bottom_k(), nth() and median(). None of them sorts the whole input: top_k keeps
+// a bounded heap of k elements, nth and median run introselect (std::nth_element) over the gathered numbers. Every
+// kernel returns std::nullopt if one of the values isn't a number.
+namespace query::select {
+
+enum class Order { Ascending, Descending };
+
+// Numbers compare by value regardless of whether they are stored as integers or doubles
+auto less(const jp::JSONValue &lhs, const jp::JSONValue &rhs) -> bool;
+
+// The k smallest (Ascending) or largest (Descending) values in that order, in O(n log k) time and O(k) memory
+auto top_k(std::span<const jp::JSONValue> values, std::size_t k, Order order) -> std::optional<jp::JSONArray>;
+
+// The value at position n of the values in ascending order, n must be less than values.size()
+auto nth(std::span<const jp::JSONValue> values, std::size_t n) -> std::optional<jp::JSONValue>;
+
+// The middle value, or the mean of the two middle values for an even number of values. values must not be empty.
+auto median(std::span<const jp::JSONValue> values) -> std::optional<jp::JSONValue>;
+
+} // namespace query::select
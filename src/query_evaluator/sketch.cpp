@@ -0,0 +1,227 @@
+#include "sketch.hpp"
+#include "index.hpp"
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <numbers>
+
+namespace query::sketch {
+
+void Moments::add(double value) {
+    n++;
+    const auto delta = value - running_mean;
+    running_mean += delta / static_cast<double>(n);
+    m2 += delta * (value - running_mean);
+}
+
+void Moments::merge(const Moments &other) {
+    if (other.n == 0) {
+        return;
+    }
+    if (n == 0) {
+        *this = other;
+        return;
+    }
+
+    const auto count = static_cast<double>(n + other.n);
+    const auto delta = other.running_mean - running_mean;
+    running_mean += delta * static_cast<double>(other.n) / count;
+    m2 += other.m2 + delta * delta * static_cast<double>(n) * static_cast<double>(other.n) / count;
+    n += other.n;
+}
+
+auto Moments::variance() const -> double { return n < 2 ? 0 : m2 / static_cast<double>(n); }
+
+auto Moments::stddev() const -> double { return std::sqrt(variance()); }
+
+namespace {
+
+// k1 scale function and its inverse, a centroid may span at most one unit of k
+auto scale(double q, double compression) -> double {
+    return compression / (2 * std::numbers::pi) * std::asin(2 * q - 1);
+}
+
+auto inverse_scale(double k, double compression) -> double {
+    return (std::sin(k * 2 * std::numbers::pi / compression) + 1) / 2;
+}
+
+} // namespace
+
+TDigest::TDigest(double compression)
+    : compression(std::clamp(compression, min_compression, max_compression)),
+      buffer_limit(static_cast<std::size_t>(this->compression) * 5) {
+    buffer.reserve(buffer_limit);
+}
+
+void TDigest::add(double value, double weight) {
+    if (count() == 0) {
+        min = value;
+        max = value;
+    }
+    min = std::min(min, value);
+    max = std::max(max, value);
+
+    buffer.push_back(Centroid{.mean = value, .weight = weight});
+    buffered_weight += weight;
+
+    if (buffer.size() >= buffer_limit) {
+        compress();
+    }
+}
+
+void TDigest::merge(const TDigest &other) {
+    if (other.count() == 0) {
+        return;
+    }
+    if (count() == 0) {
+        min = other.min;
+        max = other.max;
+    }
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+
+    for (const auto &list : {&other.centroids, &other.buffer}) {
+        for (const auto &centroid : *list) {
+            buffer.push_back(centroid);
+            buffered_weight += centroid.weight;
+        }
+    }
+    compress();
+}
+
+void TDigest::compress() {
+    if (buffer.empty()) {
+        return;
+    }
+
+    buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+    std::ranges::sort(buffer, {}, &Centroid::mean);
+
+    total_weight += buffered_weight;
+    buffered_weight = 0;
+    centroids.clear();
+
+    auto current = buffer.front();
+    auto weight_before = 0.0;
+    auto limit = total_weight * inverse_scale(scale(0, compression) + 1, compression);
+
+    for (auto i = std::size_t{1}; i < buffer.size(); i++) {
+        const auto &next = buffer[i];
+
+        if (weight_before + current.weight + next.weight <= limit) {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+            continue;
+        }
+
+        centroids.push_back(current);
+        weight_before += current.weight;
+        limit = total_weight * inverse_scale(scale(weight_before / total_weight, compression) + 1, compression);
+        current = next;
+    }
+    centroids.push_back(current);
+
+    buffer.clear();
+}
+
+auto TDigest::centroid_count() -> std::size_t {
+    compress();
+    return centroids.size();
+}
+
+auto TDigest::quantile(double q) -> double {
+    compress();
+
+    if (centroids.empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    if (centroids.size() == 1) {
+        return centroids.front().mean;
+    }
+
+    // Every centroid is treated as centered on its mean, the ends interpolate towards the exact min and max
+    const auto target = std::clamp(q, 0.0, 1.0) * total_weight;
+
+    const auto &first = centroids.front();
+    if (target < first.weight / 2) {
+        return min + (first.mean - min) * target / (first.weight / 2);
+    }
+
+    auto weight_before = 0.0;
+    for (auto i = std::size_t{0}; i + 1 < centroids.size(); i++) {
+        const auto &left = centroids[i];
+        const auto &right = centroids[i + 1];
+        const auto left_center = weight_before + left.weight / 2;
+        const auto right_center = weight_before + left.weight + right.weight / 2;
+
+        if (target <= right_center) {
+            return left.mean + (right.mean - left.mean) * (target - left_center) / (right_center - left_center);
+        }
+        weight_before += left.weight;
+    }
+
+    const auto &last = centroids.back();
+    const auto tail = total_weight - last.weight / 2;
+    return last.mean + (max - last.mean) * std::min(1.0, (target - tail) / (last.weight / 2));
+}
+
+HyperLogLog::HyperLogLog(unsigned precision)
+    : bits(std::clamp(precision, min_precision, max_precision)), registers(std::size_t{1} << bits, 0) {}
+
+void HyperLogLog::add(std::uint64_t hash) {
+    const auto index = hash >> (64 - bits);
+    // The guard bit caps the rank at 64 - bits + 1 when the remaining bits are all zero
+    const auto rank = std::countl_zero((hash << bits) | (std::uint64_t{1} << (bits - 1))) + 1;
+    registers[index] = std::max(registers[index], static_cast<std::uint8_t>(rank));
+}
+
+void HyperLogLog::merge(const HyperLogLog &other) {
+    assert(bits == other.bits);
+    for (auto i = std::size_t{0}; i < registers.size(); i++) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+auto HyperLogLog::estimate() const -> double {
+    const auto m = static_cast<double>(registers.size());
+
+    auto harmonic = 0.0;
+    auto zeros = std::size_t{0};
+    for (const auto value : registers) {
+        harmonic += std::ldexp(1.0, -value);
+        zeros += value == 0 ? 1 : 0;
+    }
+
+    const auto alpha = registers.size() == 16 ? 0.673
+                       : registers.size() == 32 ? 0.697
+                       : registers.size() == 64 ? 0.709
+                                                : 0.7213 / (1 + 1.079 / m);
+    const auto raw = alpha * m * m / harmonic;
+
+    // Linear counting is far more accurate while many registers are still empty
+    if (raw <= 2.5 * m && zeros > 0) {
+        return m * std::log(m / static_cast<double>(zeros));
+    }
+    return raw;
+}
+
+auto hash(const jp::JSONValue &value) -> std::optional<std::uint64_t> {
+    const auto key = make_index_key(value);
+    if (!key) {
+        return std::nullopt;
+    }
+
+    // std::hash is the identity for integers, the splitmix64 finalizer spreads them over all 64 bits
+    auto h = static_cast<std::uint64_t>(std::hash<IndexKey>{}(*key));
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebULL;
+    h ^= h >> 31;
+    return h;
+}
+
+} // namespace query::sketch
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "jsonobject.hpp"
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// One-pass summaries behind avg(), stddev(), percentile() and count_distinct(). Every sketch uses memory bounded by its
+// accuracy parameter rather than by the input, and two sketches built over disjoint parts of the input can be merged
+// into the sketch of the whole, which is how the parallel evaluation combines its chunks.
+namespace query::sketch {
+
+// Running count, mean and sum of squared deviations (Welford). Merging uses Chan's pairwise update.
+class Moments {
+  public:
+    void add(double value);
+    void merge(const Moments &other);
+
+    [[nodiscard]] auto count() const -> std::uint64_t { return n; }
+    [[nodiscard]] auto mean() const -> double { return running_mean; }
+    // Population variance, 0 for fewer than two values
+    [[nodiscard]] auto variance() const -> double;
+    [[nodiscard]] auto stddev() const -> double;
+
+  private:
+    std::uint64_t n = 0;
+    double running_mean = 0;
+    double m2 = 0;
+};
+
+// Merging t-digest with the k1 (arcsine) scale function. Values are buffered and merged into at most about
+// compression / 2 centroids, which are small near the tails so extreme quantiles stay accurate.
+class TDigest {
+  public:
+    static constexpr auto default_compression = 100.0;
+    static constexpr auto min_compression = 10.0;
+    static constexpr auto max_compression = 10'000.0;
+
+    explicit TDigest(double compression = default_compression);
+
+    void add(double value, double weight = 1);
+    void merge(const TDigest &other);
+
+    // q in [0, 1], NaN if the digest is empty
+    [[nodiscard]] auto quantile(double q) -> double;
+
+    [[nodiscard]] auto count() const -> double { return total_weight + buffered_weight; }
+    [[nodiscard]] auto centroid_count() -> std::size_t;
+
+  private:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    void compress();
+
+    double compression;
+    std::size_t buffer_limit;
+    std::vector<Centroid> centroids;
+    std::vector<Centroid> buffer;
+    double total_weight = 0;
+    double buffered_weight = 0;
+    double min = 0;
+    double max = 0;
+};
+
+// HyperLogLog over 64 bit hashes with 2^precision one-byte registers. The standard error is about
+// 1.04 / sqrt(2^precision), 0.8% for the default precision of 14.
+class HyperLogLog {
+  public:
+    static constexpr auto default_precision = 14u;
+    static constexpr auto min_precision = 4u;
+    static constexpr auto max_precision = 18u;
+
+    explicit HyperLogLog(unsigned precision = default_precision);
+
+    void add(std::uint64_t hash);
+    // Both sketches must have the same precision
+    void merge(const HyperLogLog &other);
+
+    [[nodiscard]] auto estimate() const -> double;
+    [[nodiscard]] auto precision() const -> unsigned { return bits; }
+
+  private:
+    unsigned bits;
+    std::vector<std::uint8_t> registers;
+};
+
+// 64 bit hash of a scalar JSON value that agrees with equality in filters, so `1` and `1.0` hash the same.
+// Returns std::nullopt for objects and arrays.
+auto hash(const jp::JSONValue &value) -> std::optional<std::uint64_t>;
+
+} // namespace query::sketch
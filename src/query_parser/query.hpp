@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <limits>
 #include <variant>
 #include <memory>
 #include "query_token.hpp"
@@ -10,10 +11,16 @@ namespace query {
 struct Function;
 struct Unary;
 struct Binary;
+struct Filter;
 
 struct Path;
+
+// Array subscript of the form `[*]`. The rest of the path is evaluated on every element and the results are collected
+// into an array.
+struct Wildcard {};
+
 using Value = std::variant<std::unique_ptr<Path>, Integer, Double, std::unique_ptr<Function>, std::unique_ptr<Binary>,
-                           std::unique_ptr<Unary>>;
+                           std::unique_ptr<Unary>, std::unique_ptr<Filter>, Wildcard>;
 
 struct Path {
     using NextType = std::unique_ptr<Path>;
@@ -36,9 +43,23 @@ struct Binary {
     Value rhs;
 };
 
+// Array subscript of the form `[?(field == value)]`, `op` is one of `==`, `!=`, `<`, `<=`, `>` and `>=`. The field path
+// is relative to each element, the value is evaluated against the document root.
+struct Filter {
+    std::unique_ptr<Path> field;
+    Token op;
+    Value value;
+};
+
 struct Function {
+    static constexpr auto unbound = std::numeric_limits<std::uint32_t>::max();
+
     Identifier name;
     std::vector<Expression> arguments;
+    // Set when the query is bound to an evaluator, so calls don't look the name up every time. Ids are only
+    // meaningful in the function registry they were found in, evaluators with another registry look the name up.
+    std::uint32_t id = unbound;
+    const void *registry = nullptr;
 };
 
 } // namespace query
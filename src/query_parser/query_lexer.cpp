@@ -53,8 +53,7 @@ auto Lexer::next_token() -> std::optional<jp::expected<Token, Error>> {
     if (is_numeric(c)) {
         auto number = parse_num(source);
         if (!number.has_value()) {
-            return Error{
-                .source = "Query Lexer", .message = "Failed to parse number", .line = 0, .column = first_char_column};
+            return Error{ErrorCode::InvalidNumber}.at(0, first_char_column);
         }
 
         if (std::holds_alternative<double>(number->value)) {
@@ -64,8 +63,8 @@ auto Lexer::next_token() -> std::optional<jp::expected<Token, Error>> {
         return Token{Integer{as_int(number->value)}, first_char_column};
     }
 
-    if (is_alphabetic(c)) {
-        auto identifier = chop_while(is_alphabetic);
+    if (is_identifier_start(c)) {
+        auto identifier = chop_while(is_identifier);
         return Token{Identifier{std::string{identifier}}, first_char_column};
     }
 
@@ -91,9 +90,25 @@ auto Lexer::next_token() -> std::optional<jp::expected<Token, Error>> {
         return Token{Star{}, first_char_column};
     } else if (c == '/') {
         return Token{Slash{}, first_char_column};
+    } else if (c == '?') {
+        return Token{Question{}, first_char_column};
+    } else if (c == '=' && peek() == '=') {
+        chop();
+        return Token{EqualEqual{}, first_char_column};
+    } else if (c == '!' && peek() == '=') {
+        chop();
+        return Token{BangEqual{}, first_char_column};
+    } else if (c == '<' || c == '>') {
+        const auto or_equal = peek() == '=';
+        if (or_equal) {
+            chop();
+        }
+        if (c == '<') {
+            return or_equal ? Token{LessEqual{}, first_char_column} : Token{Less{}, first_char_column};
+        }
+        return or_equal ? Token{GreaterEqual{}, first_char_column} : Token{Greater{}, first_char_column};
     } else {
-        return Error{
-            .source = "Query Lexer", .message = "Unexpected character", .line = 0, .column = first_char_column};
+        return Error{ErrorCode::UnexpectedQueryCharacter, c}.at(0, first_char_column);
     }
 }
 
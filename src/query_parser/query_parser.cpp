@@ -25,17 +25,17 @@ auto Parser::chop() -> std::optional<query::Token> {
 
 void Parser::push_err(Error &&err) { errors.push_back(std::move(err)); }
 
-void Parser::push_err(std::string &&message, unsigned column) {
-    errors.push_back(Error{.source = "Query", .message = std::move(message), .line = 1, .column = column});
+void Parser::push_err(Error &&err, unsigned column) {
+    err.source = ErrorSource::Query;
+    push_err(std::move(err).at(1, column));
 }
 
-void Parser::throw_unexpected_token(std::string &&expected, const Token &unexpected) {
-    push_err(std::format("Unexpected token: Expected {}, instead found {}", expected, to_string(unexpected.token_type)),
-             unexpected.col);
+void Parser::throw_unexpected_token(const char *expected, const Token &unexpected) {
+    push_err(Error{ErrorCode::UnexpectedToken, expected, to_string(unexpected.token_type)}, unexpected.col);
 }
 
-void Parser::throw_unexpected_end_of_stream(std::string &&expected) {
-    push_err(std::format("Unexpected end of stream: Expected {}", expected), 0);
+void Parser::throw_unexpected_end_of_stream(const char *expected) {
+    push_err(Error{ErrorCode::UnexpectedEndOfStream, expected}, 0);
 }
 
 auto Parser::get_errors() -> std::span<Error> { return errors; }
@@ -50,7 +50,7 @@ auto Parser::parse() -> std::optional<query::Expression> {
     if (!tokens.empty()) {
         auto maybe_token = chop();
         if (maybe_token.has_value()) {
-            push_err(std::format("Unexpected token: '{}'", to_string(maybe_token->token_type)), maybe_token->col);
+            push_err(Error{ErrorCode::TrailingToken, to_string(maybe_token->token_type)}, maybe_token->col);
         }
 
         return std::nullopt;
@@ -64,7 +64,8 @@ auto Parser::parse_path(const query::Identifier &first_id) -> std::optional<std:
         // Parse the next identifier
         const auto maybe_next_id = chop();
         if (!maybe_next_id) {
-            push_err(std::format("Unexpected end of stream, expected identifier after '.'"), col);
+            throw_unexpected_end_of_stream("an identifier after '.'");
+            return std::nullopt;
         }
         const auto &next_id = *maybe_next_id;
         auto next = parse_path(std::get<query::Identifier>(next_id.token_type));
@@ -89,10 +90,19 @@ auto Parser::parse_path(const query::Identifier &first_id) -> std::optional<std:
     if (std::holds_alternative<query::LBracket>(delimiter.token_type)) {
         chop(); // Consume the opening bracket
 
-        auto value = parse_value();
+        const auto *const maybe_question = peek();
+        auto value = std::optional<Value>{};
+        if (maybe_question != nullptr && std::holds_alternative<query::Question>(maybe_question->token_type)) {
+            value = parse_filter();
+        } else if (maybe_question != nullptr && std::holds_alternative<query::Star>(maybe_question->token_type)) {
+            chop(); // Consume the star
+            value = Wildcard{};
+        } else {
+            value = parse_value();
+        }
 
         if (!value.has_value()) {
-            push_err("Expected value after '['", delimiter.col);
+            push_err(Error{ErrorCode::Expected, "a value after '['"}, delimiter.col);
             return std::nullopt;
         }
 
@@ -100,16 +110,14 @@ auto Parser::parse_path(const query::Identifier &first_id) -> std::optional<std:
 
         auto maybe_closing_bracket = chop();
         if (!maybe_closing_bracket) {
-            push_err(std::format("Unexpected end of stream, expected ']' after index"), delimiter.col);
+            throw_unexpected_end_of_stream("']' after the index");
             return std::nullopt;
         }
 
         const auto &closing_bracket = *maybe_closing_bracket;
 
         if (!std::holds_alternative<query::RBracket>(closing_bracket.token_type)) {
-            push_err(std::format("Unexpected token: Expected ']', instead found '{}'",
-                                 to_string(closing_bracket.token_type)),
-                     closing_bracket.col);
+            throw_unexpected_token("']'", closing_bracket);
             return std::nullopt;
         }
 
@@ -158,9 +166,12 @@ auto Parser::parse_value() -> std::optional<query::Value> {
         }
 
         auto maybe_rparen = chop();
-        if (!maybe_rparen || !std::holds_alternative<query::RParen>(maybe_rparen->token_type)) {
-            push_err(std::format("Expected ')' after expression. insted found {}", to_string(maybe_rparen->token_type)),
-                     token.col);
+        if (!maybe_rparen) {
+            throw_unexpected_end_of_stream("')' after the expression");
+            return std::nullopt;
+        }
+        if (!std::holds_alternative<query::RParen>(maybe_rparen->token_type)) {
+            throw_unexpected_token("')' after the expression", *maybe_rparen);
             return std::nullopt;
         }
 
@@ -200,23 +211,74 @@ auto Parser::parse_value() -> std::optional<query::Value> {
 
 auto Parser::parse_expression() -> std::optional<query::Expression> { return parse_term(); }
 
+auto Parser::parse_filter() -> std::optional<query::Value> {
+    chop(); // Consume the question mark
+
+    auto maybe_lparen = chop();
+    if (!maybe_lparen || !std::holds_alternative<query::LParen>(maybe_lparen->token_type)) {
+        push_err(Error{ErrorCode::Expected, "'(' after '?'"}, maybe_lparen ? maybe_lparen->col : 0);
+        return std::nullopt;
+    }
+
+    auto maybe_field = chop();
+    if (!maybe_field || !std::holds_alternative<query::Identifier>(maybe_field->token_type)) {
+        push_err(Error{ErrorCode::Expected, "a field name in filter"},
+                 maybe_field ? maybe_field->col : maybe_lparen->col);
+        return std::nullopt;
+    }
+
+    auto field = parse_path(std::get<query::Identifier>(maybe_field->token_type));
+    if (!field.has_value()) {
+        return std::nullopt;
+    }
+
+    auto maybe_op = chop();
+    if (!maybe_op) {
+        throw_unexpected_end_of_stream("a comparison operator");
+        return std::nullopt;
+    }
+
+    const auto is_comparison = std::visit(
+        overloaded{[](const query::EqualEqual &) { return true; }, [](const query::BangEqual &) { return true; },
+                   [](const query::Less &) { return true; }, [](const query::LessEqual &) { return true; },
+                   [](const query::Greater &) { return true; }, [](const query::GreaterEqual &) { return true; },
+                   [](const auto &) { return false; }},
+        maybe_op->token_type);
+    if (!is_comparison) {
+        throw_unexpected_token("a comparison operator", *maybe_op);
+        return std::nullopt;
+    }
+
+    auto value = parse_expression();
+    if (!value.has_value()) {
+        return std::nullopt;
+    }
+
+    auto maybe_rparen = chop();
+    if (!maybe_rparen || !std::holds_alternative<query::RParen>(maybe_rparen->token_type)) {
+        push_err(Error{ErrorCode::Expected, "')' after filter"}, maybe_rparen ? maybe_rparen->col : maybe_op->col);
+        return std::nullopt;
+    }
+
+    return std::make_unique<query::Filter>(std::move(*field), *maybe_op, std::move(*value));
+}
+
 auto Parser::parse_function(const query::Identifier &name) -> std::optional<query::Value> {
     auto maybe_lparen = chop();
     if (!maybe_lparen) {
-        push_err("Expected '(' after function name", 0);
+        throw_unexpected_end_of_stream("'(' after the function name");
         return std::nullopt;
     }
 
     if (!std::holds_alternative<query::LParen>(maybe_lparen->token_type)) {
-        push_err(std::format("Unexpected token: Expected '(', instead found {}", to_string(maybe_lparen->token_type)),
-                 maybe_lparen->col);
+        throw_unexpected_token("'('", *maybe_lparen);
         return std::nullopt;
     }
 
     auto args = std::vector<query::Value>{};
 
     while (true) {
-        auto arg = parse_value();
+        auto arg = parse_expression();
         if (!arg.has_value()) {
             return std::nullopt;
         }
@@ -233,9 +295,7 @@ auto Parser::parse_function(const query::Identifier &name) -> std::optional<quer
         }
 
         if (!std::holds_alternative<query::Comma>(maybe_comma->token_type)) {
-            push_err(
-                std::format("Unexpected token: Expected ',', instead found {}", to_string(maybe_comma->token_type)),
-                maybe_comma->col);
+            throw_unexpected_token("','", *maybe_comma);
             return std::nullopt;
         }
     }
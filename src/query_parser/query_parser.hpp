@@ -19,13 +19,14 @@ class Parser {
     auto parse_value() -> std::optional<query::Value>;
     auto parse_path(const query::Identifier &first_id) -> std::optional<std::unique_ptr<query::Path>>;
     auto parse_function(const query::Identifier &name) -> std::optional<query::Value>;
+    auto parse_filter() -> std::optional<query::Value>;
     auto parse_term() -> std::optional<query::Value>;
     auto parse_factor() -> std::optional<query::Value>;
 
     void push_err(Error &&err);
-    void push_err(std::string &&message, unsigned column);
-    void throw_unexpected_token(std::string &&expected, const Token &unexpected);
-    void throw_unexpected_end_of_stream(std::string &&expected);
+    void push_err(Error &&err, unsigned column);
+    void throw_unexpected_token(const char *expected, const Token &unexpected);
+    void throw_unexpected_end_of_stream(const char *expected);
     auto get_errors() -> std::span<Error>;
 
   private:
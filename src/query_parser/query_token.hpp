@@ -29,8 +29,16 @@ DEFINE_TOKEN_TYPE(Minus)
 DEFINE_TOKEN_TYPE(Star)
 DEFINE_TOKEN_TYPE(Slash)
 
-using TokenType =
-    std::variant<Identifier, LBracket, RBracket, LParen, RParen, Comma, Dot, Double, Integer, Plus, Minus, Star, Slash>;
+DEFINE_TOKEN_TYPE(Question)
+DEFINE_TOKEN_TYPE(EqualEqual)
+DEFINE_TOKEN_TYPE(BangEqual)
+DEFINE_TOKEN_TYPE(Less)
+DEFINE_TOKEN_TYPE(LessEqual)
+DEFINE_TOKEN_TYPE(Greater)
+DEFINE_TOKEN_TYPE(GreaterEqual)
+
+using TokenType = std::variant<Identifier, LBracket, RBracket, LParen, RParen, Comma, Dot, Double, Integer, Plus, Minus,
+                               Star, Slash, Question, EqualEqual, BangEqual, Less, LessEqual, Greater, GreaterEqual>;
 
 struct Token {
     TokenType token_type;
@@ -68,6 +76,20 @@ constexpr auto to_string(TokenType token_type) -> std::string {
                 return "*";
             } else if constexpr (std::is_same_v<T, Slash>) {
                 return "/";
+            } else if constexpr (std::is_same_v<T, Question>) {
+                return "?";
+            } else if constexpr (std::is_same_v<T, EqualEqual>) {
+                return "==";
+            } else if constexpr (std::is_same_v<T, BangEqual>) {
+                return "!=";
+            } else if constexpr (std::is_same_v<T, Less>) {
+                return "<";
+            } else if constexpr (std::is_same_v<T, LessEqual>) {
+                return "<=";
+            } else if constexpr (std::is_same_v<T, Greater>) {
+                return ">";
+            } else if constexpr (std::is_same_v<T, GreaterEqual>) {
+                return ">=";
             } else if constexpr (std::is_same_v<T, Double>) {
                 return std::format("{}", token.value);
             } else if constexpr (std::is_same_v<T, Integer>) {
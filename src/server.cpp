@@ -0,0 +1,356 @@
+#include "server.hpp"
+#include "document.hpp"
+#include "query_evaluator.hpp"
+#include "query_lexer.hpp"
+#include "query_parser.hpp"
+#include "thread_pool.hpp"
+#include "trace.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <deque>
+#include <format>
+#include <future>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Latencies of the most recent queries, enough for stable percentiles without growing with the uptime
+class LatencyLog {
+  public:
+    void record(double micros) {
+        auto lock = std::scoped_lock{mutex};
+        if (samples.size() < capacity) {
+            samples.push_back(micros);
+        } else {
+            samples[count % capacity] = micros;
+        }
+        count++;
+    }
+
+    [[nodiscard]] auto summary() const -> std::string {
+        auto sorted = std::vector<double>{};
+        auto total = std::size_t{0};
+        {
+            auto lock = std::scoped_lock{mutex};
+            sorted = samples;
+            total = count;
+        }
+
+        if (sorted.empty()) {
+            return R"({"count": 0})";
+        }
+
+        std::ranges::sort(sorted);
+        const auto percentile = [&](double q) {
+            const auto rank = static_cast<std::size_t>(q * static_cast<double>(sorted.size()));
+            return sorted[std::min(sorted.size() - 1, rank)];
+        };
+        return std::format(R"({{"count": {}, "p50_us": {:.1f}, "p90_us": {:.1f}, "p99_us": {:.1f}, "max_us": {:.1f}}})",
+                           total, percentile(0.5), percentile(0.9), percentile(0.99), sorted.back());
+    }
+
+  private:
+    static constexpr auto capacity = std::size_t{1} << 16;
+
+    mutable std::mutex mutex;
+    std::vector<double> samples;
+    std::size_t count = 0;
+};
+
+auto write_all(int fd, std::string_view data) -> bool {
+    while (!data.empty()) {
+        const auto written = ::write(fd, data.data(), data.size());
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data.remove_prefix(static_cast<std::size_t>(written));
+    }
+    return true;
+}
+
+class Server {
+  public:
+    Server(std::vector<ResidentDocument> resident, const Options &options) : documents(std::move(resident)) {
+        pool = std::make_shared<jp::ThreadPool>(options.threads);
+        // The documents don't move from here on, evaluators keep pointers to them
+        for (auto &document : documents) {
+            auto &evaluator = evaluators.emplace_back(&document.value);
+            evaluator.parallel_threshold = options.parallel_threshold;
+            if (options.threads != 1) {
+                evaluator.thread_pool = pool;
+            }
+        }
+        max_in_flight = 4 * pool->size();
+    }
+
+    // Answers the requests read from `input` on `output` until the input is closed or a write fails. Requests that
+    // arrive together are evaluated concurrently, responses are written in request order.
+    void run(int input, int output) {
+        auto pending = std::deque<std::future<std::string>>{};
+        auto failed = false;
+        const auto respond = [&] {
+            auto response = pending.front().get();
+            pending.pop_front();
+            response += '\n';
+            failed = failed || !write_all(output, response);
+        };
+
+        auto buffer = std::string{};
+        auto chunk = std::array<char, 1 << 16>{};
+        while (!failed) {
+            const auto count = ::read(input, chunk.data(), chunk.size());
+            if (count < 0 && errno == EINTR) {
+                continue;
+            }
+            if (count <= 0) {
+                break;
+            }
+
+            const auto received = Clock::now();
+            buffer.append(chunk.data(), static_cast<std::size_t>(count));
+
+            auto start = std::size_t{0};
+            for (auto end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n', start)) {
+                auto request = buffer.substr(start, end - start);
+                start = end + 1;
+                if (!request.empty() && request.back() == '\r') {
+                    request.pop_back();
+                }
+                if (request.empty()) {
+                    continue;
+                }
+
+                if (pending.size() >= max_in_flight) {
+                    respond();
+                }
+                auto task = Task{[this, request = std::move(request), received] { return answer(request, received); }};
+                pending.push_back(task.get_future());
+                enqueue(std::move(task));
+            }
+            buffer.erase(0, start);
+
+            // The client may be waiting for these before it sends more, answer them before blocking on the input
+            while (!pending.empty() && !failed) {
+                respond();
+            }
+        }
+
+        // A last request without a trailing newline
+        if (!failed && buffer.find_first_not_of(" \t\r") != std::string::npos) {
+            write_all(output, answer(buffer, Clock::now()) + '\n');
+        }
+    }
+
+    [[nodiscard]] auto summary() const -> std::string { return latencies.summary(); }
+
+  private:
+    using Task = std::packaged_task<std::string()>;
+
+    // Workers run the newest task of their own queue first, which would let a busy connection starve the others.
+    // Every pool task takes the oldest request instead.
+    void enqueue(Task task) {
+        {
+            auto lock = std::scoped_lock{queue_mutex};
+            queue.push_back(std::move(task));
+        }
+        pool->submit([this] {
+            auto lock = std::unique_lock{queue_mutex};
+            auto oldest = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            oldest();
+        });
+    }
+
+    auto answer(const std::string &request, Clock::time_point received) -> std::string {
+        // Answered like a query but not counted as one
+        if (request == ":stats") {
+            const auto micros = std::chrono::duration<double, std::micro>(Clock::now() - received).count();
+            return std::format(R"({{"result": {}, "micros": {:.1f}}})", latencies.summary(), micros);
+        }
+
+        auto span = jp::trace::Span{"request", "serve"};
+        const auto body = evaluate(request);
+        const auto micros = std::chrono::duration<double, std::micro>(Clock::now() - received).count();
+        latencies.record(micros);
+        return std::format(R"({{{}, "micros": {:.1f}}})", body, micros);
+    }
+
+    // Returns the `"result": ...` or `"error": ...` member of the response
+    [[nodiscard]] auto evaluate(std::string_view request) const -> std::string {
+        const auto error = [](std::string_view message) {
+            return std::format(R"("error": "{}")", escape_json(message));
+        };
+
+        const auto *evaluator = &evaluators.front();
+        if (request.starts_with('@')) {
+            const auto space = request.find(' ');
+            const auto name = request.substr(1, space == std::string_view::npos ? space : space - 1);
+            const auto document = std::ranges::find(documents, name, &ResidentDocument::name);
+            if (document == documents.end()) {
+                return error(std::format("Unknown document '{}'", name));
+            }
+            evaluator = &evaluators[static_cast<std::size_t>(document - documents.begin())];
+            request = space == std::string_view::npos ? std::string_view{} : request.substr(space + 1);
+        }
+
+        auto [tokens, lexer_errors] = query::collect_tokens(request);
+        if (!lexer_errors.empty()) {
+            return error(lexer_errors.front().message());
+        }
+
+        auto parser = query::Parser(tokens);
+        auto expression = parser.parse();
+        if (!expression) {
+            const auto errors = parser.get_errors();
+            return error(errors.empty() ? "Expected a query" : errors.front().message());
+        }
+
+        evaluator->bind(*expression);
+        // Errors may refer to names in the expression, they are formatted while it is alive
+        const auto result = evaluator->evaluate_expression(*expression);
+        if (result.has_error()) {
+            return error(result.error().message());
+        }
+        return std::format(R"("result": {})", jp::to_string(result.value()));
+    }
+
+    std::vector<ResidentDocument> documents;
+    std::vector<query::Evaluator> evaluators;
+    std::shared_ptr<jp::ThreadPool> pool;
+    std::size_t max_in_flight;
+    std::mutex queue_mutex;
+    std::deque<Task> queue;
+    LatencyLog latencies;
+};
+
+// Written by the signal handler to wake up the accept loop
+int stop_pipe[2] = {-1, -1};
+
+void request_stop(int /*signal*/) {
+    const char byte = 0;
+    [[maybe_unused]] const auto written = ::write(stop_pipe[1], &byte, 1);
+}
+
+struct Connection {
+    int fd;
+    std::atomic<bool> done = false;
+    std::thread thread;
+};
+
+auto listen_on(const std::string &path) -> int {
+    auto address = sockaddr_un{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Socket path is too long: " << path << std::endl;
+        return -1;
+    }
+    std::ranges::copy(path, address.sun_path);
+
+    const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        std::perror("socket");
+        return -1;
+    }
+
+    ::unlink(path.c_str());
+    if (::bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof(address)) < 0 || ::listen(fd, 64) < 0) {
+        std::perror(path.c_str());
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+auto serve_socket(Server &server, const std::string &path) -> bool {
+    const auto listener = listen_on(path);
+    if (listener < 0 || ::pipe(stop_pipe) < 0) {
+        return false;
+    }
+    std::signal(SIGINT, request_stop);
+    std::signal(SIGTERM, request_stop);
+    std::cerr << "Listening on " << path << std::endl;
+
+    auto connections = std::list<Connection>{};
+    const auto reap = [&](bool all) {
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (!all && !it->done) {
+                ++it;
+                continue;
+            }
+            // Unblocks a connection that is still waiting for requests
+            ::shutdown(it->fd, SHUT_RDWR);
+            it->thread.join();
+            ::close(it->fd);
+            it = connections.erase(it);
+        }
+    };
+
+    while (true) {
+        auto fds = std::array<pollfd, 2>{pollfd{listener, POLLIN, 0}, pollfd{stop_pipe[0], POLLIN, 0}};
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        if ((fds[1].revents & POLLIN) != 0) {
+            break;
+        }
+
+        const auto fd = ::accept(listener, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        reap(false);
+        auto &connection = connections.emplace_back();
+        connection.fd = fd;
+        connection.thread = std::thread([&server, &connection] {
+            server.run(connection.fd, connection.fd);
+            connection.done = true;
+        });
+    }
+
+    reap(true);
+    ::close(listener);
+    ::unlink(path.c_str());
+    return true;
+}
+
+} // namespace
+
+auto serve(std::vector<ResidentDocument> documents, const Options &options) -> int {
+    // A client that disconnects early shows up as a failed write instead of killing the server
+    std::signal(SIGPIPE, SIG_IGN);
+
+    auto server = Server{std::move(documents), options};
+
+    if (options.socket_path) {
+        if (!serve_socket(server, *options.socket_path)) {
+            return 1;
+        }
+    } else {
+        server.run(STDIN_FILENO, STDOUT_FILENO);
+    }
+
+    std::cerr << "Query latency: " << server.summary() << std::endl;
+    return 0;
+}
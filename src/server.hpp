@@ -0,0 +1,31 @@
+#pragma once
+
+#include "jsonobject.hpp"
+#include "options.hpp"
+#include <string>
+#include <vector>
+
+// Document kept in memory by --serve. Requests select it by name, the file name without its extension.
+struct ResidentDocument {
+    std::string name;
+    jp::JSONValue value;
+};
+
+// Answers queries against documents that are parsed once and stay resident, so a request only pays for lexing,
+// parsing and evaluating its query. Requests are newline-delimited and read from stdin, or from every connection to
+// the Unix socket at `options.socket_path`:
+//
+//     <query>          evaluated against the first document
+//     @<name> <query>  evaluated against the document called <name>
+//     :stats           latency percentiles of the queries answered so far
+//
+// Every request gets exactly one response line, in request order:
+//
+//     {"result": <json>, "micros": <latency>}
+//     {"error": "<message>", "micros": <latency>}
+//
+// The latency covers the time from reading a request to its response being ready, including the wait for a worker.
+// Queries are evaluated on a thread pool of `options.threads` workers, which also runs parallel reductions. Stdin is
+// served until it is closed, the socket until the process receives SIGINT or SIGTERM. The latency summary is
+// printed to stderr on exit.
+auto serve(std::vector<ResidentDocument> documents, const Options &options) -> int;
@@ -0,0 +1,227 @@
+#include "stats.hpp"
+#include "cpu.hpp"
+#include "document.hpp"
+#include "memory.hpp"
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <format>
+#include <linux/perf_event.h>
+#include <optional>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+auto seconds(clockid_t clock) -> double {
+    auto now = timespec{};
+    clock_gettime(clock, &now);
+    return static_cast<double>(now.tv_sec) + static_cast<double>(now.tv_nsec) * 1e-9;
+}
+
+auto cpu_clock(Phase phase) -> clockid_t {
+    return phase == Phase::Evaluate ? CLOCK_PROCESS_CPUTIME_ID : CLOCK_THREAD_CPUTIME_ID;
+}
+
+auto megabytes_per_second(const PhaseStats &phase) -> double {
+    return phase.wall_seconds > 0 ? static_cast<double>(phase.bytes) / 1e6 / phase.wall_seconds : 0.0;
+}
+
+// ru_maxrss is in kilobytes on Linux
+auto peak_rss_bytes() -> std::size_t {
+    auto usage = rusage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+auto instruction_counter = -1;
+
+auto instructions() -> std::optional<std::uint64_t> {
+    auto count = std::uint64_t{0};
+    if (instruction_counter < 0 || read(instruction_counter, &count, sizeof(count)) != sizeof(count)) {
+        return std::nullopt;
+    }
+    return count;
+}
+
+auto ran(const PhaseStats &phase) -> bool { return phase.wall_seconds > 0 || phase.bytes > 0; }
+
+auto node_type_name(std::size_t type_id) -> const char * {
+    constexpr const char *names[] = {"null", "bool", "integer", "double", "string", "object", "array"};
+    return names[type_id];
+}
+
+} // namespace
+
+auto phase_name(Phase phase) -> const char * {
+    switch (phase) {
+    case Phase::Read:
+        return "read";
+    case Phase::Decompress:
+        return "decompress";
+    case Phase::Lex:
+        return "lex";
+    case Phase::Parse:
+        return "parse";
+    case Phase::QueryParse:
+        return "query_parse";
+    case Phase::Evaluate:
+        return "evaluate";
+    case Phase::Output:
+        return "output";
+    }
+    return "";
+}
+
+PhaseTimer::PhaseTimer(Stats *stats, Phase phase) : span(phase_name(phase), "phase"), stats(stats), phase(phase) {
+    if (stats != nullptr) {
+        wall_start = seconds(CLOCK_MONOTONIC);
+        cpu_start = seconds(cpu_clock(phase));
+    }
+}
+
+PhaseTimer::~PhaseTimer() {
+    if (stats != nullptr) {
+        auto &phase_stats = stats->phase(phase);
+        phase_stats.wall_seconds += seconds(CLOCK_MONOTONIC) - wall_start;
+        phase_stats.cpu_seconds += seconds(cpu_clock(phase)) - cpu_start;
+    }
+}
+
+void count_nodes(const jp::JSONValue &document, Stats &stats) {
+    auto pending = std::vector<const jp::JSONValue *>{&document};
+    while (!pending.empty()) {
+        const auto *value = pending.back();
+        pending.pop_back();
+        stats.nodes[value->type_id()]++;
+
+        if (value->is_array()) {
+            for (const auto &element : value->as_array()) {
+                pending.push_back(&element);
+            }
+        } else if (value->is_object()) {
+            for (const auto &[key, member] : value->as_object()) {
+                pending.push_back(&member);
+            }
+        }
+    }
+}
+
+void start_counting_instructions() {
+    auto attributes = perf_event_attr{};
+    attributes.size = sizeof(attributes);
+    attributes.type = PERF_TYPE_HARDWARE;
+    attributes.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attributes.exclude_kernel = 1;
+    attributes.exclude_hv = 1;
+    attributes.inherit = 1;
+    instruction_counter = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+}
+
+void print_stats(const Stats &stats, std::string_view input, bool json, std::ostream &out) {
+    // Taken before printing allocates, so the categories add up to the total
+    auto categories = std::array<jp::memory::Counts, jp::memory::category_count>{};
+    auto allocations = jp::memory::Counts{};
+    for (auto i = std::size_t{0}; i < jp::memory::category_count; i++) {
+        categories[i] = jp::memory::counts(static_cast<jp::memory::Category>(i));
+        allocations.allocations += categories[i].allocations;
+        allocations.bytes += categories[i].bytes;
+    }
+    const auto frees = jp::memory::frees();
+    const auto instruction_count = instructions();
+    auto total_nodes = std::size_t{0};
+    for (const auto count : stats.nodes) {
+        total_nodes += count;
+    }
+
+    if (json) {
+        out << std::format(R"({{"input": "{}", "isa": "{}", "phases": {{)", escape_json(input),
+                           jp::cpu::level_name(jp::cpu::active_level()));
+        auto separator = "";
+        for (auto i = std::size_t{0}; i < phase_count; i++) {
+            const auto &phase = stats.phases[i];
+            if (!ran(phase)) {
+                continue;
+            }
+            out << std::format(
+                R"({}"{}": {{"wall_seconds": {:.6f}, "cpu_seconds": {:.6f}, "bytes": {}, "mb_per_second": {:.1f}}})",
+                separator, phase_name(static_cast<Phase>(i)), phase.wall_seconds, phase.cpu_seconds, phase.bytes,
+                megabytes_per_second(phase));
+            separator = ", ";
+        }
+        out << std::format(R"(}}, "compression": "{}", "tokens": {}, "nodes": {{)",
+                           compression_name(stats.compression), stats.tokens);
+        for (auto i = std::size_t{0}; i < stats.nodes.size(); i++) {
+            out << std::format(R"({}"{}": {})", i == 0 ? "" : ", ", node_type_name(i), stats.nodes[i]);
+        }
+        out << std::format(R"(}}, "dom_bytes": {}, "peak_rss_bytes": {}, "instructions": {}, )", stats.dom_bytes,
+                           peak_rss_bytes(), instruction_count ? std::to_string(*instruction_count) : "null");
+        // Like the instructions, allocations are null where they can't be counted
+        if (!jp::memory::counting_available()) {
+            out << R"("allocations": null, "allocated_bytes": null, "frees": null, "allocations_by_category": null})"
+                << std::endl;
+            return;
+        }
+        out << std::format(R"("allocations": {}, "allocated_bytes": {}, "frees": {}, "allocations_by_category": {{)",
+                           allocations.allocations, allocations.bytes, frees);
+        for (auto i = std::size_t{0}; i < jp::memory::category_count; i++) {
+            const auto &counts = categories[i];
+            out << std::format(R"({}"{}": {{"allocations": {}, "bytes": {}}})", i == 0 ? "" : ", ",
+                               jp::memory::category_name(static_cast<jp::memory::Category>(i)), counts.allocations,
+                               counts.bytes);
+        }
+        out << "}}" << std::endl;
+        return;
+    }
+
+    out << input << " (" << jp::cpu::level_name(jp::cpu::active_level()) << " kernels)" << std::endl;
+    out << std::format("{:<12}{:>12}{:>12}{:>12}{:>12}", "phase", "wall s", "cpu s", "MB", "MB/s") << std::endl;
+    for (auto i = std::size_t{0}; i < phase_count; i++) {
+        const auto &phase = stats.phases[i];
+        if (!ran(phase)) {
+            continue;
+        }
+        out << std::format("{:<12}{:>12.4f}{:>12.4f}{:>12.1f}{:>12.1f}", phase_name(static_cast<Phase>(i)),
+                           phase.wall_seconds, phase.cpu_seconds, static_cast<double>(phase.bytes) / 1e6,
+                           megabytes_per_second(phase))
+            << std::endl;
+    }
+
+    if (stats.compression != Compression::None) {
+        out << "compression: " << compression_name(stats.compression) << std::endl;
+    }
+    out << "tokens: " << stats.tokens << std::endl;
+    out << "nodes: " << total_nodes;
+    for (auto i = std::size_t{0}; i < stats.nodes.size(); i++) {
+        out << (i == 0 ? " (" : ", ") << node_type_name(i) << ' ' << stats.nodes[i];
+    }
+    out << ')' << std::endl;
+    if (stats.dom_bytes > 0) {
+        const auto source_bytes = stats.phase(Phase::Parse).bytes;
+        const auto ratio =
+            source_bytes == 0 ? 0.0 : static_cast<double>(stats.dom_bytes) / static_cast<double>(source_bytes);
+        out << std::format("DOM: {:.1f} MB, {:.1f} times the text", static_cast<double>(stats.dom_bytes) / 1e6, ratio)
+            << std::endl;
+    }
+    out << std::format("peak RSS: {:.1f} MB", static_cast<double>(peak_rss_bytes()) / 1e6) << std::endl;
+    if (instruction_count) {
+        out << "instructions: " << *instruction_count << std::endl;
+    }
+    if (!jp::memory::counting_available()) {
+        return;
+    }
+    out << std::format("allocations: {} ({:.1f} MB), frees: {}", allocations.allocations,
+                       static_cast<double>(allocations.bytes) / 1e6, frees)
+        << std::endl;
+    for (auto i = std::size_t{0}; i < jp::memory::category_count; i++) {
+        const auto &counts = categories[i];
+        const auto *name = jp::memory::category_name(static_cast<jp::memory::Category>(i));
+        if (counts.allocations > 0) {
+            out << std::format("  {:<16}{:>12}{:>12.1f} MB", name, counts.allocations,
+                               static_cast<double>(counts.bytes) / 1e6)
+                << std::endl;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "decompress.hpp"
+#include "jsonobject.hpp"
+#include "trace.hpp"
+#include <array>
+#include <cstddef>
+#include <ostream>
+#include <string_view>
+#include <variant>
+
+// The phases of a run in the order they start. Reading and decompressing stdin or a compressed file happen on a reader
+// thread while the lexer works.
+enum class Phase { Read, Decompress, Lex, Parse, QueryParse, Evaluate, Output };
+constexpr auto phase_count = std::size_t{7};
+
+auto phase_name(Phase phase) -> const char *;
+
+struct PhaseStats {
+    double wall_seconds = 0;
+    double cpu_seconds = 0;
+    // What the phase went through, for its throughput
+    std::size_t bytes = 0;
+};
+
+// Collected with --stats. Nothing is measured or counted without it, the phases only time themselves when they are
+// given a Stats.
+struct Stats {
+    std::array<PhaseStats, phase_count> phases{};
+    Compression compression = Compression::None;
+    std::size_t tokens = 0;
+    // DOM nodes indexed by JSONValue::type_id()
+    std::array<std::size_t, std::variant_size_v<jp::JSONValue::ValueType>> nodes{};
+    // memory_usage() of the document
+    std::size_t dom_bytes = 0;
+
+    auto phase(Phase which) -> PhaseStats & { return phases[static_cast<std::size_t>(which)]; }
+    [[nodiscard]] auto phase(Phase which) const -> const PhaseStats & {
+        return phases[static_cast<std::size_t>(which)];
+    }
+};
+
+// Adds the wall and CPU time from construction to destruction to a phase, or does nothing for a null `stats`. The
+// CPU time is the calling thread's, evaluation takes the whole process's since reductions run on the thread pool.
+// The phase is also a span in the trace.
+class PhaseTimer {
+  public:
+    PhaseTimer(Stats *stats, Phase phase);
+    ~PhaseTimer();
+
+    PhaseTimer(const PhaseTimer &) = delete;
+    PhaseTimer &operator=(const PhaseTimer &) = delete;
+
+    void add_bytes(std::size_t bytes) {
+        if (stats != nullptr) {
+            stats->phase(phase).bytes += bytes;
+        }
+    }
+
+  private:
+    jp::trace::Span span;
+    Stats *stats;
+    Phase phase;
+    double wall_start = 0;
+    double cpu_start = 0;
+};
+
+void count_nodes(const jp::JSONValue &document, Stats &stats);
+
+// Counts the user space instructions the process retires from now on, in the threads it starts later too. Hardware
+// counters are often not available in virtual machines and containers, the stats leave the count out then.
+void start_counting_instructions();
+
+// Prints the phases with their throughput, the counts, the DOM footprint, peak RSS, the instructions and the
+// allocations by category of a run over `input`, as text or as one JSON object
+void print_stats(const Stats &stats, std::string_view input, bool json, std::ostream &out);
@@ -0,0 +1,413 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include "decompress.hpp"
+#include "document.hpp"
+#include "parser.hpp"
+#include "../test_shared.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef JSON_EVAL_GZIP
+#include <zlib.h>
+#endif
+
+#ifdef JSON_EVAL_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+#ifdef JSON_EVAL_GZIP
+// One gzip member holding `text`
+auto gzip(std::string_view text) -> std::string {
+    auto stream = z_stream{};
+    REQUIRE(deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+    auto compressed = std::string(deflateBound(&stream, static_cast<uLong>(text.size())), '\0');
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(text.data()));
+    stream.avail_in = static_cast<uInt>(text.size());
+    stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    const auto result = deflate(&stream, Z_FINISH);
+    compressed.resize(stream.total_out);
+    deflateEnd(&stream);
+    REQUIRE(result == Z_STREAM_END);
+    return compressed;
+}
+#endif
+
+#ifdef JSON_EVAL_ZSTD
+// One zstd frame holding `text`
+auto zstd(std::string_view text) -> std::string {
+    auto compressed = std::string(ZSTD_compressBound(text.size()), '\0');
+    const auto size = ZSTD_compress(compressed.data(), compressed.size(), text.data(), text.size(), 3);
+    REQUIRE(ZSTD_isError(size) == 0);
+    compressed.resize(size);
+    return compressed;
+}
+#endif
+
+// An object with an array of `count` numbers
+auto numbers_document(int count) -> std::string {
+    auto text = std::string{R"({"values": [)"};
+    for (auto i = 0; i < count; i++) {
+        text += (i == 0 ? "" : ", ") + std::to_string(i);
+    }
+    return text + "]}";
+}
+
+auto value_count(const jp::JSONValue &document) -> std::size_t {
+    return document.as_object().at("values").as_array().size();
+}
+
+// Runs a json-eval binary, `arguments` are passed to the shell and may redirect its streams
+auto run_json_eval(const std::string &arguments, const std::string &binary = JSON_EVAL) -> int {
+    return std::system(("'" + binary + "' " + arguments).c_str());
+}
+
+// Every line of the file parsed as JSON, lines that don't parse are null
+auto json_lines(const std::string &path) -> std::vector<jp::JSONValue> {
+    auto lines = std::vector<jp::JSONValue>{};
+    auto stream = std::istringstream{read_file(path).value_or("")};
+    for (auto line = std::string{}; std::getline(stream, line);) {
+        auto parsed = jp::parse(line);
+        lines.push_back(parsed.has_value() ? std::move(parsed.value()) : jp::JSONValue{});
+    }
+    return lines;
+}
+
+auto member(const jp::JSONValue &value, const std::string &key) -> const jp::JSONValue * {
+    if (!value.is_object()) {
+        return nullptr;
+    }
+    const auto found = value.as_object().find(key);
+    return found == value.as_object().end() ? nullptr : &found->second;
+}
+
+} // namespace
+
+TEST_SUITE("json-eval") {
+
+    TEST_CASE("Compressed documents") {
+        const auto text = numbers_document(30'000);
+        const auto strict = jp::utf8::Mode::Strict;
+        auto files = TemporaryFiles{};
+
+#ifdef JSON_EVAL_GZIP
+        SUBCASE("gzip in memory and streamed from a file") {
+            const auto compressed = gzip(text);
+            CHECK(detect_compression(compressed) == Compression::Gzip);
+
+            auto parsed = parse_document(compressed, strict);
+            REQUIRE(parsed.has_value());
+            CHECK_EQ(value_count(parsed.value()), 30'000);
+
+            const auto loaded = load_document(files.add("numbers.json.gz", compressed), strict);
+            REQUIRE(loaded.has_value());
+            CHECK_EQ(value_count(*loaded), 30'000);
+        }
+
+        SUBCASE("Concatenated gzip members make one document") {
+            const auto split = text.size() / 3;
+            const auto compressed = gzip(text.substr(0, split)) + gzip(text.substr(split, split)) +
+                                    gzip(text.substr(2 * split));
+
+            auto parsed = parse_document(compressed, strict);
+            REQUIRE(parsed.has_value());
+            CHECK_EQ(value_count(parsed.value()), 30'000);
+
+            const auto loaded = load_document(files.add("members.json.gz", compressed), strict);
+            REQUIRE(loaded.has_value());
+            CHECK_EQ(value_count(*loaded), 30'000);
+        }
+
+        SUBCASE("Truncated gzip streams and trailing garbage are errors") {
+            const auto compressed = gzip(text);
+            const auto truncated = compressed.substr(0, compressed.size() - 12);
+            auto cut = parse_document(truncated, strict);
+            REQUIRE(cut.has_error());
+            CHECK_EQ(cut.error().code, ErrorCode::TruncatedCompressedData);
+            CHECK_FALSE(load_document(files.add("truncated.json.gz", truncated), strict).has_value());
+
+            auto trailing = parse_document(compressed + "garbage", strict);
+            REQUIRE(trailing.has_error());
+            CHECK_EQ(trailing.error().code, ErrorCode::InvalidCompressedData);
+            CHECK_FALSE(load_document(files.add("trailing.json.gz", compressed + "garbage"), strict).has_value());
+        }
+#endif
+
+#ifdef JSON_EVAL_ZSTD
+        SUBCASE("zstd frames in memory and streamed from a file") {
+            const auto split = text.size() / 2;
+            const auto compressed = zstd(text.substr(0, split)) + zstd(text.substr(split));
+            CHECK(detect_compression(compressed) == Compression::Zstd);
+
+            auto parsed = parse_document(compressed, strict);
+            REQUIRE(parsed.has_value());
+            CHECK_EQ(value_count(parsed.value()), 30'000);
+
+            const auto loaded = load_document(files.add("numbers.json.zst", compressed), strict);
+            REQUIRE(loaded.has_value());
+            CHECK_EQ(value_count(*loaded), 30'000);
+        }
+
+        SUBCASE("Truncated zstd streams and trailing garbage are errors") {
+            const auto compressed = zstd(text);
+            auto cut = parse_document(compressed.substr(0, compressed.size() - 12), strict);
+            REQUIRE(cut.has_error());
+            CHECK_EQ(cut.error().code, ErrorCode::TruncatedCompressedData);
+
+            auto trailing = parse_document(compressed + "garbage", strict);
+            REQUIRE(trailing.has_error());
+            CHECK_EQ(trailing.error().code, ErrorCode::InvalidCompressedData);
+            CHECK_FALSE(load_document(files.add("trailing.json.zst", compressed + "garbage"), strict).has_value());
+        }
+#else
+        SUBCASE("Builds without zstd name the format") {
+            auto parsed = parse_document(std::string_view{"\x28\xb5\x2f\xfd\x00\x00", 6}, strict);
+            REQUIRE(parsed.has_error());
+            CHECK_EQ(parsed.error().code, ErrorCode::InvalidCompressedData);
+        }
+#endif
+    }
+
+    TEST_CASE("--serve answers queries, errors and :stats with one line each") {
+        auto files = TemporaryFiles{};
+        const auto document = files.add("doc.json", R"({"a": [1, 2, 3]})");
+        const auto requests = files.add("requests.txt", "size(a)\nmissing.key\n:stats\n");
+        const auto output = (files.directory / "output.txt").string();
+        REQUIRE_EQ(run_json_eval("--serve '" + document + "' < '" + requests + "' > '" + output + "' 2> /dev/null"),
+                   0);
+
+        const auto responses = json_lines(output);
+        REQUIRE_EQ(responses.size(), 3);
+        for (const auto &response : responses) {
+            const auto *micros = member(response, "micros");
+            REQUIRE(micros != nullptr);
+            CHECK(micros->is_numeric());
+        }
+
+        const auto *result = member(responses[0], "result");
+        REQUIRE(result != nullptr);
+        CHECK_EQ(result->as_integer(), 3);
+
+        const auto *error = member(responses[1], "error");
+        REQUIRE(error != nullptr);
+        CHECK(error->is_string());
+        CHECK(member(responses[1], "result") == nullptr);
+
+        // Latencies of the two queries before it, the request itself isn't counted
+        const auto *stats = member(responses[2], "result");
+        REQUIRE(stats != nullptr);
+        REQUIRE(stats->is_object());
+        CHECK_EQ(stats->as_object().at("count").as_integer(), 2);
+        CHECK(stats->as_object().contains("p50_us"));
+        CHECK(stats->as_object().contains("max_us"));
+    }
+
+    TEST_CASE("Multi-file output keeps the input order with several workers") {
+        auto files = TemporaryFiles{};
+        const auto inputs = files.directory / "inputs";
+
+        // Large and small files alternate, so the workers finish them out of order
+        constexpr auto file_count = 24;
+        auto expected = std::vector<std::pair<std::string, int>>{};
+        for (auto i = 0; i < file_count; i++) {
+            const auto count = i % 2 == 0 ? 20'000 : 3;
+            const auto name = std::format("file_{:02}.json", i);
+            files.add("inputs/" + name, numbers_document(count));
+            expected.emplace_back((inputs / name).string(), count);
+        }
+
+        const auto output = (files.directory / "output.txt").string();
+        REQUIRE_EQ(run_json_eval("--jobs 4 --io-threads 2 --max-in-flight 3 '" + inputs.string() +
+                                 "' 'size(values)' > '" + output + "' 2> /dev/null"),
+                   0);
+
+        const auto lines = json_lines(output);
+        REQUIRE_EQ(lines.size(), expected.size());
+        for (auto i = std::size_t{0}; i < lines.size(); i++) {
+            const auto *path = member(lines[i], "path");
+            const auto *result = member(lines[i], "result");
+            REQUIRE(path != nullptr);
+            REQUIRE(result != nullptr);
+            CHECK_EQ(path->as_string(), expected[i].first);
+            CHECK_EQ(result->as_integer(), expected[i].second);
+        }
+    }
+
+    TEST_CASE("--batch rejects a query name used twice") {
+        auto files = TemporaryFiles{};
+        const auto document = files.add("doc.json", R"({"a": [1, 2, 3]})");
+        const auto unique = files.add("unique.txt", "count: size(a)\nfirst: a[0]\n");
+        const auto duplicate = files.add("duplicate.txt", "count: size(a)\n\ncount: a[0]\n");
+        const auto errors = (files.directory / "errors.txt").string();
+
+        CHECK_EQ(run_json_eval("'" + document + "' --batch '" + unique + "' > /dev/null 2> /dev/null"), 0);
+        CHECK_NE(run_json_eval("'" + document + "' --batch '" + duplicate + "' > /dev/null 2> '" + errors + "'"), 0);
+        const auto message = read_file(errors).value_or("");
+        CHECK(message.find(duplicate + ":3: Duplicate query name 'count'") != std::string::npos);
+    }
+
+    TEST_CASE("A directory without JSON files is an error like a glob without matches") {
+        auto files = TemporaryFiles{};
+        files.add("empty/notes.txt", "not json");
+        const auto empty = (files.directory / "empty").string();
+        CHECK_NE(run_json_eval("'" + empty + "' 'a' > /dev/null 2> /dev/null"), 0);
+        CHECK_NE(run_json_eval("'" + empty + "/*.json' 'a' > /dev/null 2> /dev/null"), 0);
+    }
+
+    TEST_CASE("--stats reports the phases and counts of a small document") {
+        auto files = TemporaryFiles{};
+        const auto text = std::string{R"({"a": [1, 2, 3], "b": "text"})"};
+        const auto document = files.add("small.json", text);
+        const auto stats_path = (files.directory / "stats.json").string();
+        REQUIRE_EQ(run_json_eval("--stats=json '" + document + "' 'size(a)' > /dev/null 2> '" + stats_path + "'",
+                                 JSON_EVAL_COUNTING),
+                   0);
+
+        const auto lines = json_lines(stats_path);
+        REQUIRE_EQ(lines.size(), 1);
+        REQUIRE(lines[0].is_object());
+        const auto &stats = lines[0].as_object();
+        CHECK_EQ(stats.at("input").as_string(), document);
+        CHECK_EQ(stats.at("compression").as_string(), "uncompressed");
+
+        // Every phase of a single document ran, on at most what its input was
+        const auto &phases = stats.at("phases").as_object();
+        const auto expected_bytes = std::vector<std::pair<std::string, std::size_t>>{
+            {"read", text.size()}, {"lex", text.size()}, {"parse", text.size()},
+            {"query_parse", 7},    {"evaluate", 0},      {"output", 1},
+        };
+        CHECK_EQ(phases.size(), expected_bytes.size());
+        for (const auto &[name, bytes] : expected_bytes) {
+            const auto *phase = member(stats.at("phases"), name);
+            REQUIRE(phase != nullptr);
+            const auto wall = phase->as_object().at("wall_seconds").to_double();
+            const auto cpu = phase->as_object().at("cpu_seconds").to_double();
+            CHECK(wall >= 0);
+            CHECK(wall < 10);
+            CHECK(cpu >= 0);
+            CHECK(cpu < 10);
+            CHECK_EQ(phase->as_object().at("bytes").as_integer(), static_cast<jp::JSONInteger>(bytes));
+        }
+
+        // {"a": [1, 2, 3], "b": "text"} is 15 tokens and 6 nodes
+        CHECK_EQ(stats.at("tokens").as_integer(), 15);
+        const auto &nodes = stats.at("nodes").as_object();
+        CHECK_EQ(nodes.at("object").as_integer(), 1);
+        CHECK_EQ(nodes.at("array").as_integer(), 1);
+        CHECK_EQ(nodes.at("integer").as_integer(), 3);
+        CHECK_EQ(nodes.at("string").as_integer(), 1);
+        CHECK_GT(stats.at("dom_bytes").as_integer(), 0);
+        CHECK_GT(stats.at("peak_rss_bytes").as_integer(), 0);
+        const auto &instructions = stats.at("instructions");
+        CHECK((instructions.is_null() || instructions.as_integer() > 0));
+
+        const auto allocations = stats.at("allocations").as_integer();
+        CHECK_GT(allocations, 0);
+        const auto &categories = stats.at("allocations_by_category").as_object();
+        auto by_category = jp::JSONInteger{0};
+        for (const auto &[category, counts] : categories) {
+            by_category += counts.as_object().at("allocations").as_integer();
+        }
+        CHECK_EQ(by_category, allocations);
+        CHECK_GT(categories.at("parser_arrays").as_object().at("allocations").as_integer(), 0);
+    }
+
+    TEST_CASE("json-eval only counts allocations when built with ENABLE_ALLOCATION_COUNTING") {
+        auto files = TemporaryFiles{};
+        const auto document = files.add("small.json", R"({"a": [1, 2, 3]})");
+        const auto stats_path = (files.directory / "stats.json").string();
+        REQUIRE_EQ(run_json_eval("--stats=json '" + document + "' 'size(a)' > /dev/null 2> '" + stats_path + "'"), 0);
+
+        const auto lines = json_lines(stats_path);
+        REQUIRE_EQ(lines.size(), 1);
+        REQUIRE(lines[0].is_object());
+        const auto &allocations = lines[0].as_object().at("allocations");
+        if (JSON_EVAL_COUNTS_ALLOCATIONS) {
+            CHECK(allocations.as_integer() > 0);
+        } else {
+            CHECK(allocations.is_null());
+        }
+    }
+
+    TEST_CASE("--trace writes a Chrome trace whose spans are balanced on every thread") {
+        auto files = TemporaryFiles{};
+        for (auto i = 0; i < 4; i++) {
+            files.add(std::format("inputs/file_{}.json", i), numbers_document(1'000));
+        }
+        const auto trace_path = (files.directory / "trace.json").string();
+        REQUIRE_EQ(run_json_eval("--jobs 2 --trace '" + trace_path + "' '" + (files.directory / "inputs").string() +
+                                 "' 'sum(values)' > /dev/null 2>&1"),
+                   0);
+
+        const auto trace = jp::parse(read_file(trace_path).value_or(""));
+        REQUIRE(trace.has_value());
+        const auto *events = member(trace.value(), "traceEvents");
+        REQUIRE(events != nullptr);
+        REQUIRE(events->is_array());
+
+        // Complete events carry their duration, begin and end events come in pairs. Either way the spans of one
+        // thread have to nest like a stack.
+        struct Span {
+            double begin;
+            double end;
+        };
+        auto complete = std::map<jp::JSONInteger, std::vector<Span>>{};
+        auto open = std::map<jp::JSONInteger, int>{};
+        auto names = std::set<std::string>{};
+        for (const auto &event : events->as_array()) {
+            const auto &fields = event.as_object();
+            const auto &phase = fields.at("ph").as_string();
+            if (phase == "M") {
+                continue;
+            }
+            names.insert(fields.at("name").as_string());
+            const auto thread = fields.at("tid").as_integer();
+            if (phase == "X") {
+                const auto begin = fields.at("ts").to_double();
+                const auto duration = fields.at("dur").to_double();
+                CHECK(duration >= 0);
+                complete[thread].push_back({begin, begin + duration});
+            } else {
+                REQUIRE((phase == "B" || phase == "E"));
+                open[thread] += phase == "B" ? 1 : -1;
+                CHECK(open[thread] >= 0);
+            }
+        }
+        for (const auto &[thread, count] : open) {
+            CHECK_EQ(count, 0);
+        }
+        CHECK_GT(complete.size(), 1);
+        for (const auto *name : {"query_parse", "read batch", "file", "parse", "evaluate", "sum"}) {
+            CHECK(names.contains(name));
+        }
+
+        // Times are rounded to nanoseconds, so a child may seem to end a little after its parent
+        constexpr auto rounding = 0.002;
+        for (auto &[thread, spans] : complete) {
+            std::ranges::sort(spans, [](const Span &lhs, const Span &rhs) {
+                return lhs.begin != rhs.begin ? lhs.begin < rhs.begin : lhs.end > rhs.end;
+            });
+            auto enclosing = std::vector<double>{};
+            for (const auto &span : spans) {
+                while (!enclosing.empty() && enclosing.back() <= span.begin + rounding) {
+                    enclosing.pop_back();
+                }
+                if (!enclosing.empty()) {
+                    CHECK(span.end <= enclosing.back() + rounding);
+                }
+                enclosing.push_back(span.end);
+            }
+        }
+        CHECK_EQ(member(trace.value(), "otherData")->as_object().at("dropped_events").as_integer(), 0);
+    }
+}
+
@@ -0,0 +1,120 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include "bounded_queue.hpp"
+#include "file_reader.hpp"
+#include "../test_shared.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace jp;
+
+namespace {
+auto read_all(FileReader &reader, const std::vector<std::string> &paths, std::size_t first, std::size_t count)
+    -> std::map<std::size_t, std::optional<std::string>> {
+    auto files = std::map<std::size_t, std::optional<std::string>>{};
+    reader.read(paths, first, count, [&](std::size_t index, std::optional<std::string> content) {
+        CHECK_FALSE(files.contains(index));
+        files[index] = std::move(content);
+    });
+    return files;
+}
+} // namespace
+
+TEST_SUITE("Common") {
+
+    TEST_CASE("FileReader reads whole files with either backend") {
+        auto files = TemporaryFiles{};
+        // Sizes around the 64 KiB io_uring buffers, files past it are finished with pread
+        const auto contents = std::vector<std::string>{
+            "",
+            "[1, 2, 3]",
+            std::string((std::size_t{64} << 10) - 1, 'a'),
+            std::string(std::size_t{64} << 10, 'b'),
+            std::string((std::size_t{64} << 10) + 1, 'c'),
+            std::string(std::size_t{300} << 10, 'd'),
+        };
+        auto paths = std::vector<std::string>{};
+        for (auto i = std::size_t{0}; i < contents.size(); i++) {
+            paths.push_back(files.add("file" + std::to_string(i) + ".json", contents[i]));
+        }
+        paths.push_back((files.directory / "missing.json").string());
+
+        for (const auto backend : {FileReader::Backend::IoUring, FileReader::Backend::Pread}) {
+            // A queue shallower than the batch reuses its slots
+            auto reader = FileReader(2, backend);
+            if (backend == FileReader::Backend::Pread) {
+                CHECK(reader.backend() == FileReader::Backend::Pread);
+            }
+
+            const auto read = read_all(reader, paths, 0, paths.size());
+            REQUIRE_EQ(read.size(), paths.size());
+            for (auto i = std::size_t{0}; i < contents.size(); i++) {
+                REQUIRE(read.at(i).has_value());
+                CHECK_EQ(read.at(i)->size(), contents[i].size());
+                CHECK(*read.at(i) == contents[i]);
+            }
+            CHECK_FALSE(read.at(contents.size()).has_value());
+
+            // Only the requested range is read
+            const auto middle = read_all(reader, paths, 2, 3);
+            REQUIRE_EQ(middle.size(), 3);
+            CHECK_EQ(middle.begin()->first, 2);
+            CHECK(*middle.at(4) == contents[4]);
+        }
+    }
+
+    TEST_CASE("pread_file reads files and reports the ones it can't open") {
+        auto files = TemporaryFiles{};
+        const auto path = files.add("small.json", R"({"a": 1})");
+        CHECK_EQ(pread_file(path), std::optional<std::string>{R"({"a": 1})"});
+        CHECK_FALSE(pread_file((files.directory / "missing.json").string()).has_value());
+        CHECK_FALSE(pread_file(files.directory.string()).has_value());
+    }
+
+    TEST_CASE("BoundedQueue blocks producers at capacity until an element is taken") {
+        using namespace std::chrono_literals;
+        auto queue = BoundedQueue<int>{2};
+        REQUIRE(queue.push(1));
+        REQUIRE(queue.push(2));
+
+        auto pushed = std::atomic<bool>{false};
+        auto producer = std::thread{[&] {
+            CHECK(queue.push(3));
+            pushed = true;
+        }};
+        std::this_thread::sleep_for(50ms);
+        CHECK_FALSE(pushed.load());
+
+        CHECK_EQ(queue.pop(), std::optional<int>{1});
+        producer.join();
+        CHECK(pushed.load());
+        CHECK_EQ(queue.pop(), std::optional<int>{2});
+        CHECK_EQ(queue.pop(), std::optional<int>{3});
+    }
+
+    TEST_CASE("Closing a BoundedQueue releases blocked producers and consumers") {
+        using namespace std::chrono_literals;
+        auto full = BoundedQueue<int>{1};
+        REQUIRE(full.push(1));
+        auto rejected = std::thread{[&] { CHECK_FALSE(full.push(2)); }};
+
+        auto empty = BoundedQueue<int>{1};
+        auto drained = std::thread{[&] { CHECK_FALSE(empty.pop().has_value()); }};
+
+        std::this_thread::sleep_for(20ms);
+        full.close();
+        empty.close();
+        rejected.join();
+        drained.join();
+
+        // Elements queued before closing are still handed out
+        CHECK_EQ(full.pop(), std::optional<int>{1});
+        CHECK_FALSE(full.pop().has_value());
+    }
+}
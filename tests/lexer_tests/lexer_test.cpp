@@ -4,6 +4,11 @@
 #include "expected.hpp"
 #include "token.hpp"
 #include "error.hpp"
+#include "scan.hpp"
+#include "utf8.hpp"
+#include <array>
+#include <limits>
+#include <string>
 
 using namespace jp;
 
@@ -169,6 +174,63 @@ TEST_SUITE("Lexer") {
         REQUIRE(token.has_value());
         REQUIRE(token->has_error());
     }
+
+    TEST_CASE("Lexer recognizes negative numbers and exponents") {
+        const auto [tokens, errors] = collect_tokens("-12 -0.5 15e-1 2E+2 -9223372036854775808 18446744073709551616");
+        REQUIRE(errors.empty());
+        REQUIRE_EQ(tokens.size(), 6);
+
+        const auto number = [&](std::size_t i) { return std::get<Number>(tokens[i].token_type).value; };
+        CHECK(number(0) == num_type{std::int64_t{-12}});
+        CHECK(number(1) == num_type{-0.5});
+        CHECK(number(2) == num_type{1.5});
+        CHECK(number(3) == num_type{std::int64_t{200}});
+        CHECK(number(4) == num_type{std::numeric_limits<std::int64_t>::min()});
+        CHECK(number(5) == num_type{18446744073709551616.0});
+    }
+
+    TEST_CASE("Lexer rounds numbers too small for a double to zero") {
+        const auto [tokens, errors] = collect_tokens("123e-10000000 -1e-400");
+        REQUIRE(errors.empty());
+        REQUIRE_EQ(tokens.size(), 2);
+        CHECK(std::get<Number>(tokens[0].token_type).value == num_type{0.0});
+        CHECK(std::get<Number>(tokens[1].token_type).value == num_type{-0.0});
+    }
+
+    TEST_CASE("Lexer rejects malformed numbers") {
+        for (const auto *source : {"-", "-x", "1.", "1.e3", "2.e", "1e+", "1e400", "-123123e100000"}) {
+            INFO("Source: " << source);
+            auto lexer = Lexer(source);
+            auto token = lexer.next_token();
+            REQUIRE(token.has_value());
+            CHECK(token->has_error());
+        }
+    }
+
+    TEST_CASE("Lexer rejects unescaped control characters in strings") {
+        Lexer lexer("\"a\tb\"");
+
+        auto token = lexer.next_token();
+        REQUIRE(token.has_value());
+        REQUIRE(token->has_error());
+        CHECK(token->error().code == ErrorCode::UnescapedControlCharacter);
+    }
+
+    TEST_CASE("Lexer validates strings as UTF-8") {
+        const auto *const source = "\"caf\xc3\xa9 \xed\xa0\x80!\"";
+
+        auto strict = Lexer(source).next_token();
+        REQUIRE(strict.has_value());
+        REQUIRE(strict->has_error());
+        CHECK(strict->error().code == ErrorCode::InvalidUtf8);
+
+        // The surrogate is ill-formed from its second byte on, each byte is replaced on its own
+        auto lenient = Lexer(source, utf8::Mode::Lenient).next_token();
+        REQUIRE(lenient.has_value());
+        REQUIRE(lenient->has_value());
+        CHECK_EQ(std::get<String>(lenient->value().token_type).value,
+                 std::string{"caf\xc3\xa9 \xef\xbf\xbd\xef\xbf\xbd\xef\xbf\xbd!"});
+    }
 }
 
 TEST_SUITE("Lexer::Iterator") {
@@ -196,3 +258,135 @@ TEST_SUITE("Lexer::Iterator") {
         }
     }
 }
+
+TEST_SUITE("StreamLexer") {
+    TEST_CASE("Tokens split across chunks match lexing the whole document") {
+        const auto source = std::string{R"({"name": "a \"quoted\" [value]", "values": [12, 3.25, 1e3],)"} +
+                            "\n" + R"( "flags": [true, false, null], "nested": {"key": "x,y:z"}})";
+        const auto [expected, expected_errors] = collect_tokens(source);
+        REQUIRE(expected_errors.empty());
+
+        for (auto chunk_size = std::size_t{1}; chunk_size <= source.size(); chunk_size++) {
+            auto lexer = StreamLexer{};
+            for (auto offset = std::size_t{0}; offset < source.size(); offset += chunk_size) {
+                lexer.feed(std::string_view{source}.substr(offset, chunk_size));
+            }
+            lexer.finish();
+
+            CHECK(lexer.errors().empty());
+            REQUIRE_EQ(lexer.tokens().size(), expected.size());
+            for (auto i = std::size_t{0}; i < expected.size(); i++) {
+                CHECK(lexer.tokens()[i] == expected[i]);
+                CHECK_EQ(to_string(lexer.tokens()[i].token_type), to_string(expected[i].token_type));
+            }
+        }
+    }
+
+    TEST_CASE("Errors keep their position in the document") {
+        auto lexer = StreamLexer{};
+        lexer.feed("[1,\n  tr");
+        lexer.feed("ux]");
+        lexer.finish();
+
+        REQUIRE_EQ(lexer.errors().size(), 1);
+        CHECK_EQ(lexer.errors().front().line, 2);
+    }
+}
+
+TEST_SUITE("Scan kernels") {
+    // Every level the machine supports against the scalar loops, for runs ending at each offset of a vector block
+    TEST_CASE("Vectorized kernels agree with the scalar ones") {
+        const auto &scalar = scan::kernels(cpu::Level::Scalar);
+        for (auto i = std::size_t{1}; i <= static_cast<std::size_t>(cpu::detected_level()); i++) {
+            const auto &vectorized = scan::kernels(static_cast<cpu::Level>(i));
+            INFO("Level: " << cpu::level_name(static_cast<cpu::Level>(i)));
+
+            for (auto length = std::size_t{0}; length < 150; length++) {
+                auto whitespace = std::string{};
+                for (auto j = std::size_t{0}; j < length; j++) {
+                    whitespace += " \t\n\r"[(j * 7 + length) % 4];
+                }
+                for (const auto *end : {"", "x", "\"", "\n"}) {
+                    const auto text = whitespace + end;
+                    const auto expected = scalar.skip_whitespace(text.data(), text.size());
+                    const auto actual = vectorized.skip_whitespace(text.data(), text.size());
+                    CHECK_EQ(actual.size, expected.size);
+                    CHECK_EQ(actual.newlines, expected.newlines);
+                    if (expected.newlines > 0) {
+                        CHECK_EQ(actual.last_newline, expected.last_newline);
+                    }
+                }
+
+                for (const auto special : {'"', '\\', '\x01', '\x1f'}) {
+                    auto text = std::string(length, 'a') + special + "\"";
+                    if (length > 0) {
+                        text[length / 2] = '\x7f';
+                    }
+                    CHECK_EQ(vectorized.find_string_special(text.data(), text.size()), length);
+                    CHECK_EQ(vectorized.find_string_special(text.data(), length), length);
+                }
+            }
+        }
+    }
+
+    TEST_CASE("Line and column after whitespace") {
+        auto lexer = Lexer("  \n\n    \r\n\t  1");
+        const auto token = lexer.next_token();
+        REQUIRE(token.has_value());
+        REQUIRE(token->has_value());
+        CHECK_EQ(token->value().row, 4);
+        CHECK_EQ(token->value().col, 4);
+    }
+}
+
+TEST_SUITE("UTF-8 kernels") {
+    TEST_CASE("Well-formed and ill-formed sequences") {
+        for (const auto *valid : {"", "ascii", "\xc2\x80", "\xdf\xbf", "\xe0\xa0\x80", "\xed\x9f\xbf", "\xee\x80\x80",
+                                  "\xf0\x90\x80\x80", "\xf4\x8f\xbf\xbf"}) {
+            INFO("Valid: " << valid);
+            CHECK(utf8::is_valid(valid));
+        }
+        // Overlong forms, surrogates, code points past U+10FFFF, lone continuations and cut sequences
+        for (const auto *invalid : {"\xc0\xaf", "\xc1\xbf", "\xe0\x9f\xbf", "\xed\xa0\x80", "\xf0\x8f\xbf\xbf",
+                                    "\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\xff", "\x80", "\xe2\x82",
+                                    "\xf0\x9f\x98"}) {
+            INFO("Invalid: " << invalid);
+            CHECK_FALSE(utf8::is_valid(invalid));
+            CHECK_EQ(utf8::first_invalid(invalid), 0);
+        }
+    }
+
+    TEST_CASE("Invalid subparts are replaced with U+FFFD") {
+        CHECK_EQ(utf8::repair("a\xff" "b"), std::string{"a\xef\xbf\xbd" "b"});
+        // A cut sequence is one maximal subpart
+        CHECK_EQ(utf8::repair("\xe2\x82x\xf0\x9f\x98"), std::string{"\xef\xbf\xbdx\xef\xbf\xbd"});
+        CHECK_EQ(utf8::repair("\xe2\x82\xac"), std::string{"\xe2\x82\xac"});
+    }
+
+    // Every level the machine supports against the scalar validator, with an invalid byte or a cut sequence at every
+    // offset of a vector block and across block boundaries
+    TEST_CASE("Vectorized kernels agree with the scalar one") {
+        auto text = std::string{};
+        for (auto i = 0; text.size() < 200; i++) {
+            text += std::array{"a", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9f\x98\x80", " b"}[i % 5];
+        }
+
+        const auto &scalar = utf8::kernels(cpu::Level::Scalar);
+        for (auto i = std::size_t{1}; i <= static_cast<std::size_t>(cpu::detected_level()); i++) {
+            const auto &vectorized = utf8::kernels(static_cast<cpu::Level>(i));
+            INFO("Level: " << cpu::level_name(static_cast<cpu::Level>(i)));
+
+            for (auto length = std::size_t{0}; length <= text.size(); length++) {
+                CHECK_EQ(vectorized.validate(text.data(), length), scalar.validate(text.data(), length));
+            }
+            for (auto position = std::size_t{0}; position < text.size(); position++) {
+                for (const auto byte : {0x80, 0xa0, 0xbf, 0xc0, 0xc3, 0xe0, 0xed, 0xf0, 0xf4, 0xf5, 0xff, 0x41}) {
+                    auto mutated = text;
+                    mutated[position] = static_cast<char>(byte);
+                    CHECK_EQ(vectorized.validate(mutated.data(), mutated.size()),
+                             scalar.validate(mutated.data(), mutated.size()));
+                }
+            }
+        }
+    }
+}
@@ -1,6 +1,8 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
 #include "parser.hpp"
+#include "memory.hpp"
+#include "memory_usage.hpp"
 
 using namespace jp;
 
@@ -100,3 +102,80 @@ TEST_SUITE("Parser") {
         CHECK(std::get<JSONDouble>(result->value) == 123.45);
     }
 }
+
+TEST_SUITE("Memory") {
+
+    TEST_CASE("A scalar only takes its own value") {
+        auto result = parse("123");
+        auto usage = memory_usage(result.value());
+        CHECK(usage.nodes == 1);
+        CHECK(usage.total() == sizeof(JSONValue));
+    }
+
+    TEST_CASE("Short strings stay inline, long ones count their heap block") {
+        auto short_string = parse(R"("abc")");
+        CHECK(memory_usage(short_string.value()).string_bytes == 0);
+
+        const auto text = std::string(100, 'x');
+        auto long_string = parse("\"" + text + "\"");
+        CHECK(memory_usage(long_string.value()).string_bytes > text.size());
+    }
+
+    TEST_CASE("Arrays count their capacity and their elements") {
+        auto json = std::string{"["};
+        for (auto i = 0; i < 1000; i++) {
+            json += std::to_string(i) + (i + 1 < 1000 ? ", " : "]");
+        }
+        auto result = parse(json);
+        auto usage = memory_usage(result.value());
+        CHECK(usage.nodes == 1001);
+        CHECK(usage.array_bytes >= 1000 * sizeof(JSONValue));
+        // Growth by doubling never more than doubles the elements
+        CHECK(usage.array_bytes <= 2 * 1000 * sizeof(JSONValue));
+        CHECK(usage.ratio_to(json.size()) > 0.0);
+    }
+
+    TEST_CASE("Objects count their nodes, buckets and keys") {
+        auto result = parse(R"({"a": 1, "a key that does not fit inline": 2})");
+        auto usage = memory_usage(result.value());
+        CHECK(usage.nodes == 3);
+        CHECK(usage.object_bytes >= 2 * sizeof(std::pair<const std::string, JSONValue>));
+        CHECK(usage.string_bytes > 0);
+    }
+
+    TEST_CASE("Allocations are attributed to the lexer and the parser") {
+        memory::reset();
+        memory::start_counting();
+        auto result = parse(R"({"key": ["a string that does not fit inline", {"nested": [1, 2, 3]}]})");
+        memory::stop_counting();
+
+        CHECK(result.has_value());
+        CHECK(memory::counts(memory::Category::Lexer).allocations > 0);
+        CHECK(memory::counts(memory::Category::ParserObjects).allocations > 0);
+        CHECK(memory::counts(memory::Category::ParserArrays).allocations > 0);
+        CHECK(memory::counts(memory::Category::ParserStrings).allocations > 0);
+        CHECK(memory::counts(memory::Category::Evaluator).allocations == 0);
+        CHECK(memory::total().bytes >= memory::counts(memory::Category::Lexer).bytes);
+    }
+
+    TEST_CASE("Scopes nest and restore the outer category") {
+        auto inner_text = std::string{};
+        auto outer_text = std::string{};
+        memory::reset();
+        memory::start_counting();
+        {
+            auto outer = memory::Scope{memory::Category::Evaluator};
+            {
+                auto inner = memory::Scope{memory::Category::Lexer};
+                inner_text.assign(100, 'x');
+            }
+            outer_text.assign(100, 'y');
+        }
+        memory::stop_counting();
+
+        CHECK(inner_text.size() + outer_text.size() == 200);
+        CHECK(memory::counts(memory::Category::Lexer).allocations == 1);
+        CHECK(memory::counts(memory::Category::Evaluator).allocations == 1);
+        CHECK(memory::counts(memory::Category::Other).allocations == 0);
+    }
+}
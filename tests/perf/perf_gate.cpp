@@ -0,0 +1,328 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include "bench_shared.hpp"
+#include "generators.hpp"
+#include "jsonobject.hpp"
+#include "parser.hpp"
+#include "../test_shared.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <format>
+#include <map>
+#include <sys/resource.h>
+
+// Runs json-eval-counting end to end over a generated corpus and compares what it costs with tests/perf/baseline.json, so a
+// change that makes a case much slower or allocate more fails here instead of in production. Baselines are kept per
+// compiler and build type. Instructions are the stable measure of work; where the machine has no hardware counters the
+// CPU time is compared instead, in units of a fixed workload timed by the gate, with a wider tolerance.
+//
+// A configuration without a baseline of its own is compared with the loosest of the recorded ones, on allocations and
+// CPU units only, which don't depend on the compiler as much as instructions do, and with the even wider
+// `tolerance_across_configurations`. Only a baseline file without any configuration makes the gate print
+// `skipped_marker`, which ctest reports as a skipped test rather than a pass.
+//
+// JSON_EVAL_UPDATE_BASELINE=1 ctest -R perf_gate records the current costs for this configuration.
+
+namespace {
+
+struct Case {
+    std::string_view name;
+    std::string_view document;
+    std::string_view query;
+};
+
+constexpr Case cases[] = {
+    {"records_member", "records", "items[100].name"},
+    {"records_filter", "records", "items[?(price > 500)]"},
+    {"records_sum", "records", "sum(items[*].price)"},
+    {"records_top_k", "records", "top_k(items[*].price, 10)"},
+    {"wide_object", "wide_object", "key_10"},
+    {"number_heavy", "number_heavy", "size(values)"},
+    {"string_heavy", "string_heavy", "strings[3]"},
+    {"deep_nesting", "deep_nesting", "size(items)"},
+};
+
+// Kept in sync with SKIP_REGULAR_EXPRESSION in tests/CMakeLists.txt
+constexpr auto skipped_marker = "perf gate skipped";
+
+constexpr auto document_bytes = std::size_t{128} << 10;
+constexpr auto runs = 3;
+
+struct Cost {
+    std::size_t allocations = 0;
+    std::optional<std::int64_t> instructions;
+    // CPU time of the run divided by the CPU time of calibration_seconds()
+    double cpu_units = 0;
+};
+
+struct Tolerance {
+    double allocations = 0.02;
+    double instructions = 0.05;
+    double cpu_units = 1.0;
+};
+
+// A different standard library allocates differently and a different optimizer takes a different time, a 3x regression
+// still fails
+constexpr auto default_tolerance_across_configurations = Tolerance{.allocations = 0.25, .cpu_units = 1.5};
+
+auto write_document(std::string_view name) -> std::string {
+    const auto path = std::filesystem::path{PERF_CORPUS_DIR} / (std::string{name} + ".json");
+    if (std::filesystem::exists(path)) {
+        return path.string();
+    }
+
+    auto json = std::string{};
+    if (name == "deep_nesting") {
+        json = generators::deep_nesting(document_bytes, 8);
+    } else if (name == "wide_object") {
+        json = generators::wide_object(document_bytes);
+    } else if (name == "number_heavy") {
+        json = generators::number_heavy(document_bytes);
+    } else if (name == "string_heavy") {
+        json = generators::string_heavy(document_bytes);
+    } else {
+        json = generators::records(document_bytes);
+    }
+    std::filesystem::create_directories(PERF_CORPUS_DIR);
+    std::ofstream{path} << json;
+    return path.string();
+}
+
+auto cpu_seconds(const timeval &user, const timeval &system) -> double {
+    return static_cast<double>(user.tv_sec + system.tv_sec) + static_cast<double>(user.tv_usec + system.tv_usec) * 1e-6;
+}
+
+auto children_cpu_seconds() -> double {
+    auto usage = rusage{};
+    getrusage(RUSAGE_CHILDREN, &usage);
+    return cpu_seconds(usage.ru_utime, usage.ru_stime);
+}
+
+// The best CPU time of sorting a fixed sequence, compiled like the binary under test
+auto calibration_seconds() -> double {
+    auto best = 0.0;
+    for (auto run = 0; run < 5; run++) {
+        auto random = generators::Random{5};
+        auto values = std::vector<std::uint64_t>(std::size_t{1} << 18);
+        auto start = timespec{};
+        auto end = timespec{};
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &start);
+        std::generate(values.begin(), values.end(), [&] { return random.next(); });
+        std::sort(values.begin(), values.end());
+        do_not_optimize(values.data());
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &end);
+
+        const auto elapsed = static_cast<double>(end.tv_sec - start.tv_sec) +
+                             static_cast<double>(end.tv_nsec - start.tv_nsec) * 1e-9;
+        best = run == 0 ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+// Runs the case `runs` times on one thread, the reductions would otherwise be chunked by the core count
+auto measure(const Case &test_case, double calibration) -> std::optional<Cost> {
+    const auto document = write_document(test_case.document);
+    const auto stats_path = (std::filesystem::path{PERF_CORPUS_DIR} / "stats.json").string();
+    const auto command = std::format("'{}' --stats=json --threads 1 '{}' '{}' > /dev/null 2> '{}'", JSON_EVAL,
+                                     document, test_case.query, stats_path);
+
+    auto cost = Cost{};
+    for (auto run = 0; run < runs; run++) {
+        const auto cpu_before = children_cpu_seconds();
+        if (std::system(command.c_str()) != 0) {
+            return std::nullopt;
+        }
+        const auto cpu_units = (children_cpu_seconds() - cpu_before) / calibration;
+
+        const auto stats = jp::parse(read_file(stats_path).value_or(""));
+        if (!stats.has_value() || !stats->is_object()) {
+            return std::nullopt;
+        }
+        const auto &members = stats->as_object();
+        const auto instructions = members.at("instructions");
+        cost.allocations = static_cast<std::size_t>(members.at("allocations").as_integer());
+        if (instructions.is_integer()) {
+            const auto count = instructions.as_integer();
+            cost.instructions = std::min(cost.instructions.value_or(count), count);
+        }
+        cost.cpu_units = run == 0 ? cpu_units : std::min(cost.cpu_units, cpu_units);
+    }
+    return cost;
+}
+
+auto number(const jp::JSONObject &object, const std::string &key) -> std::optional<double> {
+    const auto member = object.find(key);
+    if (member == object.end() || !member->second.is_numeric()) {
+        return std::nullopt;
+    }
+    return member->second.is_integer() ? static_cast<double>(member->second.as_integer()) : member->second.as_double();
+}
+
+auto member_object(const jp::JSONObject &object, const std::string &key) -> const jp::JSONObject * {
+    const auto member = object.find(key);
+    return member == object.end() || !member->second.is_object() ? nullptr : &member->second.as_object();
+}
+
+auto read_costs(const jp::JSONObject &entries) -> std::map<std::string, Cost> {
+    auto costs = std::map<std::string, Cost>{};
+    for (const auto &[name, entry] : entries) {
+        if (!entry.is_object()) {
+            continue;
+        }
+        const auto &values = entry.as_object();
+        auto &cost = costs[name];
+        cost.allocations = static_cast<std::size_t>(number(values, "allocations").value_or(0));
+        if (const auto instructions = number(values, "instructions")) {
+            cost.instructions = static_cast<std::int64_t>(*instructions);
+        }
+        cost.cpu_units = number(values, "cpu_units").value_or(0);
+    }
+    return costs;
+}
+
+auto read_tolerance(const jp::JSONObject &root, const std::string &key, Tolerance tolerance) -> Tolerance {
+    if (const auto *values = member_object(root, key)) {
+        tolerance.allocations = number(*values, "allocations").value_or(tolerance.allocations);
+        tolerance.instructions = number(*values, "instructions").value_or(tolerance.instructions);
+        tolerance.cpu_units = number(*values, "cpu_units").value_or(tolerance.cpu_units);
+    }
+    return tolerance;
+}
+
+// The highest cost of each case over every recorded configuration, without instructions
+auto loosest_costs(const jp::JSONObject &configurations) -> std::map<std::string, Cost> {
+    auto loosest = std::map<std::string, Cost>{};
+    for (const auto &[configuration, entries] : configurations) {
+        if (!entries.is_object()) {
+            continue;
+        }
+        for (const auto &[name, cost] : read_costs(entries.as_object())) {
+            auto &highest = loosest[name];
+            highest.allocations = std::max(highest.allocations, cost.allocations);
+            highest.cpu_units = std::max(highest.cpu_units, cost.cpu_units);
+        }
+    }
+    return loosest;
+}
+
+// Fails when `measured` exceeds `baseline` by more than `tolerance`, a fraction of the baseline
+void check_cost(const std::string &name, std::string_view what, double measured, double baseline,
+                double tolerance) {
+    if (measured > baseline * (1 + tolerance)) {
+        FAIL_CHECK(name << ": " << what << " grew from " << baseline << " to " << measured << ", more than "
+                        << tolerance * 100 << "%");
+    } else if (measured < baseline * (1 - tolerance)) {
+        MESSAGE(name << ": " << what << " improved from " << baseline << " to " << measured
+                     << ", consider updating the baseline");
+    }
+}
+
+// Compares every case with its baseline, instructions where both counted them and CPU units otherwise
+void check_costs(const std::map<std::string, Cost> &costs, const std::map<std::string, Cost> &baselines,
+                 const Tolerance &tolerance, std::string_view configuration) {
+    for (const auto &[name, cost] : costs) {
+        const auto baseline = baselines.find(name);
+        if (baseline == baselines.end()) {
+            FAIL_CHECK("No baseline for case " << name << " in " << configuration
+                                               << ", record one with JSON_EVAL_UPDATE_BASELINE=1");
+            continue;
+        }
+
+        const auto &expected = baseline->second;
+        check_cost(name, "allocations", static_cast<double>(cost.allocations),
+                   static_cast<double>(expected.allocations), tolerance.allocations);
+        if (expected.instructions && cost.instructions) {
+            check_cost(name, "instructions", static_cast<double>(*cost.instructions),
+                       static_cast<double>(*expected.instructions), tolerance.instructions);
+        } else {
+            check_cost(name, "cpu time", cost.cpu_units, expected.cpu_units, tolerance.cpu_units);
+        }
+    }
+}
+
+// Replaces the entry of this configuration, the others are kept
+void write_baseline(const jp::JSONObject &previous, const Tolerance &tolerance, const Tolerance &across,
+                    const std::map<std::string, Cost> &costs) {
+    auto configurations = std::map<std::string, std::map<std::string, Cost>>{};
+    if (const auto *stored = member_object(previous, "configurations")) {
+        for (const auto &[name, entries] : *stored) {
+            if (entries.is_object()) {
+                configurations[name] = read_costs(entries.as_object());
+            }
+        }
+    }
+    configurations[PERF_CONFIGURATION] = costs;
+
+    auto file = std::ofstream{PERF_BASELINE};
+    file << std::format(R"({{{}  "tolerance": {{"allocations": {:.2f}, "instructions": {:.2f}, "cpu_units": {:.2f}}},)",
+                        '\n', tolerance.allocations, tolerance.instructions, tolerance.cpu_units)
+         << "\n"
+         << std::format(R"(  "tolerance_across_configurations": {{"allocations": {:.2f}, "cpu_units": {:.2f}}},)",
+                        across.allocations, across.cpu_units)
+         << "\n" << R"(  "configurations": {)";
+    auto separator = "\n";
+    for (const auto &[configuration, entries] : configurations) {
+        file << std::format(R"({}    "{}": {{)", separator, configuration);
+        auto entry_separator = "\n";
+        for (const auto &[name, cost] : entries) {
+            file << std::format(R"({}      "{}": {{"allocations": {}, "instructions": {}, "cpu_units": {:.2f}}})",
+                                entry_separator, name, cost.allocations,
+                                cost.instructions ? std::to_string(*cost.instructions) : "null", cost.cpu_units);
+            entry_separator = ",\n";
+        }
+        file << "\n    }";
+        separator = ",\n";
+    }
+    file << "\n  }\n}\n";
+}
+
+} // namespace
+
+TEST_CASE("perf gate") {
+    const auto baseline_text = read_file(PERF_BASELINE);
+    REQUIRE(baseline_text);
+    const auto baseline = jp::parse(*baseline_text);
+    REQUIRE(baseline.has_value());
+    REQUIRE(baseline->is_object());
+    const auto &root = baseline->as_object();
+
+    const auto tolerance = read_tolerance(root, "tolerance", Tolerance{});
+    const auto across =
+        read_tolerance(root, "tolerance_across_configurations", default_tolerance_across_configurations);
+
+    const auto calibration = calibration_seconds();
+    auto costs = std::map<std::string, Cost>{};
+    for (const auto &test_case : cases) {
+        const auto cost = measure(test_case, calibration);
+        INFO("json-eval " << test_case.document << ".json '" << test_case.query << "'");
+        REQUIRE(cost);
+        costs[std::string{test_case.name}] = *cost;
+    }
+
+    const auto *update = std::getenv("JSON_EVAL_UPDATE_BASELINE");
+    if (update != nullptr && std::string_view{update} == "1") {
+        write_baseline(root, tolerance, across, costs);
+        MESSAGE("Recorded the baseline of " << PERF_CONFIGURATION);
+        if (std::ranges::any_of(costs, [](const auto &entry) { return !entry.second.instructions; })) {
+            MESSAGE("No hardware instruction counter, only CPU time was recorded. Record on a machine where "
+                    "perf_event_open can count instructions for the tighter check.");
+        }
+        return;
+    }
+
+    const auto *configurations = member_object(root, "configurations");
+    if (configurations == nullptr || configurations->empty()) {
+        MESSAGE(skipped_marker << ": no baseline recorded, record one with JSON_EVAL_UPDATE_BASELINE=1");
+        return;
+    }
+
+    if (const auto *entries = member_object(*configurations, PERF_CONFIGURATION)) {
+        check_costs(costs, read_costs(*entries), tolerance, PERF_CONFIGURATION);
+        return;
+    }
+
+    MESSAGE("No baseline for " << PERF_CONFIGURATION
+                               << ", comparing allocations and CPU time with the loosest recorded configuration");
+    check_costs(costs, loosest_costs(*configurations), across, "any configuration");
+}
@@ -0,0 +1,865 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include "parser.hpp"
+#include "query_evaluator.hpp"
+#include "aggregate.hpp"
+#include "order.hpp"
+#include "select.hpp"
+#include "sketch.hpp"
+#include "query_lexer.hpp"
+#include "query_parser.hpp"
+#include <atomic>
+#include <thread>
+
+using namespace query;
+
+namespace {
+auto parse_query(const std::string &query) -> Expression {
+    auto [query_tokens, query_errors] = query::collect_tokens(query);
+    REQUIRE(query_errors.empty());
+    auto query_parser = query::Parser(query_tokens);
+    auto expression = query_parser.parse();
+    REQUIRE(expression.has_value());
+    return std::move(*expression);
+}
+
+auto evaluate(Evaluator &evaluator, const std::string &query) -> jp::expected<jp::JSONValue, Error> {
+    return evaluator.evaluate_expression(parse_query(query));
+}
+} // namespace
+
+TEST_SUITE("Query Evaluator") {
+
+    TEST_CASE("Evaluator resolves paths") {
+        auto json = jp::parse(R"({"a": {"b": [1, 2, {"c": 3}]}})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+
+        SUBCASE("Nested member") {
+            auto result = evaluate(evaluator, "a.b[2].c");
+            REQUIRE(result.has_value());
+            CHECK_EQ(result->as_integer(), 3);
+        }
+
+        SUBCASE("Out of bounds subscript") {
+            auto result = evaluate(evaluator, "a.b[3]");
+            CHECK(result.has_error());
+        }
+    }
+
+    TEST_CASE("Evaluator applies equality filters") {
+        auto json = jp::parse(R"({"users": [{"id": 1, "age": 30}, {"id": 2, "age": 40}, {"id": 3, "age": 30}, 7],
+                                  "wanted": 2})");
+        REQUIRE(json.has_value());
+
+        SUBCASE("Without an index") {
+            auto evaluator = Evaluator(&json.value());
+
+            auto result = evaluate(evaluator, "users[?(age == 30)]");
+            REQUIRE(result.has_value());
+            REQUIRE(result->is_array());
+            REQUIRE_EQ(result->as_array().size(), 2);
+            CHECK_EQ(result->as_array()[0].as_object().at("id").as_integer(), 1);
+            CHECK_EQ(result->as_array()[1].as_object().at("id").as_integer(), 3);
+        }
+
+        SUBCASE("With an index") {
+            auto indexes = IndexCache{};
+            auto evaluator = Evaluator(&json.value(), &indexes);
+
+            const auto users = parse_query("users");
+            REQUIRE(evaluator.create_index(*std::get<std::unique_ptr<Path>>(users), "id").has_value());
+            REQUIRE(evaluator.create_index(*std::get<std::unique_ptr<Path>>(users), "age").has_value());
+            CHECK_EQ(indexes.size(), 2);
+
+            auto by_id = evaluate(evaluator, "users[?(id == wanted)]");
+            REQUIRE(by_id.has_value());
+            REQUIRE_EQ(by_id->as_array().size(), 1);
+            CHECK_EQ(by_id->as_array()[0].as_object().at("age").as_integer(), 40);
+
+            auto by_age = evaluate(evaluator, "users[?(age == 30.0)]");
+            REQUIRE(by_age.has_value());
+            REQUIRE_EQ(by_age->as_array().size(), 2);
+            CHECK_EQ(by_age->as_array()[0].as_object().at("id").as_integer(), 1);
+            CHECK_EQ(by_age->as_array()[1].as_object().at("id").as_integer(), 3);
+
+            auto missing = evaluate(evaluator, "users[?(id == 4)]");
+            REQUIRE(missing.has_value());
+            CHECK(missing->as_array().empty());
+        }
+
+        SUBCASE("Index is reused by other evaluators, skipped when stale and rebuilt on refresh") {
+            auto indexes = IndexCache{};
+            {
+                auto evaluator = Evaluator(&json.value(), &indexes);
+                const auto users = parse_query("users");
+                REQUIRE(evaluator.create_index(*std::get<std::unique_ptr<Path>>(users), "id").has_value());
+            }
+
+            auto &users = std::get<jp::JSONArray>(std::get<jp::JSONObject>(json->value)["users"].value);
+            users.push_back(jp::JSONValue{jp::JSONObject{{"id", jp::JSONValue{jp::JSONInteger{4}}}}});
+
+            // Evaluation doesn't write to the cache, the stale index is skipped and the array scanned
+            auto evaluator = Evaluator(&json.value(), &indexes);
+            CHECK(indexes.find(users, "id") == nullptr);
+            auto result = evaluate(evaluator, "users[?(id == 4)]");
+            REQUIRE(result.has_value());
+            CHECK_EQ(result->as_array().size(), 1);
+
+            indexes.refresh();
+            CHECK(indexes.find(users, "id") != nullptr);
+            auto indexed = evaluate(evaluator, "users[?(id == 4)]");
+            REQUIRE(indexed.has_value());
+            CHECK_EQ(indexed->as_array().size(), 1);
+            CHECK_EQ(indexes.size(), 1);
+        }
+    }
+
+    TEST_CASE("Batch evaluates queries with shared path prefixes") {
+        auto json = jp::parse(R"({"a": {"b": {"c": 1, "d": 2}, "e": [10, 20]}, "i": 1})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+
+        auto queries = std::vector<NamedQuery>{};
+        queries.push_back(NamedQuery{"c", parse_query("a.b.c")});
+        queries.push_back(NamedQuery{"sum", parse_query("a.b.c + a.b.d")});
+        queries.push_back(NamedQuery{"first", parse_query("a.e[0]")});
+        queries.push_back(NamedQuery{"dynamic", parse_query("a.e[i]")});
+        queries.push_back(NamedQuery{"missing", parse_query("a.x")});
+        auto batch = Batch{std::move(queries)};
+
+        // root, a, b, c, d, e[0], e, x
+        CHECK_EQ(batch.trie_size(), 8);
+
+        auto [results, errors] = batch.evaluate(evaluator);
+        REQUIRE(results.is_object());
+        const auto &object = results.as_object();
+        CHECK_EQ(object.at("c").as_integer(), 1);
+        CHECK_EQ(object.at("sum").to_double(), doctest::Approx(3));
+        CHECK_EQ(object.at("first").as_integer(), 10);
+        CHECK_EQ(object.at("dynamic").as_integer(), 20);
+        CHECK(object.at("missing").is_null());
+        REQUIRE_EQ(errors.size(), 1);
+        CHECK_EQ(errors[0].message(), "missing: Key 'x' not found");
+        CHECK(evaluator.path_cache == nullptr);
+    }
+
+    TEST_CASE("Errors carry a code and format their message when displayed") {
+        auto json = jp::parse(R"({"a": [1, 2, 3], "s": "text"})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+
+        const auto query = parse_query("a[5]");
+        auto out_of_bounds = evaluator.evaluate_expression(query);
+        REQUIRE(out_of_bounds.has_error());
+        CHECK_EQ(out_of_bounds.error().code, ErrorCode::IndexOutOfBounds);
+        CHECK_EQ(out_of_bounds.error().source, ErrorSource::Evaluator);
+        CHECK_EQ(out_of_bounds.error().message(), "Index 5 out of bounds for 'a' of size 3");
+
+        const auto arithmetic = parse_query("s * 2");
+        auto mismatch = evaluator.evaluate_expression(arithmetic);
+        REQUIRE(mismatch.has_error());
+        CHECK_EQ(mismatch.error().message(), "Unsupported binary operation on types: string and integer");
+
+        // Copies own the text that was copied into the original
+        const auto copy = Error{ErrorCode::UnexpectedKeyword, std::string{"nul"}}.at(1, 2);
+        CHECK_EQ(Error{copy}, copy);
+        CHECK_EQ(copy.message(), "Unexpected keyword 'nul'");
+        CHECK_EQ(copy.source_name(), std::string{"Lexer"});
+    }
+
+    TEST_CASE("Evaluator preserves integers in arithmetic") {
+        auto json = jp::parse(R"({"id": 9007199254740993, "half": 0.5})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+
+        SUBCASE("Integer operands") {
+            auto result = evaluate(evaluator, "id + 2 * 3 - 1");
+            REQUIRE(result.has_value());
+            REQUIRE(result->is_integer());
+            CHECK_EQ(result->as_integer(), 9007199254740998);
+        }
+
+        SUBCASE("Exact integer division") {
+            auto exact = evaluate(evaluator, "9 / 3");
+            REQUIRE(exact.has_value());
+            REQUIRE(exact->is_integer());
+            CHECK_EQ(exact->as_integer(), 3);
+
+            auto inexact = evaluate(evaluator, "7 / 2");
+            REQUIRE(inexact.has_value());
+            REQUIRE(inexact->is_double());
+            CHECK_EQ(inexact->as_double(), doctest::Approx(3.5));
+
+            CHECK(evaluate(evaluator, "7 / 0").has_error());
+        }
+
+        SUBCASE("Overflow promotes to double") {
+            auto result = evaluate(evaluator, "9223372036854775807 + 1");
+            REQUIRE(result.has_value());
+            REQUIRE(result->is_double());
+            CHECK_EQ(result->as_double(), doctest::Approx(9223372036854775808.0));
+
+            auto negated = evaluate(evaluator, "-(-9223372036854775807 - 1)");
+            REQUIRE(negated.has_value());
+            CHECK(negated->is_double());
+        }
+
+        SUBCASE("Mixed operands") {
+            auto result = evaluate(evaluator, "2 * half");
+            REQUIRE(result.has_value());
+            REQUIRE(result->is_double());
+            CHECK_EQ(result->as_double(), doctest::Approx(1.0));
+        }
+    }
+
+    TEST_CASE("Aggregate kernels") {
+        SUBCASE("Integer arrays stay integral") {
+            auto values = jp::JSONArray{};
+            for (auto i = jp::JSONInteger{1}; i <= 1000; i++) {
+                values.push_back(jp::JSONValue{i});
+            }
+
+            auto sum = aggregate::reduce<aggregate::Sum>(values);
+            REQUIRE(sum.has_value());
+            REQUIRE(sum->is_integer());
+            CHECK_EQ(sum->as_integer(), 500500);
+
+            auto min = aggregate::reduce<aggregate::Min>(values);
+            REQUIRE(min.has_value());
+            CHECK_EQ(min->as_integer(), 1);
+
+            auto max = aggregate::reduce<aggregate::Max>(values);
+            REQUIRE(max.has_value());
+            CHECK_EQ(max->as_integer(), 1000);
+        }
+
+        SUBCASE("Integer overflow falls back to doubles") {
+            auto values = jp::JSONArray{jp::JSONValue{std::numeric_limits<jp::JSONInteger>::max()},
+                                        jp::JSONValue{jp::JSONInteger{2}}};
+
+            auto sum = aggregate::reduce<aggregate::Sum>(values);
+            REQUIRE(sum.has_value());
+            CHECK(sum->is_double());
+
+            auto product = aggregate::reduce<aggregate::Product>(values);
+            REQUIRE(product.has_value());
+            CHECK(product->is_double());
+        }
+
+        SUBCASE("Mixed arrays") {
+            auto values = jp::JSONArray{};
+            for (auto i = 0; i < 1001; i++) {
+                values.push_back(i % 2 == 0 ? jp::JSONValue{jp::JSONInteger{1}} : jp::JSONValue{0.5});
+            }
+            values.push_back(jp::JSONValue{-3.5});
+
+            CHECK_EQ(aggregate::gather(values).kind, aggregate::ValueKind::Mixed);
+
+            auto sum = aggregate::reduce<aggregate::Sum>(values);
+            REQUIRE(sum.has_value());
+            CHECK_EQ(sum->as_double(), doctest::Approx(501 + 250 - 3.5));
+
+            auto min = aggregate::reduce<aggregate::Min>(values);
+            REQUIRE(min.has_value());
+            CHECK_EQ(min->as_double(), doctest::Approx(-3.5));
+
+            auto max = aggregate::reduce<aggregate::Max>(values);
+            REQUIRE(max.has_value());
+            CHECK_EQ(max->as_double(), doctest::Approx(1));
+        }
+
+        SUBCASE("Pairwise summation is accurate") {
+            auto values = std::vector<jp::JSONDouble>(1'000'000, 0.1);
+            CHECK_EQ(aggregate::sum(values), doctest::Approx(100000.0).epsilon(1e-12));
+        }
+
+        SUBCASE("Errors") {
+            CHECK(aggregate::reduce<aggregate::Sum>(jp::JSONArray{}).has_error());
+            CHECK(aggregate::reduce<aggregate::Max>(jp::JSONArray{jp::JSONValue{"a"}}).has_error());
+        }
+    }
+
+    TEST_CASE("Parallel reductions don't depend on the thread count") {
+        auto values = jp::JSONArray{};
+        for (auto i = 0; i < 300'000; i++) {
+            values.push_back(i % 3 == 0 ? jp::JSONValue{0.1 * i} : jp::JSONValue{jp::JSONInteger{i}});
+        }
+
+        const auto sequential = aggregate::reduce<aggregate::Sum>(values, nullptr, 1000);
+        REQUIRE(sequential.has_value());
+        CHECK_EQ(sequential->as_double(), doctest::Approx(aggregate::reduce<aggregate::Sum>(values)->as_double()));
+
+        for (const auto threads : {1u, 2u, 4u}) {
+            auto pool = jp::ThreadPool{threads};
+            auto sum = aggregate::reduce<aggregate::Sum>(values, &pool, 1000);
+            REQUIRE(sum.has_value());
+            CHECK_EQ(sum->as_double(), sequential->as_double());
+
+            auto max = aggregate::reduce<aggregate::Max>(values, &pool, 1000);
+            REQUIRE(max.has_value());
+            CHECK_EQ(max->as_double(), doctest::Approx(299'999));
+        }
+
+        auto integers = jp::JSONArray(200'000, jp::JSONValue{jp::JSONInteger{3}});
+        auto pool = jp::ThreadPool{3};
+        auto sum = aggregate::reduce<aggregate::Sum>(integers, &pool, 1000);
+        REQUIRE(sum.has_value());
+        REQUIRE(sum->is_integer());
+        CHECK_EQ(sum->as_integer(), 600'000);
+
+        integers.push_back(jp::JSONValue{"three"});
+        CHECK(aggregate::reduce<aggregate::Sum>(integers, &pool, 1000).has_error());
+    }
+
+    TEST_CASE("Function calls are bound to intrinsics and user functions") {
+        auto json = jp::parse(R"({"a": [1, 2, 3]})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+        evaluator.register_function("twice", [](const Evaluator *self, const std::span<const Expression> &args) {
+            auto value = self->evaluate_expression(args[0]);
+            if (value.has_error()) {
+                return value;
+            }
+            return jp::expected<jp::JSONValue, Error>{jp::JSONValue{value->as_integer() * 2}};
+        });
+
+        SUBCASE("Bound calls") {
+            auto expression = parse_query("twice(sum(a))");
+            evaluator.bind(expression);
+
+            const auto &outer = *std::get<std::unique_ptr<Function>>(expression);
+            const auto &inner = *std::get<std::unique_ptr<Function>>(outer.arguments[0]);
+            CHECK_EQ(inner.id, static_cast<std::uint32_t>(Intrinsic::Sum));
+            CHECK_EQ(outer.id, intrinsic_count);
+
+            auto result = evaluator.evaluate_expression(expression);
+            REQUIRE(result.has_value());
+            CHECK_EQ(result->as_integer(), 12);
+        }
+
+        SUBCASE("Unbound calls fall back to a lookup") {
+            auto result = evaluate(evaluator, "twice(size(a))");
+            REQUIRE(result.has_value());
+            CHECK_EQ(result->as_integer(), 6);
+            CHECK(evaluate(evaluator, "missing(a)").has_error());
+        }
+
+        SUBCASE("User functions override intrinsics") {
+            evaluator.register_function("size", [](const Evaluator *, const std::span<const Expression> &) {
+                return jp::expected<jp::JSONValue, Error>{jp::JSONValue{jp::JSONInteger{-1}}};
+            });
+
+            auto expression = parse_query("size(a)");
+            evaluator.bind(expression);
+            auto result = evaluator.evaluate_expression(expression);
+            REQUIRE(result.has_value());
+            CHECK_EQ(result->as_integer(), -1);
+        }
+    }
+
+    TEST_CASE("One evaluator runs queries on many threads at once") {
+        auto items = jp::JSONArray{};
+        for (auto i = 0; i < 2000; i++) {
+            auto item = jp::JSONObject{};
+            item.emplace("id", jp::JSONValue{jp::JSONInteger{i}});
+            item.emplace("price", jp::JSONValue{(i % 100) / 4.0});
+            items.push_back(jp::JSONValue{std::move(item)});
+        }
+        auto root = jp::JSONObject{};
+        root.emplace("items", jp::JSONValue{std::move(items)});
+        const auto json = jp::JSONValue{std::move(root)};
+
+        auto indexes = IndexCache{};
+        auto evaluator = Evaluator(&json, &indexes);
+        evaluator.register_function("twice", [](const Evaluator *self, const std::span<const Expression> &args) {
+            auto value = self->evaluate_expression(args[0]);
+            if (value.has_error()) {
+                return value;
+            }
+            return jp::expected<jp::JSONValue, Error>{jp::JSONValue{value->to_double() * 2}};
+        });
+        evaluator.set_thread_count(2);
+        evaluator.parallel_threshold = 500;
+        REQUIRE(evaluator.create_index(*std::get<std::unique_ptr<Path>>(parse_query("items")), "id").has_value());
+
+        auto queries = std::vector<Expression>{};
+        for (const auto *query :
+             {"items[7].price", "sum(items[*].price)", "size(items[?(price > 10)])", "items[?(id == 1234)]",
+              "twice(avg(items[*].price))", "first(items[?(price >= 24)])", "max(items[*].price * 2 - 1)",
+              "median(items[*].price)", "items[5000]", "count_distinct(items[*].price)", "nth(items[*].price, 3)"}) {
+            queries.push_back(parse_query(query));
+            evaluator.bind(queries.back());
+        }
+
+        const auto render = [](const jp::expected<jp::JSONValue, Error> &result) {
+            return result.has_value() ? to_string(result.value()) : result.error().message();
+        };
+        auto expected = std::vector<std::string>{};
+        for (const auto &query : queries) {
+            expected.push_back(render(evaluator.evaluate_expression(query)));
+        }
+
+        const auto &shared = evaluator;
+        auto mismatches = std::atomic<std::size_t>{0};
+        auto threads = std::vector<std::thread>{};
+        for (auto t = 0; t < 8; t++) {
+            threads.emplace_back([&, t] {
+                for (auto round = 0; round < 4; round++) {
+                    for (auto q = std::size_t{0}; q < queries.size(); q++) {
+                        const auto i = (q + static_cast<std::size_t>(t)) % queries.size();
+                        if (render(shared.evaluate_expression(queries[i])) != expected[i]) {
+                            mismatches++;
+                        }
+                    }
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        CHECK_EQ(mismatches.load(), 0);
+        CHECK_EQ(indexes.size(), 1);
+    }
+
+    TEST_CASE("Evaluators share the function registry") {
+        auto json = jp::parse(R"({"a": [1, 2, 3]})");
+        REQUIRE(json.has_value());
+
+        auto registry = std::make_shared<FunctionRegistry>();
+        registry->add("one", [](const Evaluator *, const std::span<const Expression> &) {
+            return jp::expected<jp::JSONValue, Error>{jp::JSONValue{jp::JSONInteger{1}}};
+        });
+        const auto shared = std::shared_ptr<const FunctionRegistry>{registry};
+
+        auto first = Evaluator(&json.value(), nullptr, shared);
+        auto second = Evaluator(&json.value(), nullptr, shared);
+        CHECK_EQ(evaluate(first, "one(a) + size(a)")->as_integer(), 4);
+        CHECK_EQ(evaluate(second, "one(a)")->as_integer(), 1);
+
+        // Registering on one evaluator leaves the shared registry alone
+        second.register_function("two", [](const Evaluator *, const std::span<const Expression> &) {
+            return jp::expected<jp::JSONValue, Error>{jp::JSONValue{jp::JSONInteger{2}}};
+        });
+        CHECK_EQ(evaluate(second, "two(a)")->as_integer(), 2);
+        CHECK(evaluate(first, "two(a)").has_error());
+        CHECK_EQ(first.functions, shared);
+        CHECK(Evaluator(&json.value()).functions == FunctionRegistry::intrinsics());
+
+        // A query bound by one evaluator looks its functions up again in an evaluator with another registry
+        auto query = parse_query("two(a) + size(a)");
+        second.bind(query);
+        CHECK_EQ(second.evaluate_expression(query)->as_integer(), 5);
+        CHECK(first.evaluate_expression(query).has_error());
+        CHECK(Evaluator(&json.value()).evaluate_expression(query).has_error());
+    }
+
+    TEST_CASE("Statistical sketches") {
+        SUBCASE("Moments merge like a single pass") {
+            auto all = sketch::Moments{};
+            auto left = sketch::Moments{};
+            auto right = sketch::Moments{};
+            for (auto i = 0; i < 1000; i++) {
+                const auto value = std::sin(i) * 100 + 50;
+                all.add(value);
+                (i < 300 ? left : right).add(value);
+            }
+            left.merge(right);
+
+            CHECK_EQ(left.count(), 1000);
+            CHECK_EQ(left.mean(), doctest::Approx(all.mean()));
+            CHECK_EQ(left.stddev(), doctest::Approx(all.stddev()));
+        }
+
+        SUBCASE("T-digest quantiles") {
+            auto digest = sketch::TDigest{};
+            auto merged = sketch::TDigest{};
+            auto part = sketch::TDigest{};
+            for (auto i = 0; i < 100'000; i++) {
+                // A fixed permutation of [0, 100000)
+                const auto value = static_cast<double>((i * 7919) % 100'000);
+                digest.add(value);
+                (i % 2 == 0 ? merged : part).add(value);
+            }
+            merged.merge(part);
+
+            // The error is bounded in rank, and smallest near the tails
+            for (const auto q : {0.01, 0.5, 0.99}) {
+                CHECK_LT(std::abs(digest.quantile(q) - q * 100'000), 100'000 * 0.001);
+                CHECK_LT(std::abs(merged.quantile(q) - q * 100'000), 100'000 * 0.001);
+            }
+            CHECK_EQ(digest.quantile(0), 0);
+            CHECK_EQ(digest.quantile(1), 99'999);
+            CHECK_LE(digest.centroid_count(), 60);
+        }
+
+        SUBCASE("HyperLogLog estimates") {
+            auto sketch = sketch::HyperLogLog{};
+            auto half = sketch::HyperLogLog{};
+            for (auto i = 0; i < 200'000; i++) {
+                const auto hash = sketch::hash(jp::JSONValue{jp::JSONInteger{i % 50'000}});
+                REQUIRE(hash.has_value());
+                (i % 3 == 0 ? sketch : half).add(*hash);
+            }
+            sketch.merge(half);
+            CHECK_EQ(sketch.estimate(), doctest::Approx(50'000).epsilon(0.03));
+
+            CHECK_EQ(sketch::hash(jp::JSONValue{1.0}), sketch::hash(jp::JSONValue{jp::JSONInteger{1}}));
+            CHECK_FALSE(sketch::hash(jp::JSONValue{jp::JSONArray{}}).has_value());
+        }
+
+        SUBCASE("Query functions") {
+            auto values = jp::JSONArray{};
+            for (auto i = 1; i <= 1000; i++) {
+                values.push_back(jp::JSONValue{jp::JSONInteger{i}});
+            }
+            auto document = jp::JSONObject{};
+            document["a"] = jp::JSONValue{values};
+            document["words"] =
+                jp::JSONValue{jp::JSONArray{jp::JSONValue{"x"}, jp::JSONValue{"y"}, jp::JSONValue{"x"}}};
+            const auto json = jp::JSONValue{document};
+
+            for (const auto threads : {1u, 3u}) {
+                auto evaluator = Evaluator(&json);
+                evaluator.set_thread_count(threads);
+                evaluator.parallel_threshold = 100;
+
+                CHECK_EQ(evaluate(evaluator, "avg(a)")->as_double(), doctest::Approx(500.5));
+                CHECK_EQ(evaluate(evaluator, "avg(1, 2, 6)")->as_double(), doctest::Approx(3));
+                CHECK_EQ(evaluate(evaluator, "stddev(a)")->as_double(), doctest::Approx(288.675).epsilon(0.001));
+                CHECK_EQ(evaluate(evaluator, "percentile(a, 50)")->as_double(), doctest::Approx(500.5).epsilon(0.01));
+                CHECK_EQ(evaluate(evaluator, "percentile(a, 99, 200)")->as_double(),
+                         doctest::Approx(990).epsilon(0.01));
+                CHECK_EQ(evaluate(evaluator, "count_distinct(a)")->as_integer(), doctest::Approx(1000).epsilon(0.02));
+                CHECK_EQ(evaluate(evaluator, "count_distinct(words, 8)")->as_integer(), 2);
+            }
+
+            auto evaluator = Evaluator(&json);
+            CHECK(evaluate(evaluator, "avg(words)").has_error());
+            CHECK(evaluate(evaluator, "percentile(a, 101)").has_error());
+            CHECK(evaluate(evaluator, "percentile(a)").has_error());
+            CHECK(evaluate(evaluator, "count_distinct(a, 30)").has_error());
+        }
+    }
+
+    TEST_CASE("Wildcards project the rest of the path") {
+        auto json = jp::parse(R"({"items": [{"latency": 3, "tags": [{"id": 1}]}, {"latency": 1.5}, {"name": "x"},
+                                            {"latency": 7, "tags": [{"id": 2}, {"id": 3}]}]})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+
+        auto latencies = evaluate(evaluator, "items[*].latency");
+        REQUIRE(latencies.has_value());
+        REQUIRE_EQ(latencies->as_array().size(), 3);
+        CHECK_EQ(latencies->as_array()[1].as_double(), 1.5);
+
+        auto ids = evaluate(evaluator, "items[*].tags[*].id");
+        REQUIRE(ids.has_value());
+        REQUIRE_EQ(ids->as_array().size(), 3);
+        CHECK_EQ(ids->as_array()[2].as_integer(), 3);
+
+        CHECK_EQ(evaluate(evaluator, "items[*]")->as_array().size(), 4);
+        CHECK_EQ(evaluate(evaluator, "max(items[*].latency)")->as_double(), 7);
+    }
+
+    TEST_CASE("Selection functions") {
+        auto values = jp::JSONArray{};
+        for (auto i = 0; i < 1001; i++) {
+            values.push_back(jp::JSONValue{jp::JSONInteger{(i * 389) % 1001}});
+        }
+
+        SUBCASE("Kernels") {
+            const auto top = select::top_k(values, 3, select::Order::Descending);
+            REQUIRE(top.has_value());
+            REQUIRE_EQ(top->size(), 3);
+            CHECK_EQ((*top)[0].as_integer(), 1000);
+            CHECK_EQ((*top)[2].as_integer(), 998);
+
+            const auto bottom = select::top_k(values, 2000, select::Order::Ascending);
+            REQUIRE(bottom.has_value());
+            CHECK_EQ(bottom->size(), 1001);
+            CHECK(std::ranges::is_sorted(*bottom, select::less));
+
+            CHECK_EQ(select::nth(values, 10)->as_integer(), 10);
+            CHECK_EQ(select::median(values)->as_integer(), 500);
+
+            values.push_back(jp::JSONValue{1001.5});
+            CHECK_EQ(select::median(values)->as_double(), 500.5);
+            CHECK_EQ(select::top_k(values, 1, select::Order::Descending)->front().as_double(), 1001.5);
+
+            values.push_back(jp::JSONValue{"x"});
+            CHECK_FALSE(select::top_k(values, 1, select::Order::Descending).has_value());
+            CHECK_FALSE(select::median(values).has_value());
+        }
+
+        SUBCASE("Query functions") {
+            auto items = jp::JSONArray{};
+            for (const auto latency : {12, 5, 40, 7, 33, 5}) {
+                auto item = jp::JSONObject{};
+                item["latency"] = jp::JSONValue{jp::JSONInteger{latency}};
+                items.push_back(jp::JSONValue{item});
+            }
+            auto document = jp::JSONObject{};
+            document["items"] = jp::JSONValue{items};
+            const auto json = jp::JSONValue{document};
+            auto evaluator = Evaluator(&json);
+
+            auto top = evaluate(evaluator, "top_k(items[*].latency, 2)");
+            REQUIRE(top.has_value());
+            CHECK_EQ(top->as_array()[0].as_integer(), 40);
+            CHECK_EQ(top->as_array()[1].as_integer(), 33);
+
+            auto bottom = evaluate(evaluator, "bottom_k(items[*].latency, 3)");
+            REQUIRE(bottom.has_value());
+            CHECK_EQ(bottom->as_array()[2].as_integer(), 7);
+
+            CHECK_EQ(evaluate(evaluator, "nth(items[*].latency, 5)")->as_integer(), 40);
+            CHECK_EQ(evaluate(evaluator, "median(items[*].latency)")->as_double(), 9.5);
+
+            CHECK(evaluate(evaluator, "nth(items[*].latency, 6)").has_error());
+            CHECK(evaluate(evaluator, "top_k(items[*].latency, -1)").has_error());
+            CHECK(evaluate(evaluator, "median(items)").has_error());
+        }
+    }
+
+    TEST_CASE("Sorting, grouping and deduplicating arrays") {
+        auto json = jp::parse(R"({"events": [{"type": "click", "size": 3, "ts": 5},
+                                             {"type": "view", "size": 1, "ts": 2},
+                                             {"type": "click", "size": 4, "ts": 2.5}, {"size": 9},
+                                             {"type": "view", "size": 2, "ts": 2}],
+                                  "tags": ["a", "b", "a", 1, 1.0, {"x": [1]}, {"x": [1]}, {"x": [2]}],
+                                  "mixed": [{"k": 1, "n": 1}, {"k": "1", "n": 2}, {"k": 1, "n": 3}]})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+
+        SUBCASE("sort_by is stable and puts missing keys first") {
+            auto sorted = evaluate(evaluator, "sort_by(events, ts)");
+            REQUIRE(sorted.has_value());
+            const auto &events = sorted->as_array();
+            REQUIRE_EQ(events.size(), 5);
+            CHECK_EQ(events[0].as_object().at("size").as_integer(), 9);
+            CHECK_EQ(events[1].as_object().at("size").as_integer(), 1);
+            CHECK_EQ(events[2].as_object().at("size").as_integer(), 2);
+            CHECK_EQ(events[3].as_object().at("size").as_integer(), 4);
+            CHECK_EQ(events[4].as_object().at("size").as_integer(), 3);
+
+            CHECK(evaluate(evaluator, "sort_by(events, 1)").has_error());
+        }
+
+        SUBCASE("group_by") {
+            auto groups = evaluate(evaluator, "group_by(events, type)");
+            REQUIRE(groups.has_value());
+            const auto &object = groups->as_object();
+            CHECK_EQ(object.size(), 3);
+            CHECK_EQ(object.at("click").as_array().size(), 2);
+            CHECK_EQ(object.at("view").as_array()[1].as_object().at("size").as_integer(), 2);
+            CHECK_EQ(object.at("null").as_array().size(), 1);
+
+            // 1 and "1" print the same and share a group, in the order their keys first appear
+            auto merged = evaluate(evaluator, "group_by(mixed, k)");
+            REQUIRE(merged.has_value());
+            REQUIRE_EQ(merged->as_object().size(), 1);
+            const auto &ones = merged->as_object().at("1").as_array();
+            REQUIRE_EQ(ones.size(), 3);
+            CHECK_EQ(ones[0].as_object().at("n").as_integer(), 1);
+            CHECK_EQ(ones[1].as_object().at("n").as_integer(), 3);
+            CHECK_EQ(ones[2].as_object().at("n").as_integer(), 2);
+        }
+
+        SUBCASE("unique") {
+            auto unique = evaluate(evaluator, "unique(tags)");
+            REQUIRE(unique.has_value());
+            const auto &tags = unique->as_array();
+            REQUIRE_EQ(tags.size(), 5);
+            CHECK_EQ(tags[2].as_integer(), 1);
+            CHECK(tags[3].is_object());
+            CHECK_EQ(tags[4].as_object().at("x").as_array()[0].as_integer(), 2);
+        }
+
+        SUBCASE("Array arguments are read in the document or computed") {
+            CHECK_EQ(evaluate(evaluator, "unique(events[*].type)")->as_array().size(), 2);
+            CHECK_EQ(evaluate(evaluator, "median(events[*].size)")->as_integer(), 3);
+
+            auto not_array = evaluate(evaluator, "unique(events[0])");
+            REQUIRE(not_array.has_error());
+            CHECK_EQ(not_array.error().code, ErrorCode::ExpectedArrayArgument);
+            CHECK(evaluate(evaluator, "unique(missing)").has_error());
+        }
+
+        SUBCASE("Parallel sort matches the sequential one") {
+            auto keys = std::vector<order::SortKey>{};
+            for (auto i = 0; i < 200'000; i++) {
+                keys.emplace_back(jp::JSONInteger{(i * 7919) % 1000});
+            }
+
+            const auto sequential = order::sort_permutation(keys, nullptr, keys.size());
+            const auto by_key = [&](auto lhs, auto rhs) { return order::compare(keys[lhs], keys[rhs]) < 0; };
+            CHECK(std::ranges::is_sorted(sequential, by_key));
+
+            auto pool = jp::ThreadPool{3};
+            CHECK_EQ(order::sort_permutation(keys, &pool, 1000), sequential);
+            CHECK_EQ(order::sort_permutation(keys, nullptr, 1000), sequential);
+        }
+    }
+
+    TEST_CASE("Arithmetic broadcasts over arrays") {
+        auto json = jp::parse(R"({"prices": [10, 20, 30], "qty": [1, 2, 3], "rates": [0.5, 1.5, 2.5],
+                                  "big": [1, 9223372036854775807], "names": ["a"], "short": [1, 2], "empty": []})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+
+        const auto numbers = [](const jp::JSONValue &value) {
+            auto result = std::vector<double>{};
+            for (const auto &element : value.as_array()) {
+                result.push_back(element.is_integer() ? static_cast<double>(element.as_integer())
+                                                      : element.as_double());
+            }
+            return result;
+        };
+
+        SUBCASE("Scalars broadcast") {
+            auto scaled = evaluate(evaluator, "prices * 2");
+            REQUIRE(scaled.has_value());
+            REQUIRE(scaled->as_array()[0].is_integer());
+            CHECK_EQ(numbers(*scaled), (std::vector<double>{20, 40, 60}));
+
+            auto taxed = evaluate(evaluator, "1.5 * prices");
+            REQUIRE(taxed.has_value());
+            CHECK(taxed->as_array()[0].is_double());
+            CHECK_EQ(numbers(*taxed), (std::vector<double>{15, 30, 45}));
+
+            auto negated = evaluate(evaluator, "-qty");
+            REQUIRE(negated.has_value());
+            CHECK_EQ(numbers(*negated), (std::vector<double>{-1, -2, -3}));
+        }
+
+        SUBCASE("Arrays combine element-wise") {
+            auto totals = evaluate(evaluator, "prices * qty + rates");
+            REQUIRE(totals.has_value());
+            CHECK_EQ(numbers(*totals), (std::vector<double>{10.5, 41.5, 92.5}));
+
+            auto ratios = evaluate(evaluator, "prices / qty");
+            REQUIRE(ratios.has_value());
+            CHECK(ratios->as_array()[0].is_integer());
+            CHECK_EQ(numbers(*ratios), (std::vector<double>{10, 10, 10}));
+
+            auto inexact = evaluate(evaluator, "qty / 2");
+            REQUIRE(inexact.has_value());
+            CHECK(inexact->as_array()[0].is_double());
+            CHECK_EQ(numbers(*inexact), (std::vector<double>{0.5, 1, 1.5}));
+        }
+
+        SUBCASE("Integer overflow promotes the whole array to double") {
+            auto result = evaluate(evaluator, "big + 1");
+            REQUIRE(result.has_value());
+            CHECK(result->as_array()[0].is_double());
+            CHECK_EQ(result->as_array()[1].as_double(), doctest::Approx(9223372036854775808.0));
+
+            // The overflow is found before the temporary operand's buffer is reused for the result
+            auto doubled = evaluate(evaluator, "(big - 0) * 2");
+            REQUIRE(doubled.has_value());
+            CHECK_EQ(doubled->as_array()[0].as_double(), 2.0);
+            CHECK_EQ(doubled->as_array()[1].as_double(), doctest::Approx(18446744073709551614.0));
+        }
+
+        SUBCASE("Empty arrays") {
+            for (const auto *query : {"empty * 2.5", "2 - empty", "empty + empty", "-empty * 3"}) {
+                INFO("Query: " << query);
+                auto result = evaluate(evaluator, query);
+                REQUIRE(result.has_value());
+                CHECK(result->as_array().empty());
+            }
+        }
+
+        SUBCASE("Reductions fuse arithmetic") {
+            auto dot = evaluate(evaluator, "sum(prices * qty)");
+            REQUIRE(dot.has_value());
+            REQUIRE(dot->is_integer());
+            CHECK_EQ(dot->as_integer(), 140);
+
+            auto weighted = evaluate(evaluator, "max(-(prices - 25) * rates)");
+            REQUIRE(weighted.has_value());
+            CHECK_EQ(weighted->as_double(), doctest::Approx(7.5));
+        }
+
+        SUBCASE("Errors") {
+            CHECK(evaluate(evaluator, "prices + short").has_error());
+            CHECK(evaluate(evaluator, "prices / (qty - 1)").has_error());
+            CHECK(evaluate(evaluator, "prices * names").has_error());
+            CHECK(evaluate(evaluator, "sum(prices + short)").has_error());
+        }
+    }
+
+    TEST_CASE("Filters, projections and arithmetic are evaluated lazily") {
+        auto json = jp::parse(R"({"items": [{"x": 1, "y": 2}, {"x": 7, "y": 0}, {"x": 9, "y": 3, "name": "b"},
+                                            {"name": "a"}, 5],
+                                  "weights": [1, 2, 3], "big": [{"v": 9223372036854775807}, {"v": 1}]})");
+        REQUIRE(json.has_value());
+        auto evaluator = Evaluator(&json.value());
+
+        SUBCASE("Comparison filters") {
+            auto greater = evaluate(evaluator, "items[?(x > 5)]");
+            REQUIRE(greater.has_value());
+            CHECK_EQ(greater->as_array().size(), 2);
+
+            auto at_most = evaluate(evaluator, "items[?(x <= 7)]");
+            REQUIRE(at_most.has_value());
+            CHECK_EQ(at_most->as_array().size(), 2);
+
+            // Missing fields and values of another kind never match
+            auto other = evaluate(evaluator, "items[?(x != 7)]");
+            REQUIRE(other.has_value());
+            CHECK_EQ(other->as_array().size(), 2);
+            CHECK_EQ(evaluate(evaluator, "size(items[?(name < 1)])")->as_integer(), 0);
+        }
+
+        SUBCASE("first() stops the pipeline after one element") {
+            auto found = evaluate(evaluator, "first(items[?(x > 5)])");
+            REQUIRE(found.has_value());
+            CHECK_EQ(found->as_object().at("x").as_integer(), 7);
+
+            // The division by zero in the second element is never evaluated
+            auto ratio = evaluate(evaluator, "first(items[*].x / items[*].y)");
+            REQUIRE(ratio.has_value());
+            CHECK_EQ(ratio->as_double(), doctest::Approx(0.5));
+            CHECK(evaluate(evaluator, "sum(items[*].x / items[*].y)").has_error());
+
+            CHECK_EQ(evaluate(evaluator, "first(weights)")->as_integer(), 1);
+            CHECK(evaluate(evaluator, "first(items[?(x > 100)])").has_error());
+        }
+
+        SUBCASE("Aggregates consume pipelines") {
+            CHECK_EQ(evaluate(evaluator, "sum(items[*].x)")->as_integer(), 17);
+            CHECK_EQ(evaluate(evaluator, "sum(items[*].x * weights)")->as_integer(), 42);
+            CHECK_EQ(evaluate(evaluator, "max(-items[*].x)")->as_integer(), -1);
+            CHECK_EQ(evaluate(evaluator, "size(items[?(x < 9)])")->as_integer(), 2);
+            CHECK(evaluate(evaluator, "avg(items[?(x > 5)].x)").has_error());
+            CHECK_EQ(evaluate(evaluator, "avg(items[*].x)")->as_double(), doctest::Approx(17.0 / 3));
+            CHECK_EQ(evaluate(evaluator, "count_distinct(items[*].x)")->as_integer(), 3);
+
+            auto overflow = evaluate(evaluator, "sum(big[*].v)");
+            REQUIRE(overflow.has_value());
+            CHECK(overflow->is_double());
+
+            CHECK(evaluate(evaluator, "sum(items[*].name)").has_error());
+            CHECK(evaluate(evaluator, "sum(items[*].x + weights[0])").has_value());
+            CHECK(evaluate(evaluator, "sum(items[*].x * big[*].v)").has_error());
+        }
+
+        SUBCASE("Accumulator spills its buffer without losing values") {
+            auto sum = aggregate::Accumulator<aggregate::Sum>{};
+            auto max = aggregate::Accumulator<aggregate::Max>{};
+            for (auto i = 1; i <= 10'000; i++) {
+                CHECK(sum.add(jp::JSONValue{jp::JSONInteger{i}}));
+                max.add(jp::JSONValue{jp::JSONInteger{i}});
+            }
+            CHECK_EQ(sum.result().as_integer(), 50'005'000);
+            CHECK_EQ(max.result().as_integer(), 10'000);
+
+            sum.add(jp::JSONValue{0.5});
+            CHECK_EQ(sum.result().as_double(), doctest::Approx(50'005'000.5));
+            CHECK_FALSE(sum.add(jp::JSONValue{std::string{"x"}}));
+        }
+    }
+}
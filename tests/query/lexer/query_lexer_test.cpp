@@ -15,6 +15,16 @@ TEST_SUITE("Query Lexer") {
         }
     }
 
+    TEST_CASE("Lexer recognizes identifiers with underscores and digits") {
+        auto [tokens, errors] = query::collect_tokens("count_distinct(_items.p99)");
+
+        CHECK(errors.empty());
+        REQUIRE_EQ(tokens.size(), 6);
+        CHECK_EQ(std::get<Identifier>(tokens[0].token_type).identifier, "count_distinct");
+        CHECK_EQ(std::get<Identifier>(tokens[2].token_type).identifier, "_items");
+        CHECK_EQ(std::get<Identifier>(tokens[4].token_type).identifier, "p99");
+    }
+
     TEST_CASE("Lexer rejects unknown characters") {
         const auto source = R"(a.b.c.ce.x$)";
 
@@ -67,4 +77,16 @@ TEST_SUITE("Query Lexer") {
             CHECK(token->has_value());
         }
     }
+
+    TEST_CASE("Lexer recognizes comparison operators") {
+        auto [tokens, errors] = query::collect_tokens("== != < <= > >=");
+        CHECK(errors.empty());
+        REQUIRE_EQ(tokens.size(), 6);
+        CHECK(std::holds_alternative<EqualEqual>(tokens[0].token_type));
+        CHECK(std::holds_alternative<BangEqual>(tokens[1].token_type));
+        CHECK(std::holds_alternative<Less>(tokens[2].token_type));
+        CHECK(std::holds_alternative<LessEqual>(tokens[3].token_type));
+        CHECK(std::holds_alternative<Greater>(tokens[4].token_type));
+        CHECK(std::holds_alternative<GreaterEqual>(tokens[5].token_type));
+    }
 }
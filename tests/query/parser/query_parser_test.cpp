@@ -71,6 +71,36 @@ TEST_SUITE("Query Parser") {
             CHECK(!std::get<std::unique_ptr<Path>>(query_parsed.value())->next.value()->subscript.has_value());
             CHECK(!std::get<std::unique_ptr<Path>>(query_parsed.value())->next.value()->next.has_value());
         }
+
+        SUBCASE("Path with wildcard") {
+            const std::string query = R"(items[*].latency)";
+            auto [query_tokens, query_errors] = query::collect_tokens(query);
+            auto query_parser = query::Parser(query_tokens);
+
+            auto query_parsed = query_parser.parse();
+            REQUIRE(query_parsed.has_value());
+            const auto &path = std::get<std::unique_ptr<Path>>(query_parsed.value());
+            CHECK_EQ(path->id.identifier, "items");
+            REQUIRE(path->subscript.has_value());
+            CHECK(std::holds_alternative<Wildcard>(*path->subscript));
+            REQUIRE(path->next.has_value());
+            CHECK_EQ(path->next.value()->id.identifier, "latency");
+        }
+
+        SUBCASE("Path with comparison filter") {
+            const std::string query = R"(items[?(x>5)])";
+            auto [query_tokens, query_errors] = query::collect_tokens(query);
+            auto query_parser = query::Parser(query_tokens);
+
+            auto query_parsed = query_parser.parse();
+            REQUIRE(query_parsed.has_value());
+            const auto &path = std::get<std::unique_ptr<Path>>(query_parsed.value());
+            REQUIRE(path->subscript.has_value());
+            const auto &filter = std::get<std::unique_ptr<Filter>>(*path->subscript);
+            CHECK_EQ(filter->field->id.identifier, "x");
+            CHECK(std::holds_alternative<Greater>(filter->op.token_type));
+            CHECK_EQ(std::get<Integer>(filter->value).value, 5);
+        }
     }
 
     TEST_CASE("Parser accepts unary expressions") {
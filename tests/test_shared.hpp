@@ -9,6 +9,7 @@
 #include <sstream>
 #include <string>
 #include <filesystem>
+#include <unistd.h>
 #include <vector>
 
 inline auto read_file(const std::string &filename) -> std::optional<std::string> {
@@ -57,3 +58,26 @@ inline auto read_test_files(const std::filesystem::path &dir) -> std::pair<std::
 
     return {filename, *filecontent};
 }
+
+// Files written to a fresh directory that is removed again at the end of the test
+struct TemporaryFiles {
+    TemporaryFiles()
+        : directory(std::filesystem::temp_directory_path() / ("json_eval_test_" + std::to_string(::getpid()))) {
+        std::filesystem::create_directories(directory);
+    }
+    ~TemporaryFiles() { std::filesystem::remove_all(directory); }
+
+    TemporaryFiles(const TemporaryFiles &) = delete;
+    TemporaryFiles &operator=(const TemporaryFiles &) = delete;
+
+    // `name` may contain directories, they are created
+    auto add(const std::string &name, const std::string &content) -> std::string {
+        const auto path = directory / name;
+        std::filesystem::create_directories(path.parent_path());
+        auto file = std::ofstream(path, std::ios::binary);
+        file << content;
+        return path.string();
+    }
+
+    std::filesystem::path directory;
+};
@@ -1,20 +1,26 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include <doctest/doctest.h>
-#include "lexer.hpp"
+#include "parser.hpp"
 #include "expected.hpp"
-#include "token.hpp"
 #include "error.hpp"
 #include <fstream>
 #include "test_shared.hpp"
 
 using namespace jp;
 
+// y_ files must parse and n_ files must be rejected. i_ files are left to the implementation, they only have to be
+// handled without crashing.
 TEST_CASE("JSONTestSuite") {
     auto dir = std::filesystem::path(TESTS_DIR);
 
     auto [filename, filecontent] = read_test_files(dir);
-    auto lexer = Lexer(filecontent);
     INFO("Filename: " << filename);
 
-    CHECK(true);
+    const auto result = parse(filecontent);
+    if (filename.starts_with("y_") && !result.has_value()) {
+        FAIL_CHECK(filename << " was rejected: " << result.error().front().message());
+    }
+    if (filename.starts_with("n_") && result.has_value()) {
+        FAIL_CHECK(filename << " was accepted");
+    }
 }